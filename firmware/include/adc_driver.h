@@ -0,0 +1,114 @@
+// firmware/include/adc_driver.h
+
+#ifndef ADC_DRIVER_H
+#define ADC_DRIVER_H
+
+#include <stdint.h>
+
+class SampleClock;
+
+// Scan-mode acquisition of the six analyte channels (A0..A5).
+//
+// On the nRF52832 the SAADC is configured once with all six channels
+// enabled, so one SAMPLE task converts every channel back to back into an
+// EasyDMA result buffer. Two result buffers alternate: the SAADC fills one
+// while the END interrupt copies the other into a small frame queue, and the
+// main loop takes frames from the queue when it is ready for them.
+//
+// Host builds replace the SAADC with a stand-in that produces synthetic or
+// recorded frames through the same queue, so acquisition can be exercised
+// and benchmarked off-target.
+
+#define ADC_SCAN_CHANNELS       6
+#define ADC_FRAME_QUEUE_DEPTH   4       // Power of two
+#define ADC_SCAN_TIMEOUT_US     1000    // Six conversions take ~70 us
+#define ADC_ALL_CHANNELS        0x3F
+
+typedef struct {
+    uint16_t raw[ADC_SCAN_CHANNELS];    // 12-bit counts, A0..A5
+    uint32_t tick;                      // Trigger time, SAMPLE_CLOCK_HZ ticks
+    uint32_t timestamp_ms;              // Trigger time, millis() epoch
+    uint32_t seq;                       // Increments per completed scan
+    uint8_t mask;                       // Bit n set: raw[n] converted, else 0
+} AdcFrame;
+
+// Host stand-in: count = level + amplitude * sin(2*pi*seq/period) + noise
+typedef struct {
+    uint16_t level;
+    uint16_t amplitude;
+    uint16_t period_frames;
+    uint16_t noise;                     // Peak uniform noise, counts
+} AdcSyntheticChannel;
+
+class AdcDriver {
+public:
+    void init();
+
+    // Claim the SAADC and arm the first DMA buffer (idempotent)
+    void start();
+
+    // Release the SAADC for other users (analogRead, battery measurement)
+    void stop();
+
+    // Start one scan of the masked channels; the frame arrives in the
+    // queue. Refused while a sample clock owns the SAMPLE task.
+    bool trigger();
+
+    // Channels for scans not yet started. Disabled channels are not
+    // converted at all: the SAADC skips them and DMA packs the results.
+    // Under a clock the change lands on the scan after the one in flight.
+    void setScanMask(uint8_t mask);
+    uint8_t scanMask() const;
+    uint32_t conversions() const;       // Channel conversions since init
+
+    // Hand SAMPLE to a hardware clock (0 returns it to trigger()).
+    // Frames are then stamped with the clock's trigger tick.
+    void setTriggerClock(const SampleClock* clock);
+
+    // Take the oldest completed frame; false if none is ready
+    bool fetch(AdcFrame* frame);
+
+    // trigger() then wait for that frame, for blocking callers
+    bool acquire(AdcFrame* frame);
+
+    uint8_t pending() const;
+    uint32_t droppedFrames() const;
+    bool isRunning() const;
+
+#ifndef NRF52
+    // Host stand-in sources. Recorded frames are ADC_SCAN_CHANNELS counts each.
+    void setSyntheticSource(const AdcSyntheticChannel* channels);
+    void setRecordedSource(const uint16_t* frames, uint32_t frame_count, bool loop);
+
+    // Stand-in for the PPI-routed SAMPLE task
+    bool onExternalTrigger();
+#endif
+
+    // Completed-scan handler, called from the SAADC interrupt. result
+    // holds one count per set bit of mask, in channel order.
+    void onScanComplete(const int16_t* result, uint8_t mask);
+
+private:
+    AdcFrame queue[ADC_FRAME_QUEUE_DEPTH];
+    volatile uint8_t queue_head;        // Written by the interrupt
+    volatile uint8_t queue_tail;        // Written by the main loop
+    volatile uint32_t dropped;
+    uint32_t seq;
+    bool running;
+    const SampleClock* clock;
+    volatile uint8_t scan_mask;
+    volatile uint32_t converted;
+
+#ifndef NRF52
+    AdcSyntheticChannel synthetic[ADC_SCAN_CHANNELS];
+    const uint16_t* recorded;
+    uint32_t recorded_count;
+    uint32_t recorded_pos;
+    bool recorded_loop;
+    uint32_t noise_state;
+
+    bool generateFrame(int16_t* result);
+#endif
+};
+
+#endif
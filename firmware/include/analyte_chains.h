@@ -0,0 +1,70 @@
+// firmware/include/analyte_chains.h
+
+#ifndef ANALYTE_CHAINS_H
+#define ANALYTE_CHAINS_H
+
+#include <stdint.h>
+#include <string.h>
+#include "pipeline.h"
+#include "sensor_manager.h"
+
+#define OUTLIER_WINDOW          7       // Hampel window (samples)
+#define OUTLIER_THRESHOLD       3.0f    // Hampel threshold (scaled MADs)
+
+// Per-channel processing chains: spike rejection, Butterworth low-pass,
+// Kalman smoothing, then saturation to the analyte's detection range
+typedef Pipeline<OutlierStage, BiquadStage, KalmanStage,
+                 ClampStage<SEROTONIN_MIN_NM, SEROTONIN_MAX_NM> > SerotoninChain;
+typedef Pipeline<OutlierStage, BiquadStage, KalmanStage,
+                 ClampStage<DOPAMINE_MIN_NM, DOPAMINE_MAX_NM> > DopamineChain;
+typedef Pipeline<OutlierStage, BiquadStage, KalmanStage,
+                 ClampStage<GABA_MIN_NM, GABA_MAX_NM> > GabaChain;
+
+// The chains the firmware runs on every reading, shared with the trace
+// replay so its output is what the device would have sent
+class AnalyteChains {
+public:
+    SerotoninChain serotonin;
+    DopamineChain dopamine;
+    GabaChain gaba;
+
+    void configure() {
+        serotonin.stage<0>().configure(OUTLIER_WINDOW, OUTLIER_THRESHOLD);
+        dopamine.stage<0>().configure(OUTLIER_WINDOW, OUTLIER_THRESHOLD);
+        gaba.stage<0>().configure(OUTLIER_WINDOW, OUTLIER_THRESHOLD);
+
+        serotonin.stage<1>().configure();
+        dopamine.stage<1>().configure();
+        gaba.stage<1>().configure();
+
+        serotonin.stage<2>().configure(100.0f, 0.1f, 10.0f);
+        dopamine.stage<2>().configure(200.0f, 0.1f, 15.0f);
+        gaba.stage<2>().configure(500.0f, 0.1f, 20.0f);
+
+        memset(&filtered, 0, sizeof(filtered));
+    }
+
+    // Filter the channels converted this tick; the others hold their last
+    // filtered value
+    const SensorReading* process(const SensorReading* raw, uint8_t mask) {
+        filtered.ph_level = raw->ph_level;
+        filtered.temperature_c = raw->temperature_c;
+        filtered.calprotectin_ug_g = raw->calprotectin_ug_g;
+        filtered.timestamp_ms = raw->timestamp_ms;
+        if (mask & 0x01) {
+            filtered.serotonin_nm = serotonin.process(raw->serotonin_nm);
+        }
+        if (mask & 0x02) {
+            filtered.dopamine_nm = dopamine.process(raw->dopamine_nm);
+        }
+        if (mask & 0x04) {
+            filtered.gaba_nm = gaba.process(raw->gaba_nm);
+        }
+        return &filtered;
+    }
+
+private:
+    SensorReading filtered;
+};
+
+#endif
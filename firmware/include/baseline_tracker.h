@@ -0,0 +1,69 @@
+// firmware/include/baseline_tracker.h
+
+#ifndef BASELINE_TRACKER_H
+#define BASELINE_TRACKER_H
+
+#include <stdint.h>
+
+#define BASELINE_CHANNELS       6
+
+// Incremental baseline drift estimator fed from the normal sample stream.
+//
+// Each sample costs a few multiply-adds per channel. Within a window the
+// samples are Winsorised around a running Huber location (residuals beyond
+// BASELINE_HUBER_K robust sigmas are clipped), so spikes and short
+// excursions do not drag the baseline. At the end of each window the
+// Winsorised mean updates the baseline by EMA or, with drift fitting on, a
+// forgetting least-squares line through the window means is evaluated at
+// the current time so a steady drift is tracked without EMA lag.
+
+#define BASELINE_HUBER_K        2.0f    // Clip at k robust sigmas
+#define BASELINE_LOCATION_ALPHA 0.05f   // Running location, per sample
+#define BASELINE_SCALE_ALPHA    0.05f   // Mean absolute deviation, per sample
+#define BASELINE_SCALE_FLOOR_MV 0.5f    // Below ADC quantisation, never clip to nothing
+#define BASELINE_EMA_ALPHA      0.1f    // Per window
+#define BASELINE_FIT_FORGET     0.8f    // Per-window weight decay of the drift fit
+#define BASELINE_FIT_MIN_WINDOWS 3
+
+typedef struct {
+    float location_mv;      // Running Huber location
+    float scale_mv;         // Mean absolute deviation about it
+    float window_sum_mv;    // Winsorised samples this window
+    float baseline_mv;      // Current estimate
+
+    // Exponentially forgotten least squares over (minutes, window mean)
+    float sw, st, sy, stt, sty;
+    float slope_mv_per_min;
+} BaselineChannel;
+
+class BaselineTracker {
+public:
+    void init(uint32_t window_ms, bool fit_drift);
+
+    // Zero the estimate and restart the window, e.g. after calibration
+    void reset(uint32_t now_ms);
+
+    void setWindow(uint32_t window_ms);
+    void setDriftFit(bool enabled);
+
+    // Feed one frame in mV; true when a window closed and the estimate moved
+    bool addSample(const float* mv, uint32_t now_ms);
+
+    float baseline(uint8_t channel) const;
+    float driftPerMinute(uint8_t channel) const;
+    uint32_t windowsClosed() const;
+
+private:
+    BaselineChannel channels[BASELINE_CHANNELS];
+    uint32_t window_ms;
+    uint32_t window_start_ms;
+    uint32_t epoch_ms;
+    uint32_t window_samples;
+    uint32_t windows;
+    bool fit_drift;
+    bool primed;
+
+    void closeWindow(uint32_t now_ms);
+};
+
+#endif
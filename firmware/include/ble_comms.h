@@ -5,16 +5,38 @@
 
 #include <stdint.h>
 #include "sensor_manager.h"
+#include "reading_codec.h"
+#include "ble_link.h"
+#include "tx_queue.h"
+#include "reading_batch.h"
+#include "spectral_analysis.h"
+#include "sample_log.h"
+#include "bulk_transfer.h"
+#include "conn_params.h"
+#include "command_queue.h"
+#include "telemetry_streams.h"
+#include "broadcast.h"
+#include "retransmit.h"
 
 // BLE UUIDs for gut-brain sensing service
 #define SERVICE_UUID        "4fafc201-1fb5-459e-8fcc-c5c9c331914b"
 #define SENSOR_DATA_UUID    "beb5483e-36e1-4688-b7f5-ea07361b26a8"
 #define CONTROL_UUID        "1c95d5e3-d8f7-413a-bf3d-7a2e5d7be87e"
+#define SPECTRAL_UUID       "8d2a4c1e-5b7f-4e3a-9c61-2f0b7a9e4d53"
+#define RESPONSE_UUID       "e3b7a2d4-6c1f-4f8e-a5d0-9b2c7e41f6a8"
+#define LOG_DATA_UUID       "5c3e9f1a-7d2b-4a6c-8e05-b4f17a2c9d36"
+#define RAW_DATA_UUID       "a1d7e3b0-2f4c-4b8e-9d16-5e8c0f3a7b29"
+#define FILTERED_DATA_UUID  "6b0f2c8e-9a3d-4e17-b5c4-1d7a9e2f6c03"
+#define SUMMARY_UUID        "d42e8a6c-0b1f-4c7d-8e93-7f5a2b6c1e48"
 
-// BLE transmission parameters
-#define BLE_MTU_SIZE        20
+// BLE transmission parameters; notifications are sized from the
+// negotiated ATT MTU (ble_link.h)
 #define BLE_TX_BUFFER_SIZE  256
 
+// Advertising interval units, and ArduinoBLE's default of 100 ms
+#define BLE_ADV_UNIT_US     625
+#define BLE_ADV_INTERVAL_DEFAULT 160
+
 // Control commands
 #define CMD_START_SAMPLING  0x01
 #define CMD_STOP_SAMPLING   0x02
@@ -22,21 +44,146 @@
 #define CMD_SELF_TEST       0x04
 #define CMD_SET_INTERVAL    0x05
 #define CMD_SET_KEY         0x06
-#define CMD_REQUEST_STATUS  0x07
+#define CMD_REQUEST_STATUS  0x07    // answered with a DeviceStatus (command_queue.h)
+#define CMD_ABORT_PROCEDURE 0x08
+#define CMD_CALIBRATE_POINT 0x09    // channel, reference value (float32 LE)
+#define CMD_CLEAR_CALIBRATION 0x0A  // channel, 0xFF for all
+#define CMD_SET_CHANNEL_PERIOD 0x0B // channel, period ms (uint16 BE)
+#define CMD_SET_BATCH_LATENCY 0x0C  // max batching delay ms (uint16 BE), 0 = off
+#define CMD_LOG_SYNC        0x0D    // [from sequence (uint32 BE)], default the acknowledged one
+#define CMD_LOG_ACK         0x0E    // every logged reading before sequence (uint32 BE) received
+#define CMD_BULK_START      0x0F    // credits (uint16 BE), [from sequence (uint32 BE)]
+#define CMD_BULK_CREDIT     0x10    // further credits (uint16 BE)
+#define CMD_SET_SUMMARY_PERIOD 0x11 // summary stream period s (uint16 BE)
+#define CMD_SET_BROADCAST   0x12    // advertising snapshot interval ms (uint16 BE), 0 = off
+#define CMD_ACK_TELEMETRY   0x13    // sensor data received: base seq (uint16 BE), bitmap (uint32 BE)
 
 class BLECommsManager {
 public:
     void init();
-    void transmitEncrypted(uint8_t* data, uint16_t length);
-    void transmitSensorReading(SensorReading* reading);
+    
+    // Queued for transmission as controller buffers free up; false when
+    // disconnected or dropped by the TX queue
+    bool transmitEncrypted(uint8_t* data, uint16_t length);
+    bool transmitSensorReading(SensorReading* reading);
+    
+    // Compact quantised reading, only the channels in the mask. Batched
+    // with later readings until the notification fills or the batch
+    // latency passes; true once accepted into the batch.
+    bool transmitCompactReading(const SensorReading* reading, uint8_t mask);
+    
+    // One reading to every stream with a subscriber (telemetry_streams.h):
+    // counts for the raw stream, filtered units for the rest. True if any
+    // stream took it.
+    bool transmitReading(const SensorReading* filtered, const uint16_t* counts, uint8_t mask);
+    
+    // STREAM_BIT mask of the streams a central is subscribed to, and what
+    // each has sent since the last link stats reset
+    uint8_t activeStreams();
+    const StreamStats* streamStats();
+    void setSummaryPeriod(uint32_t ms);
+    bool transmitSpectralFeatures(SpectralFeatures* features);
+    void transmitProcedureStatus(const ProcedureStatus* status);
     bool isConnected();
+    
+    // Poll the stack, keep transmit going and run the commands queued
+    // since the last pass through their handlers (command_queue.h)
     void processControlCommands();
+    bool registerCommand(uint8_t command, uint8_t min_args, CommandHandler handler,
+                         void* context = 0);
+    void transmitStatus(const DeviceStatus* status);
+    const CommandStats* commandStats();
+    void resetCommandStats();
+    
     void setEncryptionKey(const uint8_t* key);
     
+    // Negotiated MTU / data length and transmit counts since the last reset
+    void linkStats(BleLinkStats* stats);
+    void resetLinkStats();
+    
+    // TX queue filling up: hold back what can wait
+    bool txBackpressure();
+    void setTxDropPolicy(TxDropPolicy policy);
+    const TxQueueStats* txStats();
+    
+    // Sensor data packets kept until the central acknowledges them, and
+    // resent when it reports them missing (retransmit.h)
+    const RetransmitStats* retransmitStats();
+    
+    void setBatchLatency(uint16_t ms);
+    uint16_t batchLatency();
+    const BatchStats* batchStats();
+    
+    // Catch-up of readings logged offline, on the log characteristic;
+    // sent only into controller buffers the live stream leaves free
+    void setSampleLog(SampleLog* log);
+    void startLogSync(uint32_t from);
+    bool logSyncActive();
+    
+    // History download of the same log at full speed on the 2M PHY, paced
+    // by credits from the central; replaces a catch-up sync in progress
+    void startBulkTransfer(uint32_t from, uint16_t credits);
+    void grantBulkCredits(uint16_t credits);
+    bool bulkActive();
+    const BulkStats* bulkStats();
+    
+    // Connection parameters follow the sampling interval (0 when not
+    // sampling), the batching and any backlog (conn_params.h)
+    void setSamplingInterval(uint16_t ms);
+    const ConnParams* connParams();
+    
+    // Connectionless mode (broadcast.h): while no central is connected the
+    // latest reading is advertised, encrypted, every interval; 0 turns it
+    // off. The counter resumes from what the caller persisted.
+    void setBroadcastInterval(uint16_t ms);
+    uint16_t broadcastInterval();
+    void setBroadcastCounter(uint32_t counter);
+    uint32_t broadcastCounter();
+    void broadcastReading(const SensorReading* reading);
+    
 private:
     uint8_t aes_key[16];
     bool connected;
+    ReadingCodec codec;
+    ReadingBatcher batcher;
+    SampleLog* sample_log;
+    bool log_syncing;
+    BulkTransfer bulk;
+    ConnParamPolicy conn_policy;
+    uint16_t sample_interval_ms;
+    uint16_t applied_interval;
+    uint16_t applied_latency;
+    CommandTable commands;
+    CommandStats command_stats;
+    uint32_t received_base;
+    uint32_t dropped_base;
+    uint8_t response_seq;
+    uint8_t streams;
+    SummaryStream summary;
+    StreamStats stream_stats;
+    BroadcastKeys broadcast_keys;
+    uint16_t broadcast_interval_ms;
+    uint32_t broadcast_counter;
+    uint32_t last_broadcast_ms;
+    SensorReading broadcast_snapshot;
+    bool broadcast_fresh;
+    bool advertising_snapshot;
+    
+    bool flushBatch(uint32_t now);
+    void pumpLogSync();
+    void pumpBulk(uint32_t now);
+    void manageConnParams(uint32_t now);
+    void dispatchCommands();
+    void updateStreams(uint32_t now);
+    void advertiseSnapshot(uint32_t now);
+    void advertiseDefault();
+    bool sendStream(uint8_t stream, const uint8_t* data, uint16_t length, uint16_t readings);
     
+    static uint8_t onLogSync(const uint8_t* args, uint8_t length, void* context);
+    static uint8_t onBulkStart(const uint8_t* args, uint8_t length, void* context);
+    static uint8_t onBulkCredit(const uint8_t* args, uint8_t length, void* context);
+    static uint8_t onSetSummaryPeriod(const uint8_t* args, uint8_t length, void* context);
+    static uint8_t onAckTelemetry(const uint8_t* args, uint8_t length, void* context);
     void onConnect();
     void onDisconnect();
 };
@@ -0,0 +1,83 @@
+// firmware/include/ble_frame.h
+
+#ifndef BLE_FRAME_H
+#define BLE_FRAME_H
+
+#include <stdint.h>
+
+// Frame layer for the notification characteristics.
+//
+// Every notification starts with a 4-byte header:
+//   seq (uint16 LE)      packet sequence number, per characteristic
+//   fragment (uint8)     index in the high nibble, count - 1 in the low
+//   length (uint8)       whole packet length in bytes
+// followed by that fragment's share of the packet. A packet is at most
+// FRAME_MAX_FRAGMENTS notifications and FRAME_MAX_PACKET bytes.
+//
+// The receiver never has to guess where a packet starts: fragment 0 always
+// begins one, so after a lost notification it is back in step on the next
+// packet, and sequence numbers show how many packets went missing. A
+// packet numbered behind the newest one (a resend, retransmit.h) is
+// reassembled like any other and counted as late.
+
+#define FRAME_HEADER_SIZE       4
+#define FRAME_MAX_FRAGMENTS     16
+#define FRAME_MAX_PACKET        255
+
+typedef struct {
+    uint16_t seq;
+    uint8_t index;
+    uint8_t count;
+    uint8_t length;
+} FrameHeader;
+
+void frameEncodeHeader(const FrameHeader* header, uint8_t* out);
+
+// False for a header no sender would produce
+bool frameDecodeHeader(const uint8_t* in, uint16_t length, FrameHeader* header);
+
+// Fragments needed for a packet at this notification size, 0 if too large
+uint8_t frameFragmentsFor(uint16_t length, uint16_t notify_payload);
+
+typedef struct {
+    uint32_t packets;       // Delivered whole
+    uint32_t fragments;     // Notifications accepted
+    uint32_t lost;          // Packets never seen, from sequence gaps
+    uint32_t incomplete;    // Started but missing a fragment
+    uint32_t gaps;          // Sequence discontinuities
+    uint32_t late;          // Behind the newest sequence number
+    uint32_t malformed;     // Bad headers or lengths
+} FrameStats;
+
+// Streaming reassembler for one characteristic; firmware-independent so
+// host tools can feed it captured notifications.
+class FrameReassembler {
+public:
+    void init();
+
+    // One notification in; true when it completes a packet
+    bool feed(const uint8_t* notification, uint16_t length);
+
+    const uint8_t* packet() const;
+    uint8_t packetLength() const;
+    uint16_t packetSeq() const;
+
+    const FrameStats* stats() const;
+
+private:
+    uint8_t buffer[FRAME_MAX_PACKET];
+    uint16_t received;
+    uint16_t seq;
+    uint8_t next_index;
+    uint8_t count;
+    uint8_t length;
+    bool assembling;
+    bool have_seq;
+    uint16_t last_seq;
+    uint8_t done_length;
+    FrameStats counters;
+
+    void abandon();
+};
+
+#endif
@@ -0,0 +1,150 @@
+// firmware/include/ble_link.h
+
+#ifndef BLE_LINK_H
+#define BLE_LINK_H
+
+#include <stdint.h>
+
+// Negotiated BLE link parameters and notification sizing.
+//
+// The peripheral offers the largest ATT MTU and LE data length the
+// controller supports; the central's exchange decides what is used. A
+// notification carries ATT_MTU - 3 bytes of value, and each notification
+// costs one link-layer packet per data length's worth of L2CAP PDU, so
+// payloads are split by the negotiated MTU rather than the 23-byte default.
+//
+// Notifications are handed to the controller only while it has a free ACL
+// buffer. On the nRF52 a tap on the HCI transport counts the ACL packets
+// written and the Number Of Completed Packets events that return them, so
+// the main loop never blocks inside writeValue.
+//
+// Bulk transfers ask for the 2M PHY, which halves the air time of every
+// packet; the tap follows the PHY Update Complete event for the outcome.
+//
+// Connection parameters are requested with an L2CAP Connection Parameter
+// Update, which every central handles; the tap picks the parameters in use
+// out of the Connection Complete and Connection Update Complete events and
+// counts requests the central rejects.
+//
+// Host builds stand in for the central with setPeer() and for the
+// controller's TX-complete events with completeTx().
+
+#define BLE_ATT_MTU_DEFAULT     23      // Before (or without) an MTU exchange
+#define BLE_ATT_MTU_MAX         247     // One 251-byte LL packet with DLE
+#define BLE_DATA_LENGTH_DEFAULT 27      // LL payload octets, Bluetooth 4.0/4.1
+#define BLE_DATA_LENGTH_MAX     251     // Data Length Extension, 4.2+
+#define BLE_DATA_TIME_MAX_US    2120    // 251 octets on the 1M PHY
+#define BLE_ATT_NOTIFY_OVERHEAD 3       // Opcode + attribute handle
+#define BLE_L2CAP_HEADER        4
+#define BLE_TX_BUFFERS_DEFAULT  3       // Until the controller reports its count
+#define BLE_LL_PACKET_OVERHEAD  10      // Preamble, access address, header, CRC (1M PHY)
+#define BLE_T_IFS_US            150     // Inter-frame space
+#define BLE_PHY_1M              1
+#define BLE_PHY_2M              2
+#define BLE_CONN_INTERVAL_DEFAULT 24    // 30 ms, 1.25 ms units; until the controller reports it
+
+typedef struct {
+    uint16_t att_mtu;
+    uint16_t data_length;
+    uint8_t phy;
+    uint16_t conn_interval;     // 1.25 ms units
+    uint16_t conn_latency;
+    uint32_t payloads;          // transmit calls
+    uint32_t readings;          // Carried by those payloads
+    uint32_t notifications;
+    uint32_t link_packets;      // LL data packets, from the data length
+    uint32_t bytes;             // Notification value bytes
+    uint32_t air_bytes;         // Including L2CAP/ATT headers and LL framing
+    uint32_t window_ms;         // Since the last reset
+    uint32_t bytes_per_sec;
+    uint16_t notifications_per_payload_x100;
+    uint16_t air_bytes_per_reading;
+} BleLinkStats;
+
+class BleLink {
+public:
+    // Offer the maximum MTU and data length to every connection
+    void init();
+
+    // Request the larger MTU and data length on a new link; stats restart
+    void onConnect(const char* address);
+    void onDisconnect();
+
+    // Pick up an exchange the central started after the connection
+    void update();
+
+    uint16_t attMtu() const;
+    uint16_t dataLength() const;
+
+    // Value bytes per notification at the negotiated MTU
+    uint16_t notifyPayload() const;
+    uint16_t notificationsFor(uint16_t length) const;
+    uint16_t linkPacketsFor(uint16_t length) const;
+    uint32_t airBytesFor(uint16_t length) const;
+
+    // Ask for a PHY; the central may refuse, phy() says what is in use
+    void setPhy(uint8_t phy);
+    uint8_t phy() const;
+
+    // Radio time for a notification: each LL packet, the central's empty
+    // acknowledgement and the inter-frame spaces, at the current PHY
+    uint32_t airTimeUsFor(uint16_t length) const;
+
+    // Ask the central for new connection parameters, in HCI units; the
+    // conn*() getters report what the central applied
+    void requestConnParams(uint16_t interval_min, uint16_t interval_max, uint16_t latency,
+                           uint16_t timeout);
+    uint16_t connInterval() const;
+    uint16_t connLatency() const;
+    uint16_t connTimeout() const;
+    uint8_t connParamRejects() const;
+
+    // Controller buffers free for another notification
+    uint8_t txCredits() const;
+    void onTxSent();
+
+    // Account one payload sent as notifications
+    void record(uint16_t length, uint16_t notifications, uint16_t readings = 1);
+    void stats(BleLinkStats* out) const;
+    void resetStats();
+
+#ifndef NRF52
+    // Host: what the simulated central supports; used on the next connect
+    void setPeer(uint16_t att_mtu, uint16_t data_length, uint8_t phy = BLE_PHY_2M);
+
+    // Host: whether the simulated central accepts parameter requests
+    void setPeerAcceptsConnParams(bool accept);
+
+    // Host: controller ACL buffer count, and buffers the controller returns
+    void setTxBuffers(uint8_t count);
+    void completeTx(uint8_t count);
+#endif
+
+private:
+    uint16_t att_mtu;
+    uint16_t data_length;
+    uint16_t conn_handle;
+    uint32_t payloads;
+    uint32_t readings;
+    uint32_t notifications;
+    uint32_t link_packets;
+    uint32_t bytes;
+    uint32_t air_bytes;
+    uint32_t window_start;
+
+#ifndef NRF52
+    uint16_t peer_mtu;
+    uint16_t peer_data_length;
+    uint8_t peer_phy;
+    uint8_t current_phy;
+    bool peer_accepts_params;
+    uint16_t current_interval;
+    uint16_t current_latency;
+    uint16_t current_timeout;
+    uint8_t rejects;
+    uint8_t tx_buffers;
+    uint8_t tx_outstanding;
+#endif
+};
+
+#endif
@@ -0,0 +1,72 @@
+// firmware/include/broadcast.h
+
+#ifndef BROADCAST_H
+#define BROADCAST_H
+
+#include <stdint.h>
+#include "aes.h"
+
+// Latest reading in advertising packets, for hubs that only show values
+// and never connect.
+//
+// ArduinoBLE drives legacy advertising only, so the snapshot travels as
+// manufacturer data in a 31-byte advertising packet next to the flags;
+// the name and service UUID move to the scan response. After the company
+// id the payload is:
+//   version, counter (uint32 LE), ciphertext, tag (4 bytes)
+// The ciphertext is a compact reading (reading_codec.h) under AES-128 in
+// counter mode, the counter as nonce; the tag is a truncated CBC-MAC over
+// version, counter and ciphertext. Both keys are derived from the session
+// key. The counter goes up with every new snapshot and is never reused
+// across resets (the caller persists a reserve ahead of it), so a receiver
+// drops anything at or below the last counter it accepted.
+
+#define BROADCAST_COMPANY_ID        0xFFFF  // Bluetooth SIG test id; replace before shipping
+#define BROADCAST_VERSION           1
+#define BROADCAST_HEADER_SIZE       5
+#define BROADCAST_TAG_SIZE          4
+#define BROADCAST_MAX_PLAIN         12      // Compact reading, every channel
+#define BROADCAST_MAX_SIZE          (BROADCAST_HEADER_SIZE + BROADCAST_MAX_PLAIN + BROADCAST_TAG_SIZE)
+#define BROADCAST_ADV_OVERHEAD      7       // Flags AD, manufacturer AD header, company id
+#define BROADCAST_ADV_MAX           31
+
+#define BROADCAST_INTERVAL_MIN_MS   100
+#define BROADCAST_INTERVAL_MAX_MS   10240
+#define BROADCAST_COUNTER_RESERVE   256     // Counters persisted ahead
+
+typedef struct {
+    AESContext enc;
+    AESContext mac;
+} BroadcastKeys;
+
+void broadcastDeriveKeys(const uint8_t* key, BroadcastKeys* keys);
+
+// Payload after the company id; returns its length
+uint8_t broadcastSeal(const BroadcastKeys* keys, uint32_t counter, const uint8_t* plain, uint8_t length,
+                      uint8_t* out);
+
+// Plaintext length, or 0 for a short, unknown or forged payload
+uint8_t broadcastOpen(const BroadcastKeys* keys, const uint8_t* in, uint8_t length, uint32_t* counter,
+                      uint8_t* plain);
+
+typedef struct {
+    uint32_t accepted;
+    uint32_t forged;            // Bad tag, version or length
+    uint32_t replayed;          // Counter not above the last accepted
+} BroadcastStats;
+
+// Receiving end, as a hub would run it
+class BroadcastReceiver {
+public:
+    void init(const uint8_t* key);
+    uint8_t receive(const uint8_t* in, uint8_t length, uint32_t* counter, uint8_t* plain);
+    const BroadcastStats* stats() const;
+
+private:
+    BroadcastKeys keys;
+    uint32_t last_counter;
+    bool have_last;
+    BroadcastStats counts;
+};
+
+#endif
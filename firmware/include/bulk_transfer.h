@@ -0,0 +1,61 @@
+// firmware/include/bulk_transfer.h
+
+#ifndef BULK_TRANSFER_H
+#define BULK_TRANSFER_H
+
+#include <stdint.h>
+#include "sample_log.h"
+#include "tx_queue.h"
+#include "ble_link.h"
+
+// History download: the offline log streamed back-to-back on the 2M PHY.
+//
+// Unlike the catch-up sync, which only uses buffers the live stream leaves
+// free, a bulk transfer keeps a few notifications queued ahead of the
+// controller so no connection event goes unused. Packets are the log's
+// catch-up packets (sample_log.h), end marker included. Flow control is
+// credit based: the central grants one credit per packet it can buffer
+// and returns them as it processes packets; with no credits left the
+// transfer waits instead of overrunning it.
+
+#define BULK_QUEUE_AHEAD        4       // Notifications queued ahead of the controller
+#define BULK_MAX_CREDITS        255
+
+typedef struct {
+    uint32_t packets;
+    uint32_t readings;
+    uint32_t bytes;             // Notification value bytes, frame headers included
+    uint32_t credit_stalls;     // Services that found no credit left
+    uint32_t elapsed_ms;        // Start to end marker, or so far
+    uint32_t bytes_per_sec;
+    uint8_t phy;
+} BulkStats;
+
+class BulkTransfer {
+public:
+    void init();
+
+    // Stream from wherever the log was seek()ed to; the central has room
+    // for credits packets
+    void start(uint16_t credits, uint32_t now);
+    void grant(uint16_t credits);
+    void stop(uint32_t now);
+    bool active() const;
+
+    // Encrypt and queue packets while credits and queue room last; the
+    // caller hands the queue to the controller. Returns packets queued.
+    uint16_t service(SampleLog* log, TxQueue* queue, BleLink* link, uint8_t target,
+                     const uint8_t* key, uint32_t now);
+
+    const BulkStats* stats() const;
+
+private:
+    bool running;
+    uint16_t credits;
+    uint32_t started;
+    BulkStats counters;
+
+    void finish(uint32_t now);
+};
+
+#endif
@@ -0,0 +1,102 @@
+// firmware/include/calibration_lut.h
+
+#ifndef CALIBRATION_LUT_H
+#define CALIBRATION_LUT_H
+
+#include <stdint.h>
+#include "conversion_kernels.h"
+
+// Multi-point calibration as a per-channel lookup table on a uniform grid
+// of raw ADC counts. The piecewise-linear curve through the calibration
+// points is resampled into cells of 2^CAL_LUT_CELL_BITS counts when
+// calibration or baseline changes, so a conversion is one shift, one mask
+// and one multiply-add - no search over the points.
+//
+// Sensitivity drifts with temperature: the sensor's response about the
+// zero point grows by (1 + temp_coeff * (T - T_cal)), so it is divided by
+// that factor to refer it back to the calibration. T comes from the A4
+// channel and T_cal is the mean temperature the points were taken at.
+
+#define CAL_LUT_MAX_POINTS  8
+#define CAL_LUT_CELL_BITS   7
+#define CAL_LUT_CELLS       (4096 >> CAL_LUT_CELL_BITS)
+#define CAL_LUT_CELL_MASK   ((1 << CAL_LUT_CELL_BITS) - 1)
+#define CAL_COMP_SHIFT      16      // Fixed-point temperature factor, Q16
+#define CAL_SENS_MIN        0.25f   // Floor on the sensitivity factor
+
+typedef struct {
+    float mv;           // Measured in the standard solution
+    float units;        // Reference value of the standard
+    float temp_c;       // Temperature it was measured at
+} CalPoint;
+
+// One grid cell: units relative to the zero point at the cell's first
+// count, and the slope across it
+typedef struct {
+    float base;
+    float slope;        // Per count
+} CalLutCell;
+
+typedef struct {
+    CalLutCell cells[CAL_LUT_CELLS];
+    float zero;         // Pivot of the temperature scaling
+    float temp_coeff;   // Sensor's fractional sensitivity change per degree C
+    float ref_temp_c;
+    float min_value;    // Saturation limits
+    float max_value;
+} ChannelLut;
+
+typedef struct {
+    int32_t base_q;     // Q(FIXED_FRAC_BITS)
+    int32_t slope_q;    // Per count, Q(FIXED_FRAC_BITS + FIXED_COEFF_SHIFT)
+} FixedLutCell;
+
+typedef struct {
+    FixedLutCell cells[CAL_LUT_CELLS];
+    int32_t zero_q;         // Q(FIXED_FRAC_BITS)
+    int32_t temp_coeff_q;   // Per degree C, Q(CAL_COMP_SHIFT)
+    int32_t ref_temp_q;     // Q(FIXED_FRAC_BITS)
+    int32_t min_q;
+    int32_t max_q;
+} FixedChannelLut;
+
+// Resample the curve through points (any order, at least two distinct mV)
+// with mv = count * mv_per_count - baseline_mv. Returns false, leaving the
+// table untouched, if the points do not define a curve.
+bool buildChannelLut(ChannelLut* lut, const CalPoint* points, uint8_t count,
+                     float mv_per_count, float baseline_mv, float units_at_zero,
+                     float temp_coeff, float min_value, float max_value);
+
+void buildFixedLut(FixedChannelLut* fixed, const ChannelLut* lut);
+
+// Temperature factors, computed once per frame: the reciprocal of the
+// sensitivity at temp, so the per-channel conversion stays a multiply
+static inline float lutCompensation(const ChannelLut* lut, float temp_c) {
+    float sensitivity = 1.0f + lut->temp_coeff * (temp_c - lut->ref_temp_c);
+    return 1.0f / ((sensitivity > CAL_SENS_MIN) ? sensitivity : CAL_SENS_MIN);
+}
+
+static inline int32_t lutCompensationFixed(const FixedChannelLut* lut, int32_t temp_q) {
+    const int32_t min_q = (int32_t)(CAL_SENS_MIN * (1 << CAL_COMP_SHIFT));
+    int64_t dt_q = (int64_t)temp_q - lut->ref_temp_q;
+    int32_t sensitivity_q = (1 << CAL_COMP_SHIFT) + (int32_t)((lut->temp_coeff_q * dt_q) >> FIXED_FRAC_BITS);
+    if (sensitivity_q < min_q) sensitivity_q = min_q;
+    return (int32_t)(((int64_t)1 << (2 * CAL_COMP_SHIFT)) / sensitivity_q);
+}
+
+static inline float convertChannelLut(const ChannelLut* lut, uint16_t raw, float comp) {
+    const CalLutCell* cell = &lut->cells[(raw >> CAL_LUT_CELL_BITS) & (CAL_LUT_CELLS - 1)];
+    float v = lut->zero + (cell->base + cell->slope * (raw & CAL_LUT_CELL_MASK)) * comp;
+    v = (v < lut->min_value) ? lut->min_value : v;
+    return (v > lut->max_value) ? lut->max_value : v;
+}
+
+static inline int32_t convertChannelLutFixed(const FixedChannelLut* lut, uint16_t raw, int32_t comp_q) {
+    const FixedLutCell* cell = &lut->cells[(raw >> CAL_LUT_CELL_BITS) & (CAL_LUT_CELLS - 1)];
+    int64_t rel = cell->base_q + (((int64_t)cell->slope_q * (raw & CAL_LUT_CELL_MASK)) >> FIXED_COEFF_SHIFT);
+    int64_t v = lut->zero_q + ((rel * comp_q) >> CAL_COMP_SHIFT);
+    v = (v < lut->min_q) ? lut->min_q : v;
+    return (int32_t)((v > lut->max_q) ? lut->max_q : v);
+}
+
+#endif
@@ -0,0 +1,46 @@
+// firmware/include/channel_scheduler.h
+
+#ifndef CHANNEL_SCHEDULER_H
+#define CHANNEL_SCHEDULER_H
+
+#include <stdint.h>
+
+#define SCHED_CHANNELS      6
+#define SCHED_MAX_DIVIDER   255
+
+// Per-channel sampling periods on a common base tick.
+//
+// The base period is the sampling interval; each channel runs every
+// divider-th base tick, its period rounded to the nearest multiple of the
+// base. Channels due on the same tick are converted by one scan, and all
+// dividers share tick 0, so slow channels always land on a tick where the
+// fast ones are being converted anyway. The clock triggers every base tick,
+// so the fastest channel always runs at the base period.
+class ChannelScheduler {
+public:
+    void init(uint16_t base_ms);
+
+    // Changing the base keeps each channel's period in ms
+    void setBasePeriod(uint16_t base_ms);
+    uint16_t basePeriod() const;
+
+    // 0 or anything at or below the base: every tick
+    void setPeriod(uint8_t channel, uint16_t period_ms);
+    uint32_t period(uint8_t channel) const;     // As scheduled, rounded
+
+    // Channels due on base tick n (bit n: channel An)
+    uint8_t dueMask(uint32_t tick) const;
+
+    // Channel conversions per hyperperiod against converting all of them
+    // every tick, in percent
+    uint8_t conversionPercent() const;
+
+private:
+    uint16_t base_ms;
+    uint16_t requested_ms[SCHED_CHANNELS];
+    uint8_t divider[SCHED_CHANNELS];
+
+    void recompute();
+};
+
+#endif
@@ -0,0 +1,130 @@
+// firmware/include/command_queue.h
+
+#ifndef COMMAND_QUEUE_H
+#define COMMAND_QUEUE_H
+
+#include <stdint.h>
+
+// Control-point commands, captured when they are written and run from the
+// main loop.
+//
+// The control characteristic's write handler copies each write, with its
+// arrival time, into a single-producer single-consumer ring: the head is
+// only advanced by the writer and the tail only by the main loop, so
+// neither side takes a lock or masks interrupts. The main loop drains a
+// few commands per pass and dispatches each through a table of registered
+// handlers; the handler's status goes back to the central in an
+// acknowledgement that also carries the time from arrival to answer.
+//
+// Response characteristic, first byte the type:
+//   RESP_ACK        command, status, sequence, latency us (uint32 LE)
+//   RESP_STATUS     DeviceStatus
+//   RESP_PROCEDURE  ProcedureStatus
+
+#define CMD_QUEUE_DEPTH         8       // Power of two
+#define CMD_MAX_LENGTH          20      // Control characteristic size
+#define CMD_MAX_HANDLERS        24
+#define CMD_DISPATCH_PER_PASS   4
+
+// Handler results, returned in the acknowledgement
+#define CMD_STATUS_OK           0x00
+#define CMD_STATUS_UNKNOWN      0x01    // No handler registered
+#define CMD_STATUS_BAD_LENGTH   0x02    // Fewer argument bytes than required
+#define CMD_STATUS_REJECTED     0x03    // Valid, but refused in this state
+#define CMD_STATUS_BUSY         0x04    // Something else is running
+
+#define RESP_ACK                0x80
+#define RESP_STATUS             0x81
+#define RESP_PROCEDURE          0x82
+#define RESP_ACK_SIZE           8
+
+typedef struct {
+    uint8_t length;
+    uint8_t data[CMD_MAX_LENGTH];   // Command byte, then arguments
+    uint32_t received_us;
+} Command;
+
+// Arguments exclude the command byte; returns a CMD_STATUS_ value
+typedef uint8_t (*CommandHandler)(const uint8_t* args, uint8_t length, void* context);
+
+typedef struct {
+    uint32_t received;
+    uint32_t dropped;           // Ring full
+    uint32_t dispatched;
+    uint32_t failed;            // Answered with anything but OK
+    uint32_t latency_max_us;    // Arrival to acknowledgement
+    uint64_t latency_total_us;
+} CommandStats;
+
+class CommandQueue {
+public:
+    void init();
+
+    // Writer side; false when full, counted as dropped
+    bool push(const uint8_t* data, uint8_t length, uint32_t now_us);
+
+    // Main loop side: oldest command or 0, then pop() it
+    const Command* peek() const;
+    void pop();
+
+    uint8_t count() const;
+    uint32_t received() const;
+    uint32_t dropped() const;
+
+private:
+    Command slots[CMD_QUEUE_DEPTH];
+    volatile uint8_t queue_head;        // Written by the writer
+    volatile uint8_t queue_tail;        // Written by the main loop
+    volatile uint32_t pushed;
+    volatile uint32_t drops;
+};
+
+class CommandTable {
+public:
+    void init();
+
+    // Replaces an earlier handler for the same command; false when full
+    bool add(uint8_t command, uint8_t min_args, CommandHandler handler, void* context = 0);
+
+    uint8_t dispatch(const Command* command) const;
+
+private:
+    struct Entry {
+        uint8_t command;
+        uint8_t min_args;
+        CommandHandler handler;
+        void* context;
+    };
+    Entry entries[CMD_MAX_HANDLERS];
+    uint8_t used;
+};
+
+// Status snapshot answered to CMD_REQUEST_STATUS; encoded little-endian
+// after the RESP_STATUS byte, RESP_STATUS_SIZE bytes in all
+#define STATUS_SAMPLING         0x01
+#define STATUS_KEY_SET          0x02
+#define STATUS_LOG_SYNC         0x04
+#define STATUS_BULK             0x08
+#define STATUS_PROCEDURE        0x10
+#define STATUS_BACKPRESSURE     0x20
+#define RESP_STATUS_SIZE        19
+
+typedef struct {
+    uint8_t flags;                  // STATUS_ bits
+    uint8_t battery_percent;
+    uint16_t sampling_interval_ms;
+    uint32_t uptime_s;
+    uint32_t log_pending;           // Logged readings not yet acknowledged
+    uint16_t conn_interval;         // 1.25 ms units
+    uint8_t conn_latency;           // Saturates at 255
+    uint8_t phy;
+    uint8_t procedure_percent;
+    uint8_t command_drops;          // Saturates at 255
+} DeviceStatus;
+
+// Encoders for the response characteristic; return the length
+uint8_t commandEncodeAck(uint8_t command, uint8_t status, uint8_t seq, uint32_t latency_us,
+                         uint8_t* out);
+uint8_t commandEncodeStatus(const DeviceStatus* status, uint8_t* out);
+
+#endif
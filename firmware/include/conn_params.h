@@ -0,0 +1,102 @@
+// firmware/include/conn_params.h
+
+#ifndef CONN_PARAMS_H
+#define CONN_PARAMS_H
+
+#include <stdint.h>
+#include "ble_link.h"
+
+// Connection interval and slave latency chosen from what the link carries.
+//
+// A notification waits at most one interval for its connection event,
+// while slave latency lets the peripheral sleep through events it has
+// nothing to send in; the central's own traffic (commands, credits) waits
+// up to interval x (latency + 1). So the interval follows how often
+// payloads leave the batcher and the latency stretches the sleeps between
+// them:
+//   bulk     shortest interval, no latency: every event carries data
+//   backlog  catch-up sync or a backed-up queue: short interval
+//   stream   interval a quarter of the payload period, latency up to it
+//   idle     long interval, the longest sleep the central accepts
+// Every mode stays within what iOS accepts: interval 15 ms or more, max at
+// least min + 15 ms unless both are 15 ms, latency <= 30, interval x
+// (latency + 1) <= 2 s and a supervision timeout of 6 s or less.
+//
+// Parameters are in HCI units: intervals of 1.25 ms, timeout of 10 ms.
+
+#define CONN_UNIT_US                1250
+#define CONN_TIMEOUT_UNIT_MS        10
+
+#define CONN_BULK_INTERVAL          12      // 15 ms; DLE fills the event
+#define CONN_BACKLOG_INTERVAL_MIN   12      // 15 ms
+#define CONN_BACKLOG_INTERVAL_MAX   24      // 30 ms
+#define CONN_STREAM_INTERVAL_MIN    24      // 30 ms
+#define CONN_STREAM_INTERVAL_MAX    80      // 100 ms
+#define CONN_IDLE_INTERVAL          80      // 100 ms
+#define CONN_INTERVAL_SPREAD        12      // max - min, 15 ms
+#define CONN_MAX_LATENCY            30
+#define CONN_MAX_SLEEP_MS           2000    // interval x (latency + 1)
+#define CONN_TIMEOUT_MIN_MS         2000
+#define CONN_TIMEOUT_MAX_MS         6000
+#define CONN_PAYLOAD_WAIT_DIV       4       // Payload waits a quarter period at most
+#define CONN_RELAX_HOLDOFF_MS       10000   // Before loosening again
+#define CONN_SETTLE_MS              5000    // Discovery and MTU exchange go first
+#define CONN_EVENT_BASE_US          450     // Ramp-up, RX window and an empty exchange
+
+#define CONN_MODE_IDLE              0
+#define CONN_MODE_STREAM            1
+#define CONN_MODE_BACKLOG           2
+#define CONN_MODE_BULK              3
+
+typedef struct {
+    uint16_t sample_interval_ms;    // 0 when not sampling
+    uint16_t batch_capacity;        // Plaintext bytes per batch
+    uint16_t batch_latency_ms;      // 0 = every reading alone
+    uint8_t reading_size;           // Compact reading, every channel
+    bool backlog;                   // Catch-up sync or queue backpressure
+    bool bulk;
+} ConnDemand;
+
+typedef struct {
+    uint8_t mode;
+    uint16_t interval_min;          // 1.25 ms units
+    uint16_t interval_max;
+    uint16_t latency;               // Events the peripheral may skip
+    uint16_t timeout;               // 10 ms units
+    uint32_t payload_period_ms;     // 0 without a stream
+    uint16_t duty_x100;             // Estimated radio duty cycle, % x 100
+} ConnParams;
+
+class ConnParamPolicy {
+public:
+    void init();
+
+    // Parameters for this demand; air time comes from the link's MTU,
+    // data length and PHY
+    static void choose(const ConnDemand* demand, const BleLink* link, ConnParams* out);
+
+    // Radio on-time at these parameters, one payload per period costing
+    // payload_air_us on top of the empty exchange
+    static uint16_t dutyCycleX100(const ConnParams* params, uint32_t payload_period_ms,
+                                  uint32_t payload_air_us);
+
+    // Parameters to request now, or false to keep the last request:
+    // tighter ones go at once, looser ones after CONN_RELAX_HOLDOFF_MS.
+    // Nothing is requested in the first CONN_SETTLE_MS of a connection
+    // unless a bulk transfer starts.
+    bool update(const ConnDemand* demand, const BleLink* link, uint32_t now, ConnParams* out);
+
+    // Forget the last request on a new connection
+    void reset(uint32_t now);
+
+    const ConnParams* requested() const;
+    uint32_t requests() const;
+
+private:
+    ConnParams last;
+    bool have_last;
+    uint32_t last_ms;
+    uint32_t count;
+};
+
+#endif
@@ -0,0 +1,57 @@
+// firmware/include/conversion_kernels.h
+
+#ifndef CONVERSION_KERNELS_H
+#define CONVERSION_KERNELS_H
+
+#include <stdint.h>
+
+// Fixed-point output format: engineering units * 2^FIXED_FRAC_BITS
+#define FIXED_FRAC_BITS     8
+#define FIXED_COEFF_SHIFT   16      // Extra coefficient precision, dropped after the MAC
+
+// Raw ADC counts to engineering units as one affine map plus saturation.
+// Offset, gain, baseline and the per-analyte factor are folded into
+// scale/offset whenever calibration or baseline changes.
+typedef struct {
+    float scale;        // Units per ADC count
+    float offset;       // Units at count 0
+    float min_value;    // Saturation limits
+    float max_value;
+} ChannelTransform;
+
+// Integer-only equivalent producing units in Q(FIXED_FRAC_BITS)
+typedef struct {
+    int32_t scale_q;    // Units per count, Q(FIXED_FRAC_BITS + FIXED_COEFF_SHIFT)
+    int64_t offset_q;   // Units at count 0, same format
+    int32_t min_q;      // Saturation limits, Q(FIXED_FRAC_BITS)
+    int32_t max_q;
+} FixedChannelTransform;
+
+// units = units_at_zero + units_per_mv * ((mv - cal_offset_mv) * cal_gain - baseline_mv)
+void buildChannelTransform(ChannelTransform* transform, float mv_per_count,
+                           float units_per_mv, float units_at_zero,
+                           float cal_offset_mv, float cal_gain, float baseline_mv,
+                           float min_value, float max_value);
+
+void buildFixedTransform(FixedChannelTransform* fixed, const ChannelTransform* transform);
+
+// Convert one frame of channels; the loops carry no data-dependent branches
+void convertChannels(const ChannelTransform* transforms, const uint16_t* raw,
+                     float* out, uint8_t channels);
+void convertChannelsFixed(const FixedChannelTransform* transforms, const uint16_t* raw,
+                          int32_t* out_q, uint8_t channels);
+
+static inline float convertChannel(const ChannelTransform* t, uint16_t raw) {
+    float v = raw * t->scale + t->offset;
+    v = (v < t->min_value) ? t->min_value : v;
+    return (v > t->max_value) ? t->max_value : v;
+}
+
+static inline int32_t convertChannelFixed(const FixedChannelTransform* t, uint16_t raw) {
+    int64_t acc = (int64_t)raw * t->scale_q + t->offset_q;
+    int64_t v = acc >> FIXED_COEFF_SHIFT;
+    v = (v < t->min_q) ? t->min_q : v;
+    return (int32_t)((v > t->max_q) ? t->max_q : v);
+}
+
+#endif
@@ -0,0 +1,12 @@
+// firmware/include/crc32.h
+
+#ifndef CRC32_H
+#define CRC32_H
+
+#include <stdint.h>
+
+// CRC-32 (IEEE 802.3, reflected 0xEDB88320), chainable like zlib:
+// crc = crc32(0, a, n); crc = crc32(crc, b, m);
+uint32_t crc32(uint32_t crc, const void* data, uint32_t length);
+
+#endif
@@ -0,0 +1,42 @@
+// firmware/include/cycle_counter.h
+
+#ifndef CYCLE_COUNTER_H
+#define CYCLE_COUNTER_H
+
+#include <stdint.h>
+
+// Free-running counter for micro-benchmarks.
+// On the nRF52832 this is the Cortex-M4 DWT cycle counter (64 MHz core clock);
+// on host builds it is CLOCK_MONOTONIC in nanoseconds. Differences are taken
+// as uint32_t so a single wrap between two reads is harmless.
+
+#ifdef NRF52
+#include <nrf.h>
+
+#define CYCLE_COUNTER_HZ    64000000UL
+
+static inline void cycle_counter_init() {
+    CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk;
+    DWT->CYCCNT = 0;
+    DWT->CTRL |= DWT_CTRL_CYCCNTENA_Msk;
+}
+
+static inline uint32_t cycle_counter_read() {
+    return DWT->CYCCNT;
+}
+#else
+#include <time.h>
+
+#define CYCLE_COUNTER_HZ    1000000000UL
+
+static inline void cycle_counter_init() {
+}
+
+static inline uint32_t cycle_counter_read() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint32_t)((uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec);
+}
+#endif
+
+#endif
@@ -0,0 +1,76 @@
+// firmware/include/flash_device.h
+
+#ifndef FLASH_DEVICE_H
+#define FLASH_DEVICE_H
+
+#include <stdint.h>
+
+// A region of internal flash: the persistent records, or the offline
+// sample log after them. NOR semantics: erase sets a whole page to 0xFF,
+// writes can only clear bits and must be whole aligned words. Offsets are
+// relative to the start of the region.
+#define FLASH_PAGE_SIZE         4096
+#define FLASH_WORD_SIZE         4
+#define FLASH_STORE_PAGES       4
+#define FLASH_LOG_PAGES         12
+
+#ifndef FLASH_STORE_BASE
+#define FLASH_STORE_BASE        0x70000     // Start of the configuration region
+#endif
+#define FLASH_LOG_BASE          (FLASH_STORE_BASE + FLASH_STORE_PAGES * FLASH_PAGE_SIZE)
+
+class FlashDevice {
+public:
+    // Host builds take the size from open() instead
+    void init(uint32_t base = FLASH_STORE_BASE, uint16_t page_count = FLASH_STORE_PAGES);
+
+    uint32_t size() const;
+    uint16_t pageCount() const;
+
+    // Flash is memory-mapped on the nRF52; reads never wait
+    void read(uint32_t offset, void* data, uint32_t length) const;
+
+    // Word-aligned offset and length; blocks until the SoftDevice reports
+    // the operation done
+    bool write(uint32_t offset, const void* data, uint32_t length);
+    bool erasePage(uint16_t page);
+
+    // Word-aligned, like write(). Erased flash reads all 0xFF; anything
+    // else, a cut-short write included, must not be programmed over.
+    bool blank(uint32_t offset, uint32_t length) const;
+
+    // Erase the page unless it already reads blank, sparing wear
+    bool ensureErased(uint16_t page);
+
+#ifdef NRF52
+    // SoC events from the SoftDevice dispatcher
+    static void onSocEvent(uint32_t evt);
+#else
+    // Host stand-in: the region lives in a file so records survive a
+    // "reboot" (close, then open again)
+    bool open(const char* path, uint16_t pages);
+    void close();
+
+    uint32_t eraseCount(uint16_t page) const;
+
+    // Simulated power loss: the write in progress stops after this many
+    // more bytes and later writes fail, until open() again
+    void failAfter(uint32_t bytes);
+#endif
+
+private:
+    uint32_t base;
+    uint16_t pages;
+
+#ifndef NRF52
+    uint8_t* image;
+    uint32_t* erases;
+    char path[128];
+    uint32_t fail_budget;
+    bool failing;
+
+    void flush(uint32_t offset, uint32_t length);
+#endif
+};
+
+#endif
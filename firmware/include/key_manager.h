@@ -2,6 +2,7 @@
 #define KEY_MANAGER_H
 
 #include <stdint.h>
+#include "record_store.h"
 
 // Key provisioning states
 #define KEY_STATE_UNPROVISIONED  0
@@ -15,7 +16,8 @@
 // In production, use nRF52 CryptoCell CC310 for true ECDH
 class KeyManager {
 public:
-    void init();
+    // Keys persist in store; NULL keeps them in RAM only
+    void init(RecordStore* store);
 
     // Check if device has a provisioned key
     bool isProvisioned();
@@ -41,6 +43,7 @@ private:
     uint8_t masterKey[16];
     uint8_t sessionKey[16];
     uint8_t keyState;
+    RecordStore* store;
 
     // Persist key to non-volatile storage (nRF52 flash)
     void saveToFlash();
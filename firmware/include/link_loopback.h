@@ -0,0 +1,85 @@
+// firmware/include/link_loopback.h
+
+#ifndef LINK_LOOPBACK_H
+#define LINK_LOOPBACK_H
+
+#include <stdint.h>
+#include "ble_link.h"
+#include "tx_queue.h"
+
+// Host-only stand-in for the radio between the transmit queue and a
+// simulated central.
+//
+// It plays the controller: notifications move from the queue into its ACL
+// buffers while the link has credits, as the firmware's pump does, and
+// each connection event sends buffered notifications for as long as their
+// air time (BleLink::airTimeUsFor) fits in the event. Every notification
+// sent returns its buffer with completeTx() and is handed to the receiver.
+// The firmware's main-loop work runs as the pump callback before each
+// notification, so it can refill the queue mid-event as it would on the
+// device. Time is the virtual clock (sys_time.h), advanced one connection
+// interval per event.
+//
+// The link can also be made lossy: each notification is then dropped with
+// the given probability after using its air time and buffer, as one lost
+// to an overflowing receiver or a stack that discards it would be. Drops
+// come from a seeded generator so runs repeat exactly.
+
+#define LOOPBACK_MAX_BUFFERS        16
+#define LOOPBACK_INTERVAL_US        7500    // Shortest connection interval
+
+typedef void (*LoopbackPump)(void* context);
+typedef void (*LoopbackReceive)(uint8_t target, const uint8_t* data, uint8_t length, void* context);
+
+typedef struct {
+    uint32_t events;
+    uint32_t idle_events;       // Nothing to send
+    uint32_t notifications;
+    uint32_t dropped;           // Sent, never handed to the receiver
+    uint32_t bytes;             // Notification values
+    uint64_t air_us;
+} LoopbackStats;
+
+#ifndef NRF52
+class LinkLoopback {
+public:
+    void init(BleLink* link, TxQueue* queue);
+
+    // Connection interval, and how much of it the controller gives to this
+    // link; the event defaults to the whole interval
+    void setInterval(uint32_t interval_us, uint32_t event_us = 0);
+
+    void setPump(LoopbackPump pump, void* context);
+    void setReceiver(LoopbackReceive receive, void* context);
+
+    // Drop notifications with probability per_mille / 1000; 0 is lossless
+    void setLoss(uint16_t per_mille, uint32_t seed = 1);
+
+    // Run one connection event; returns notifications delivered
+    uint16_t connectionEvent();
+
+    const LoopbackStats* stats() const;
+
+private:
+    BleLink* link;
+    TxQueue* queue;
+    uint32_t interval_us;
+    uint32_t event_us;
+    LoopbackPump pump;
+    void* pump_context;
+    LoopbackReceive receive;
+    void* receive_context;
+    uint16_t loss_per_mille;
+    uint32_t loss_state;
+
+    TxSlot buffers[LOOPBACK_MAX_BUFFERS];
+    uint8_t head;
+    uint8_t used;
+    LoopbackStats counters;
+
+    void fillBuffers();
+    bool dropNext();
+};
+#endif
+
+#endif
@@ -0,0 +1,43 @@
+// firmware/include/order_statistics.h
+
+#ifndef ORDER_STATISTICS_H
+#define ORDER_STATISTICS_H
+
+#include <stdint.h>
+
+// Sliding-window capacity (odd window sizes 3..63 are meaningful for medians)
+#define OSW_MAX_SIZE    63
+#define OSW_MAX_LEVELS  6       // log2(OSW_MAX_SIZE + 1)
+#define OSW_NIL         0xFF
+
+// Indexable skiplist over a fixed node pool.
+// insert/remove/at are O(log n) expected; no heap allocation.
+class OrderStatisticsWindow {
+public:
+    void init();
+
+    // Insert a value, keeping the list sorted (duplicates allowed)
+    bool insert(float value);
+
+    // Remove one node holding exactly this value
+    bool remove(float value);
+
+    // k-th smallest value (0-based); k must be < size()
+    float at(uint8_t k) const;
+
+    uint8_t size() const { return count; }
+
+private:
+    // Node 0 is the head sentinel; free nodes are chained through next[0]
+    float value[OSW_MAX_SIZE + 1];
+    uint8_t next[OSW_MAX_SIZE + 1][OSW_MAX_LEVELS];
+    uint8_t width[OSW_MAX_SIZE + 1][OSW_MAX_LEVELS];
+    uint8_t levels[OSW_MAX_SIZE + 1];
+    uint8_t free_head;
+    uint8_t count;
+    uint32_t rng;
+
+    uint8_t randomLevel();
+};
+
+#endif
@@ -0,0 +1,155 @@
+// firmware/include/pipeline.h
+
+#ifndef PIPELINE_H
+#define PIPELINE_H
+
+#include <stdint.h>
+#include "signal_processing.h"
+
+// Compile-time composed per-channel processing chain.
+//
+//   typedef Pipeline<OutlierStage, BiquadStage, KalmanStage,
+//                    ClampStage<SEROTONIN_MIN_NM, SEROTONIN_MAX_NM> > Chain;
+//
+// Each stage owns its state by value, so a Chain instance is one statically
+// allocated object. process() is a chain of inline calls with no virtual
+// dispatch; adding a stage or a channel is a change to the typedef.
+//
+// A stage provides:
+//   float process(float x);    one sample in, one sample out
+//   void reset();              clear filter memory, keep configuration
+
+// Hampel spike rejection
+struct OutlierStage {
+    HampelState state;
+
+    void configure(uint8_t window, float threshold) {
+        SignalProcessor::initHampelState(&state, window, threshold);
+    }
+    void reset() {
+        SignalProcessor::initHampelState(&state, state.window, state.threshold);
+    }
+    float process(float x) {
+        return hampelStep(x, &state);
+    }
+};
+
+// 2nd-order Butterworth low-pass section
+struct BiquadStage {
+    FilterState state;
+
+    void configure() {
+        SignalProcessor::initFilterState(&state);
+    }
+    void reset() {
+        SignalProcessor::initFilterState(&state);
+    }
+    float process(float x) {
+        return butterworthStep(x, &state);
+    }
+};
+
+// Scalar Kalman smoother
+struct KalmanStage {
+    KalmanState state;
+    float initial_value;
+
+    void configure(float initial, float q, float r) {
+        initial_value = initial;
+        SignalProcessor::initKalmanState(&state, initial, q, r);
+    }
+    void reset() {
+        SignalProcessor::initKalmanState(&state, initial_value, state.q, state.r);
+    }
+    float process(float x) {
+        return kalmanStep(x, &state);
+    }
+};
+
+// Saturate to an analyte's detection range
+template <int MIN_VALUE, int MAX_VALUE>
+struct ClampStage {
+    void configure() {
+    }
+    void reset() {
+    }
+    float process(float x) {
+        x = (x < (float)MIN_VALUE) ? (float)MIN_VALUE : x;
+        return (x > (float)MAX_VALUE) ? (float)MAX_VALUE : x;
+    }
+};
+
+template <typename... Stages>
+class Pipeline;
+
+// Resolve the type and storage of stage I
+template <uint8_t I, typename P>
+struct PipelineStageAt;
+
+// Empty tail terminates the recursion
+template <>
+class Pipeline<> {
+public:
+    static const uint8_t STAGE_COUNT = 0;
+
+    float process(float x) {
+        return x;
+    }
+    void reset() {
+    }
+};
+
+template <typename First, typename... Rest>
+class Pipeline<First, Rest...> {
+public:
+    static const uint8_t STAGE_COUNT = 1 + sizeof...(Rest);
+
+    First head;
+    Pipeline<Rest...> tail;
+
+    float process(float x) {
+        return tail.process(head.process(x));
+    }
+
+    // Run a block through every stage sample by sample; state after the
+    // block is identical to calling process() n times.
+    void processBlock(const float* input, float* output, uint16_t n) {
+        for (uint16_t i = 0; i < n; i++) {
+            output[i] = process(input[i]);
+        }
+    }
+
+    void reset() {
+        head.reset();
+        tail.reset();
+    }
+
+    // Typed access to stage I for configuration: chain.stage<2>().configure(...)
+    template <uint8_t I>
+    typename PipelineStageAt<I, Pipeline>::type& stage();
+};
+
+template <typename First, typename... Rest>
+struct PipelineStageAt<0, Pipeline<First, Rest...> > {
+    typedef First type;
+    static First& get(Pipeline<First, Rest...>& p) {
+        return p.head;
+    }
+};
+
+template <uint8_t I, typename First, typename... Rest>
+struct PipelineStageAt<I, Pipeline<First, Rest...> > {
+    typedef typename PipelineStageAt<I - 1, Pipeline<Rest...> >::type type;
+    static type& get(Pipeline<First, Rest...>& p) {
+        return PipelineStageAt<I - 1, Pipeline<Rest...> >::get(p.tail);
+    }
+};
+
+template <typename First, typename... Rest>
+template <uint8_t I>
+typename PipelineStageAt<I, Pipeline<First, Rest...> >::type&
+Pipeline<First, Rest...>::stage() {
+    return PipelineStageAt<I, Pipeline<First, Rest...> >::get(*this);
+}
+
+#endif
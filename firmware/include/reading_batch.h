@@ -0,0 +1,71 @@
+// firmware/include/reading_batch.h
+
+#ifndef READING_BATCH_H
+#define READING_BATCH_H
+
+#include <stdint.h>
+
+// Accumulates compact readings (reading_codec.h) into one plaintext that is
+// encrypted and sent as a single payload. Readings are self-delimiting, so
+// a batch is just their concatenation. A batch is due when it could not
+// take another full reading or when its oldest reading has waited the
+// maximum latency; 0 latency sends every reading on its own.
+//
+// The capacity follows the negotiated MTU: the IV and padded ciphertext of
+// a full batch fill what one notification carries after its frame header.
+
+#define BATCH_MAX_SIZE          223     // 240 bytes after the frame header: IV + 14 blocks
+#define BATCH_LATENCY_MS        1000
+
+typedef struct {
+    uint32_t readings;
+    uint32_t batches;
+    uint32_t full;          // Flushed because another reading would not fit
+    uint32_t deadline;      // Flushed at the latency deadline
+} BatchStats;
+
+class ReadingBatcher {
+public:
+    void init();
+
+    void setLatency(uint16_t ms);
+    uint16_t latency() const;
+
+    // Plaintext bytes per batch, and the largest single reading; a
+    // capacity below one reading sends every reading alone
+    void setCapacity(uint16_t bytes, uint8_t reading_max);
+    uint16_t capacity() const;
+
+    // Capacity for this many packet bytes per notification
+    static uint16_t capacityFor(uint16_t notify_payload);
+
+    // False if the current batch must be taken first
+    bool fits(uint8_t length) const;
+    void add(const uint8_t* reading, uint8_t length, uint32_t now_ms);
+
+    bool full() const;
+    bool expired(uint32_t now_ms) const;
+
+    const uint8_t* data() const;
+    uint16_t length() const;
+    uint8_t count() const;
+
+    // Hand the batch over; counted as a full or deadline flush
+    void take(uint32_t now_ms);
+    void clear();
+
+    const BatchStats* stats() const;
+    void resetStats();
+
+private:
+    uint8_t buffer[BATCH_MAX_SIZE];
+    uint16_t used;
+    uint16_t limit;
+    uint8_t reading_max;
+    uint8_t readings;
+    uint16_t latency_ms;
+    uint32_t first_ms;
+    BatchStats counters;
+};
+
+#endif
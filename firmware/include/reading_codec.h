@@ -0,0 +1,82 @@
+// firmware/include/reading_codec.h
+
+#ifndef READING_CODEC_H
+#define READING_CODEC_H
+
+#include <stdint.h>
+#include "sensor_manager.h"
+
+// Compact SensorReading wire format.
+//
+// Little-endian throughout: timestamp_ms (uint32), then a bit stream packed
+// LSB first holding the 6-bit channel mask and each present channel's code
+// in channel order, zero-padded to a whole byte. Neurotransmitters and
+// calprotectin are quantised on a log scale across their detection range,
+// so the error is a bounded fraction of the value; pH and temperature are
+// fixed point. Out-of-range values saturate. At the default widths a full
+// reading is 12 bytes and a tick of the three fast channels 9.
+
+#define CODEC_CHANNELS          6
+#define CODEC_HEADER_SIZE       4
+#define CODEC_MAX_BITS          16
+#define CODEC_MAX_SIZE          (CODEC_HEADER_SIZE + (CODEC_CHANNELS + CODEC_CHANNELS * CODEC_MAX_BITS + 7) / 8)
+
+// Default code widths
+#define CODEC_BITS_SEROTONIN    10      // 0.34% over 3 decades
+#define CODEC_BITS_DOPAMINE     10      // 0.23% over 2 decades
+#define CODEC_BITS_GABA         10      // 0.30%
+#define CODEC_BITS_PH           10      // 0.007 pH
+#define CODEC_BITS_TEMP         8       // 0.05 C
+#define CODEC_BITS_CALPROTECTIN 8       // 1.4%
+
+// Fixed-point ranges
+#define CODEC_PH_MIN            0.0f
+#define CODEC_PH_MAX            14.0f
+#define CODEC_TEMP_MIN_C        20.0f
+#define CODEC_TEMP_MAX_C        45.5f   // 0.1 C steps at 8 bits
+
+typedef enum {
+    CODEC_SCALE_LINEAR = 0,
+    CODEC_SCALE_LOG,
+} CodecScale;
+
+typedef struct {
+    float min;
+    float max;
+    uint8_t bits;
+    uint8_t scale;          // CodecScale
+    float origin;           // min, or ln(min) on a log scale
+    float codes_per_unit;   // Of the (log) value
+    float units_per_code;
+    uint16_t max_code;
+} CodecChannel;
+
+class ReadingCodec {
+public:
+    // Detection ranges and default widths
+    void init();
+
+    // 1..CODEC_MAX_BITS; the decoder must use the same widths
+    bool setBits(uint8_t channel, uint8_t bits);
+    uint8_t bits(uint8_t channel) const;
+
+    uint8_t size(uint8_t mask) const;
+    uint8_t encode(const SensorReading* reading, uint8_t mask, uint8_t* out) const;
+
+    // Fills the channels present in the mask and the timestamp; returns the
+    // mask, or 0 for a short or empty reading
+    uint8_t decode(const uint8_t* in, uint8_t length, SensorReading* reading) const;
+
+    // Worst-case round-trip error inside the range: relative on a log
+    // scale, in units on a linear one
+    float maxError(uint8_t channel) const;
+
+private:
+    CodecChannel channel[CODEC_CHANNELS];
+
+    void setChannel(uint8_t ch, float min, float max, uint8_t scale, uint8_t bits);
+    uint16_t quantise(uint8_t ch, float value) const;
+    float dequantise(uint8_t ch, uint16_t code) const;
+};
+
+#endif
@@ -0,0 +1,86 @@
+// firmware/include/record_store.h
+
+#ifndef RECORD_STORE_H
+#define RECORD_STORE_H
+
+#include <stdint.h>
+#include "flash_device.h"
+
+// Log-structured key-value records on internal flash.
+//
+// Records are appended to the active page; a newer record for a key
+// supersedes the older one and a zero-length record deletes it. Each
+// record carries a CRC-32 over key, length and data, so a write torn by a
+// reset is ignored at boot. Pages are used round-robin: when the active
+// page fills, the next (erased) page becomes active and the oldest page's
+// still-current records are copied forward before it is erased, so every
+// page sees the same number of erases. A RAM index, rebuilt by one scan
+// at boot, maps each key straight to its latest record.
+
+#define RECORD_MAX_KEYS         24
+#define RECORD_MAX_LENGTH       128
+#define RECORD_PAGE_MAGIC       0x53594D42UL    // "SYMB"
+
+// Record keys
+#define RECORD_KEY_MASTER_KEY       0x01    // 16 bytes
+#define RECORD_KEY_CAL_OFFSET       0x02    // 6 floats, mV
+#define RECORD_KEY_SAMPLING_INTERVAL 0x03   // uint16_t, ms
+#define RECORD_KEY_TEMP_COEFF       0x04    // 6 floats, per degree C
+#define RECORD_KEY_CHANNEL_PERIODS  0x05    // 6 uint16_t, ms
+#define RECORD_KEY_BATCH_LATENCY    0x06    // uint16_t, ms
+#define RECORD_KEY_LOG_ACKED        0x07    // uint32_t, sample log sequence
+#define RECORD_KEY_CAL_POINTS       0x08    // + channel, 0x08..0x0D
+#define RECORD_KEY_BROADCAST_INTERVAL 0x0E  // uint16_t, ms, 0 = off
+#define RECORD_KEY_BROADCAST_COUNTER 0x0F   // uint32_t, first counter not yet used
+
+typedef struct {
+    uint32_t magic;
+    uint32_t seq;           // Increments each time a page is opened
+} RecordPageHeader;
+
+typedef struct {
+    uint16_t key;
+    uint16_t length;        // 0: deleted
+    uint32_t crc;           // Over key, length and data
+} RecordHeader;
+
+typedef struct {
+    uint32_t offset;        // Of the data in the region, 0 when absent
+    uint16_t length;
+} RecordIndexEntry;
+
+class RecordStore {
+public:
+    // Scan the flash and build the index; formats a blank or foreign region
+    bool init(FlashDevice* flash);
+
+    bool put(uint16_t key, const void* data, uint16_t length);
+    bool remove(uint16_t key);
+
+    // Copies the record only if it exists and is exactly length bytes
+    bool get(uint16_t key, void* data, uint16_t length) const;
+    bool contains(uint16_t key) const;
+    uint16_t length(uint16_t key) const;
+
+    uint32_t loadTimeUs() const;        // Last init()
+    uint32_t freeBytes() const;         // Left in the active page
+    uint32_t pagesCollected() const;
+
+private:
+    FlashDevice* flash;
+    RecordIndexEntry index[RECORD_MAX_KEYS];
+    uint16_t active_page;
+    uint32_t write_offset;              // Within the region
+    uint32_t next_seq;
+    uint32_t load_time_us;
+    uint32_t collected;
+
+    bool scanPage(uint16_t page, bool active);
+    bool openPage(uint16_t page);
+    bool collectPage(uint16_t page);
+    bool rotate();
+    bool append(uint16_t key, const void* data, uint16_t length);
+    uint32_t pageEnd() const;
+};
+
+#endif
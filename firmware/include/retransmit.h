@@ -0,0 +1,112 @@
+// firmware/include/retransmit.h
+
+#ifndef RETRANSMIT_H
+#define RETRANSMIT_H
+
+#include <stdint.h>
+#include "ble_frame.h"
+
+// Selective-repeat delivery for the live sensor data characteristic.
+//
+// Notifications keep flowing without waiting on anything: each packet is
+// queued as before and a copy, keyed by its frame sequence number
+// (ble_frame.h), stays in a bounded retransmit buffer. Every so often the
+// central acknowledges what it holds over the control characteristic:
+//   base (uint16 BE)     first sequence number not yet received
+//   bitmap (uint32 BE)   bit i set: base + 1 + i received
+// Acknowledged packets leave the buffer. One that is not acknowledged is
+// resent when the central reports a later packet (a hole), or when it has
+// gone unacknowledged through a whole ack; a resent packet only goes again
+// after a whole ack. Resends keep their sequence number and ciphertext,
+// so the central drops duplicates by sequence. When the buffer is full the
+// oldest packet is given up; the central slides its window past a gap
+// once the gap falls off the bitmap.
+
+#define RETRANSMIT_DEPTH        16
+#define RETRANSMIT_ACK_BITS     32
+#define RETRANSMIT_ACK_SIZE     6
+
+typedef struct {
+    uint16_t seq;
+    uint8_t length;
+    bool used;
+    bool missing;           // Due for a resend
+    bool probed;            // Outstanding through at least one ack
+    uint8_t sends;
+    uint8_t data[FRAME_MAX_PACKET];
+} RetransmitSlot;
+
+typedef struct {
+    uint32_t stored;
+    uint32_t acknowledged;
+    uint32_t resent;
+    uint32_t evicted;           // Given up unacknowledged
+    uint32_t acks;
+} RetransmitStats;
+
+void retransmitEncodeAck(uint16_t base, uint32_t bitmap, uint8_t* out);
+void retransmitDecodeAck(const uint8_t* in, uint16_t* base, uint32_t* bitmap);
+
+// Sending end
+class RetransmitBuffer {
+public:
+    void init();
+
+    // Keep a copy of a packet just queued with this sequence number
+    void store(uint16_t seq, const uint8_t* data, uint8_t length);
+
+    // Central's acknowledgement; returns packets newly acknowledged
+    uint8_t acknowledge(uint16_t base, uint32_t bitmap);
+
+    // Oldest packet due for a resend, or 0; resent() once it is queued
+    const RetransmitSlot* nextMissing() const;
+    void resent(const RetransmitSlot* slot);
+
+    uint8_t count() const;
+
+    // Outstanding packets are forgotten, e.g. on disconnect
+    void clear();
+
+    const RetransmitStats* stats() const;
+    void resetStats();
+
+private:
+    RetransmitSlot slots[RETRANSMIT_DEPTH];
+    uint8_t used;
+    RetransmitStats counters;
+
+    RetransmitSlot* oldest();
+};
+
+typedef struct {
+    uint32_t delivered;         // Packets seen for the first time
+    uint32_t recovered;         // Of those, behind a later packet
+    uint32_t duplicates;
+    uint32_t lost;              // Gaps slid past unfilled
+} AckWindowStats;
+
+// Receiving end, as the app runs it: tracks which sequence numbers have
+// arrived and builds the acknowledgement
+class AckWindow {
+public:
+    void init();
+
+    // False for a packet already delivered
+    bool receive(uint16_t seq);
+
+    uint16_t base() const;
+    uint32_t bitmap() const;
+    void encodeAck(uint8_t* out) const;
+
+    const AckWindowStats* stats() const;
+
+private:
+    bool started;
+    uint16_t next;              // First sequence number not received
+    uint32_t seen;              // Bit i: next + 1 + i received
+    AckWindowStats counters;
+
+    void advance();
+};
+
+#endif
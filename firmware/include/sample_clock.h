@@ -0,0 +1,96 @@
+// firmware/include/sample_clock.h
+
+#ifndef SAMPLE_CLOCK_H
+#define SAMPLE_CLOCK_H
+
+#include <stdint.h>
+
+class AdcDriver;
+class ChannelScheduler;
+
+// Hardware sampling clock.
+//
+// On the nRF52832, RTC2 compare events trigger the SAADC SAMPLE task through
+// PPI, so conversions start on the LFCLK tick with no CPU involvement. The
+// RTC interrupt only re-arms the next compare and records the trigger tick,
+// which becomes the frame timestamp. A second PPI channel captures TIMER3
+// (1 MHz, HFCLK) on the same event to measure the achieved sample period
+// against an independent clock for the jitter histogram.
+//
+// Host builds fire triggers from service() in the main loop, which is also
+// how the firmware sampled before; the histogram then shows that jitter.
+
+#define SAMPLE_CLOCK_HZ         32768   // LFCLK, RTC prescaler 0
+#define JITTER_BINS             16
+#define JITTER_BIN_US           32      // Default bin width, ~1 LFCLK tick
+
+// Achieved sample period minus the nominal period, in microseconds.
+// bins[JITTER_BINS / 2] starts at zero deviation.
+typedef struct {
+    uint32_t bins[JITTER_BINS];
+    uint32_t underflow;
+    uint32_t overflow;
+    uint32_t count;
+    uint16_t bin_us;
+    int32_t min_us;
+    int32_t max_us;
+} JitterHistogram;
+
+class SampleClock {
+public:
+    void init(AdcDriver* adc);
+
+    // Begin hardware-triggered scans every interval_ms
+    void start(uint16_t interval_ms);
+    void stop();
+    bool isRunning() const;
+
+    // Per-tick channel selection; each scan converts only the channels
+    // due on its tick. 0 converts every channel on every tick.
+    void setScheduler(const ChannelScheduler* schedule);
+
+    // Host: fire a due trigger from the main loop. No-op on the nRF52.
+    void service();
+
+    // Extended tick of the most recent trigger, in SAMPLE_CLOCK_HZ ticks
+    uint64_t triggerTick() const;
+    uint32_t triggerCount() const;
+    uint32_t missedTriggers() const;
+
+    const JitterHistogram* jitter() const;
+    void resetJitter(uint16_t bin_us);
+
+    static uint64_t msToTicks(uint32_t ms);
+    static uint32_t ticksToMs(uint64_t ticks);
+
+    // Compare handler, called from the RTC interrupt
+    void onCompare();
+
+private:
+    AdcDriver* adc;
+    const ChannelScheduler* schedule;
+    bool running;
+    uint16_t interval_ms;
+    uint32_t nominal_us;
+
+    uint64_t base_tick;                 // Extended tick at RTC count 0
+    uint32_t start_us;
+    uint64_t next_tick;                 // Extended tick of the armed compare
+    uint32_t next_index;                // Its base tick number since start
+    volatile uint64_t fired_tick;
+    uint32_t tick_remainder;            // Fractional ticks, in 1/1000
+    volatile uint32_t triggers;
+    volatile uint32_t missed;
+
+    uint32_t last_capture_us;
+    JitterHistogram histogram;
+
+    void advance();
+    void selectChannels();
+    void recordPeriod(uint32_t capture_us);
+};
+
+// Add one deviation sample to a histogram
+void jitterRecord(JitterHistogram* histogram, int32_t deviation_us);
+
+#endif
@@ -0,0 +1,117 @@
+// firmware/include/sample_log.h
+
+#ifndef SAMPLE_LOG_H
+#define SAMPLE_LOG_H
+
+#include <stdint.h>
+#include "flash_device.h"
+#include "reading_codec.h"
+
+// Append-only ring log of the readings taken while no central is connected.
+//
+// Readings are stored compact (reading_codec.h) and numbered from a
+// sequence that carries on across reboots. They collect in RAM and go to
+// flash as blocks of up to LOG_BLOCK_MAX bytes, each with a CRC-32 over
+// header and data, so a block torn by a reset is skipped at boot and a
+// reset costs at most the block still in RAM. Pages are used round-robin;
+// when the log wraps, the oldest page is erased with whatever it held.
+//
+// Catch-up: the central acknowledges the sequence number it has every
+// reading before. A sync reads blocks from there, one packet per block:
+//   first (uint32 LE)    sequence number of the first reading
+//   readings             the block's compact readings back to back
+// A packet with no readings marks the end of the log.
+
+#define LOG_PAGE_MAGIC          0x53594C47UL    // "SYLG"
+#define LOG_MAX_PAGES           16
+#define LOG_BLOCK_MAX           219     // + first encrypts to 240 bytes: one notification at MTU 247
+#define LOG_PACKET_HEADER       4
+#define LOG_PACKET_MAX          (LOG_PACKET_HEADER + LOG_BLOCK_MAX)
+#define LOG_FLUSH_MS            60000   // Longest a reading waits in RAM
+
+typedef struct {
+    uint32_t magic;
+    uint32_t seq;           // Increments each time a page is opened
+} LogPageHeader;
+
+typedef struct {
+    uint32_t first;         // Sequence number of the first reading
+    uint16_t length;        // Data bytes
+    uint8_t count;          // Readings
+    uint8_t reserved;
+    uint32_t crc;           // Over the fields above and the data
+} LogBlockHeader;
+
+typedef struct {
+    uint32_t appended;      // Readings
+    uint32_t blocks;        // Written
+    uint32_t flash_bytes;   // Including headers and padding
+    uint32_t overwritten;   // Unacknowledged readings erased by the wrap
+    uint32_t corrupt;       // Blocks failing their CRC
+    uint32_t synced;        // Readings handed to catch-up packets
+} SampleLogStats;
+
+class SampleLog {
+public:
+    // Scan the flash for the newest block; a blank or foreign region is
+    // formatted. acked is what the central had at the last save; a fresh
+    // log carries the numbering on from there.
+    bool init(FlashDevice* flash, uint32_t acked = 0);
+
+    bool append(const SensorReading* reading, uint8_t mask, uint32_t now);
+
+    // Write the block collecting in RAM, if any; due once it has waited
+    // LOG_FLUSH_MS
+    bool flush();
+    bool due(uint32_t now) const;
+
+    uint32_t nextSeq() const;
+    uint32_t oldestSeq() const;
+
+    // The central has every reading before seq
+    void acknowledge(uint32_t seq);
+    uint32_t acknowledged() const;
+    uint32_t pending() const;
+
+    // Start a sync at the block holding seq, or the oldest one after it
+    void seek(uint32_t seq);
+
+    // Next catch-up packet and the readings in it; the end marker once the
+    // log is exhausted, then 0 until the next seek()
+    uint16_t readPacket(uint8_t* out, uint16_t* readings);
+
+    const SampleLogStats* stats() const;
+
+private:
+    FlashDevice* flash;
+    ReadingCodec codec;
+    uint16_t pages;
+    uint16_t active_page;
+    uint32_t write_offset;          // Within the region
+    uint32_t next_page_seq;
+    uint32_t page_seq[LOG_MAX_PAGES];
+    uint32_t page_first[LOG_MAX_PAGES];
+    uint32_t page_end[LOG_MAX_PAGES];
+    uint32_t next_seq;
+    uint32_t acked;
+
+    uint8_t block[LOG_BLOCK_MAX];
+    uint16_t block_length;
+    uint8_t block_count;
+    uint32_t block_started;
+
+    uint16_t cursor_page;
+    uint32_t cursor_page_seq;
+    uint32_t cursor_offset;
+    uint32_t cursor_seq;
+    uint8_t cursor_state;
+
+    SampleLogStats counters;
+
+    void scanPage(uint16_t page);
+    bool openPage(uint16_t page);
+    bool readBlock(uint32_t offset, LogBlockHeader* header, uint8_t* data);
+    bool nextPage(uint16_t page, uint16_t* next) const;
+};
+
+#endif
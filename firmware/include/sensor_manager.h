@@ -4,6 +4,10 @@
 #define SENSOR_MANAGER_H
 
 #include <stdint.h>
+#include "adc_driver.h"
+#include "sample_clock.h"
+#include "channel_scheduler.h"
+#include "record_store.h"
 
 // Analyte detection ranges
 #define SEROTONIN_MIN_NM 10
@@ -12,6 +16,8 @@
 #define DOPAMINE_MAX_NM 5000
 #define GABA_MIN_NM 100
 #define GABA_MAX_NM 50000
+#define CALPROTECTIN_MIN_UG_G 5
+#define CALPROTECTIN_MAX_UG_G 5000
 
 typedef struct {
     float serotonin_nm;
@@ -23,16 +29,139 @@ typedef struct {
     uint32_t timestamp_ms;
 } SensorReading;
 
+// Calibration and self-test run incrementally from the main loop
+typedef enum {
+    PROCEDURE_NONE = 0,
+    PROCEDURE_CALIBRATE,
+    PROCEDURE_SELF_TEST,
+} ProcedureType;
+
+typedef enum {
+    PROCEDURE_RUNNING = 0,
+    PROCEDURE_PASSED,
+    PROCEDURE_FAILED,
+    PROCEDURE_ABORTED,
+} ProcedureOutcome;
+
+// Progress and result, notified to the central
+typedef struct {
+    uint8_t procedure;          // ProcedureType
+    uint8_t outcome;            // ProcedureOutcome
+    uint8_t percent;
+    uint8_t failed_channels;    // Bit n set: channel An failed
+} ProcedureStatus;
+
 class SensorManager {
 public:
     void init();
     SensorReading readAnalytes();
+    
+    // Non-blocking acquisition: start a scan, then take the converted
+    // reading once its frame has arrived
+    bool requestReading();
+    bool takeReading(SensorReading* reading);
+    void stopAcquisition();
+    AdcDriver& adcDriver();
+    
+    // Hardware-clocked acquisition: scans start on RTC ticks via PPI and
+    // arrive through takeReading(). service() drives the host stand-in.
+    void startSampling(uint16_t interval_ms);
+    void service();
+    const JitterHistogram* samplingJitter() const;
+    
+    // Per-channel periods under the sample clock, rounded to multiples of
+    // the sampling interval; 0 samples the channel on every tick. Slow
+    // channels keep their last value between conversions and
+    // readingMask() tells which ones the last reading actually converted.
+    void setChannelPeriod(uint8_t channel, uint16_t period_ms);
+    uint32_t channelPeriod(uint8_t channel) const;
+    uint8_t readingMask() const;
+    
+    // A0..A5 counts behind the last reading, slow channels held
+    const uint16_t* rawCounts() const;
+    const ChannelScheduler* channelSchedule() const;
+    
+    // Baseline drift tracking from the sample stream: window length, and
+    // optional linear drift fit in place of the per-window EMA
+    void setBaselineWindow(uint32_t window_ms);
+    void setDriftFit(bool enabled);
+    float baselineDrift(uint8_t channel) const;     // mV per minute
+    
+    // Convert one raw frame (A0..A5 counts) through the precomputed kernels
+    SensorReading convertRaw(const uint16_t* raw);
+    
+    // Integer-only conversion to units in Q(FIXED_FRAC_BITS)
+    void convertRawFixed(const uint16_t* raw, int32_t* out_q);
+    
+    // Blocking wrappers, for boot and tests
     void calibrate();
     bool selfTest();
+    
+    // Non-blocking procedures: start, then call serviceProcedure() every
+    // loop pass. It returns true when procedureStatus() has news to report.
+    bool startCalibration();
+    bool startSelfTest();
+    bool serviceProcedure();
+    void abortProcedure();
+    bool procedureActive() const;
+    const ProcedureStatus* procedureStatus() const;
+    
+    // Multi-point calibration: measure one standard of known value on one
+    // channel. Two or more standards switch the channel to a lookup table
+    // with temperature compensation from A4; per_c is the sensor's own
+    // fractional sensitivity change per degree C.
+    bool startCalibrationPoint(uint8_t channel, float reference_units);
+    void clearCalibrationPoints(uint8_t channel);   // channel >= 6: all
+    uint8_t calibrationPoints(uint8_t channel) const;
+    void setTemperatureCoefficient(uint8_t channel, float per_c);
+    
+    // Load calibration from flash records now, save there when it changes
+    void setRecordStore(RecordStore* records);
 private:
+    AdcDriver adc;
+    SampleClock clock;
+    ChannelScheduler schedule;
+    uint16_t sampling_interval_ms;
+    uint16_t channel_period_ms[6];
+    uint16_t held_raw[6];
+    uint8_t reading_mask;
+    RecordStore* store;
+    
     void configureADC();
-    float applyCalibration(uint16_t raw_value, uint8_t channel);
-    void baselineDriftCorrection();
+    void rebuildTransforms();
+    void baselineDriftCorrection(const AdcFrame* frame);
+    void holdAbsentChannels(AdcFrame* frame);
+    bool pauseClock();
+    void resumeClock(bool was_running);
+    
+    // Procedure state
+    ProcedureType procedure;
+    ProcedureStatus status;
+    uint8_t procedure_phase;
+    uint32_t phase_start_ms;
+    uint32_t scan_start_us;
+    bool scan_pending;
+    bool resume_clock;
+    uint8_t scans_done;
+    uint8_t scan_failures;
+    uint8_t failed_channels;
+    float zero_sum[6];
+    uint8_t point_channel;
+    float point_reference;
+    uint16_t min_val[6];
+    uint16_t max_val[6];
+    
+    void beginProcedure(ProcedureType type, uint8_t phase);
+    void claimAdc();
+    bool procedureScan(uint32_t spacing_us, AdcFrame* frame);
+    void checkResponse(const AdcFrame* frame);
+    void finishCalibration();
+    void recordCalibrationPoint();
+    void saveCalibrationPoints(uint8_t channel);
+    int findCalibrationPoint(uint8_t channel, float reference_units) const;
+    void finishSelfTest();
+    void finishProcedure(ProcedureOutcome outcome, uint8_t failed);
+    void runProcedure();
 };
 
 #endif
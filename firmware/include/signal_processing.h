@@ -5,6 +5,7 @@
 
 #include <stdint.h>
 #include "sensor_manager.h"
+#include "order_statistics.h"
 
 // Butterworth filter state (2nd order IIR)
 typedef struct {
@@ -22,6 +23,49 @@ typedef struct {
     float r;   // Measurement noise covariance
 } KalmanState;
 
+// Hampel outlier rejector state (sliding median/MAD)
+typedef struct {
+    OrderStatisticsWindow sorted;       // Window contents in value order
+    float history[OSW_MAX_SIZE];        // Window contents in arrival order
+    uint8_t window;                     // Window length (odd, 3..OSW_MAX_SIZE)
+    uint8_t head;                       // Oldest sample in history
+    float threshold;                    // Rejection threshold in scaled MADs
+    uint32_t rejected;                  // Samples replaced by the median
+} HampelState;
+
+// Butterworth low-pass filter coefficients (2nd order, fc=0.05Hz)
+static const float BUTTERWORTH_B0 = 0.0201, BUTTERWORTH_B1 = 0.0402, BUTTERWORTH_B2 = 0.0201;
+static const float BUTTERWORTH_A1 = -1.5610, BUTTERWORTH_A2 = 0.6414;
+
+// Single-sample filter kernels, inline so composed pipelines flatten into
+// one loop. The SignalProcessor methods below are thin wrappers.
+static inline float butterworthStep(float input, FilterState* state) {
+    float output = BUTTERWORTH_B0 * input + BUTTERWORTH_B1 * state->x1 + BUTTERWORTH_B2 * state->x2
+                   - BUTTERWORTH_A1 * state->y1 - BUTTERWORTH_A2 * state->y2;
+    
+    // Update state
+    state->x2 = state->x1;
+    state->x1 = input;
+    state->y2 = state->y1;
+    state->y1 = output;
+    
+    return output;
+}
+
+static inline float kalmanStep(float measurement, KalmanState* state) {
+    // Prediction
+    state->p = state->p + state->q;
+    
+    // Update
+    float k = state->p / (state->p + state->r);
+    state->x = state->x + k * (measurement - state->x);
+    state->p = (1 - k) * state->p;
+    
+    return state->x;
+}
+
+float hampelStep(float input, HampelState* state);
+
 class SignalProcessor {
 public:
     // Low-pass filtering
@@ -30,12 +74,29 @@ public:
     // Noise reduction
     float kalmanFilter(float measurement, KalmanState* state);
     
+    // Block variants: count samples of one channel per call. Filter state is
+    // held in registers across the block and ends bit-identical to calling
+    // the scalar filter count times. input and output may alias.
+    void butterworthFilterBlock(const float* input, float* output, uint16_t count, FilterState* state);
+    void kalmanFilterBlock(const float* input, float* output, uint16_t count, KalmanState* state);
+    
+    // Filter bank variants: count frames of interleaved channels
+    // (input[i * channels + c]), one state per channel
+    void butterworthFilterBank(const float* input, float* output, uint16_t count,
+                               uint8_t channels, FilterState* states);
+    void kalmanFilterBank(const float* input, float* output, uint16_t count,
+                          uint8_t channels, KalmanState* states);
+    
+    // Impulse/spike rejection (run ahead of the IIR stages)
+    float hampelFilter(float input, HampelState* state);
+    
     // Data compression
     uint16_t deltaEncode(SensorReading* readings, uint8_t* buffer, uint16_t count);
     
     // State initialization helpers
     static void initFilterState(FilterState* state);
     static void initKalmanState(KalmanState* state, float initial_value, float q, float r);
+    static void initHampelState(HampelState* state, uint8_t window, float threshold);
 };
 
 #endif
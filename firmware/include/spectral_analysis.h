@@ -0,0 +1,81 @@
+// firmware/include/spectral_analysis.h
+
+#ifndef SPECTRAL_ANALYSIS_H
+#define SPECTRAL_ANALYSIS_H
+
+#include <stdint.h>
+
+// Analysis window (samples). Must be a power of two for the FFT path.
+#define SPECTRAL_FFT_MAX_SIZE   256
+#define SPECTRAL_MAX_DETECTORS  24      // 0.5 cpm spacing over the range
+
+// Motility search range in cycles per minute
+#define SPECTRAL_MIN_CPM        0.5f
+#define SPECTRAL_MAX_CPM        12.0f
+
+// Motility bands (cpm)
+typedef enum {
+    SPECTRAL_BAND_BRADYGASTRIC = 0,     // 0.5 - 2
+    SPECTRAL_BAND_NORMOGASTRIC,         // 2 - 4 (gastric slow wave ~3 cpm)
+    SPECTRAL_BAND_TACHYGASTRIC,         // 4 - 9
+    SPECTRAL_BAND_SMALL_INTESTINE,      // 9 - 12
+    SPECTRAL_NUM_BANDS
+} SpectralBand;
+
+typedef enum {
+    SPECTRAL_MODE_GOERTZEL,     // Bank of Goertzel detectors across the range
+    SPECTRAL_MODE_FFT,          // Q15 radix-2 real FFT, full bin resolution
+} SpectralMode;
+
+// Features emitted once per hop (half a window).
+// Powers are mean-square amplitude in the input's units squared. Goertzel
+// band powers are scaled for broadband content and read high for pure tones.
+typedef struct {
+    float dominant_cpm;
+    float dominant_power;
+    float band_power[SPECTRAL_NUM_BANDS];
+    float total_power;
+    uint32_t window_samples;
+} SpectralFeatures;
+
+class SpectralAnalyzer {
+public:
+    // window is rounded down to a power of two in [16, SPECTRAL_FFT_MAX_SIZE]
+    void init(float sample_rate_hz, uint16_t window, SpectralMode mode);
+
+    // Changing the rate discards the buffered samples
+    void setSampleRate(float sample_rate_hz);
+
+    // Push one filtered sample; returns true and fills features at each hop
+    bool addSample(float sample, SpectralFeatures* features);
+
+private:
+    float ring[SPECTRAL_FFT_MAX_SIZE];
+    uint16_t window;
+    uint16_t head;
+    uint16_t filled;
+    uint16_t since_hop;
+    float sample_rate_hz;
+    SpectralMode mode;
+
+    // Periodic Hann/twiddle table, cos(2*pi*k/window) for k = 0..window/2
+    int16_t cos_q15[SPECTRAL_FFT_MAX_SIZE / 2 + 1];
+
+    // Goertzel bank
+    float detector_cpm[SPECTRAL_MAX_DETECTORS];
+    float detector_coeff[SPECTRAL_MAX_DETECTORS];
+
+    // FFT work buffers (complex, window/2 points)
+    int16_t work_re[SPECTRAL_FFT_MAX_SIZE / 2];
+    int16_t work_im[SPECTRAL_FFT_MAX_SIZE / 2];
+
+    void configureDetectors();
+    float hann(uint16_t n) const;
+    float windowedSample(uint16_t n, float mean) const;
+    void analyzeGoertzel(SpectralFeatures* features, float mean);
+    void analyzeFFT(SpectralFeatures* features, float mean);
+    void fftQ15(uint16_t points);
+    int16_t sinQ15(uint16_t k) const;
+};
+
+#endif
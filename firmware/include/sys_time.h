@@ -0,0 +1,45 @@
+// firmware/include/sys_time.h
+
+#ifndef SYS_TIME_H
+#define SYS_TIME_H
+
+#include <stdint.h>
+
+// Time base for the sensing pipeline (ADC driver, sample clock, sensor
+// manager). On the nRF52832 these are the Arduino clock calls. Host builds
+// can switch to a virtual clock that only moves when advanced: delays
+// complete instantly by advancing it, so recorded traces replay as fast as
+// the code runs, with timestamps identical from run to run.
+
+#ifdef NRF52
+#include <Arduino.h>
+
+static inline uint32_t sysMillis() {
+    return millis();
+}
+
+static inline uint32_t sysMicros() {
+    return micros();
+}
+
+static inline void sysDelay(uint32_t ms) {
+    delay(ms);
+}
+
+static inline void sysDelayMicroseconds(uint32_t us) {
+    delayMicroseconds(us);
+}
+#else
+uint32_t sysMillis();
+uint32_t sysMicros();
+void sysDelay(uint32_t ms);
+void sysDelayMicroseconds(uint32_t us);
+
+// Virtual time starts at 0 when enabled; disabling returns to the host clock
+void sysTimeSetVirtual(bool enabled);
+bool sysTimeIsVirtual();
+void sysTimeAdvanceUs(uint64_t us);
+uint64_t sysTimeNowUs();
+#endif
+
+#endif
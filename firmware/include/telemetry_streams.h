@@ -0,0 +1,84 @@
+// firmware/include/telemetry_streams.h
+
+#ifndef TELEMETRY_STREAMS_H
+#define TELEMETRY_STREAMS_H
+
+#include <stdint.h>
+#include "sensor_manager.h"
+
+// Telemetry streams, each on its own characteristic so a central subscribes
+// to the ones it uses:
+//   raw         ADC counts of every reading, for research captures
+//   filtered    full-precision filtered units of every reading
+//   compressed  compact readings batched per notification (reading_codec.h),
+//               the sensor data characteristic the app plots from
+//   summary     per-channel count, min, mean and max over a period, for
+//               daily trends
+// Only streams with a subscriber are encoded, encrypted and queued.
+//
+// Little-endian throughout. Raw and filtered readings are timestamp_ms
+// (uint32) and the channel mask, then each present channel in channel
+// order: 12-bit counts packed LSB first (a reading of all six fits one
+// AES block), units as float32. A summary is the period's
+// start (uint32 ms), its length (uint32 ms) and the channel mask, then per
+// present channel the reading count (uint16) and min, mean and max
+// (float32).
+
+#define STREAM_RAW              0
+#define STREAM_FILTERED         1
+#define STREAM_COMPRESSED       2
+#define STREAM_SUMMARY          3
+#define STREAM_COUNT            4
+#define STREAM_BIT(stream)      (1 << (stream))
+#define STREAM_READINGS         (STREAM_BIT(STREAM_RAW) | STREAM_BIT(STREAM_FILTERED) | STREAM_BIT(STREAM_COMPRESSED))
+
+#define STREAM_CHANNELS         6
+#define STREAM_READING_HEADER   5
+#define STREAM_RAW_BITS         12
+#define STREAM_RAW_MAX_SIZE     (STREAM_READING_HEADER + (STREAM_CHANNELS * STREAM_RAW_BITS + 7) / 8)
+#define STREAM_FILTERED_MAX_SIZE (STREAM_READING_HEADER + STREAM_CHANNELS * 4)
+#define STREAM_SUMMARY_HEADER   9
+#define STREAM_SUMMARY_CHANNEL  14
+#define STREAM_SUMMARY_MAX_SIZE (STREAM_SUMMARY_HEADER + STREAM_CHANNELS * STREAM_SUMMARY_CHANNEL)
+
+#define SUMMARY_PERIOD_DEFAULT_MS   60000
+#define SUMMARY_PERIOD_MIN_MS       1000
+
+typedef struct {
+    uint32_t notifications[STREAM_COUNT];   // Payloads queued
+    uint32_t bytes[STREAM_COUNT];           // Plaintext
+    uint32_t dropped[STREAM_COUNT];         // Refused by the TX queue
+} StreamStats;
+
+// Encoders; return the length
+uint8_t streamEncodeRaw(const uint16_t* counts, uint8_t mask, uint32_t timestamp_ms, uint8_t* out);
+uint8_t streamEncodeFiltered(const SensorReading* reading, uint8_t mask, uint8_t* out);
+
+class SummaryStream {
+public:
+    void init(uint32_t period_ms);
+    void setPeriod(uint32_t period_ms);
+    uint32_t period() const;
+
+    // Start a fresh period, e.g. when a central subscribes
+    void restart(uint32_t now);
+
+    // Channels in the mask were converted in this reading
+    void add(const SensorReading* reading, uint8_t mask);
+
+    // The period has run out and holds at least one reading
+    bool due(uint32_t now) const;
+
+    // Encode the period so far and start the next; 0 when empty
+    uint8_t take(uint32_t now, uint8_t* out);
+
+private:
+    uint32_t period_ms;
+    uint32_t start_ms;
+    uint16_t count[STREAM_CHANNELS];
+    float min[STREAM_CHANNELS];
+    float max[STREAM_CHANNELS];
+    float sum[STREAM_CHANNELS];
+};
+
+#endif
@@ -0,0 +1,94 @@
+// firmware/include/trace_replay.h
+
+#ifndef TRACE_REPLAY_H
+#define TRACE_REPLAY_H
+
+#include <stdint.h>
+#include "adc_driver.h"
+#include "sensor_manager.h"
+
+// Host-only replay of raw ADC traces through the sensing pipeline.
+//
+// A trace file is a TraceHeader followed by frame_count frames of
+// ADC_SCAN_CHANNELS little-endian 12-bit counts. It is memory-mapped and
+// handed to the ADC stand-in as a recorded source, so replay reads straight
+// from the page cache. Replay runs on the virtual clock (sys_time.h): each
+// frame advances time by the recorded interval, readAnalytes() converts it
+// and the firmware's analyte chains filter it, with no real waiting. The
+// output is one ReplayRecord per frame; two outputs from different firmware
+// versions are compared bit for bit.
+
+#define TRACE_MAGIC             0x52545953UL    // "SYTR"
+#define TRACE_OUTPUT_MAGIC      0x4F545953UL    // "SYTO"
+#define TRACE_VERSION           1
+
+typedef struct {
+    uint32_t magic;
+    uint16_t version;
+    uint16_t channels;          // ADC_SCAN_CHANNELS
+    uint32_t interval_us;       // Sample period of the recording
+    uint32_t frame_count;
+} TraceHeader;
+
+typedef struct {
+    uint32_t magic;
+    uint16_t version;
+    uint16_t record_size;
+    uint32_t record_count;
+} ReplayOutputHeader;
+
+// Filtered neurotransmitters, converted pH, temperature and calprotectin
+typedef struct {
+    uint32_t timestamp_ms;
+    float units[6];
+} ReplayRecord;
+
+typedef struct {
+    uint32_t readings;
+    uint64_t virtual_us;
+    uint64_t wall_us;
+    float samples_per_sec;      // Readings per wall-clock second
+    float speedup;              // Virtual over wall-clock time
+} ReplayStats;
+
+typedef struct {
+    uint32_t compared;
+    uint32_t mismatched;        // Records not bit-identical
+    int32_t first_mismatch;     // Record index, -1 if none
+    float max_abs[6];           // Largest difference per field
+    bool length_differs;
+} ReplayDiff;
+
+#ifndef NRF52
+class TraceFile {
+public:
+    void init();
+
+    // Map a trace read-only; false if missing, truncated or foreign
+    bool open(const char* path);
+    void close();
+
+    uint32_t frameCount() const;
+    uint32_t intervalUs() const;
+    const uint16_t* frames() const;
+
+    static bool write(const char* path, const uint16_t* frames, uint32_t frame_count,
+                      uint32_t interval_us);
+
+    // Capture frames from the ADC stand-in's synthetic source
+    static bool writeSynthetic(const char* path, const AdcSyntheticChannel* channels,
+                               uint32_t frame_count, uint32_t interval_us);
+
+private:
+    void* map;
+    uint32_t map_size;
+};
+
+// Replay every frame of the trace; output may be NULL to only measure
+bool replayTrace(SensorManager* sensors, const TraceFile* trace, const char* output,
+                 ReplayStats* stats);
+
+bool diffReplayOutputs(const char* a, const char* b, ReplayDiff* diff);
+#endif
+
+#endif
@@ -0,0 +1,95 @@
+// firmware/include/tx_queue.h
+
+#ifndef TX_QUEUE_H
+#define TX_QUEUE_H
+
+#include <stdint.h>
+
+// Bounded queue of notifications waiting for a controller buffer.
+//
+// Producers push a whole payload; it is split into framed notifications
+// (ble_frame.h) with the next sequence number of its target, and the main
+// loop pops one per free controller buffer as TX-complete events return
+// them. A payload is queued whole or not at all, so the central never sees
+// part of one. When it does not fit the drop policy decides whether the new
+// payload or the oldest unsent ones go; either shows up at the central as
+// a sequence gap.
+// Backpressure asserts at the high watermark and clears at the low one so
+// producers can hold back lower-priority data before anything is dropped.
+
+#define TX_QUEUE_DEPTH          16
+#define TX_SLOT_SIZE            244     // BLE_ATT_MTU_MAX - 3
+#define TX_HIGH_WATERMARK       12
+#define TX_LOW_WATERMARK        4
+#define TX_TARGETS              6       // Characteristics with their own sequence
+
+typedef enum {
+    TX_DROP_NEWEST = 0,     // Refuse the payload being pushed
+    TX_DROP_OLDEST,         // Evict whole unsent payloads from the head
+} TxDropPolicy;
+
+typedef struct {
+    uint8_t target;         // Caller's characteristic id
+    uint8_t length;         // Including the frame header
+    bool first;             // Starts a payload
+    uint8_t data[TX_SLOT_SIZE];
+} TxSlot;
+
+typedef struct {
+    uint32_t payloads;          // Accepted
+    uint32_t fragments;         // Accepted
+    uint32_t sent;              // Fragments popped
+    uint32_t dropped_newest;    // Payloads refused
+    uint32_t dropped_oldest;    // Payloads evicted
+    uint32_t backpressure;      // Times the high watermark was reached
+    uint8_t high_water;
+} TxQueueStats;
+
+class TxQueue {
+public:
+    void init();
+
+    void setDropPolicy(TxDropPolicy policy);
+    TxDropPolicy dropPolicy() const;
+
+    // Frame data into notifications of at most notify_payload bytes;
+    // false if dropped or too long to frame
+    bool push(uint8_t target, const uint8_t* data, uint16_t length, uint16_t notify_payload);
+
+    // The same, under a sequence number already sent (retransmit.h)
+    bool resend(uint8_t target, uint16_t seq, const uint8_t* data, uint16_t length,
+                uint16_t notify_payload);
+
+    // Sequence number the next packet for target will carry
+    uint16_t nextSeq(uint8_t target) const;
+
+    // Oldest fragment, or 0 when empty; pop() once it has been handed over
+    const TxSlot* peek() const;
+    void pop();
+
+    uint8_t count() const;
+    uint8_t space() const;
+    bool backpressure() const;
+
+    // Unsent fragments are discarded, e.g. on disconnect
+    void clear();
+
+    const TxQueueStats* stats() const;
+    void resetStats();
+
+private:
+    TxSlot slots[TX_QUEUE_DEPTH];
+    uint8_t head;
+    uint8_t used;
+    bool congested;
+    uint8_t policy;
+    uint16_t seq[TX_TARGETS];
+    TxQueueStats counters;
+
+    bool enqueue(uint8_t target, uint16_t packet_seq, const uint8_t* data, uint16_t length,
+                 uint16_t notify_payload);
+    bool evictOldest();
+    void updateBackpressure();
+};
+
+#endif
@@ -0,0 +1,395 @@
+// firmware/src/adc_driver.cpp
+
+#include "adc_driver.h"
+#include "sys_time.h"
+#include "sample_clock.h"
+#include <Arduino.h>
+#include <string.h>
+
+#ifdef NRF52
+#include <nrf.h>
+#else
+#include <math.h>
+#endif
+
+#define ADC_MAX_COUNT   4095
+
+// Order queue stores against the index update seen by the other context
+#define ADC_COMPILER_BARRIER()  __asm__ volatile("" ::: "memory")
+
+#ifdef NRF52
+// EasyDMA targets; the SAADC fills one while the other is copied out
+static int16_t dma_buffer[2][ADC_SCAN_CHANNELS];
+static volatile uint8_t dma_active = 0;
+static volatile bool scan_busy = false;
+static volatile bool external_trigger = false;
+static AdcDriver* saadc_owner = 0;
+
+// Channels each buffer was armed with, and the set last written to the
+// SAADC channel registers
+static volatile uint8_t buffer_mask[2];
+static volatile uint8_t armed_mask = 0;
+
+// Gain 1/4 against VDD/4 gives a 0..VDD (3.3 V) input range, matching the
+// mV conversion in the sensor manager
+#define SAADC_CHANNEL_CONFIG \
+    ((SAADC_CH_CONFIG_RESP_Bypass << SAADC_CH_CONFIG_RESP_Pos) | \
+     (SAADC_CH_CONFIG_RESN_Bypass << SAADC_CH_CONFIG_RESN_Pos) | \
+     (SAADC_CH_CONFIG_GAIN_Gain1_4 << SAADC_CH_CONFIG_GAIN_Pos) | \
+     (SAADC_CH_CONFIG_REFSEL_VDD1_4 << SAADC_CH_CONFIG_REFSEL_Pos) | \
+     (SAADC_CH_CONFIG_TACQ_10us << SAADC_CH_CONFIG_TACQ_Pos) | \
+     (SAADC_CH_CONFIG_MODE_SE << SAADC_CH_CONFIG_MODE_Pos) | \
+     (SAADC_CH_CONFIG_BURST_Disabled << SAADC_CH_CONFIG_BURST_Pos))
+
+static uint8_t maskCount(uint8_t mask) {
+    uint8_t n = 0;
+    for (; mask; mask &= mask - 1) {
+        n++;
+    }
+    return n;
+}
+
+// Channel enables and result count for the scan the next START arms
+static void armChannels(uint8_t mask) {
+    if (mask != armed_mask) {
+        for (uint8_t ch = 0; ch < ADC_SCAN_CHANNELS; ch++) {
+            NRF_SAADC->CH[ch].PSELP = (mask & (1 << ch)) ?
+                SAADC_CH_PSELP_PSELP_AnalogInput0 + ch : SAADC_CH_PSELP_PSELP_NC;
+        }
+        armed_mask = mask;
+    }
+    NRF_SAADC->RESULT.MAXCNT = maskCount(mask);
+}
+
+extern "C" void SAADC_IRQHandler(void) {
+    // END before STARTED: the buffer index must flip before the next
+    // pointer is latched, in case both events are pending together
+    if (NRF_SAADC->EVENTS_END) {
+        NRF_SAADC->EVENTS_END = 0;
+        if (!scan_busy && !external_trigger) {
+            // Conversion started by someone else (analogRead)
+            return;
+        }
+        uint8_t done = dma_active;
+        dma_active = done ^ 1;
+        scan_busy = false;
+
+        // Re-arm into the buffer latched at the previous STARTED, with the
+        // channels wanted for the next trigger
+        if (saadc_owner) {
+            uint8_t next = saadc_owner->scanMask();
+            armChannels(next);
+            buffer_mask[done ^ 1] = next;
+        }
+        NRF_SAADC->TASKS_START = 1;
+
+        if (saadc_owner) {
+            saadc_owner->onScanComplete(dma_buffer[done], buffer_mask[done]);
+        }
+    }
+
+    if (NRF_SAADC->EVENTS_STARTED) {
+        NRF_SAADC->EVENTS_STARTED = 0;
+        NRF_SAADC->RESULT.PTR = (uint32_t)dma_buffer[dma_active ^ 1];
+    }
+}
+#endif
+
+void AdcDriver::init() {
+    queue_head = 0;
+    queue_tail = 0;
+    dropped = 0;
+    seq = 0;
+    running = false;
+    clock = 0;
+    scan_mask = ADC_ALL_CHANNELS;
+    converted = 0;
+
+#ifndef NRF52
+    // Mid-range analyte channels, pH ~7 and body temperature (370 mV)
+    static const AdcSyntheticChannel defaults[ADC_SCAN_CHANNELS] = {
+        {1000, 0, 0, 4}, {1000, 0, 0, 4}, {1000, 0, 0, 4},
+        {20, 0, 0, 4}, {459, 0, 0, 4}, {1000, 0, 0, 4}
+    };
+    setSyntheticSource(defaults);
+    noise_state = 0x2545F491;
+#endif
+}
+
+void AdcDriver::start() {
+    if (running) return;
+
+#ifdef NRF52
+    NRF_SAADC->ENABLE = SAADC_ENABLE_ENABLE_Disabled;
+    NRF_SAADC->INTENCLR = 0xFFFFFFFF;
+
+    for (uint8_t ch = 0; ch < 8; ch++) {
+        NRF_SAADC->CH[ch].PSELP = SAADC_CH_PSELP_PSELP_NC;
+        NRF_SAADC->CH[ch].PSELN = SAADC_CH_PSELN_PSELN_NC;
+    }
+
+    // A0..A5 on AIN0..AIN5, scanned in channel order
+    for (uint8_t ch = 0; ch < ADC_SCAN_CHANNELS; ch++) {
+        NRF_SAADC->CH[ch].CONFIG = SAADC_CHANNEL_CONFIG;
+    }
+    armed_mask = 0;
+
+    NRF_SAADC->RESOLUTION = SAADC_RESOLUTION_VAL_12bit;
+    NRF_SAADC->OVERSAMPLE = SAADC_OVERSAMPLE_OVERSAMPLE_Bypass;
+    NRF_SAADC->SAMPLERATE = SAADC_SAMPLERATE_MODE_Task << SAADC_SAMPLERATE_MODE_Pos;
+    NRF_SAADC->ENABLE = SAADC_ENABLE_ENABLE_Enabled;
+
+    // Offset calibration once per claim
+    NRF_SAADC->EVENTS_CALIBRATEDONE = 0;
+    NRF_SAADC->TASKS_CALIBRATEOFFSET = 1;
+    while (!NRF_SAADC->EVENTS_CALIBRATEDONE);
+    NRF_SAADC->EVENTS_CALIBRATEDONE = 0;
+
+    dma_active = 0;
+    scan_busy = false;
+    saadc_owner = this;
+    NRF_SAADC->RESULT.PTR = (uint32_t)dma_buffer[0];
+    armChannels(scan_mask);
+    buffer_mask[0] = scan_mask;
+
+    NRF_SAADC->EVENTS_STARTED = 0;
+    NRF_SAADC->EVENTS_END = 0;
+    NRF_SAADC->INTENSET = SAADC_INTENSET_STARTED_Msk | SAADC_INTENSET_END_Msk;
+    NVIC_SetPriority(SAADC_IRQn, 3);
+    NVIC_ClearPendingIRQ(SAADC_IRQn);
+    NVIC_EnableIRQ(SAADC_IRQn);
+
+    NRF_SAADC->TASKS_START = 1;
+#endif
+
+    running = true;
+}
+
+void AdcDriver::stop() {
+    if (!running) return;
+
+#ifdef NRF52
+    NVIC_DisableIRQ(SAADC_IRQn);
+    NRF_SAADC->INTENCLR = 0xFFFFFFFF;
+
+    NRF_SAADC->EVENTS_STOPPED = 0;
+    NRF_SAADC->TASKS_STOP = 1;
+    while (!NRF_SAADC->EVENTS_STOPPED);
+    NRF_SAADC->EVENTS_STOPPED = 0;
+
+    NRF_SAADC->ENABLE = SAADC_ENABLE_ENABLE_Disabled;
+    saadc_owner = 0;
+    scan_busy = false;
+#endif
+
+    running = false;
+}
+
+bool AdcDriver::trigger() {
+    if (clock) return false;
+
+#ifdef NRF52
+    // analogRead() reconfigures and disables the SAADC; reclaim it
+    if (running && (NRF_SAADC->ENABLE == SAADC_ENABLE_ENABLE_Disabled ||
+                    NRF_SAADC->RESULT.MAXCNT != maskCount(buffer_mask[dma_active]))) {
+        running = false;
+    }
+#endif
+    start();
+
+#ifdef NRF52
+    if (scan_busy) return false;
+
+    // The armed buffer latched its count at START; re-arm for a new mask
+    if (buffer_mask[dma_active] != scan_mask) {
+        NRF_SAADC->INTENCLR = SAADC_INTENCLR_STARTED_Msk;
+        NRF_SAADC->EVENTS_STOPPED = 0;
+        NRF_SAADC->TASKS_STOP = 1;
+        while (!NRF_SAADC->EVENTS_STOPPED);
+        NRF_SAADC->EVENTS_STOPPED = 0;
+        NRF_SAADC->EVENTS_END = 0;
+
+        NRF_SAADC->RESULT.PTR = (uint32_t)dma_buffer[dma_active];
+        armChannels(scan_mask);
+        buffer_mask[dma_active] = scan_mask;
+        NRF_SAADC->EVENTS_STARTED = 0;
+        NRF_SAADC->TASKS_START = 1;
+        while (!NRF_SAADC->EVENTS_STARTED);
+        NRF_SAADC->EVENTS_STARTED = 0;
+        NRF_SAADC->RESULT.PTR = (uint32_t)dma_buffer[dma_active ^ 1];
+        NRF_SAADC->INTENSET = SAADC_INTENSET_STARTED_Msk;
+    }
+
+    scan_busy = true;
+    NRF_SAADC->TASKS_SAMPLE = 1;
+    return true;
+#else
+    return onExternalTrigger();
+#endif
+}
+
+void AdcDriver::setTriggerClock(const SampleClock* sample_clock) {
+    clock = sample_clock;
+#ifdef NRF52
+    external_trigger = (sample_clock != 0);
+#endif
+}
+
+void AdcDriver::setScanMask(uint8_t mask) {
+    mask &= ADC_ALL_CHANNELS;
+    scan_mask = mask ? mask : ADC_ALL_CHANNELS;
+}
+
+uint8_t AdcDriver::scanMask() const {
+    return scan_mask;
+}
+
+uint32_t AdcDriver::conversions() const {
+    return converted;
+}
+
+void AdcDriver::onScanComplete(const int16_t* result, uint8_t mask) {
+    uint8_t head = queue_head;
+    uint8_t n = 0;
+
+    for (uint8_t ch = 0; ch < ADC_SCAN_CHANNELS; ch++) {
+        n += (mask >> ch) & 1;
+    }
+    converted += n;
+
+    if ((uint8_t)(head - queue_tail) >= ADC_FRAME_QUEUE_DEPTH) {
+        dropped++;
+        seq++;
+        return;
+    }
+
+    AdcFrame* frame = &queue[head & (ADC_FRAME_QUEUE_DEPTH - 1)];
+    const int16_t* next = result;
+    for (uint8_t ch = 0; ch < ADC_SCAN_CHANNELS; ch++) {
+        if (!(mask & (1 << ch))) {
+            frame->raw[ch] = 0;
+            continue;
+        }
+        // Single-ended inputs can read slightly below zero
+        int16_t v = *next++;
+        frame->raw[ch] = (v < 0) ? 0 : ((v > ADC_MAX_COUNT) ? ADC_MAX_COUNT : (uint16_t)v);
+    }
+    frame->mask = mask;
+    // Trigger time, not completion time
+    uint64_t tick = clock ? clock->triggerTick() : SampleClock::msToTicks(sysMillis());
+    frame->tick = (uint32_t)tick;
+    frame->timestamp_ms = SampleClock::ticksToMs(tick);
+    frame->seq = seq++;
+
+    ADC_COMPILER_BARRIER();
+    queue_head = head + 1;
+}
+
+bool AdcDriver::fetch(AdcFrame* frame) {
+    uint8_t tail = queue_tail;
+    if (tail == queue_head) return false;
+
+    ADC_COMPILER_BARRIER();
+    memcpy(frame, &queue[tail & (ADC_FRAME_QUEUE_DEPTH - 1)], sizeof(AdcFrame));
+    ADC_COMPILER_BARRIER();
+    queue_tail = tail + 1;
+    return true;
+}
+
+bool AdcDriver::acquire(AdcFrame* frame) {
+    // Frames already queued are stale for a blocking caller and are skipped
+    uint32_t wanted = seq;
+    if (!trigger()) return false;
+
+    uint32_t start_us = sysMicros();
+    while (sysMicros() - start_us < ADC_SCAN_TIMEOUT_US) {
+        while (fetch(frame)) {
+            if (frame->seq == wanted) return true;
+        }
+#ifdef NRF52
+        __WFE();
+#else
+        // The stand-in completes scans synchronously; nothing more is coming
+        break;
+#endif
+    }
+    return false;
+}
+
+uint8_t AdcDriver::pending() const {
+    return (uint8_t)(queue_head - queue_tail);
+}
+
+uint32_t AdcDriver::droppedFrames() const {
+    return dropped;
+}
+
+bool AdcDriver::isRunning() const {
+    return running;
+}
+
+#ifndef NRF52
+void AdcDriver::setSyntheticSource(const AdcSyntheticChannel* channels) {
+    memcpy(synthetic, channels, sizeof(synthetic));
+    recorded = 0;
+    recorded_count = 0;
+    recorded_pos = 0;
+}
+
+void AdcDriver::setRecordedSource(const uint16_t* frames, uint32_t frame_count, bool loop) {
+    recorded = frames;
+    recorded_count = frame_count;
+    recorded_pos = 0;
+    recorded_loop = loop;
+}
+
+bool AdcDriver::onExternalTrigger() {
+    // The stand-in completes the scan immediately, as the END interrupt
+    // would, with DMA-packed results for the masked channels
+    int16_t result[ADC_SCAN_CHANNELS];
+    if (!generateFrame(result)) return false;
+
+    uint8_t mask = scan_mask;
+    uint8_t n = 0;
+    for (uint8_t ch = 0; ch < ADC_SCAN_CHANNELS; ch++) {
+        if (mask & (1 << ch)) {
+            result[n++] = result[ch];
+        }
+    }
+    onScanComplete(result, mask);
+    return true;
+}
+
+bool AdcDriver::generateFrame(int16_t* result) {
+    if (recorded) {
+        if (recorded_pos >= recorded_count) {
+            if (!recorded_loop || recorded_count == 0) return false;
+            recorded_pos = 0;
+        }
+        const uint16_t* src = &recorded[recorded_pos * ADC_SCAN_CHANNELS];
+        for (uint8_t ch = 0; ch < ADC_SCAN_CHANNELS; ch++) {
+            result[ch] = (int16_t)src[ch];
+        }
+        recorded_pos++;
+        return true;
+    }
+
+    for (uint8_t ch = 0; ch < ADC_SCAN_CHANNELS; ch++) {
+        const AdcSyntheticChannel* c = &synthetic[ch];
+        float v = c->level;
+
+        if (c->amplitude && c->period_frames) {
+            v += c->amplitude * sinf(2.0f * (float)M_PI * (seq % c->period_frames) / c->period_frames);
+        }
+        if (c->noise) {
+            // xorshift32, uniform in [-noise, +noise]
+            noise_state ^= noise_state << 13;
+            noise_state ^= noise_state >> 17;
+            noise_state ^= noise_state << 5;
+            v += (int32_t)(noise_state % (2u * c->noise + 1)) - (int32_t)c->noise;
+        }
+        result[ch] = (int16_t)lrintf(v);
+    }
+    return true;
+}
+#endif
@@ -0,0 +1,110 @@
+// firmware/src/baseline_tracker.cpp
+
+#include "baseline_tracker.h"
+#include <math.h>
+#include <string.h>
+
+// Mean absolute deviation to standard deviation, Gaussian noise
+#define MAD_TO_SIGMA    1.2533f
+
+void BaselineTracker::init(uint32_t window, bool fit) {
+    window_ms = window;
+    fit_drift = fit;
+    reset(0);
+}
+
+void BaselineTracker::reset(uint32_t now_ms) {
+    memset(channels, 0, sizeof(channels));
+    window_start_ms = now_ms;
+    epoch_ms = now_ms;
+    window_samples = 0;
+    windows = 0;
+    primed = false;
+}
+
+void BaselineTracker::setWindow(uint32_t window) {
+    window_ms = window;
+}
+
+void BaselineTracker::setDriftFit(bool enabled) {
+    fit_drift = enabled;
+}
+
+bool BaselineTracker::addSample(const float* mv, uint32_t now_ms) {
+    if (!primed) {
+        for (uint8_t i = 0; i < BASELINE_CHANNELS; i++) {
+            channels[i].location_mv = mv[i];
+        }
+        primed = true;
+    }
+
+    for (uint8_t i = 0; i < BASELINE_CHANNELS; i++) {
+        BaselineChannel* c = &channels[i];
+
+        float scale = (c->scale_mv > BASELINE_SCALE_FLOOR_MV) ? c->scale_mv : BASELINE_SCALE_FLOOR_MV;
+        float limit = BASELINE_HUBER_K * MAD_TO_SIGMA * scale;
+        float r = mv[i] - c->location_mv;
+        r = (r > limit) ? limit : ((r < -limit) ? -limit : r);
+
+        // Winsorised sample, then the Huber location and spread steps
+        c->window_sum_mv += c->location_mv + r;
+        c->location_mv += BASELINE_LOCATION_ALPHA * r;
+        c->scale_mv += BASELINE_SCALE_ALPHA * (fabsf(r) - c->scale_mv);
+    }
+    window_samples++;
+
+    if (now_ms - window_start_ms < window_ms) {
+        return false;
+    }
+    closeWindow(now_ms);
+    return true;
+}
+
+void BaselineTracker::closeWindow(uint32_t now_ms) {
+    float t = (now_ms - epoch_ms) / 60000.0f;
+    windows++;
+
+    for (uint8_t i = 0; i < BASELINE_CHANNELS; i++) {
+        BaselineChannel* c = &channels[i];
+        float mean = c->window_sum_mv / window_samples;
+        c->window_sum_mv = 0.0f;
+
+        // Apply exponential moving average for smooth baseline tracking
+        float ema = (BASELINE_EMA_ALPHA * mean) + ((1.0f - BASELINE_EMA_ALPHA) * c->baseline_mv);
+
+        c->sw = BASELINE_FIT_FORGET * c->sw + 1.0f;
+        c->st = BASELINE_FIT_FORGET * c->st + t;
+        c->sy = BASELINE_FIT_FORGET * c->sy + mean;
+        c->stt = BASELINE_FIT_FORGET * c->stt + t * t;
+        c->sty = BASELINE_FIT_FORGET * c->sty + t * mean;
+
+        float det = c->sw * c->stt - c->st * c->st;
+        if (windows >= BASELINE_FIT_MIN_WINDOWS && det > 1e-9f) {
+            c->slope_mv_per_min = (c->sw * c->sty - c->st * c->sy) / det;
+        } else {
+            c->slope_mv_per_min = 0.0f;
+        }
+
+        if (fit_drift && windows >= BASELINE_FIT_MIN_WINDOWS && det > 1e-9f) {
+            float intercept = (c->sy - c->slope_mv_per_min * c->st) / c->sw;
+            c->baseline_mv = intercept + c->slope_mv_per_min * t;
+        } else {
+            c->baseline_mv = ema;
+        }
+    }
+
+    window_samples = 0;
+    window_start_ms = now_ms;
+}
+
+float BaselineTracker::baseline(uint8_t channel) const {
+    return channels[channel].baseline_mv;
+}
+
+float BaselineTracker::driftPerMinute(uint8_t channel) const {
+    return channels[channel].slope_mv_per_min;
+}
+
+uint32_t BaselineTracker::windowsClosed() const {
+    return windows;
+}
@@ -2,6 +2,10 @@
 
 #include <ArduinoBLE.h>
 #include "ble_comms.h"
+#include "ble_link.h"
+#include "tx_queue.h"
+#include "ble_frame.h"
+#include "retransmit.h"
 #include "aes.h"
 #include <string.h>
 
@@ -9,24 +13,64 @@
 static BLEService sensorService(SERVICE_UUID);
 static BLECharacteristic sensorDataChar(SENSOR_DATA_UUID, BLERead | BLENotify, BLE_TX_BUFFER_SIZE);
 static BLECharacteristic controlChar(CONTROL_UUID, BLEWrite | BLERead, 20);
+static BLECharacteristic spectralChar(SPECTRAL_UUID, BLERead | BLENotify, BLE_TX_BUFFER_SIZE);
+static BLECharacteristic responseChar(RESPONSE_UUID, BLERead | BLENotify, 20);
+static BLECharacteristic logDataChar(LOG_DATA_UUID, BLERead | BLENotify, BLE_TX_BUFFER_SIZE);
+static BLECharacteristic rawDataChar(RAW_DATA_UUID, BLERead | BLENotify, BLE_TX_BUFFER_SIZE);
+static BLECharacteristic filteredDataChar(FILTERED_DATA_UUID, BLERead | BLENotify, BLE_TX_BUFFER_SIZE);
+static BLECharacteristic summaryChar(SUMMARY_UUID, BLERead | BLENotify, BLE_TX_BUFFER_SIZE);
+
+// Queued notification targets, indexing txTargets
+#define TX_SENSOR_DATA      0
+#define TX_SPECTRAL         1
+#define TX_LOG_DATA         2
+#define TX_RAW_DATA         3
+#define TX_FILTERED_DATA    4
+#define TX_SUMMARY          5
+
+static BLECharacteristic* const txTargets[TX_TARGETS] = {
+    &sensorDataChar, &spectralChar, &logDataChar, &rawDataChar, &filteredDataChar, &summaryChar
+};
+
+// Characteristic and TX target of each telemetry stream
+static BLECharacteristic* const streamChars[STREAM_COUNT] = {
+    &rawDataChar, &filteredDataChar, &sensorDataChar, &summaryChar
+};
+static const uint8_t streamTargets[STREAM_COUNT] = {
+    TX_RAW_DATA, TX_FILTERED_DATA, TX_SENSOR_DATA, TX_SUMMARY
+};
 
 // Connection state
 static bool ble_connected = false;
+static BleLink link;
+static TxQueue txQueue;
+static RetransmitBuffer retransmit;
+static CommandQueue commandQueue;
 
 // Callback handlers
 static void onBLEConnect(BLEDevice central) {
     ble_connected = true;
+    link.onConnect(central.address().c_str());
     Serial.print("Connected to: ");
     Serial.println(central.address());
 }
 
 static void onBLEDisconnect(BLEDevice central) {
     ble_connected = false;
+    link.onDisconnect();
+    txQueue.clear();
+    retransmit.clear();
     Serial.print("Disconnected from: ");
     Serial.println(central.address());
     BLE.advertise();  // Resume advertising
 }
 
+// Runs inside BLE.poll(): only copy the write out
+static void onControlWritten(BLEDevice central, BLECharacteristic characteristic) {
+    (void)central;
+    commandQueue.push(characteristic.value(), characteristic.valueLength(), micros());
+}
+
 void BLECommsManager::init() {
     if (!BLE.begin()) {
         Serial.println("BLE init failed");
@@ -41,16 +85,34 @@ void BLECommsManager::init() {
     // Configure characteristics
     sensorService.addCharacteristic(sensorDataChar);
     sensorService.addCharacteristic(controlChar);
+    sensorService.addCharacteristic(spectralChar);
+    sensorService.addCharacteristic(responseChar);
+    sensorService.addCharacteristic(logDataChar);
+    sensorService.addCharacteristic(rawDataChar);
+    sensorService.addCharacteristic(filteredDataChar);
+    sensorService.addCharacteristic(summaryChar);
     BLE.addService(sensorService);
     
     // Set initial values
     uint8_t initial_data[1] = {0x00};
     sensorDataChar.writeValue(initial_data, 1);
     controlChar.writeValue(initial_data, 1);
+    spectralChar.writeValue(initial_data, 1);
+    responseChar.writeValue(initial_data, 1);
+    logDataChar.writeValue(initial_data, 1);
+    rawDataChar.writeValue(initial_data, 1);
+    filteredDataChar.writeValue(initial_data, 1);
+    summaryChar.writeValue(initial_data, 1);
     
     // Set event handlers
     BLE.setEventHandler(BLEConnected, onBLEConnect);
     BLE.setEventHandler(BLEDisconnected, onBLEDisconnect);
+    controlChar.setEventHandler(BLEWritten, onControlWritten);
+    
+    // Offer the largest MTU and data length before any central connects
+    link.init();
+    txQueue.init();
+    retransmit.init();
     
     // Start advertising
     BLE.advertise();
@@ -58,122 +120,664 @@ void BLECommsManager::init() {
     
     // Initialize with default key (should be replaced via secure pairing)
     memset(aes_key, 0, 16);
+    broadcastDeriveKeys(aes_key, &broadcast_keys);
     connected = false;
+    codec.init();
+    batcher.init();
+    sample_log = 0;
+    log_syncing = false;
+    bulk.init();
+    conn_policy.init();
+    sample_interval_ms = 0;
+    applied_interval = 0;
+    applied_latency = 0;
+    streams = 0;
+    summary.init(SUMMARY_PERIOD_DEFAULT_MS);
+    memset(&stream_stats, 0, sizeof(stream_stats));
+    broadcast_interval_ms = 0;
+    broadcast_counter = 0;
+    last_broadcast_ms = 0;
+    broadcast_fresh = false;
+    advertising_snapshot = false;
+    
+    // Written from BLE.poll(), run from processControlCommands()
+    commandQueue.init();
+    commands.init();
+    response_seq = 0;
+    resetCommandStats();
+    commands.add(CMD_LOG_SYNC, 0, onLogSync, this);
+    commands.add(CMD_BULK_START, 2, onBulkStart, this);
+    commands.add(CMD_BULK_CREDIT, 2, onBulkCredit, this);
+    commands.add(CMD_SET_SUMMARY_PERIOD, 2, onSetSummaryPeriod, this);
+    commands.add(CMD_ACK_TELEMETRY, RETRANSMIT_ACK_SIZE, onAckTelemetry, this);
 }
 
 void BLECommsManager::setEncryptionKey(const uint8_t* key) {
     memcpy(aes_key, key, 16);
+    broadcastDeriveKeys(aes_key, &broadcast_keys);
 }
 
 bool BLECommsManager::isConnected() {
     return ble_connected;
 }
 
-void BLECommsManager::transmitEncrypted(uint8_t* data, uint16_t length) {
-    if (!ble_connected) return;
-    
+// Hand queued notifications to the controller while it has buffers free.
+// Completions arrive during BLE.poll(), so this runs after every poll and
+// after every push; nothing here waits on the radio.
+static void pumpTx() {
+    const TxSlot* slot;
+    while (link.txCredits() > 0 && (slot = txQueue.peek()) != 0) {
+        txTargets[slot->target]->writeValue(slot->data, slot->length);
+        link.onTxSent();
+        txQueue.pop();
+    }
+}
+
+// Encrypt and queue for one characteristic as framed notifications of the
+// negotiated MTU; false if the queue dropped it. Sensor data is kept for
+// resending until acknowledged.
+static bool notifyEncrypted(uint8_t target, const uint8_t* key,
+                            const uint8_t* data, uint16_t length, uint16_t readings = 1) {
     uint8_t encrypted[BLE_TX_BUFFER_SIZE];
-    uint16_t encrypted_len = aes128_encrypt(data, encrypted, aes_key, length);
+    uint16_t encrypted_len = aes128_encrypt(data, encrypted, key, length);
+    uint16_t payload = link.notifyPayload();
+    uint16_t seq = txQueue.nextSeq(target);
     
-    // Transmit in chunks (BLE max 20 bytes per notification)
-    for (uint16_t i = 0; i < encrypted_len; i += BLE_MTU_SIZE) {
-        uint16_t chunk_size = encrypted_len - i;
-        if (chunk_size > BLE_MTU_SIZE) {
-            chunk_size = BLE_MTU_SIZE;
+    if (!txQueue.push(target, encrypted, encrypted_len, payload)) {
+        return false;
+    }
+    if (target == TX_SENSOR_DATA) {
+        retransmit.store(seq, encrypted, (uint8_t)encrypted_len);
+    }
+    uint8_t fragments = frameFragmentsFor(encrypted_len, payload);
+    link.record(encrypted_len + fragments * FRAME_HEADER_SIZE, fragments, readings);
+    pumpTx();
+    return true;
+}
+
+// Requeue what the central reported missing, under its original sequence
+// number; only into room the queue has short of backpressure, so resends
+// never push out new readings
+static void pumpRetransmit() {
+    const RetransmitSlot* slot;
+    uint16_t payload = link.notifyPayload();
+    while (!txQueue.backpressure() && (slot = retransmit.nextMissing()) != 0) {
+        uint8_t fragments = frameFragmentsFor(slot->length, payload);
+        if (fragments > txQueue.space() ||
+            !txQueue.resend(TX_SENSOR_DATA, slot->seq, slot->data, slot->length, payload)) {
+            break;
         }
-        
-        sensorDataChar.writeValue(encrypted + i, chunk_size);
-        delay(10);  // Ensure transmission completes
+        link.record(slot->length + fragments * FRAME_HEADER_SIZE, fragments, 0);
+        retransmit.resent(slot);
     }
 }
 
-void BLECommsManager::transmitSensorReading(SensorReading* reading) {
-    if (!ble_connected) return;
+bool BLECommsManager::transmitEncrypted(uint8_t* data, uint16_t length) {
+    if (!ble_connected) return false;
+    
+    return notifyEncrypted(TX_SENSOR_DATA, aes_key, data, length);
+}
+
+bool BLECommsManager::transmitSensorReading(SensorReading* reading) {
+    if (!ble_connected) return false;
     
     // Serialize sensor reading
     uint8_t buffer[sizeof(SensorReading)];
     memcpy(buffer, reading, sizeof(SensorReading));
     
     // Transmit encrypted
-    transmitEncrypted(buffer, sizeof(SensorReading));
+    return transmitEncrypted(buffer, sizeof(SensorReading));
+}
+
+bool BLECommsManager::transmitCompactReading(const SensorReading* reading, uint8_t mask) {
+    if (!ble_connected) {
+        batcher.clear();
+        return false;
+    }
+    
+    // 12 bytes for all six channels; batched up to one notification
+    uint8_t buffer[CODEC_MAX_SIZE];
+    uint8_t length = codec.encode(reading, mask, buffer);
+    uint32_t now = millis();
+    
+    uint16_t framed = link.notifyPayload() - FRAME_HEADER_SIZE;
+    batcher.setCapacity(ReadingBatcher::capacityFor(framed), codec.size(ADC_ALL_CHANNELS));
+    if (!batcher.fits(length)) {
+        flushBatch(now);
+    }
+    batcher.add(buffer, length, now);
+    if (batcher.full()) {
+        flushBatch(now);
+    }
+    return true;
+}
+
+bool BLECommsManager::flushBatch(uint32_t now) {
+    if (batcher.count() == 0) return true;
+    
+    // Encrypted once for the whole batch
+    bool sent = sendStream(STREAM_COMPRESSED, batcher.data(), batcher.length(), batcher.count());
+    batcher.take(now);
+    return sent;
+}
+
+bool BLECommsManager::sendStream(uint8_t stream, const uint8_t* data, uint16_t length, uint16_t readings) {
+    if (!notifyEncrypted(streamTargets[stream], aes_key, data, length, readings)) {
+        stream_stats.dropped[stream]++;
+        return false;
+    }
+    stream_stats.notifications[stream]++;
+    stream_stats.bytes[stream] += length;
+    return true;
+}
+
+bool BLECommsManager::transmitReading(const SensorReading* filtered, const uint16_t* counts, uint8_t mask) {
+    if (!ble_connected || !streams) return false;
+    
+    // Nothing is encoded or encrypted for a stream nobody reads
+    if (streams & STREAM_BIT(STREAM_RAW)) {
+        uint8_t buffer[STREAM_RAW_MAX_SIZE];
+        uint8_t length = streamEncodeRaw(counts, mask, filtered->timestamp_ms, buffer);
+        sendStream(STREAM_RAW, buffer, length, 1);
+    }
+    if (streams & STREAM_BIT(STREAM_FILTERED)) {
+        uint8_t buffer[STREAM_FILTERED_MAX_SIZE];
+        uint8_t length = streamEncodeFiltered(filtered, mask, buffer);
+        sendStream(STREAM_FILTERED, buffer, length, 1);
+    }
+    if (streams & STREAM_BIT(STREAM_COMPRESSED)) {
+        transmitCompactReading(filtered, mask);
+    }
+    if (streams & STREAM_BIT(STREAM_SUMMARY)) {
+        summary.add(filtered, mask);
+    }
+    return true;
+}
+
+uint8_t BLECommsManager::activeStreams() {
+    return streams;
+}
+
+const StreamStats* BLECommsManager::streamStats() {
+    return &stream_stats;
+}
+
+void BLECommsManager::setSummaryPeriod(uint32_t ms) {
+    summary.setPeriod(ms);
+}
+
+static const char* const streamNames[STREAM_COUNT] = {"raw", "filtered", "compressed", "summary"};
+
+void BLECommsManager::updateStreams(uint32_t now) {
+    uint8_t subscribed = 0;
+    if (ble_connected) {
+        for (uint8_t i = 0; i < STREAM_COUNT; i++) {
+            if (streamChars[i]->subscribed()) {
+                subscribed |= STREAM_BIT(i);
+            }
+        }
+    }
+    if (subscribed == streams) return;
+    
+    // A summary covers only time someone was subscribed; a dropped
+    // compressed stream takes its partial batch with it
+    uint8_t added = subscribed & ~streams;
+    if (added & STREAM_BIT(STREAM_SUMMARY)) {
+        summary.restart(now);
+    }
+    if (!(subscribed & STREAM_BIT(STREAM_COMPRESSED))) {
+        batcher.clear();
+    }
+    streams = subscribed;
+    
+    Serial.print("Streams:");
+    for (uint8_t i = 0; i < STREAM_COUNT; i++) {
+        if (streams & STREAM_BIT(i)) {
+            Serial.print(" ");
+            Serial.print(streamNames[i]);
+        }
+    }
+    Serial.println(streams ? "" : " none");
+}
+
+void BLECommsManager::setBroadcastInterval(uint16_t ms) {
+    if (ms != 0 && ms < BROADCAST_INTERVAL_MIN_MS) ms = BROADCAST_INTERVAL_MIN_MS;
+    if (ms > BROADCAST_INTERVAL_MAX_MS) ms = BROADCAST_INTERVAL_MAX_MS;
+    broadcast_interval_ms = ms;
+    
+    // Back to the plain advertisement; a snapshot goes up on the next
+    // reading after the interval
+    if (ms == 0 && advertising_snapshot) {
+        advertiseDefault();
+    }
+    last_broadcast_ms = millis() - ms;
+}
+
+uint16_t BLECommsManager::broadcastInterval() {
+    return broadcast_interval_ms;
+}
+
+void BLECommsManager::setBroadcastCounter(uint32_t counter) {
+    broadcast_counter = counter;
+}
+
+uint32_t BLECommsManager::broadcastCounter() {
+    return broadcast_counter;
+}
+
+void BLECommsManager::broadcastReading(const SensorReading* reading) {
+    if (!broadcast_interval_ms) return;
+    
+    // Only kept here; encoded and sealed when the interval comes round
+    broadcast_snapshot = *reading;
+    broadcast_fresh = true;
+}
+
+void BLECommsManager::advertiseSnapshot(uint32_t now) {
+    uint8_t plain[CODEC_MAX_SIZE];
+    uint8_t length = codec.encode(&broadcast_snapshot, ADC_ALL_CHANNELS, plain);
+    uint8_t payload[BROADCAST_MAX_SIZE];
+    uint8_t payload_length = broadcastSeal(&broadcast_keys, ++broadcast_counter, plain, length, payload);
+    
+    BLEAdvertisingData advert;
+    advert.setFlags(BLEFlagsGeneralDiscoverable | BLEFlagsBREDRNotSupported);
+    advert.setManufacturerData(BROADCAST_COMPANY_ID, payload, payload_length);
+    BLEAdvertisingData scan;
+    scan.setAdvertisedService(sensorService);
+    
+    // Connectable still, so the app can reach the device to turn it off
+    BLE.stopAdvertise();
+    BLE.setAdvertisingData(advert);
+    BLE.setScanResponseData(scan);
+    BLE.setAdvertisingInterval((uint32_t)broadcast_interval_ms * 1000 / BLE_ADV_UNIT_US);
+    BLE.advertise();
+    
+    advertising_snapshot = true;
+    broadcast_fresh = false;
+    last_broadcast_ms = now;
+}
+
+void BLECommsManager::advertiseDefault() {
+    BLEAdvertisingData advert;
+    advert.setFlags(BLEFlagsGeneralDiscoverable | BLEFlagsBREDRNotSupported);
+    advert.setAdvertisedService(sensorService);
+    BLEAdvertisingData scan;
+    scan.setLocalName("Symbion-GBI");
+    
+    BLE.stopAdvertise();
+    BLE.setAdvertisingData(advert);
+    BLE.setScanResponseData(scan);
+    BLE.setAdvertisingInterval(BLE_ADV_INTERVAL_DEFAULT);
+    if (!ble_connected) {
+        BLE.advertise();
+    }
+    advertising_snapshot = false;
+}
+
+void BLECommsManager::setBatchLatency(uint16_t ms) {
+    batcher.setLatency(ms);
+}
+
+uint16_t BLECommsManager::batchLatency() {
+    return batcher.latency();
+}
+
+const BatchStats* BLECommsManager::batchStats() {
+    return batcher.stats();
+}
+
+void BLECommsManager::setSampleLog(SampleLog* log) {
+    sample_log = log;
+}
+
+void BLECommsManager::startLogSync(uint32_t from) {
+    if (!sample_log || !ble_connected) return;
+    
+    // Readings still in RAM go out with the rest
+    sample_log->flush();
+    sample_log->seek(from);
+    if (bulk.active()) {
+        bulk.stop(millis());
+        link.setPhy(BLE_PHY_1M);
+    }
+    log_syncing = true;
+}
+
+bool BLECommsManager::logSyncActive() {
+    return log_syncing;
+}
+
+void BLECommsManager::pumpLogSync() {
+    // Catch-up only goes into an empty queue with a controller buffer
+    // free, so live readings never wait behind the backlog
+    while (log_syncing && txQueue.count() == 0 && link.txCredits() > 0) {
+        uint8_t packet[LOG_PACKET_MAX];
+        uint16_t readings;
+        uint16_t length = sample_log->readPacket(packet, &readings);
+        if (length == 0) {
+            log_syncing = false;
+            break;
+        }
+        notifyEncrypted(TX_LOG_DATA, aes_key, packet, length, readings);
+    }
+}
+
+bool BLECommsManager::transmitSpectralFeatures(SpectralFeatures* features) {
+    if (!ble_connected) return false;
+    
+    // Serialize spectral features
+    uint8_t buffer[sizeof(SpectralFeatures)];
+    memcpy(buffer, features, sizeof(SpectralFeatures));
+    
+    return notifyEncrypted(TX_SPECTRAL, aes_key, buffer, sizeof(SpectralFeatures));
+}
+
+void BLECommsManager::transmitProcedureStatus(const ProcedureStatus* status) {
+    if (!ble_connected) return;
+    
+    // Control-plane status, readable before a key is provisioned
+    uint8_t packet[1 + sizeof(ProcedureStatus)];
+    packet[0] = RESP_PROCEDURE;
+    memcpy(packet + 1, status, sizeof(ProcedureStatus));
+    responseChar.writeValue(packet, sizeof(packet));
+}
+
+void BLECommsManager::linkStats(BleLinkStats* stats) {
+    link.stats(stats);
+}
+
+void BLECommsManager::resetLinkStats() {
+    link.resetStats();
+    txQueue.resetStats();
+    retransmit.resetStats();
+    batcher.resetStats();
+    memset(&stream_stats, 0, sizeof(stream_stats));
+}
+
+void BLECommsManager::startBulkTransfer(uint32_t from, uint16_t credits) {
+    if (!sample_log || !ble_connected) return;
+    
+    sample_log->flush();
+    sample_log->seek(from);
+    log_syncing = false;
+    link.setPhy(BLE_PHY_2M);
+    bulk.start(credits, millis());
+}
+
+void BLECommsManager::grantBulkCredits(uint16_t credits) {
+    bulk.grant(credits);
+}
+
+bool BLECommsManager::bulkActive() {
+    return bulk.active();
+}
+
+const BulkStats* BLECommsManager::bulkStats() {
+    return bulk.stats();
+}
+
+void BLECommsManager::pumpBulk(uint32_t now) {
+    if (!bulk.active()) return;
+    
+    // Keep the controller's buffers full until credits or the log run out
+    while (bulk.service(sample_log, &txQueue, &link, TX_LOG_DATA, aes_key, now) > 0) {
+        pumpTx();
+    }
+    if (bulk.active()) return;
+    
+    const BulkStats* stats = bulk.stats();
+    Serial.print("Bulk: ");
+    Serial.print(stats->readings);
+    Serial.print(" readings, ");
+    Serial.print(stats->bytes);
+    Serial.print(" B in ");
+    Serial.print(stats->elapsed_ms);
+    Serial.print(" ms, ");
+    Serial.print(stats->bytes_per_sec / 1000.0f, 1);
+    Serial.print(" kB/s, ");
+    Serial.println(stats->phy == BLE_PHY_2M ? "2M PHY" : "1M PHY");
+    link.setPhy(BLE_PHY_1M);
+}
+
+void BLECommsManager::setSamplingInterval(uint16_t ms) {
+    sample_interval_ms = ms;
+}
+
+const ConnParams* BLECommsManager::connParams() {
+    return conn_policy.requested();
+}
+
+static const char* connModeName(uint8_t mode) {
+    switch (mode) {
+        case CONN_MODE_BULK: return "bulk";
+        case CONN_MODE_BACKLOG: return "backlog";
+        case CONN_MODE_STREAM: return "stream";
+        default: return "idle";
+    }
+}
+
+void BLECommsManager::manageConnParams(uint32_t now) {
+    ConnDemand demand;
+    demand.sample_interval_ms = sample_interval_ms;
+    demand.batch_capacity = ReadingBatcher::capacityFor(link.notifyPayload() - FRAME_HEADER_SIZE);
+    demand.batch_latency_ms = batcher.latency();
+    demand.reading_size = codec.size(ADC_ALL_CHANNELS);
+    demand.backlog = log_syncing || txQueue.backpressure();
+    demand.bulk = bulk.active();
+    
+    ConnParams params;
+    if (conn_policy.update(&demand, &link, now, &params)) {
+        link.requestConnParams(params.interval_min, params.interval_max, params.latency, params.timeout);
+        Serial.print("Conn params: ");
+        Serial.print(connModeName(params.mode));
+        Serial.print(" | interval ");
+        Serial.print(params.interval_min * CONN_UNIT_US / 1000.0f, 2);
+        Serial.print("-");
+        Serial.print(params.interval_max * CONN_UNIT_US / 1000.0f, 2);
+        Serial.print(" ms latency ");
+        Serial.print(params.latency);
+        Serial.print(" timeout ");
+        Serial.print(params.timeout * CONN_TIMEOUT_UNIT_MS);
+        Serial.print(" ms | est. radio duty ");
+        Serial.print(params.duty_x100 / 100.0f, 2);
+        Serial.println("%");
+    }
+    
+    // What the central actually granted
+    if (link.connInterval() != applied_interval || link.connLatency() != applied_latency) {
+        applied_interval = link.connInterval();
+        applied_latency = link.connLatency();
+        Serial.print("Conn params applied: interval ");
+        Serial.print(applied_interval * CONN_UNIT_US / 1000.0f, 2);
+        Serial.print(" ms latency ");
+        Serial.print(applied_latency);
+        Serial.print(" | ");
+        Serial.print(link.connParamRejects());
+        Serial.println(" requests rejected");
+    }
+}
+
+bool BLECommsManager::txBackpressure() {
+    return txQueue.backpressure();
+}
+
+void BLECommsManager::setTxDropPolicy(TxDropPolicy policy) {
+    txQueue.setDropPolicy(policy);
+}
+
+const TxQueueStats* BLECommsManager::txStats() {
+    return txQueue.stats();
+}
+
+const RetransmitStats* BLECommsManager::retransmitStats() {
+    return retransmit.stats();
 }
 
 void BLECommsManager::processControlCommands() {
     BLE.poll();
+    link.update();
+    if (ble_connected != connected) {
+        if (ble_connected) {
+            onConnect();
+        } else {
+            onDisconnect();
+        }
+    }
     
-    if (controlChar.written()) {
-        uint8_t cmd_buffer[20];
-        int len = controlChar.valueLength();
-
-        if (len > 0 && len <= 20) {
-            memcpy(cmd_buffer, controlChar.value(), len);
-            
-            uint8_t command = cmd_buffer[0];
-            
-            // Declare external command handlers from main.cpp
-            extern void onStartSampling();
-            extern void onStopSampling();
-            extern void onCalibrate();
-            extern void onSelfTest();
-            extern void onSetInterval(uint16_t);
-            extern void onProvisionKey(const uint8_t*, uint8_t);
-
-            switch (command) {
-                case CMD_START_SAMPLING:
-                    Serial.println("CMD: Start sampling");
-                    onStartSampling();
-                    break;
-                    
-                case CMD_STOP_SAMPLING:
-                    Serial.println("CMD: Stop sampling");
-                    onStopSampling();
-                    break;
-                    
-                case CMD_CALIBRATE:
-                    Serial.println("CMD: Calibrate");
-                    onCalibrate();
-                    break;
-                    
-                case CMD_SELF_TEST:
-                    Serial.println("CMD: Self test");
-                    onSelfTest();
-                    break;
-                    
-                case CMD_SET_INTERVAL:
-                    if (len >= 3) {
-                        uint16_t interval_ms = (cmd_buffer[1] << 8) | cmd_buffer[2];
-                        Serial.print("CMD: Set interval to ");
-                        Serial.print(interval_ms);
-                        Serial.println(" ms");
-                        onSetInterval(interval_ms);
-                    }
-                    break;
-                    
-                case CMD_SET_KEY:
-                    if (len >= 17) { // 1 byte cmd + 16 bytes key
-                        Serial.println("CMD: Provision encryption key");
-                        onProvisionKey(cmd_buffer + 1, len - 1);
-                    } else {
-                        Serial.println("CMD: Key provisioning failed - invalid key data");
-                    }
-                    break;
-
-                case CMD_REQUEST_STATUS:
-                    Serial.println("CMD: Status request");
-                    // Send device status
-                    break;
-                    
-                default:
-                    Serial.print("CMD: Unknown command 0x");
-                    Serial.println(command, HEX);
-                    break;
-            }
+    // A partial batch goes at its deadline, later while the queue is
+    // backed up; a full one never waits
+    uint32_t now = millis();
+    if (!ble_connected) {
+        batcher.clear();
+        log_syncing = false;
+        bulk.stop(now);
+    } else if (batcher.expired(now) && !txQueue.backpressure()) {
+        flushBatch(now);
+    }
+    updateStreams(now);
+    if (!ble_connected && broadcast_interval_ms && broadcast_fresh &&
+        now - last_broadcast_ms >= broadcast_interval_ms) {
+        advertiseSnapshot(now);
+    }
+    if ((streams & STREAM_BIT(STREAM_SUMMARY)) && summary.due(now)) {
+        uint8_t packet[STREAM_SUMMARY_MAX_SIZE];
+        uint8_t length = summary.take(now, packet);
+        sendStream(STREAM_SUMMARY, packet, length, 0);
+    }
+    if (ble_connected) {
+        pumpRetransmit();
+    }
+    pumpTx();
+    pumpLogSync();
+    pumpBulk(now);
+    if (ble_connected) {
+        manageConnParams(now);
+    }
+    
+    dispatchCommands();
+}
+
+bool BLECommsManager::registerCommand(uint8_t command, uint8_t min_args, CommandHandler handler,
+                                      void* context) {
+    return commands.add(command, min_args, handler, context);
+}
+
+void BLECommsManager::dispatchCommands() {
+    const Command* command;
+    for (uint8_t n = 0; n < CMD_DISPATCH_PER_PASS && (command = commandQueue.peek()) != 0; n++) {
+        uint8_t status = commands.dispatch(command);
+        
+        // Time waiting in the queue plus the handler itself
+        uint32_t latency = micros() - command->received_us;
+        uint8_t ack[RESP_ACK_SIZE];
+        commandEncodeAck(command->data[0], status, response_seq++, latency, ack);
+        if (ble_connected) {
+            responseChar.writeValue(ack, sizeof(ack));
+        }
+        
+        command_stats.dispatched++;
+        if (status != CMD_STATUS_OK) {
+            command_stats.failed++;
         }
+        command_stats.latency_total_us += latency;
+        if (latency > command_stats.latency_max_us) {
+            command_stats.latency_max_us = latency;
+        }
+        
+        Serial.print("CMD 0x");
+        Serial.print(command->data[0], HEX);
+        Serial.print(" -> ");
+        Serial.print(status);
+        Serial.print(" in ");
+        Serial.print(latency);
+        Serial.println(" us");
+        commandQueue.pop();
     }
 }
 
+void BLECommsManager::transmitStatus(const DeviceStatus* status) {
+    if (!ble_connected) return;
+    
+    uint8_t packet[RESP_STATUS_SIZE];
+    commandEncodeStatus(status, packet);
+    responseChar.writeValue(packet, sizeof(packet));
+}
+
+const CommandStats* BLECommsManager::commandStats() {
+    command_stats.received = commandQueue.received() - received_base;
+    command_stats.dropped = commandQueue.dropped() - dropped_base;
+    return &command_stats;
+}
+
+void BLECommsManager::resetCommandStats() {
+    memset(&command_stats, 0, sizeof(command_stats));
+    received_base = commandQueue.received();
+    dropped_base = commandQueue.dropped();
+}
+
+// Commands the comms layer serves itself
+uint8_t BLECommsManager::onLogSync(const uint8_t* args, uint8_t length, void* context) {
+    BLECommsManager* self = (BLECommsManager*)context;
+    if (!self->sample_log) return CMD_STATUS_REJECTED;
+    
+    uint32_t from = self->sample_log->acknowledged();
+    if (length >= 4) {
+        from = ((uint32_t)args[0] << 24) | ((uint32_t)args[1] << 16) | ((uint32_t)args[2] << 8) | args[3];
+    }
+    Serial.print("Log sync from ");
+    Serial.println(from);
+    self->startLogSync(from);
+    return CMD_STATUS_OK;
+}
+
+uint8_t BLECommsManager::onBulkStart(const uint8_t* args, uint8_t length, void* context) {
+    BLECommsManager* self = (BLECommsManager*)context;
+    if (!self->sample_log) return CMD_STATUS_REJECTED;
+    
+    uint16_t credits = (args[0] << 8) | args[1];
+    uint32_t from = self->sample_log->acknowledged();
+    if (length >= 6) {
+        from = ((uint32_t)args[2] << 24) | ((uint32_t)args[3] << 16) | ((uint32_t)args[4] << 8) | args[5];
+    }
+    Serial.print("Bulk transfer from ");
+    Serial.println(from);
+    self->startBulkTransfer(from, credits);
+    return CMD_STATUS_OK;
+}
+
+uint8_t BLECommsManager::onBulkCredit(const uint8_t* args, uint8_t length, void* context) {
+    (void)length;
+    BLECommsManager* self = (BLECommsManager*)context;
+    if (!self->bulk.active()) return CMD_STATUS_REJECTED;
+    
+    self->grantBulkCredits((args[0] << 8) | args[1]);
+    return CMD_STATUS_OK;
+}
+
+uint8_t BLECommsManager::onSetSummaryPeriod(const uint8_t* args, uint8_t length, void* context) {
+    (void)length;
+    uint16_t seconds = (args[0] << 8) | args[1];
+    if (seconds == 0) return CMD_STATUS_REJECTED;
+    
+    ((BLECommsManager*)context)->setSummaryPeriod(seconds * 1000UL);
+    return CMD_STATUS_OK;
+}
+
+uint8_t BLECommsManager::onAckTelemetry(const uint8_t* args, uint8_t length, void* context) {
+    (void)length;
+    (void)context;
+    uint16_t base;
+    uint32_t bitmap;
+    retransmitDecodeAck(args, &base, &bitmap);
+    retransmit.acknowledge(base, bitmap);
+    return CMD_STATUS_OK;
+}
+
 void BLECommsManager::onConnect() {
     connected = true;
+    conn_policy.reset(millis());
+    applied_interval = 0;
+    applied_latency = 0;
 }
 
 void BLECommsManager::onDisconnect() {
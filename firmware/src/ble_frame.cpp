@@ -0,0 +1,139 @@
+// firmware/src/ble_frame.cpp
+
+#include "ble_frame.h"
+#include <string.h>
+
+void frameEncodeHeader(const FrameHeader* header, uint8_t* out) {
+    out[0] = (uint8_t)header->seq;
+    out[1] = (uint8_t)(header->seq >> 8);
+    out[2] = (uint8_t)((header->index << 4) | ((header->count - 1) & 0x0F));
+    out[3] = header->length;
+}
+
+bool frameDecodeHeader(const uint8_t* in, uint16_t length, FrameHeader* header) {
+    if (length <= FRAME_HEADER_SIZE) {
+        return false;
+    }
+    header->seq = (uint16_t)(in[0] | (in[1] << 8));
+    header->index = in[2] >> 4;
+    header->count = (in[2] & 0x0F) + 1;
+    header->length = in[3];
+    return header->index < header->count && header->length > 0;
+}
+
+uint8_t frameFragmentsFor(uint16_t length, uint16_t notify_payload) {
+    if (notify_payload <= FRAME_HEADER_SIZE || length == 0 || length > FRAME_MAX_PACKET) {
+        return 0;
+    }
+    uint16_t share = notify_payload - FRAME_HEADER_SIZE;
+    uint16_t fragments = (length + share - 1) / share;
+    return (fragments <= FRAME_MAX_FRAGMENTS) ? (uint8_t)fragments : 0;
+}
+
+void FrameReassembler::init() {
+    received = 0;
+    seq = 0;
+    next_index = 0;
+    count = 0;
+    length = 0;
+    assembling = false;
+    have_seq = false;
+    last_seq = 0;
+    done_length = 0;
+    memset(&counters, 0, sizeof(counters));
+}
+
+void FrameReassembler::abandon() {
+    if (assembling) {
+        counters.incomplete++;
+        assembling = false;
+    }
+}
+
+bool FrameReassembler::feed(const uint8_t* notification, uint16_t size) {
+    FrameHeader header;
+    if (!frameDecodeHeader(notification, size, &header)) {
+        counters.malformed++;
+        return false;
+    }
+    const uint8_t* data = notification + FRAME_HEADER_SIZE;
+    uint16_t data_length = size - FRAME_HEADER_SIZE;
+
+    // A new packet: whatever was in progress is lost, and any numbers
+    // skipped since the newest one never arrived at all
+    if (!assembling || header.seq != seq) {
+        abandon();
+        int16_t ahead = have_seq ? (int16_t)(header.seq - last_seq) : 1;
+        if (ahead > 0) {
+            if (have_seq && ahead > 1) {
+                counters.gaps++;
+                counters.lost += ahead - 1;
+            }
+            have_seq = true;
+            last_seq = header.seq;
+        } else if (ahead < 0 && header.index == 0) {
+            counters.late++;
+        }
+
+        // Joined mid-packet: wait for the next fragment 0
+        if (header.index != 0) {
+            if (ahead != 0) {
+                counters.incomplete++;
+            }
+            return false;
+        }
+        assembling = true;
+        seq = header.seq;
+        count = header.count;
+        length = header.length;
+        next_index = 0;
+        received = 0;
+    }
+
+    if (!assembling) {
+        return false;
+    }
+    if (header.count != count || header.length != length || received + data_length > length) {
+        abandon();
+        counters.malformed++;
+        return false;
+    }
+    if (header.index != next_index) {
+        // A fragment went missing: drop the packet, resync on the next
+        abandon();
+        return false;
+    }
+
+    memcpy(buffer + received, data, data_length);
+    received += data_length;
+    next_index++;
+    counters.fragments++;
+
+    if (next_index < count) {
+        return false;
+    }
+    assembling = false;
+    if (received != length) {
+        counters.incomplete++;
+        return false;
+    }
+    done_length = length;
+    counters.packets++;
+    return true;
+}
+
+const uint8_t* FrameReassembler::packet() const {
+    return buffer;
+}
+
+uint8_t FrameReassembler::packetLength() const {
+    return done_length;
+}
+
+uint16_t FrameReassembler::packetSeq() const {
+    return seq;
+}
+
+const FrameStats* FrameReassembler::stats() const {
+    return &counters;
+}
@@ -0,0 +1,506 @@
+// firmware/src/ble_link.cpp
+
+#include "ble_link.h"
+#include "sys_time.h"
+#include <stdlib.h>
+
+#ifdef NRF52
+#include <ArduinoBLE.h>
+#include <utility/ATT.h>
+#include <utility/HCI.h>
+#include <utility/HCITransport.h>
+
+#define HCI_LE_SET_EVENT_MASK           0x2001
+#define HCI_LE_READ_BUFFER_SIZE         0x2002
+#define HCI_LE_SET_DATA_LENGTH          0x2022
+#define HCI_LE_WRITE_DEFAULT_DATA_LENGTH 0x2024
+#define HCI_LE_SET_PHY                  0x2032
+#define CONN_HANDLE_NONE                0xFFFF
+
+#define H4_ACL                          0x02
+#define H4_EVENT                        0x04
+#define HCI_EVT_DISCONNECT_COMPLETE     0x05
+#define HCI_EVT_COMMAND_COMPLETE        0x0E
+#define HCI_EVT_NUM_COMPLETED_PACKETS   0x13
+#define HCI_EVT_LE_META                 0x3E
+#define HCI_LE_CONN_COMPLETE            0x01
+#define HCI_LE_CONN_UPDATE_COMPLETE     0x03
+#define HCI_LE_ENHANCED_CONN_COMPLETE   0x0A
+#define HCI_LE_PHY_UPDATE_COMPLETE      0x0C
+
+#define L2CAP_CID_SIGNALING             0x0005
+#define L2CAP_CONN_PARAM_UPDATE_REQ     0x12
+#define L2CAP_CONN_PARAM_UPDATE_RSP     0x13
+
+// Passes the H4 stream through to ArduinoBLE's transport, counting ACL
+// packets out and the completions coming back. Only the first bytes of
+// each event or incoming ACL packet are kept; the rest are skipped by
+// length.
+class HciTap : public HCITransportInterface {
+public:
+    HCITransportInterface* inner;
+    volatile uint8_t total;
+    volatile uint8_t outstanding;
+    volatile uint8_t phy;
+    volatile uint16_t interval;
+    volatile uint16_t latency;
+    volatile uint16_t timeout;
+    volatile uint8_t rejects;
+
+    int begin() { return inner->begin(); }
+    void end() { inner->end(); }
+    void wait(unsigned long timeout) { inner->wait(timeout); }
+    int available() { return inner->available(); }
+    int peek() { return inner->peek(); }
+
+    int read() {
+        int b = inner->read();
+        if (b >= 0) {
+            feed((uint8_t)b);
+        }
+        return b;
+    }
+
+    size_t write(const uint8_t* data, size_t length) {
+        if (length > 0 && data[0] == H4_ACL && outstanding < total) {
+            outstanding++;
+        }
+        return inner->write(data, length);
+    }
+
+private:
+    uint8_t header[5];
+    uint8_t params[32];
+    uint16_t at;
+    uint16_t length;
+
+    void feed(uint8_t b) {
+        if (at == 0) {
+            header[at++] = b;
+            length = 0;
+            return;
+        }
+
+        // Type, then event code + length or handle + length
+        uint8_t header_size = (header[0] == H4_EVENT) ? 3 : 5;
+        if (at < header_size) {
+            header[at++] = b;
+            if (at == header_size) {
+                length = (header[0] == H4_EVENT) ? header[2] : (header[3] | (header[4] << 8));
+                if (length == 0) {
+                    done();
+                }
+            }
+            return;
+        }
+
+        uint16_t offset = at - header_size;
+        if (offset < sizeof(params)) {
+            params[offset] = b;
+        }
+        at++;
+        if (offset + 1 == length) {
+            done();
+        }
+    }
+
+    void connParams(uint8_t offset) {
+        interval = params[offset] | (params[offset + 1] << 8);
+        latency = params[offset + 2] | (params[offset + 3] << 8);
+        timeout = params[offset + 4] | (params[offset + 5] << 8);
+    }
+
+    void done() {
+        at = 0;
+        if (header[0] == H4_ACL) {
+            // The central's answer to a parameter request: L2CAP length and
+            // CID, then code, identifier, length and result
+            if (length >= 10 && (params[2] | (params[3] << 8)) == L2CAP_CID_SIGNALING &&
+                params[4] == L2CAP_CONN_PARAM_UPDATE_RSP && (params[8] | (params[9] << 8)) != 0) {
+                rejects++;
+            }
+            return;
+        }
+        if (header[0] != H4_EVENT) {
+            return;
+        }
+
+        if (header[1] == HCI_EVT_NUM_COMPLETED_PACKETS) {
+            // Handle/count pairs; a single central fits in the kept bytes
+            uint8_t handles = params[0];
+            uint16_t completed = 0;
+            for (uint8_t i = 0; i < handles && 4U * i + 4 < sizeof(params); i++) {
+                completed += params[1 + 4 * i + 2] | (params[1 + 4 * i + 3] << 8);
+            }
+            outstanding = (completed < outstanding) ? outstanding - completed : 0;
+        } else if (header[1] == HCI_EVT_COMMAND_COMPLETE && length >= 7 &&
+                   (params[1] | (params[2] << 8)) == HCI_LE_READ_BUFFER_SIZE && params[3] == 0) {
+            if (params[6]) {
+                total = params[6];
+            }
+        } else if (header[1] == HCI_EVT_LE_META && length >= 6 &&
+                   params[0] == HCI_LE_PHY_UPDATE_COMPLETE && params[1] == 0) {
+            phy = params[4];
+        } else if (header[1] == HCI_EVT_LE_META && length >= 18 &&
+                   params[0] == HCI_LE_CONN_COMPLETE && params[1] == 0) {
+            connParams(12);
+        } else if (header[1] == HCI_EVT_LE_META && length >= 30 &&
+                   params[0] == HCI_LE_ENHANCED_CONN_COMPLETE && params[1] == 0) {
+            connParams(24);
+        } else if (header[1] == HCI_EVT_LE_META && length >= 10 &&
+                   params[0] == HCI_LE_CONN_UPDATE_COMPLETE && params[1] == 0) {
+            connParams(4);
+        } else if (header[1] == HCI_EVT_DISCONNECT_COMPLETE) {
+            // The controller flushes what the link still held
+            outstanding = 0;
+            phy = BLE_PHY_1M;
+        }
+    }
+};
+
+static HciTap tap;
+
+// "aa:bb:cc:dd:ee:ff" to the little-endian bytes ATT keys peers by
+static bool parseAddress(const char* text, uint8_t address[6]) {
+    for (int8_t i = 5; i >= 0; i--) {
+        char* end;
+        address[i] = (uint8_t)strtoul(text, &end, 16);
+        if (end != text + 2 || (i > 0 && *end != ':')) {
+            return false;
+        }
+        text = end + 1;
+    }
+    return true;
+}
+
+static uint16_t findHandle(const char* text) {
+    uint8_t address[6];
+    if (!parseAddress(text, address)) {
+        return CONN_HANDLE_NONE;
+    }
+
+    // Public or random address
+    for (uint8_t type = 0; type < 2; type++) {
+        uint16_t handle = ATT.connectionHandle(type, address);
+        if (handle != CONN_HANDLE_NONE) {
+            return handle;
+        }
+    }
+    return CONN_HANDLE_NONE;
+}
+#endif
+
+void BleLink::init() {
+    att_mtu = BLE_ATT_MTU_DEFAULT;
+    data_length = BLE_DATA_LENGTH_DEFAULT;
+#ifdef NRF52
+    conn_handle = CONN_HANDLE_NONE;
+
+    // Answer MTU requests with the largest MTU, and have the controller
+    // start the data length procedure on every new connection
+    ATT.setMaxMtu(BLE_ATT_MTU_MAX);
+    uint16_t params[2] = {BLE_DATA_LENGTH_MAX, BLE_DATA_TIME_MAX_US};
+    HCI.sendCommand(HCI_LE_WRITE_DEFAULT_DATA_LENGTH, sizeof(params), params);
+
+    // ArduinoBLE enables LE events 0-9; PHY Update Complete is event 11
+    uint8_t mask[8] = {0xFF, 0x0B, 0, 0, 0, 0, 0, 0};
+    HCI.sendCommand(HCI_LE_SET_EVENT_MASK, sizeof(mask), mask);
+
+    // Watch buffer use from here on; the controller's buffer count comes
+    // back through the tap
+    tap.inner = &HCITransport;
+    tap.total = BLE_TX_BUFFERS_DEFAULT;
+    tap.outstanding = 0;
+    tap.phy = BLE_PHY_1M;
+    tap.interval = BLE_CONN_INTERVAL_DEFAULT;
+    tap.latency = 0;
+    tap.timeout = 0;
+    tap.rejects = 0;
+    HCI.setTransport(&tap);
+    HCI.sendCommand(HCI_LE_READ_BUFFER_SIZE);
+#else
+    conn_handle = 0;
+    peer_mtu = BLE_ATT_MTU_DEFAULT;
+    peer_data_length = BLE_DATA_LENGTH_DEFAULT;
+    peer_phy = BLE_PHY_2M;
+    current_phy = BLE_PHY_1M;
+    peer_accepts_params = true;
+    current_interval = BLE_CONN_INTERVAL_DEFAULT;
+    current_latency = 0;
+    current_timeout = 0;
+    rejects = 0;
+    tx_buffers = BLE_TX_BUFFERS_DEFAULT;
+    tx_outstanding = 0;
+#endif
+    resetStats();
+}
+
+void BleLink::onConnect(const char* address) {
+    att_mtu = BLE_ATT_MTU_DEFAULT;
+    data_length = BLE_DATA_LENGTH_DEFAULT;
+
+#ifdef NRF52
+    tap.phy = BLE_PHY_1M;
+    conn_handle = findHandle(address);
+    if (conn_handle != CONN_HANDLE_NONE) {
+        // Centrals that never ask keep the 23-byte MTU unless we do
+        ATT.exchangeMtu(conn_handle);
+
+        // The controller would fall back to 27 octets with an older
+        // central. ArduinoBLE drops the Data Length Change event, so
+        // assume the request stands once the controller accepts it.
+        uint16_t params[3] = {conn_handle, BLE_DATA_LENGTH_MAX, BLE_DATA_TIME_MAX_US};
+        if (HCI.sendCommand(HCI_LE_SET_DATA_LENGTH, sizeof(params), params) == 0) {
+            data_length = BLE_DATA_LENGTH_MAX;
+        }
+    }
+#else
+    (void)address;
+    current_phy = BLE_PHY_1M;
+    current_interval = BLE_CONN_INTERVAL_DEFAULT;
+    current_latency = 0;
+    att_mtu = (peer_mtu < BLE_ATT_MTU_MAX) ? peer_mtu : BLE_ATT_MTU_MAX;
+    data_length = (peer_data_length < BLE_DATA_LENGTH_MAX) ? peer_data_length : BLE_DATA_LENGTH_MAX;
+#endif
+    update();
+    resetStats();
+}
+
+void BleLink::onDisconnect() {
+#ifdef NRF52
+    conn_handle = CONN_HANDLE_NONE;
+#else
+    tx_outstanding = 0;
+#endif
+    att_mtu = BLE_ATT_MTU_DEFAULT;
+    data_length = BLE_DATA_LENGTH_DEFAULT;
+}
+
+void BleLink::update() {
+#ifdef NRF52
+    if (conn_handle != CONN_HANDLE_NONE) {
+        uint16_t mtu = ATT.mtu(conn_handle);
+        if (mtu >= BLE_ATT_MTU_DEFAULT) {
+            att_mtu = (mtu < BLE_ATT_MTU_MAX) ? mtu : BLE_ATT_MTU_MAX;
+        }
+    }
+#endif
+}
+
+uint16_t BleLink::attMtu() const {
+    return att_mtu;
+}
+
+uint16_t BleLink::dataLength() const {
+    return data_length;
+}
+
+uint16_t BleLink::notifyPayload() const {
+    return att_mtu - BLE_ATT_NOTIFY_OVERHEAD;
+}
+
+uint16_t BleLink::notificationsFor(uint16_t length) const {
+    uint16_t payload = notifyPayload();
+    return (length + payload - 1) / payload;
+}
+
+uint16_t BleLink::linkPacketsFor(uint16_t length) const {
+    uint16_t payload = notifyPayload();
+    uint16_t packets = 0;
+
+    // Each notification is its own L2CAP PDU, fragmented by data length
+    while (length > 0) {
+        uint16_t value = (length < payload) ? length : payload;
+        uint16_t pdu = BLE_L2CAP_HEADER + BLE_ATT_NOTIFY_OVERHEAD + value;
+        packets += (pdu + data_length - 1) / data_length;
+        length -= value;
+    }
+    return packets;
+}
+
+uint32_t BleLink::airBytesFor(uint16_t length) const {
+    uint16_t notifications = notificationsFor(length);
+    uint32_t pdu = (uint32_t)notifications * (BLE_L2CAP_HEADER + BLE_ATT_NOTIFY_OVERHEAD) + length;
+    return pdu + (uint32_t)linkPacketsFor(length) * BLE_LL_PACKET_OVERHEAD;
+}
+
+void BleLink::setPhy(uint8_t wanted) {
+#ifdef NRF52
+    if (conn_handle == CONN_HANDLE_NONE) return;
+    
+    // Same preference both ways; the controller negotiates it with the central
+    uint8_t mask = (wanted == BLE_PHY_2M) ? 0x02 : 0x01;
+    uint8_t params[7] = {(uint8_t)conn_handle, (uint8_t)(conn_handle >> 8), 0x00, mask, mask, 0x00, 0x00};
+    HCI.sendCommand(HCI_LE_SET_PHY, sizeof(params), params);
+#else
+    current_phy = (wanted <= peer_phy) ? wanted : peer_phy;
+#endif
+}
+
+uint8_t BleLink::phy() const {
+#ifdef NRF52
+    return tap.phy;
+#else
+    return current_phy;
+#endif
+}
+
+uint32_t BleLink::airTimeUsFor(uint16_t length) const {
+    uint8_t rate = phy();
+    uint16_t overhead = BLE_LL_PACKET_OVERHEAD + (rate == BLE_PHY_2M ? 1 : 0);   // 2-byte preamble
+    uint16_t payload = notifyPayload();
+    uint32_t us = 0;
+
+    while (length > 0) {
+        uint16_t value = (length < payload) ? length : payload;
+        uint16_t pdu = BLE_L2CAP_HEADER + BLE_ATT_NOTIFY_OVERHEAD + value;
+        while (pdu > 0) {
+            uint16_t octets = (pdu < data_length) ? pdu : data_length;
+            us += (uint32_t)(overhead + octets) * 8 / rate + BLE_T_IFS_US;
+            us += (uint32_t)overhead * 8 / rate + BLE_T_IFS_US;
+            pdu -= octets;
+        }
+        length -= value;
+    }
+    return us;
+}
+
+void BleLink::requestConnParams(uint16_t interval_min, uint16_t interval_max, uint16_t latency,
+                                uint16_t timeout) {
+#ifdef NRF52
+    if (conn_handle == CONN_HANDLE_NONE) return;
+    
+    // Signalling identifiers are never 0
+    static uint8_t identifier = 0;
+    if (++identifier == 0) {
+        identifier = 1;
+    }
+    uint8_t request[12] = {
+        L2CAP_CONN_PARAM_UPDATE_REQ, identifier, 8, 0,
+        (uint8_t)interval_min, (uint8_t)(interval_min >> 8),
+        (uint8_t)interval_max, (uint8_t)(interval_max >> 8),
+        (uint8_t)latency, (uint8_t)(latency >> 8),
+        (uint8_t)timeout, (uint8_t)(timeout >> 8),
+    };
+    HCI.sendAclPkt(conn_handle, L2CAP_CID_SIGNALING, sizeof(request), request);
+#else
+    (void)interval_min;
+    if (!peer_accepts_params) {
+        rejects++;
+        return;
+    }
+    current_interval = interval_max;
+    current_latency = latency;
+    current_timeout = timeout;
+#endif
+}
+
+uint16_t BleLink::connInterval() const {
+#ifdef NRF52
+    return tap.interval;
+#else
+    return current_interval;
+#endif
+}
+
+uint16_t BleLink::connLatency() const {
+#ifdef NRF52
+    return tap.latency;
+#else
+    return current_latency;
+#endif
+}
+
+uint16_t BleLink::connTimeout() const {
+#ifdef NRF52
+    return tap.timeout;
+#else
+    return current_timeout;
+#endif
+}
+
+uint8_t BleLink::connParamRejects() const {
+#ifdef NRF52
+    return tap.rejects;
+#else
+    return rejects;
+#endif
+}
+
+uint8_t BleLink::txCredits() const {
+#ifdef NRF52
+    uint8_t total = tap.total;
+    uint8_t outstanding = tap.outstanding;
+#else
+    uint8_t total = tx_buffers;
+    uint8_t outstanding = tx_outstanding;
+#endif
+    return (outstanding < total) ? total - outstanding : 0;
+}
+
+void BleLink::onTxSent() {
+#ifndef NRF52
+    // The tap counts the ACL write on the nRF52
+    if (tx_outstanding < tx_buffers) {
+        tx_outstanding++;
+    }
+#endif
+}
+
+void BleLink::record(uint16_t length, uint16_t sent, uint16_t carried) {
+    payloads++;
+    readings += carried;
+    notifications += sent;
+    link_packets += linkPacketsFor(length);
+    bytes += length;
+    air_bytes += airBytesFor(length);
+}
+
+void BleLink::stats(BleLinkStats* out) const {
+    out->att_mtu = att_mtu;
+    out->data_length = data_length;
+    out->phy = phy();
+    out->conn_interval = connInterval();
+    out->conn_latency = connLatency();
+    out->payloads = payloads;
+    out->readings = readings;
+    out->notifications = notifications;
+    out->link_packets = link_packets;
+    out->bytes = bytes;
+    out->air_bytes = air_bytes;
+    out->window_ms = sysMillis() - window_start;
+    out->bytes_per_sec = out->window_ms ? (uint32_t)((uint64_t)bytes * 1000 / out->window_ms) : 0;
+    out->notifications_per_payload_x100 = payloads ? (uint16_t)(100UL * notifications / payloads) : 0;
+    out->air_bytes_per_reading = readings ? (uint16_t)(air_bytes / readings) : 0;
+}
+
+void BleLink::resetStats() {
+    payloads = 0;
+    readings = 0;
+    notifications = 0;
+    link_packets = 0;
+    bytes = 0;
+    air_bytes = 0;
+    window_start = sysMillis();
+}
+
+#ifndef NRF52
+void BleLink::setPeer(uint16_t mtu, uint16_t length, uint8_t phy) {
+    peer_mtu = (mtu < BLE_ATT_MTU_DEFAULT) ? BLE_ATT_MTU_DEFAULT : mtu;
+    peer_data_length = (length < BLE_DATA_LENGTH_DEFAULT) ? BLE_DATA_LENGTH_DEFAULT : length;
+    peer_phy = (phy == BLE_PHY_2M) ? BLE_PHY_2M : BLE_PHY_1M;
+}
+
+void BleLink::setPeerAcceptsConnParams(bool accept) {
+    peer_accepts_params = accept;
+}
+
+void BleLink::setTxBuffers(uint8_t count) {
+    tx_buffers = count ? count : 1;
+    tx_outstanding = 0;
+}
+
+void BleLink::completeTx(uint8_t count) {
+    tx_outstanding = (count < tx_outstanding) ? tx_outstanding - count : 0;
+}
+#endif
@@ -0,0 +1,131 @@
+// firmware/src/broadcast.cpp
+
+#include "broadcast.h"
+#include <string.h>
+
+// Domain bytes keeping the derived keys apart from the session key's
+// other uses
+#define BROADCAST_DOMAIN_ENC    0xB1
+#define BROADCAST_DOMAIN_MAC    0xB2
+
+void broadcastDeriveKeys(const uint8_t* key, BroadcastKeys* keys) {
+    AESContext master;
+    aes128_init(&master, key);
+
+    uint8_t block[AES_BLOCK_SIZE];
+    uint8_t derived[AES_BLOCK_SIZE];
+    memset(block, 0, sizeof(block));
+    block[0] = BROADCAST_DOMAIN_ENC;
+    aes128_encrypt_block(&master, block, derived);
+    aes128_init(&keys->enc, derived);
+
+    block[0] = BROADCAST_DOMAIN_MAC;
+    aes128_encrypt_block(&master, block, derived);
+    aes128_init(&keys->mac, derived);
+}
+
+// Counter mode over at most one block: the plaintext fits in a single
+// keystream block
+static void applyKeystream(const BroadcastKeys* keys, const uint8_t* header, const uint8_t* in,
+                           uint8_t length, uint8_t* out) {
+    uint8_t block[AES_BLOCK_SIZE];
+    uint8_t stream[AES_BLOCK_SIZE];
+    memset(block, 0, sizeof(block));
+    memcpy(block, header, BROADCAST_HEADER_SIZE);
+    aes128_encrypt_block(&keys->enc, block, stream);
+    for (uint8_t i = 0; i < length; i++) {
+        out[i] = in[i] ^ stream[i];
+    }
+}
+
+// CBC-MAC over length, header and ciphertext, zero padded; the length
+// block first keeps messages of different sizes apart
+static void computeTag(const BroadcastKeys* keys, const uint8_t* message, uint8_t length, uint8_t* tag) {
+    uint8_t state[AES_BLOCK_SIZE];
+    memset(state, 0, sizeof(state));
+    state[0] = length;
+    aes128_encrypt_block(&keys->mac, state, state);
+
+    for (uint8_t at = 0; at < length; at += AES_BLOCK_SIZE) {
+        for (uint8_t i = 0; i < AES_BLOCK_SIZE && at + i < length; i++) {
+            state[i] ^= message[at + i];
+        }
+        aes128_encrypt_block(&keys->mac, state, state);
+    }
+    memcpy(tag, state, BROADCAST_TAG_SIZE);
+}
+
+uint8_t broadcastSeal(const BroadcastKeys* keys, uint32_t counter, const uint8_t* plain, uint8_t length,
+                      uint8_t* out) {
+    if (length > BROADCAST_MAX_PLAIN) {
+        length = BROADCAST_MAX_PLAIN;
+    }
+
+    out[0] = BROADCAST_VERSION;
+    out[1] = (uint8_t)counter;
+    out[2] = (uint8_t)(counter >> 8);
+    out[3] = (uint8_t)(counter >> 16);
+    out[4] = (uint8_t)(counter >> 24);
+    applyKeystream(keys, out, plain, length, out + BROADCAST_HEADER_SIZE);
+
+    uint8_t sealed = BROADCAST_HEADER_SIZE + length;
+    computeTag(keys, out, sealed, out + sealed);
+    return sealed + BROADCAST_TAG_SIZE;
+}
+
+uint8_t broadcastOpen(const BroadcastKeys* keys, const uint8_t* in, uint8_t length, uint32_t* counter,
+                      uint8_t* plain) {
+    if (length <= BROADCAST_HEADER_SIZE + BROADCAST_TAG_SIZE || length > BROADCAST_MAX_SIZE ||
+        in[0] != BROADCAST_VERSION) {
+        return 0;
+    }
+
+    uint8_t sealed = length - BROADCAST_TAG_SIZE;
+    uint8_t tag[BROADCAST_TAG_SIZE];
+    computeTag(keys, in, sealed, tag);
+
+    // Every byte compared, whatever the first mismatch
+    uint8_t diff = 0;
+    for (uint8_t i = 0; i < BROADCAST_TAG_SIZE; i++) {
+        diff |= tag[i] ^ in[sealed + i];
+    }
+    if (diff) {
+        return 0;
+    }
+
+    *counter = in[1] | (in[2] << 8) | ((uint32_t)in[3] << 16) | ((uint32_t)in[4] << 24);
+    uint8_t plain_length = sealed - BROADCAST_HEADER_SIZE;
+    applyKeystream(keys, in, in + BROADCAST_HEADER_SIZE, plain_length, plain);
+    return plain_length;
+}
+
+void BroadcastReceiver::init(const uint8_t* key) {
+    broadcastDeriveKeys(key, &keys);
+    last_counter = 0;
+    have_last = false;
+    memset(&counts, 0, sizeof(counts));
+}
+
+uint8_t BroadcastReceiver::receive(const uint8_t* in, uint8_t length, uint32_t* counter, uint8_t* plain) {
+    uint32_t seen;
+    uint8_t plain_length = broadcastOpen(&keys, in, length, &seen, plain);
+    if (plain_length == 0) {
+        counts.forged++;
+        return 0;
+    }
+
+    // Scanners report the same advertisement many times over
+    if (have_last && seen <= last_counter) {
+        counts.replayed++;
+        return 0;
+    }
+    last_counter = seen;
+    have_last = true;
+    counts.accepted++;
+    *counter = seen;
+    return plain_length;
+}
+
+const BroadcastStats* BroadcastReceiver::stats() const {
+    return &counts;
+}
@@ -0,0 +1,99 @@
+// firmware/src/bulk_transfer.cpp
+
+#include "bulk_transfer.h"
+#include "ble_frame.h"
+#include "aes.h"
+#include <string.h>
+
+#define BULK_ENCRYPTED_MAX  (LOG_PACKET_MAX + 2 * AES_BLOCK_SIZE)
+
+void BulkTransfer::init() {
+    running = false;
+    credits = 0;
+    started = 0;
+    memset(&counters, 0, sizeof(counters));
+}
+
+void BulkTransfer::start(uint16_t granted, uint32_t now) {
+    running = true;
+    credits = (granted < BULK_MAX_CREDITS) ? granted : BULK_MAX_CREDITS;
+    started = now;
+    memset(&counters, 0, sizeof(counters));
+}
+
+void BulkTransfer::grant(uint16_t granted) {
+    uint32_t total = (uint32_t)credits + granted;
+    credits = (total < BULK_MAX_CREDITS) ? total : BULK_MAX_CREDITS;
+}
+
+void BulkTransfer::stop(uint32_t now) {
+    if (running) {
+        finish(now);
+    }
+}
+
+bool BulkTransfer::active() const {
+    return running;
+}
+
+void BulkTransfer::finish(uint32_t now) {
+    running = false;
+    counters.elapsed_ms = now - started;
+    counters.bytes_per_sec = counters.elapsed_ms ?
+        (uint32_t)((uint64_t)counters.bytes * 1000 / counters.elapsed_ms) : 0;
+}
+
+uint16_t BulkTransfer::service(SampleLog* log, TxQueue* queue, BleLink* link, uint8_t target,
+                               const uint8_t* key, uint32_t now) {
+    uint16_t queued = 0;
+    uint16_t payload = link->notifyPayload();
+    uint8_t worst = frameFragmentsFor(AES_BLOCK_SIZE + aes_padded_length(LOG_PACKET_MAX), payload);
+
+    // Room for the largest packet is checked before it leaves the log, so
+    // a push never fails and nothing read is lost
+    while (running && queue->count() < BULK_QUEUE_AHEAD && queue->space() >= worst) {
+        if (credits == 0) {
+            counters.credit_stalls++;
+            break;
+        }
+
+        uint8_t packet[LOG_PACKET_MAX];
+        uint16_t readings;
+        uint16_t length = log->readPacket(packet, &readings);
+        if (length == 0) {
+            finish(now);
+            break;
+        }
+
+        uint8_t encrypted[BULK_ENCRYPTED_MAX];
+        uint16_t encrypted_len = aes128_encrypt(packet, encrypted, key, length);
+        if (!queue->push(target, encrypted, encrypted_len, payload)) {
+            finish(now);
+            break;
+        }
+        uint8_t fragments = frameFragmentsFor(encrypted_len, payload);
+        uint16_t framed = encrypted_len + fragments * FRAME_HEADER_SIZE;
+        link->record(framed, fragments, readings);
+
+        credits--;
+        queued++;
+        counters.packets++;
+        counters.readings += readings;
+        counters.bytes += framed;
+        counters.phy = link->phy();
+
+        // The end marker closes the transfer
+        if (readings == 0) {
+            finish(now);
+        }
+    }
+
+    if (running) {
+        counters.elapsed_ms = now - started;
+    }
+    return queued;
+}
+
+const BulkStats* BulkTransfer::stats() const {
+    return &counters;
+}
@@ -0,0 +1,92 @@
+// firmware/src/calibration_lut.cpp
+
+#include "calibration_lut.h"
+#include <math.h>
+
+// Points closer than this are the same standard measured twice
+#define CAL_POINT_MERGE_MV  0.5f
+
+// Units on the piecewise-linear curve, extrapolating the end segments
+static float curveAt(const CalPoint* sorted, uint8_t count, float mv) {
+    uint8_t seg = 0;
+    while (seg < count - 2 && mv > sorted[seg + 1].mv) {
+        seg++;
+    }
+    const CalPoint* a = &sorted[seg];
+    const CalPoint* b = &sorted[seg + 1];
+    return a->units + (mv - a->mv) * (b->units - a->units) / (b->mv - a->mv);
+}
+
+bool buildChannelLut(ChannelLut* lut, const CalPoint* points, uint8_t count,
+                     float mv_per_count, float baseline_mv, float units_at_zero,
+                     float temp_coeff, float min_value, float max_value) {
+    CalPoint sorted[CAL_LUT_MAX_POINTS];
+    uint8_t n = 0;
+    float temp_sum = 0.0f;
+
+    if (count > CAL_LUT_MAX_POINTS) {
+        count = CAL_LUT_MAX_POINTS;
+    }
+
+    // Insertion sort by mV, averaging repeats of the same standard
+    for (uint8_t i = 0; i < count; i++) {
+        const CalPoint* p = &points[i];
+        temp_sum += p->temp_c;
+
+        uint8_t j = 0;
+        while (j < n && sorted[j].mv < p->mv - CAL_POINT_MERGE_MV) {
+            j++;
+        }
+        if (j < n && fabsf(sorted[j].mv - p->mv) <= CAL_POINT_MERGE_MV) {
+            sorted[j].mv = 0.5f * (sorted[j].mv + p->mv);
+            sorted[j].units = 0.5f * (sorted[j].units + p->units);
+            continue;
+        }
+        for (uint8_t k = n; k > j; k--) {
+            sorted[k] = sorted[k - 1];
+        }
+        sorted[j] = *p;
+        n++;
+    }
+
+    if (n < 2) {
+        return false;
+    }
+
+    // Grid node k sits at count k << CAL_LUT_CELL_BITS
+    float prev = curveAt(sorted, n, -baseline_mv) - units_at_zero;
+    for (uint16_t k = 0; k < CAL_LUT_CELLS; k++) {
+        float mv = ((k + 1) << CAL_LUT_CELL_BITS) * mv_per_count - baseline_mv;
+        float next = curveAt(sorted, n, mv) - units_at_zero;
+        lut->cells[k].base = prev;
+        lut->cells[k].slope = (next - prev) / (1 << CAL_LUT_CELL_BITS);
+        prev = next;
+    }
+
+    lut->zero = units_at_zero;
+    lut->temp_coeff = temp_coeff;
+    lut->ref_temp_c = temp_sum / count;
+    lut->min_value = min_value;
+    lut->max_value = max_value;
+    return true;
+}
+
+// Round a value scaled by 2^bits into an int32, saturating at the type limits
+static int32_t toFixed32(float value, uint8_t bits) {
+    double scaled = ldexp((double)value, bits);
+    if (scaled >= 2147483647.0) return INT32_MAX;
+    if (scaled <= -2147483648.0) return INT32_MIN;
+    return (int32_t)llround(scaled);
+}
+
+void buildFixedLut(FixedChannelLut* fixed, const ChannelLut* lut) {
+    for (uint16_t k = 0; k < CAL_LUT_CELLS; k++) {
+        fixed->cells[k].base_q = toFixed32(lut->cells[k].base, FIXED_FRAC_BITS);
+        fixed->cells[k].slope_q = toFixed32(lut->cells[k].slope, FIXED_FRAC_BITS + FIXED_COEFF_SHIFT);
+    }
+    fixed->zero_q = toFixed32(lut->zero, FIXED_FRAC_BITS);
+    fixed->temp_coeff_q = toFixed32(lut->temp_coeff, CAL_COMP_SHIFT);
+    fixed->ref_temp_q = toFixed32(lut->ref_temp_c, FIXED_FRAC_BITS);
+    fixed->min_q = toFixed32(lut->min_value, FIXED_FRAC_BITS);
+    fixed->max_q = toFixed32(lut->max_value, FIXED_FRAC_BITS);
+}
@@ -0,0 +1,66 @@
+// firmware/src/channel_scheduler.cpp
+
+#include "channel_scheduler.h"
+
+void ChannelScheduler::init(uint16_t base) {
+    base_ms = base ? base : 1;
+    for (uint8_t ch = 0; ch < SCHED_CHANNELS; ch++) {
+        requested_ms[ch] = 0;
+    }
+    recompute();
+}
+
+void ChannelScheduler::setBasePeriod(uint16_t base) {
+    base_ms = base ? base : 1;
+    recompute();
+}
+
+uint16_t ChannelScheduler::basePeriod() const {
+    return base_ms;
+}
+
+void ChannelScheduler::setPeriod(uint8_t channel, uint16_t period_ms) {
+    if (channel >= SCHED_CHANNELS) return;
+    requested_ms[channel] = period_ms;
+    recompute();
+}
+
+uint32_t ChannelScheduler::period(uint8_t channel) const {
+    if (channel >= SCHED_CHANNELS) return 0;
+    return (uint32_t)base_ms * divider[channel];
+}
+
+void ChannelScheduler::recompute() {
+    uint8_t fastest = 0;
+    for (uint8_t ch = 0; ch < SCHED_CHANNELS; ch++) {
+        uint32_t d = ((uint32_t)requested_ms[ch] + base_ms / 2) / base_ms;
+        if (d < 1) d = 1;
+        if (d > SCHED_MAX_DIVIDER) d = SCHED_MAX_DIVIDER;
+        divider[ch] = (uint8_t)d;
+        if (divider[ch] < divider[fastest]) {
+            fastest = ch;
+        }
+    }
+
+    // The clock triggers a scan every base tick; never leave one empty
+    divider[fastest] = 1;
+}
+
+uint8_t ChannelScheduler::dueMask(uint32_t tick) const {
+    uint8_t mask = 0;
+    for (uint8_t ch = 0; ch < SCHED_CHANNELS; ch++) {
+        if (tick % divider[ch] == 0) {
+            mask |= (1 << ch);
+        }
+    }
+    return mask;
+}
+
+uint8_t ChannelScheduler::conversionPercent() const {
+    // Each channel converts 1/divider of the ticks
+    float sum = 0.0f;
+    for (uint8_t ch = 0; ch < SCHED_CHANNELS; ch++) {
+        sum += 1.0f / divider[ch];
+    }
+    return (uint8_t)(100.0f * sum / SCHED_CHANNELS + 0.5f);
+}
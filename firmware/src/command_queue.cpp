@@ -0,0 +1,123 @@
+// firmware/src/command_queue.cpp
+
+#include "command_queue.h"
+#include <string.h>
+
+// Order slot stores against the index update seen by the other side
+#define CMD_COMPILER_BARRIER()  __asm__ volatile("" ::: "memory")
+
+void CommandQueue::init() {
+    queue_head = 0;
+    queue_tail = 0;
+    pushed = 0;
+    drops = 0;
+}
+
+bool CommandQueue::push(const uint8_t* data, uint8_t length, uint32_t now_us) {
+    uint8_t head = queue_head;
+    pushed++;
+    if ((uint8_t)(head - queue_tail) >= CMD_QUEUE_DEPTH) {
+        drops++;
+        return false;
+    }
+
+    Command* slot = &slots[head & (CMD_QUEUE_DEPTH - 1)];
+    slot->length = (length < CMD_MAX_LENGTH) ? length : CMD_MAX_LENGTH;
+    memcpy(slot->data, data, slot->length);
+    slot->received_us = now_us;
+
+    CMD_COMPILER_BARRIER();
+    queue_head = head + 1;
+    return true;
+}
+
+const Command* CommandQueue::peek() const {
+    uint8_t tail = queue_tail;
+    if (tail == queue_head) return 0;
+    CMD_COMPILER_BARRIER();
+    return &slots[tail & (CMD_QUEUE_DEPTH - 1)];
+}
+
+void CommandQueue::pop() {
+    uint8_t tail = queue_tail;
+    if (tail == queue_head) return;
+    CMD_COMPILER_BARRIER();
+    queue_tail = tail + 1;
+}
+
+uint8_t CommandQueue::count() const {
+    return (uint8_t)(queue_head - queue_tail);
+}
+
+uint32_t CommandQueue::received() const {
+    return pushed;
+}
+
+uint32_t CommandQueue::dropped() const {
+    return drops;
+}
+
+void CommandTable::init() {
+    used = 0;
+}
+
+bool CommandTable::add(uint8_t command, uint8_t min_args, CommandHandler handler, void* context) {
+    uint8_t i = 0;
+    while (i < used && entries[i].command != command) {
+        i++;
+    }
+    if (i == used) {
+        if (used == CMD_MAX_HANDLERS) return false;
+        used++;
+    }
+
+    entries[i].command = command;
+    entries[i].min_args = min_args;
+    entries[i].handler = handler;
+    entries[i].context = context;
+    return true;
+}
+
+uint8_t CommandTable::dispatch(const Command* command) const {
+    if (command->length == 0) return CMD_STATUS_BAD_LENGTH;
+
+    uint8_t args = command->length - 1;
+    for (uint8_t i = 0; i < used; i++) {
+        if (entries[i].command != command->data[0]) continue;
+        if (args < entries[i].min_args) return CMD_STATUS_BAD_LENGTH;
+        return entries[i].handler(command->data + 1, args, entries[i].context);
+    }
+    return CMD_STATUS_UNKNOWN;
+}
+
+uint8_t commandEncodeAck(uint8_t command, uint8_t status, uint8_t seq, uint32_t latency_us,
+                         uint8_t* out) {
+    out[0] = RESP_ACK;
+    out[1] = command;
+    out[2] = status;
+    out[3] = seq;
+    out[4] = (uint8_t)latency_us;
+    out[5] = (uint8_t)(latency_us >> 8);
+    out[6] = (uint8_t)(latency_us >> 16);
+    out[7] = (uint8_t)(latency_us >> 24);
+    return RESP_ACK_SIZE;
+}
+
+uint8_t commandEncodeStatus(const DeviceStatus* status, uint8_t* out) {
+    out[0] = RESP_STATUS;
+    out[1] = status->flags;
+    out[2] = status->battery_percent;
+    out[3] = (uint8_t)status->sampling_interval_ms;
+    out[4] = (uint8_t)(status->sampling_interval_ms >> 8);
+    for (uint8_t i = 0; i < 4; i++) {
+        out[5 + i] = (uint8_t)(status->uptime_s >> (8 * i));
+        out[9 + i] = (uint8_t)(status->log_pending >> (8 * i));
+    }
+    out[13] = (uint8_t)status->conn_interval;
+    out[14] = (uint8_t)(status->conn_interval >> 8);
+    out[15] = status->conn_latency;
+    out[16] = status->phy;
+    out[17] = status->procedure_percent;
+    out[18] = status->command_drops;
+    return RESP_STATUS_SIZE;
+}
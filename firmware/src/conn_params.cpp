@@ -0,0 +1,139 @@
+// firmware/src/conn_params.cpp
+
+#include "conn_params.h"
+#include "ble_frame.h"
+#include "aes.h"
+#include <string.h>
+
+void ConnParamPolicy::init() {
+    reset(0);
+    count = 0;
+}
+
+void ConnParamPolicy::reset(uint32_t now) {
+    memset(&last, 0, sizeof(last));
+    have_last = false;
+    last_ms = now;
+}
+
+// One encrypted, framed payload on air
+static uint32_t payloadAirUs(const BleLink* link, uint16_t plain) {
+    uint16_t encrypted = AES_BLOCK_SIZE + aes_padded_length(plain);
+    uint8_t fragments = frameFragmentsFor(encrypted, link->notifyPayload());
+    return link->airTimeUsFor(encrypted + fragments * FRAME_HEADER_SIZE);
+}
+
+void ConnParamPolicy::choose(const ConnDemand* demand, const BleLink* link, ConnParams* out) {
+    memset(out, 0, sizeof(*out));
+
+    // Readings per batch: as many as fit or arrive within the latency
+    uint16_t readings = 1;
+    uint32_t period = 0;
+    if (demand->sample_interval_ms > 0) {
+        if (demand->batch_latency_ms > 0 && demand->reading_size > 0) {
+            uint16_t fit = demand->batch_capacity / demand->reading_size;
+            uint16_t arrive = demand->batch_latency_ms / demand->sample_interval_ms;
+            readings = (fit < arrive) ? fit : arrive;
+            if (readings == 0) {
+                readings = 1;
+            }
+        }
+        period = (uint32_t)readings * demand->sample_interval_ms;
+    }
+
+    uint32_t sleep_ms = 0;
+    uint32_t air_us = payloadAirUs(link, readings * demand->reading_size);
+    if (demand->bulk) {
+        out->mode = CONN_MODE_BULK;
+        out->interval_min = CONN_BULK_INTERVAL;
+        out->interval_max = CONN_BULK_INTERVAL;
+    } else if (demand->backlog) {
+        out->mode = CONN_MODE_BACKLOG;
+        out->interval_min = CONN_BACKLOG_INTERVAL_MIN;
+        out->interval_max = CONN_BACKLOG_INTERVAL_MAX;
+    } else if (period > 0) {
+        uint32_t target = period * 1000 / CONN_PAYLOAD_WAIT_DIV / CONN_UNIT_US;
+        if (target < CONN_STREAM_INTERVAL_MIN) target = CONN_STREAM_INTERVAL_MIN;
+        if (target > CONN_STREAM_INTERVAL_MAX) target = CONN_STREAM_INTERVAL_MAX;
+        out->mode = CONN_MODE_STREAM;
+        out->interval_min = target;
+        out->interval_max = target + CONN_INTERVAL_SPREAD;
+        sleep_ms = (period < CONN_MAX_SLEEP_MS) ? period : CONN_MAX_SLEEP_MS;
+    } else {
+        out->mode = CONN_MODE_IDLE;
+        out->interval_min = CONN_IDLE_INTERVAL;
+        out->interval_max = CONN_IDLE_INTERVAL + CONN_INTERVAL_SPREAD;
+        sleep_ms = CONN_MAX_SLEEP_MS;
+    }
+
+    // Skip events for as long as the central can wait, counted at the
+    // longest interval it may pick
+    uint32_t interval_us = (uint32_t)out->interval_max * CONN_UNIT_US;
+    uint32_t events = sleep_ms * 1000 / interval_us;
+    out->latency = (events > 1) ? events - 1 : 0;
+    if (out->latency > CONN_MAX_LATENCY) {
+        out->latency = CONN_MAX_LATENCY;
+    }
+
+    // Three missed wake-ups before the link is given up
+    uint32_t timeout_ms = interval_us * (out->latency + 1) / 1000 * 3;
+    if (timeout_ms < CONN_TIMEOUT_MIN_MS) timeout_ms = CONN_TIMEOUT_MIN_MS;
+    if (timeout_ms > CONN_TIMEOUT_MAX_MS) timeout_ms = CONN_TIMEOUT_MAX_MS;
+    out->timeout = timeout_ms / CONN_TIMEOUT_UNIT_MS;
+
+    // Bulk and backlog: at least one full notification every event
+    if (out->mode == CONN_MODE_BULK || out->mode == CONN_MODE_BACKLOG) {
+        period = interval_us / 1000;
+        air_us = link->airTimeUsFor(link->notifyPayload());
+    }
+    out->payload_period_ms = period;
+    out->duty_x100 = dutyCycleX100(out, period, air_us);
+}
+
+uint16_t ConnParamPolicy::dutyCycleX100(const ConnParams* params, uint32_t payload_period_ms,
+                                        uint32_t payload_air_us) {
+    float sleep_s = (float)params->interval_max * CONN_UNIT_US * (params->latency + 1) / 1e6f;
+    float payloads = payload_period_ms ? 1000.0f / payload_period_ms : 0.0f;
+
+    // Payload events restart the latency count; the rest are the
+    // wake-ups latency still requires
+    float covered = payloads * sleep_s;
+    float wakes = payloads + ((covered < 1.0f) ? (1.0f - covered) / sleep_s : 0.0f);
+    float radio_us = wakes * CONN_EVENT_BASE_US + payloads * payload_air_us;
+
+    float duty = radio_us / 100.0f;     // Of 1e6 us, x 100
+    return (duty < 10000.0f) ? (uint16_t)(duty + 0.5f) : 10000;
+}
+
+bool ConnParamPolicy::update(const ConnDemand* demand, const BleLink* link, uint32_t now, ConnParams* out) {
+    ConnParams want;
+    choose(demand, link, &want);
+
+    if (!have_last && !demand->bulk && now - last_ms < CONN_SETTLE_MS) {
+        return false;
+    }
+    if (have_last && want.interval_min == last.interval_min &&
+        want.interval_max == last.interval_max && want.latency == last.latency) {
+        return false;
+    }
+
+    // Loosening waits so a burst of work does not flap the link
+    if (have_last && want.interval_min >= last.interval_min && now - last_ms < CONN_RELAX_HOLDOFF_MS) {
+        return false;
+    }
+
+    last = want;
+    have_last = true;
+    last_ms = now;
+    count++;
+    *out = want;
+    return true;
+}
+
+const ConnParams* ConnParamPolicy::requested() const {
+    return &last;
+}
+
+uint32_t ConnParamPolicy::requests() const {
+    return count;
+}
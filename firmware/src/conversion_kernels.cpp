@@ -0,0 +1,45 @@
+// firmware/src/conversion_kernels.cpp
+
+#include "conversion_kernels.h"
+#include <math.h>
+
+void buildChannelTransform(ChannelTransform* transform, float mv_per_count,
+                           float units_per_mv, float units_at_zero,
+                           float cal_offset_mv, float cal_gain, float baseline_mv,
+                           float min_value, float max_value) {
+    transform->scale = mv_per_count * cal_gain * units_per_mv;
+    transform->offset = units_at_zero - units_per_mv * (cal_offset_mv * cal_gain + baseline_mv);
+    transform->min_value = min_value;
+    transform->max_value = max_value;
+}
+
+// Round a value scaled by 2^bits into an int32, saturating at the type limits
+static int32_t toFixed32(float value, uint8_t bits) {
+    double scaled = ldexp((double)value, bits);
+    if (scaled >= 2147483647.0) return INT32_MAX;
+    if (scaled <= -2147483648.0) return INT32_MIN;
+    return (int32_t)llround(scaled);
+}
+
+void buildFixedTransform(FixedChannelTransform* fixed, const ChannelTransform* transform) {
+    const uint8_t coeff_bits = FIXED_FRAC_BITS + FIXED_COEFF_SHIFT;
+
+    fixed->scale_q = toFixed32(transform->scale, coeff_bits);
+    fixed->offset_q = (int64_t)llround(ldexp((double)transform->offset, coeff_bits));
+    fixed->min_q = toFixed32(transform->min_value, FIXED_FRAC_BITS);
+    fixed->max_q = toFixed32(transform->max_value, FIXED_FRAC_BITS);
+}
+
+void convertChannels(const ChannelTransform* transforms, const uint16_t* raw,
+                     float* out, uint8_t channels) {
+    for (uint8_t c = 0; c < channels; c++) {
+        out[c] = convertChannel(&transforms[c], raw[c]);
+    }
+}
+
+void convertChannelsFixed(const FixedChannelTransform* transforms, const uint16_t* raw,
+                          int32_t* out_q, uint8_t channels) {
+    for (uint8_t c = 0; c < channels; c++) {
+        out_q[c] = convertChannelFixed(&transforms[c], raw[c]);
+    }
+}
@@ -0,0 +1,267 @@
+// firmware/src/flash_device.cpp
+
+#include "flash_device.h"
+#include <Arduino.h>
+#include <string.h>
+
+#define FLASH_WRITE_CHUNK   64      // Bytes per SoftDevice write request
+
+#ifdef NRF52
+#include <nrf.h>
+#include <nrf_soc.h>
+#include <nrf_sdm.h>
+
+enum {
+    FLASH_OP_IDLE,
+    FLASH_OP_BUSY,
+    FLASH_OP_DONE,
+    FLASH_OP_FAILED,
+};
+
+static volatile uint8_t flash_op = FLASH_OP_IDLE;
+
+void FlashDevice::onSocEvent(uint32_t evt) {
+    if (evt == NRF_EVT_FLASH_OPERATION_SUCCESS) {
+        flash_op = FLASH_OP_DONE;
+    } else if (evt == NRF_EVT_FLASH_OPERATION_ERROR) {
+        flash_op = FLASH_OP_FAILED;
+    }
+}
+
+static bool softDeviceEnabled() {
+    uint8_t enabled = 0;
+    sd_softdevice_is_enabled(&enabled);
+    return enabled != 0;
+}
+
+// The SoftDevice schedules flash operations between radio events and
+// reports completion as a SoC event
+static bool waitFlashOp() {
+    while (flash_op == FLASH_OP_BUSY) {
+        uint32_t evt;
+        while (sd_evt_get(&evt) == NRF_SUCCESS) {
+            FlashDevice::onSocEvent(evt);
+        }
+    }
+    return flash_op == FLASH_OP_DONE;
+}
+
+static void nvmcWait() {
+    while (NRF_NVMC->READY == NVMC_READY_READY_Busy);
+}
+
+static bool writeWords(uint32_t* dst, const uint32_t* src, uint32_t words) {
+    if (!softDeviceEnabled()) {
+        NRF_NVMC->CONFIG = NVMC_CONFIG_WEN_Wen;
+        nvmcWait();
+        for (uint32_t i = 0; i < words; i++) {
+            dst[i] = src[i];
+            nvmcWait();
+        }
+        NRF_NVMC->CONFIG = NVMC_CONFIG_WEN_Ren;
+        nvmcWait();
+        return true;
+    }
+
+    uint32_t err;
+    flash_op = FLASH_OP_BUSY;
+    while ((err = sd_flash_write(dst, src, words)) == NRF_ERROR_BUSY);
+    if (err != NRF_SUCCESS) {
+        flash_op = FLASH_OP_IDLE;
+        return false;
+    }
+    return waitFlashOp();
+}
+
+static bool erasePageAt(uint32_t address) {
+    if (!softDeviceEnabled()) {
+        NRF_NVMC->CONFIG = NVMC_CONFIG_WEN_Een;
+        nvmcWait();
+        NRF_NVMC->ERASEPAGE = address;
+        nvmcWait();
+        NRF_NVMC->CONFIG = NVMC_CONFIG_WEN_Ren;
+        nvmcWait();
+        return true;
+    }
+
+    uint32_t err;
+    flash_op = FLASH_OP_BUSY;
+    while ((err = sd_flash_page_erase(address / FLASH_PAGE_SIZE)) == NRF_ERROR_BUSY);
+    if (err != NRF_SUCCESS) {
+        flash_op = FLASH_OP_IDLE;
+        return false;
+    }
+    return waitFlashOp();
+}
+
+void FlashDevice::init(uint32_t start, uint16_t page_count) {
+    base = start;
+    pages = page_count;
+}
+
+void FlashDevice::read(uint32_t offset, void* data, uint32_t length) const {
+    memcpy(data, (const void*)(base + offset), length);
+}
+
+bool FlashDevice::write(uint32_t offset, const void* data, uint32_t length) {
+    if (((offset | length) & (FLASH_WORD_SIZE - 1)) || offset + length > size()) {
+        return false;
+    }
+
+    // Stage through an aligned buffer; callers pass packed structs
+    uint32_t staged[FLASH_WRITE_CHUNK / FLASH_WORD_SIZE];
+    const uint8_t* src = (const uint8_t*)data;
+    for (uint32_t done = 0; done < length; done += FLASH_WRITE_CHUNK) {
+        uint32_t chunk = length - done;
+        if (chunk > FLASH_WRITE_CHUNK) {
+            chunk = FLASH_WRITE_CHUNK;
+        }
+        memcpy(staged, src + done, chunk);
+        if (!writeWords((uint32_t*)(base + offset + done), staged, chunk / FLASH_WORD_SIZE)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool FlashDevice::erasePage(uint16_t page) {
+    if (page >= pages) {
+        return false;
+    }
+    return erasePageAt(base + (uint32_t)page * FLASH_PAGE_SIZE);
+}
+#else
+#include <stdio.h>
+#include <stdlib.h>
+
+void FlashDevice::init(uint32_t start, uint16_t page_count) {
+    (void)page_count;
+    base = start;
+    pages = 0;
+    image = NULL;
+    erases = NULL;
+    path[0] = '\0';
+    failing = false;
+    fail_budget = 0;
+}
+
+bool FlashDevice::open(const char* file, uint16_t page_count) {
+    close();
+
+    pages = page_count;
+    image = (uint8_t*)malloc((uint32_t)pages * FLASH_PAGE_SIZE);
+    erases = (uint32_t*)calloc(pages, sizeof(uint32_t));
+    if (!image || !erases) {
+        close();
+        return false;
+    }
+    strncpy(path, file, sizeof(path) - 1);
+    path[sizeof(path) - 1] = '\0';
+    failing = false;
+    fail_budget = 0;
+
+    // A missing or short file reads as erased flash
+    memset(image, 0xFF, size());
+    FILE* f = fopen(path, "rb");
+    if (f) {
+        size_t got = fread(image, 1, size(), f);
+        (void)got;
+        fclose(f);
+    }
+    flush(0, size());
+    return true;
+}
+
+void FlashDevice::close() {
+    free(image);
+    free(erases);
+    image = NULL;
+    erases = NULL;
+    pages = 0;
+}
+
+void FlashDevice::flush(uint32_t offset, uint32_t length) {
+    FILE* f = fopen(path, "r+b");
+    if (!f) {
+        f = fopen(path, "w+b");
+    }
+    if (!f) {
+        return;
+    }
+    fseek(f, offset, SEEK_SET);
+    fwrite(image + offset, 1, length, f);
+    fclose(f);
+}
+
+void FlashDevice::read(uint32_t offset, void* data, uint32_t length) const {
+    memcpy(data, image + offset, length);
+}
+
+bool FlashDevice::write(uint32_t offset, const void* data, uint32_t length) {
+    if (((offset | length) & (FLASH_WORD_SIZE - 1)) || offset + length > size() || failing) {
+        return false;
+    }
+
+    // Programming can only clear bits
+    const uint8_t* src = (const uint8_t*)data;
+    uint32_t n = length;
+    if (fail_budget && n >= fail_budget) {
+        n = fail_budget;
+        failing = true;
+    } else if (fail_budget) {
+        fail_budget -= n;
+    }
+    for (uint32_t i = 0; i < n; i++) {
+        image[offset + i] &= src[i];
+    }
+    flush(offset, n);
+    return !failing;
+}
+
+bool FlashDevice::erasePage(uint16_t page) {
+    if (page >= pages || failing) {
+        return false;
+    }
+    memset(image + (uint32_t)page * FLASH_PAGE_SIZE, 0xFF, FLASH_PAGE_SIZE);
+    erases[page]++;
+    flush((uint32_t)page * FLASH_PAGE_SIZE, FLASH_PAGE_SIZE);
+    return true;
+}
+
+uint32_t FlashDevice::eraseCount(uint16_t page) const {
+    return (page < pages) ? erases[page] : 0;
+}
+
+void FlashDevice::failAfter(uint32_t bytes) {
+    fail_budget = bytes;
+}
+#endif
+
+bool FlashDevice::blank(uint32_t offset, uint32_t length) const {
+    uint32_t words[16];
+
+    while (length) {
+        uint32_t n = (length < sizeof(words)) ? length : sizeof(words);
+        read(offset, words, n);
+        for (uint32_t i = 0; i < n / FLASH_WORD_SIZE; i++) {
+            if (words[i] != 0xFFFFFFFFUL) {
+                return false;
+            }
+        }
+        offset += n;
+        length -= n;
+    }
+    return true;
+}
+
+bool FlashDevice::ensureErased(uint16_t page) {
+    return blank((uint32_t)page * FLASH_PAGE_SIZE, FLASH_PAGE_SIZE) || erasePage(page);
+}
+
+uint32_t FlashDevice::size() const {
+    return (uint32_t)pages * FLASH_PAGE_SIZE;
+}
+
+uint16_t FlashDevice::pageCount() const {
+    return pages;
+}
@@ -3,12 +3,8 @@
 #include <Arduino.h>
 #include <string.h>
 
-// Simulated NVM address for key storage
-// On real nRF52, use nrf_nvmc or FDS (Flash Data Storage)
-static uint8_t nvm_key_storage[16] = {0};
-static bool nvm_has_key = false;
-
-void KeyManager::init() {
+void KeyManager::init(RecordStore* records) {
+    store = records;
     memset(masterKey, 0, 16);
     memset(sessionKey, 0, 16);
     keyState = KEY_STATE_UNPROVISIONED;
@@ -64,8 +60,9 @@ void KeyManager::wipeKeys() {
     keyState = KEY_STATE_UNPROVISIONED;
 
     // Clear NVM
-    memset(nvm_key_storage, 0, 16);
-    nvm_has_key = false;
+    if (store) {
+        store->remove(RECORD_KEY_MASTER_KEY);
+    }
 
     Serial.println("All keys wiped");
 }
@@ -82,17 +79,13 @@ void KeyManager::generateNonce(uint8_t* nonce, uint8_t len) {
 }
 
 void KeyManager::saveToFlash() {
-    // Simulated flash storage
-    // On real nRF52: use nrf_nvmc_write_bytes() or FDS
-    memcpy(nvm_key_storage, masterKey, 16);
-    nvm_has_key = true;
+    if (store && !store->put(RECORD_KEY_MASTER_KEY, masterKey, 16)) {
+        Serial.println("Key not persisted: flash write failed");
+    }
 }
 
 void KeyManager::loadFromFlash() {
-    // Simulated flash read
-    if (nvm_has_key) {
-        memcpy(masterKey, nvm_key_storage, 16);
-
+    if (store && store->get(RECORD_KEY_MASTER_KEY, masterKey, 16)) {
         // Derive session key from stored master key
         uint8_t nonce[8];
         generateNonce(nonce, 8);
@@ -0,0 +1,108 @@
+// firmware/src/link_loopback.cpp
+
+#include "link_loopback.h"
+
+#ifndef NRF52
+#include "sys_time.h"
+#include <string.h>
+
+void LinkLoopback::init(BleLink* l, TxQueue* q) {
+    link = l;
+    queue = q;
+    interval_us = LOOPBACK_INTERVAL_US;
+    event_us = LOOPBACK_INTERVAL_US;
+    pump = 0;
+    pump_context = 0;
+    receive = 0;
+    receive_context = 0;
+    loss_per_mille = 0;
+    loss_state = 1;
+    head = 0;
+    used = 0;
+    memset(&counters, 0, sizeof(counters));
+}
+
+void LinkLoopback::setInterval(uint32_t interval, uint32_t event) {
+    interval_us = interval;
+    event_us = (event == 0 || event > interval) ? interval : event;
+}
+
+void LinkLoopback::setPump(LoopbackPump p, void* context) {
+    pump = p;
+    pump_context = context;
+}
+
+void LinkLoopback::setReceiver(LoopbackReceive r, void* context) {
+    receive = r;
+    receive_context = context;
+}
+
+void LinkLoopback::setLoss(uint16_t per_mille, uint32_t seed) {
+    loss_per_mille = per_mille;
+    loss_state = seed ? seed : 1;
+}
+
+// xorshift32: cheap, and the same drops for the same seed
+bool LinkLoopback::dropNext() {
+    if (loss_per_mille == 0) {
+        return false;
+    }
+    loss_state ^= loss_state << 13;
+    loss_state ^= loss_state >> 17;
+    loss_state ^= loss_state << 5;
+    return loss_state % 1000 < loss_per_mille;
+}
+
+// What the firmware's pumpTx does: one queued notification per free buffer
+void LinkLoopback::fillBuffers() {
+    const TxSlot* slot;
+    while (used < LOOPBACK_MAX_BUFFERS && link->txCredits() > 0 && (slot = queue->peek()) != 0) {
+        buffers[(head + used) % LOOPBACK_MAX_BUFFERS] = *slot;
+        used++;
+        link->onTxSent();
+        queue->pop();
+    }
+}
+
+uint16_t LinkLoopback::connectionEvent() {
+    uint32_t elapsed = 0;
+    uint16_t sent = 0;
+
+    counters.events++;
+    for (;;) {
+        if (pump) {
+            pump(pump_context);
+        }
+        fillBuffers();
+        if (used == 0) break;
+
+        const TxSlot* slot = &buffers[head];
+        uint32_t cost = link->airTimeUsFor(slot->length);
+        if (elapsed + cost > event_us) break;
+        elapsed += cost;
+
+        if (dropNext()) {
+            counters.dropped++;
+        } else if (receive) {
+            receive(slot->target, slot->data, slot->length, receive_context);
+        }
+        counters.notifications++;
+        counters.bytes += slot->length;
+        head = (head + 1) % LOOPBACK_MAX_BUFFERS;
+        used--;
+        link->completeTx(1);
+        sent++;
+    }
+
+    if (sent == 0) {
+        counters.idle_events++;
+    }
+    counters.air_us += elapsed;
+    sysTimeAdvanceUs(interval_us);
+    return sent;
+}
+
+const LoopbackStats* LinkLoopback::stats() const {
+    return &counters;
+}
+#endif
@@ -5,10 +5,15 @@
 #include <ArduinoBLE.h>
 #include "sensor_manager.h"
 #include "signal_processing.h"
+#include "analyte_chains.h"
+#include "spectral_analysis.h"
 #include "ble_comms.h"
 #include "power_manager.h"
 #include "device_info.h"
 #include "key_manager.h"
+#include "flash_device.h"
+#include "record_store.h"
+#include "sample_log.h"
 
 // Global instances
 SensorManager sensorManager;
@@ -17,27 +22,49 @@ BLECommsManager bleComms;
 PowerManager powerManager;
 DeviceInfoManager deviceInfo;
 KeyManager keyManager;
+FlashDevice flash;
+RecordStore records;
+FlashDevice logFlash;
+SampleLog sampleLog;
 
 // Sampling configuration
 #define SAMPLING_INTERVAL_MS    1000    // 1 Hz default
+#define SPECTRAL_WINDOW         256     // Motility analysis window (samples)
+#define MOTILITY_CHANNEL        0       // A0, serotonin
 #define BATTERY_UPDATE_MS       60000   // Update battery every minute
 #define POWER_CHECK_INTERVAL_MS 5000    // Check power mode every 5 seconds
+#define JITTER_REPORT_MS        60000   // Sampling jitter histogram report
+#define LINK_REPORT_MS          60000   // BLE MTU and throughput report
+#define LOG_ACK_SAVE_READINGS   1000    // Acknowledgement progress worth a flash record
 
 // State variables
 bool sampling_active = false;
-uint32_t last_sample_time = 0;
+uint32_t last_jitter_report = 0;
+uint32_t last_link_report = 0;
 uint32_t last_battery_update = 0;
 uint32_t last_power_check = 0;
 uint16_t sampling_interval_ms = SAMPLING_INTERVAL_MS;
+uint32_t log_acked_saved = 0;
+uint32_t broadcast_reserved = 0;
 
 // Signal processing filter states
-FilterState serotonin_filter;
-FilterState dopamine_filter;
-FilterState gaba_filter;
+AnalyteChains chains;
 
-KalmanState serotonin_kalman;
-KalmanState dopamine_kalman;
-KalmanState gaba_kalman;
+// Motility rhythm extraction on the filtered serotonin signal
+SpectralAnalyzer motilityAnalyzer;
+SpectralFeatures pending_features;
+bool features_pending = false;
+uint32_t motility_period_ms = 0;
+
+void reportJitter(const JitterHistogram* jitter);
+void reportLink(const BleLinkStats* link, const TxQueueStats* tx, const BatchStats* batch);
+void reportLog(const SampleLog* log);
+void reportProcedure(const ProcedureStatus* status);
+void reportCommands(const CommandStats* commands);
+void reportStreams(uint8_t active, const StreamStats* streams);
+void reportRetransmit(const RetransmitStats* retransmit);
+void updateMotilityRate();
+void registerCommands();
 
 // AES encryption key - provisioned via secure BLE pairing
 // No longer hardcoded; managed by KeyManager with flash persistence
@@ -57,9 +84,38 @@ void setup() {
     powerManager.init();
     Serial.println("OK");
     
+    // Load persisted keys, calibration and settings
+    Serial.print("Loading records from flash... ");
+    flash.init();
+    if (records.init(&flash)) {
+        Serial.print("OK (");
+        Serial.print(records.loadTimeUs());
+        Serial.println(" us)");
+    } else {
+        Serial.println("FAILED - using defaults");
+    }
+    
+    // Readings taken while no central is connected
+    Serial.print("Opening sample log... ");
+    logFlash.init(FLASH_LOG_BASE, FLASH_LOG_PAGES);
+    records.get(RECORD_KEY_LOG_ACKED, &log_acked_saved, sizeof(log_acked_saved));
+    if (sampleLog.init(&logFlash, log_acked_saved)) {
+        Serial.print("OK (");
+        Serial.print(sampleLog.pending());
+        Serial.println(" readings to sync)");
+    } else {
+        Serial.println("FAILED - offline readings will be lost");
+    }
+    uint16_t stored_interval;
+    if (records.get(RECORD_KEY_SAMPLING_INTERVAL, &stored_interval, sizeof(stored_interval)) &&
+        stored_interval > 0) {
+        sampling_interval_ms = stored_interval;
+    }
+    
     // Initialize sensor manager
     Serial.print("Initializing sensors... ");
     sensorManager.init();
+    sensorManager.setRecordStore(&records);
     Serial.println("OK");
     
     // Run sensor self-test
@@ -72,18 +128,15 @@ void setup() {
     
     // Initialize signal processing filters
     Serial.print("Initializing filters... ");
-    SignalProcessor::initFilterState(&serotonin_filter);
-    SignalProcessor::initFilterState(&dopamine_filter);
-    SignalProcessor::initFilterState(&gaba_filter);
+    chains.configure();
     
-    SignalProcessor::initKalmanState(&serotonin_kalman, 100.0f, 0.1f, 10.0f);
-    SignalProcessor::initKalmanState(&dopamine_kalman, 200.0f, 0.1f, 15.0f);
-    SignalProcessor::initKalmanState(&gaba_kalman, 500.0f, 0.1f, 20.0f);
+    motility_period_ms = sensorManager.channelPeriod(MOTILITY_CHANNEL);
+    motilityAnalyzer.init(1000.0f / motility_period_ms, SPECTRAL_WINDOW, SPECTRAL_MODE_FFT);
     Serial.println("OK");
     
     // Initialize key management
     Serial.print("Initializing key manager... ");
-    keyManager.init();
+    keyManager.init(&records);
     if (keyManager.isProvisioned()) {
         Serial.println("OK (key loaded from flash)");
     } else {
@@ -99,6 +152,20 @@ void setup() {
     if (keyManager.getKey(currentKey)) {
         bleComms.setEncryptionKey(currentKey);
     }
+    uint16_t stored_latency;
+    if (records.get(RECORD_KEY_BATCH_LATENCY, &stored_latency, sizeof(stored_latency))) {
+        bleComms.setBatchLatency(stored_latency);
+    }
+    
+    // Broadcast counters continue past any used before the reset
+    records.get(RECORD_KEY_BROADCAST_COUNTER, &broadcast_reserved, sizeof(broadcast_reserved));
+    bleComms.setBroadcastCounter(broadcast_reserved);
+    uint16_t stored_broadcast;
+    if (records.get(RECORD_KEY_BROADCAST_INTERVAL, &stored_broadcast, sizeof(stored_broadcast))) {
+        bleComms.setBroadcastInterval(stored_broadcast);
+    }
+    bleComms.setSampleLog(&sampleLog);
+    registerCommands();
     Serial.println("OK");
     
     // Initialize device info & battery services
@@ -121,55 +188,102 @@ void loop() {
     
     // Process BLE events and commands
     bleComms.processControlCommands();
+    bool connected = bleComms.isConnected();
+    
+    // Scans are started by the sample clock; pick up finished frames.
+    // Sampling carries on without a central, into the flash log.
+    sensorManager.service();
     
-    // Check if we're connected
-    if (bleComms.isConnected()) {
+    if (connected) {
+        // Calibration / self-test advance one step per pass
+        if (sensorManager.serviceProcedure()) {
+            reportProcedure(sensorManager.procedureStatus());
+        }
+    } else if (sensorManager.procedureActive()) {
+        // A procedure cannot report without a central; abandon it
+        sensorManager.abortProcedure();
+        Serial.println("Procedure aborted: disconnected");
+    }
+    
+    SensorReading raw_reading;
+    if (sensorManager.takeReading(&raw_reading)) {
         
-        // Sampling loop
-        if (sampling_active && (current_time - last_sample_time >= sampling_interval_ms)) {
-            last_sample_time = current_time;
-            
-            // Read raw sensor data
-            SensorReading raw_reading = sensorManager.readAnalytes();
-            
-            // Apply signal processing
-            SensorReading filtered_reading = raw_reading;
-            
-            // Butterworth low-pass filter
-            filtered_reading.serotonin_nm = signalProcessor.butterworthFilter(
-                raw_reading.serotonin_nm, &serotonin_filter
-            );
-            filtered_reading.dopamine_nm = signalProcessor.butterworthFilter(
-                raw_reading.dopamine_nm, &dopamine_filter
-            );
-            filtered_reading.gaba_nm = signalProcessor.butterworthFilter(
-                raw_reading.gaba_nm, &gaba_filter
-            );
-            
-            // Kalman filter for additional noise reduction
-            filtered_reading.serotonin_nm = signalProcessor.kalmanFilter(
-                filtered_reading.serotonin_nm, &serotonin_kalman
-            );
-            filtered_reading.dopamine_nm = signalProcessor.kalmanFilter(
-                filtered_reading.dopamine_nm, &dopamine_kalman
-            );
-            filtered_reading.gaba_nm = signalProcessor.kalmanFilter(
-                filtered_reading.gaba_nm, &gaba_kalman
-            );
-            
-            // Transmit filtered data
-            bleComms.transmitSensorReading(&filtered_reading);
+        // Apply signal processing to the channels converted this tick
+        uint8_t mask = sensorManager.readingMask();
+        SensorReading filtered_reading = *chains.process(&raw_reading, mask);
+        
+        // Present channels only, to whichever streams have subscribers;
+        // kept for the catch-up sync while nobody is connected
+        if (connected) {
+            bleComms.transmitReading(&filtered_reading, sensorManager.rawCounts(), mask);
+        } else {
+            sampleLog.append(&filtered_reading, mask, current_time);
+            bleComms.broadcastReading(&filtered_reading);
+        }
+        
+        // Motility features replace uploading minutes of raw samples; fed
+        // only on ticks that converted A0, never its held value
+        SpectralFeatures features;
+        if ((mask & (1 << MOTILITY_CHANNEL)) &&
+            motilityAnalyzer.addSample(filtered_reading.serotonin_nm, &features)) {
+            pending_features = features;
+            features_pending = true;
             
-            // Debug output
-            Serial.print("Sample | 5-HT: ");
-            Serial.print(filtered_reading.serotonin_nm, 1);
-            Serial.print(" nM | DA: ");
-            Serial.print(filtered_reading.dopamine_nm, 1);
-            Serial.print(" nM | GABA: ");
-            Serial.print(filtered_reading.gaba_nm, 1);
-            Serial.print(" nM | pH: ");
-            Serial.print(filtered_reading.ph_level, 2);
-            Serial.println();
+            Serial.print("Motility | dominant: ");
+            Serial.print(features.dominant_cpm, 2);
+            Serial.println(" cpm");
+        }
+        
+        // Debug output
+        Serial.print("Sample | 5-HT: ");
+        Serial.print(filtered_reading.serotonin_nm, 1);
+        Serial.print(" nM | DA: ");
+        Serial.print(filtered_reading.dopamine_nm, 1);
+        Serial.print(" nM | GABA: ");
+        Serial.print(filtered_reading.gaba_nm, 1);
+        Serial.print(" nM | pH: ");
+        Serial.print(filtered_reading.ph_level, 2);
+        Serial.println();
+    }
+    
+    // Reserve broadcast counters ahead so a reset never reuses one
+    if (bleComms.broadcastInterval() && bleComms.broadcastCounter() >= broadcast_reserved) {
+        uint32_t reserve = bleComms.broadcastCounter() + BROADCAST_COUNTER_RESERVE;
+        if (records.put(RECORD_KEY_BROADCAST_COUNTER, &reserve, sizeof(reserve))) {
+            broadcast_reserved = reserve;
+        }
+    }
+    
+    // Bound what a reset can lose from the log's RAM block
+    if (sampleLog.due(current_time)) {
+        sampleLog.flush();
+    }
+    
+    if (connected) {
+        
+        // Features wait out TX backpressure so readings keep the queue
+        if (features_pending && !bleComms.txBackpressure()) {
+            features_pending = !bleComms.transmitSpectralFeatures(&pending_features);
+        }
+        
+        // Achieved sample period vs nominal
+        if (sampling_active && current_time - last_jitter_report >= JITTER_REPORT_MS) {
+            last_jitter_report = current_time;
+            reportJitter(sensorManager.samplingJitter());
+        }
+        
+        // Negotiated link and what the readings cost on it
+        if (current_time - last_link_report >= LINK_REPORT_MS) {
+            last_link_report = current_time;
+            BleLinkStats link;
+            bleComms.linkStats(&link);
+            reportLink(&link, bleComms.txStats(), bleComms.batchStats());
+            reportStreams(bleComms.activeStreams(), bleComms.streamStats());
+            reportRetransmit(bleComms.retransmitStats());
+            reportLog(&sampleLog);
+            reportCommands(bleComms.commandStats());
+            bleComms.resetLinkStats();
+            bleComms.resetCommandStats();
         }
         
         // Battery level update
@@ -181,83 +295,405 @@ void loop() {
             Serial.print(deviceInfo.getBatteryPercentage());
             Serial.println("%");
         }
+    }
+    
+    // Dynamic power management
+    if (current_time - last_power_check >= POWER_CHECK_INTERVAL_MS) {
+        last_power_check = current_time;
         
-        // Dynamic power management
-        if (current_time - last_power_check >= POWER_CHECK_INTERVAL_MS) {
-            last_power_check = current_time;
-            
-            // Calculate load level based on sampling rate
-            uint8_t load_level;
-            if (!sampling_active) {
-                load_level = 10; // Idle
-            } else if (sampling_interval_ms > 5000) {
-                load_level = 30; // Low rate
-            } else if (sampling_interval_ms > 1000) {
-                load_level = 60; // Medium rate
-            } else {
-                load_level = 90; // High rate
-            }
-            
-            powerManager.dynamicVoltageScaling(load_level);
+        // Calculate load level based on sampling rate
+        uint8_t load_level;
+        if (!sampling_active) {
+            load_level = connected ? 10 : 5; // Idle; minimum without a central
+        } else if (sampling_interval_ms > 5000) {
+            load_level = 30; // Low rate
+        } else if (sampling_interval_ms > 1000) {
+            load_level = 60; // Medium rate
+        } else {
+            load_level = 90; // High rate
         }
         
-    } else {
-        // Not connected - enter low power mode
-        if (current_time - last_power_check >= POWER_CHECK_INTERVAL_MS) {
-            last_power_check = current_time;
-            powerManager.dynamicVoltageScaling(5); // Minimum power
-        }
+        powerManager.dynamicVoltageScaling(load_level);
     }
     
     // Small delay to prevent busy-waiting
     delay(1);
 }
 
-// Command handlers (called from BLE callbacks)
-extern "C" {
-    void onStartSampling() {
-        sampling_active = true;
-        last_sample_time = millis();
-        Serial.println("Sampling started");
+void reportJitter(const JitterHistogram* jitter) {
+    Serial.print("Jitter | n: ");
+    Serial.print(jitter->count);
+    Serial.print(" min: ");
+    Serial.print(jitter->min_us);
+    Serial.print(" us max: ");
+    Serial.print(jitter->max_us);
+    Serial.print(" us | <");
+    Serial.print(jitter->underflow);
+    for (uint8_t b = 0; b < JITTER_BINS; b++) {
+        Serial.print(" ");
+        Serial.print(jitter->bins[b]);
     }
+    Serial.print(" >");
+    Serial.print(jitter->overflow);
+    Serial.print(" (");
+    Serial.print(jitter->bin_us);
+    Serial.println(" us bins)");
+}
+
+void reportLink(const BleLinkStats* link, const TxQueueStats* tx, const BatchStats* batch) {
+    Serial.print("Link | MTU: ");
+    Serial.print(link->att_mtu);
+    Serial.print(" DLE: ");
+    Serial.print(link->data_length);
+    Serial.print(" interval: ");
+    Serial.print(link->conn_interval * CONN_UNIT_US / 1000.0f, 2);
+    Serial.print(" ms latency: ");
+    Serial.print(link->conn_latency);
+    Serial.print(" | ");
+    Serial.print(link->payloads);
+    Serial.print(" payloads, ");
+    Serial.print(link->notifications);
+    Serial.print(" notifications (");
+    Serial.print(link->notifications_per_payload_x100 / 100.0f, 2);
+    Serial.print(" each), ");
+    Serial.print(link->link_packets);
+    Serial.print(" LL packets | ");
+    Serial.print(link->bytes_per_sec);
+    Serial.print(" B/s | ");
+    Serial.print(batch->readings);
+    Serial.print(" readings in ");
+    Serial.print(batch->batches);
+    Serial.print(" batches (");
+    Serial.print(batch->full);
+    Serial.print(" full), ");
+    Serial.print(link->air_bytes_per_reading);
+    Serial.print(" B on air each | queue peak: ");
+    Serial.print(tx->high_water);
+    Serial.print(" backpressure: ");
+    Serial.print(tx->backpressure);
+    Serial.print(" dropped new/old: ");
+    Serial.print(tx->dropped_newest);
+    Serial.print("/");
+    Serial.println(tx->dropped_oldest);
+}
+
+void reportLog(const SampleLog* log) {
+    const SampleLogStats* stats = log->stats();
+    Serial.print("Log | next: ");
+    Serial.print(log->nextSeq());
+    Serial.print(" pending: ");
+    Serial.print(log->pending());
+    Serial.print(" | ");
+    Serial.print(stats->appended);
+    Serial.print(" logged, ");
+    Serial.print(stats->synced);
+    Serial.print(" synced, ");
+    Serial.print(stats->overwritten);
+    Serial.print(" overwritten, ");
+    Serial.print(stats->corrupt);
+    Serial.println(" corrupt blocks");
+}
+
+void reportStreams(uint8_t active, const StreamStats* streams) {
+    static const char* const names[STREAM_COUNT] = {"raw", "filtered", "compressed", "summary"};
     
-    void onStopSampling() {
-        sampling_active = false;
-        Serial.println("Sampling stopped");
+    // Subscribed streams only; the rest cost nothing
+    Serial.print("Streams");
+    for (uint8_t i = 0; i < STREAM_COUNT; i++) {
+        if (!(active & STREAM_BIT(i))) continue;
+        Serial.print(" | ");
+        Serial.print(names[i]);
+        Serial.print(": ");
+        Serial.print(streams->notifications[i]);
+        Serial.print(" sent ");
+        Serial.print(streams->bytes[i]);
+        Serial.print(" B ");
+        Serial.print(streams->dropped[i]);
+        Serial.print(" dropped");
     }
+    Serial.println(active ? "" : " | none subscribed");
+}
+
+void reportRetransmit(const RetransmitStats* retransmit) {
+    Serial.print("Retransmit | ");
+    Serial.print(retransmit->stored);
+    Serial.print(" kept, ");
+    Serial.print(retransmit->acknowledged);
+    Serial.print(" acknowledged in ");
+    Serial.print(retransmit->acks);
+    Serial.print(" acks, ");
+    Serial.print(retransmit->resent);
+    Serial.print(" resent, ");
+    Serial.print(retransmit->evicted);
+    Serial.println(" given up");
+}
+
+void reportCommands(const CommandStats* commands) {
+    Serial.print("Commands | ");
+    Serial.print(commands->received);
+    Serial.print(" received, ");
+    Serial.print(commands->dropped);
+    Serial.print(" dropped, ");
+    Serial.print(commands->failed);
+    Serial.print(" refused | latency avg: ");
+    Serial.print(commands->dispatched ? (uint32_t)(commands->latency_total_us / commands->dispatched) : 0);
+    Serial.print(" us max: ");
+    Serial.print(commands->latency_max_us);
+    Serial.println(" us");
+}
+
+void reportProcedure(const ProcedureStatus* status) {
+    bleComms.transmitProcedureStatus(status);
     
-    void onCalibrate() {
-        Serial.println("Starting calibration...");
-        sampling_active = false;
-        sensorManager.calibrate();
-        Serial.println("Calibration complete");
+    static const char* const names[] = {"", "Calibration", "Self-test"};
+    static const char* const outcomes[] = {"running", "PASSED", "FAILED", "aborted"};
+    Serial.print(names[status->procedure]);
+    Serial.print(": ");
+    Serial.print(outcomes[status->outcome]);
+    Serial.print(" ");
+    Serial.print(status->percent);
+    Serial.print("%");
+    if (status->failed_channels) {
+        Serial.print(" failed channels 0x");
+        Serial.print(status->failed_channels, HEX);
     }
-    
-    void onSelfTest() {
-        Serial.println("Running self-test...");
-        bool result = sensorManager.selfTest();
-        Serial.print("Self-test: ");
-        Serial.println(result ? "PASSED" : "FAILED");
+    Serial.println();
+}
+
+// A0's scheduled period follows the base interval and the other channels'
+// periods; the analyzer restarts only when it actually changes
+void updateMotilityRate() {
+    uint32_t period_ms = sensorManager.channelPeriod(MOTILITY_CHANNEL);
+    if (period_ms != motility_period_ms) {
+        motility_period_ms = period_ms;
+        motilityAnalyzer.setSampleRate(1000.0f / period_ms);
     }
+}
+
+// Command handlers, run from the command table; arguments follow the
+// command byte (ble_comms.h)
+static uint8_t onStartSampling(const uint8_t* args, uint8_t length, void* context) {
+    (void)args;
+    (void)length;
+    (void)context;
+    sampling_active = true;
+    last_jitter_report = millis();
+    sensorManager.startSampling(sampling_interval_ms);
+    bleComms.setSamplingInterval(sampling_interval_ms);
+    updateMotilityRate();
+    Serial.println("Sampling started");
+    return CMD_STATUS_OK;
+}
+
+static uint8_t onStopSampling(const uint8_t* args, uint8_t length, void* context) {
+    (void)args;
+    (void)length;
+    (void)context;
+    sampling_active = false;
+    sensorManager.stopAcquisition();
+    bleComms.setSamplingInterval(0);
+    sampleLog.flush();
+    Serial.println("Sampling stopped");
+    return CMD_STATUS_OK;
+}
+
+static uint8_t onCalibrate(const uint8_t* args, uint8_t length, void* context) {
+    (void)args;
+    (void)length;
+    (void)context;
+    // Runs incrementally from loop(); sampling and BLE keep going
+    if (!sensorManager.startCalibration()) {
+        Serial.println("Procedure already running");
+        return CMD_STATUS_BUSY;
+    }
+    Serial.println("Starting calibration...");
+    reportProcedure(sensorManager.procedureStatus());
+    return CMD_STATUS_OK;
+}
+
+static uint8_t onCalibratePoint(const uint8_t* args, uint8_t length, void* context) {
+    (void)length;
+    (void)context;
+    // Standard of known value applied to one channel's sensor
+    float reference;
+    memcpy(&reference, args + 1, sizeof(reference));
+    if (!sensorManager.startCalibrationPoint(args[0], reference)) {
+        Serial.println("Calibration point rejected");
+        return CMD_STATUS_REJECTED;
+    }
+    Serial.print("Measuring calibration standard on A");
+    Serial.println(args[0]);
+    reportProcedure(sensorManager.procedureStatus());
+    return CMD_STATUS_OK;
+}
+
+static uint8_t onClearCalibration(const uint8_t* args, uint8_t length, void* context) {
+    (void)length;
+    (void)context;
+    sensorManager.clearCalibrationPoints(args[0]);
+    Serial.println("Calibration points cleared");
+    return CMD_STATUS_OK;
+}
+
+static uint8_t onSelfTest(const uint8_t* args, uint8_t length, void* context) {
+    (void)args;
+    (void)length;
+    (void)context;
+    if (!sensorManager.startSelfTest()) {
+        Serial.println("Procedure already running");
+        return CMD_STATUS_BUSY;
+    }
+    Serial.println("Running self-test...");
+    reportProcedure(sensorManager.procedureStatus());
+    return CMD_STATUS_OK;
+}
+
+static uint8_t onAbortProcedure(const uint8_t* args, uint8_t length, void* context) {
+    (void)args;
+    (void)length;
+    (void)context;
+    if (!sensorManager.procedureActive()) {
+        return CMD_STATUS_REJECTED;
+    }
+    sensorManager.abortProcedure();
+    reportProcedure(sensorManager.procedureStatus());
+    return CMD_STATUS_OK;
+}
+
+static uint8_t onSetInterval(const uint8_t* args, uint8_t length, void* context) {
+    (void)length;
+    (void)context;
+    uint16_t interval_ms = (args[0] << 8) | args[1];
+    if (interval_ms == 0) return CMD_STATUS_REJECTED;
     
-    void onSetInterval(uint16_t interval_ms) {
-        sampling_interval_ms = interval_ms;
-        Serial.print("Sampling interval set to ");
+    sampling_interval_ms = interval_ms;
+    records.put(RECORD_KEY_SAMPLING_INTERVAL, &sampling_interval_ms, sizeof(sampling_interval_ms));
+    if (sampling_active) {
+        sensorManager.startSampling(interval_ms);
+        bleComms.setSamplingInterval(interval_ms);
+    }
+    updateMotilityRate();
+    Serial.print("Sampling interval set to ");
+    Serial.print(interval_ms);
+    Serial.println(" ms");
+    return CMD_STATUS_OK;
+}
+
+static uint8_t onSetChannelPeriod(const uint8_t* args, uint8_t length, void* context) {
+    (void)length;
+    (void)context;
+    uint16_t period_ms = (args[1] << 8) | args[2];
+    sensorManager.setChannelPeriod(args[0], period_ms);
+    updateMotilityRate();
+    Serial.print("A");
+    Serial.print(args[0]);
+    Serial.print(" sampled every ");
+    Serial.print(sensorManager.channelPeriod(args[0]));
+    Serial.println(" ms");
+    return CMD_STATUS_OK;
+}
+
+static uint8_t onSetBatchLatency(const uint8_t* args, uint8_t length, void* context) {
+    (void)length;
+    (void)context;
+    uint16_t latency_ms = (args[0] << 8) | args[1];
+    bleComms.setBatchLatency(latency_ms);
+    records.put(RECORD_KEY_BATCH_LATENCY, &latency_ms, sizeof(latency_ms));
+    Serial.print("Readings batched for up to ");
+    Serial.print(latency_ms);
+    Serial.println(" ms");
+    return CMD_STATUS_OK;
+}
+
+static uint8_t onSetBroadcast(const uint8_t* args, uint8_t length, void* context) {
+    (void)length;
+    (void)context;
+    uint16_t interval_ms = (args[0] << 8) | args[1];
+    bleComms.setBroadcastInterval(interval_ms);
+    interval_ms = bleComms.broadcastInterval();
+    records.put(RECORD_KEY_BROADCAST_INTERVAL, &interval_ms, sizeof(interval_ms));
+    if (interval_ms) {
+        Serial.print("Broadcasting readings every ");
         Serial.print(interval_ms);
-        Serial.println(" ms");
+        Serial.println(" ms while disconnected");
+    } else {
+        Serial.println("Broadcast off");
     }
+    return CMD_STATUS_OK;
+}
 
-    void onProvisionKey(const uint8_t* key, uint8_t keyLen) {
-        Serial.println("Provisioning encryption key...");
-        if (keyManager.provisionKey(key, keyLen)) {
-            uint8_t sessionKey[16];
-            if (keyManager.getKey(sessionKey)) {
-                bleComms.setEncryptionKey(sessionKey);
-                Serial.println("Encryption key provisioned and active");
-            }
-        } else {
-            Serial.println("Key provisioning failed");
+static uint8_t onLogAck(const uint8_t* args, uint8_t length, void* context) {
+    (void)length;
+    (void)context;
+    uint32_t seq = ((uint32_t)args[0] << 24) | ((uint32_t)args[1] << 16) | ((uint32_t)args[2] << 8) | args[3];
+    sampleLog.acknowledge(seq);
+    
+    // Saved when caught up or every so often, not on every ack; a
+    // reset in between only repeats part of the catch-up
+    uint32_t acked = sampleLog.acknowledged();
+    if (sampleLog.pending() == 0 || acked - log_acked_saved >= LOG_ACK_SAVE_READINGS) {
+        if (records.put(RECORD_KEY_LOG_ACKED, &acked, sizeof(acked))) {
+            log_acked_saved = acked;
         }
     }
+    return CMD_STATUS_OK;
+}
+
+static uint8_t onProvisionKey(const uint8_t* args, uint8_t length, void* context) {
+    (void)context;
+    Serial.println("Provisioning encryption key...");
+    uint8_t sessionKey[16];
+    if (!keyManager.provisionKey(args, length) || !keyManager.getKey(sessionKey)) {
+        Serial.println("Key provisioning failed");
+        return CMD_STATUS_REJECTED;
+    }
+    bleComms.setEncryptionKey(sessionKey);
+    Serial.println("Encryption key provisioned and active");
+    return CMD_STATUS_OK;
+}
+
+static uint8_t onRequestStatus(const uint8_t* args, uint8_t length, void* context) {
+    (void)args;
+    (void)length;
+    (void)context;
+    BleLinkStats link;
+    bleComms.linkStats(&link);
+    const CommandStats* commands = bleComms.commandStats();
+    
+    DeviceStatus status;
+    status.flags = (sampling_active ? STATUS_SAMPLING : 0) |
+                   (keyManager.isProvisioned() ? STATUS_KEY_SET : 0) |
+                   (bleComms.logSyncActive() ? STATUS_LOG_SYNC : 0) |
+                   (bleComms.bulkActive() ? STATUS_BULK : 0) |
+                   (sensorManager.procedureActive() ? STATUS_PROCEDURE : 0) |
+                   (bleComms.txBackpressure() ? STATUS_BACKPRESSURE : 0);
+    status.battery_percent = deviceInfo.getBatteryPercentage();
+    status.sampling_interval_ms = sampling_interval_ms;
+    status.uptime_s = millis() / 1000;
+    status.log_pending = sampleLog.pending();
+    status.conn_interval = link.conn_interval;
+    status.conn_latency = (link.conn_latency < 255) ? link.conn_latency : 255;
+    status.phy = link.phy;
+    status.procedure_percent = sensorManager.procedureStatus()->percent;
+    status.command_drops = (commands->dropped < 255) ? commands->dropped : 255;
+    bleComms.transmitStatus(&status);
+    return CMD_STATUS_OK;
 }
 
+// Minimum argument bytes per command; anything shorter is refused unrun
+void registerCommands() {
+    bleComms.registerCommand(CMD_START_SAMPLING, 0, onStartSampling);
+    bleComms.registerCommand(CMD_STOP_SAMPLING, 0, onStopSampling);
+    bleComms.registerCommand(CMD_CALIBRATE, 0, onCalibrate);
+    bleComms.registerCommand(CMD_SELF_TEST, 0, onSelfTest);
+    bleComms.registerCommand(CMD_ABORT_PROCEDURE, 0, onAbortProcedure);
+    bleComms.registerCommand(CMD_CALIBRATE_POINT, 5, onCalibratePoint);
+    bleComms.registerCommand(CMD_CLEAR_CALIBRATION, 1, onClearCalibration);
+    bleComms.registerCommand(CMD_SET_INTERVAL, 2, onSetInterval);
+    bleComms.registerCommand(CMD_SET_CHANNEL_PERIOD, 3, onSetChannelPeriod);
+    bleComms.registerCommand(CMD_SET_BATCH_LATENCY, 2, onSetBatchLatency);
+    bleComms.registerCommand(CMD_SET_BROADCAST, 2, onSetBroadcast);
+    bleComms.registerCommand(CMD_LOG_ACK, 4, onLogAck);
+    bleComms.registerCommand(CMD_SET_KEY, 16, onProvisionKey);
+    bleComms.registerCommand(CMD_REQUEST_STATUS, 0, onRequestStatus);
+}
@@ -0,0 +1,123 @@
+// firmware/src/order_statistics.cpp
+
+#include "order_statistics.h"
+
+// Link widths count positions: head is position 0, the k-th smallest value
+// sits at position k+1 and the end of the list at position count+1.
+
+void OrderStatisticsWindow::init() {
+    for (uint8_t lvl = 0; lvl < OSW_MAX_LEVELS; lvl++) {
+        next[0][lvl] = OSW_NIL;
+        width[0][lvl] = 1;
+    }
+    levels[0] = OSW_MAX_LEVELS;
+
+    // Chain nodes 1..N into the free list
+    for (uint8_t n = 1; n <= OSW_MAX_SIZE; n++) {
+        next[n][0] = (n < OSW_MAX_SIZE) ? (uint8_t)(n + 1) : OSW_NIL;
+    }
+    free_head = 1;
+    count = 0;
+    rng = 0x2545F491;
+}
+
+uint8_t OrderStatisticsWindow::randomLevel() {
+    // xorshift32; each extra level with probability 1/2
+    rng ^= rng << 13;
+    rng ^= rng >> 17;
+    rng ^= rng << 5;
+
+    uint8_t lvl = 1;
+    uint32_t bits = rng;
+    while ((bits & 1) && lvl < OSW_MAX_LEVELS) {
+        lvl++;
+        bits >>= 1;
+    }
+    return lvl;
+}
+
+bool OrderStatisticsWindow::insert(float v) {
+    if (free_head == OSW_NIL) return false;
+
+    uint8_t chain[OSW_MAX_LEVELS];
+    uint8_t steps_at_level[OSW_MAX_LEVELS];
+
+    uint8_t node = 0;
+    for (int8_t lvl = OSW_MAX_LEVELS - 1; lvl >= 0; lvl--) {
+        steps_at_level[lvl] = 0;
+        while (next[node][lvl] != OSW_NIL && value[next[node][lvl]] <= v) {
+            steps_at_level[lvl] += width[node][lvl];
+            node = next[node][lvl];
+        }
+        chain[lvl] = node;
+    }
+
+    // Take a node from the free list
+    uint8_t n = free_head;
+    free_head = next[n][0];
+
+    uint8_t d = randomLevel();
+    value[n] = v;
+    levels[n] = d;
+
+    uint8_t steps = 0;
+    for (uint8_t lvl = 0; lvl < d; lvl++) {
+        uint8_t prev = chain[lvl];
+        next[n][lvl] = next[prev][lvl];
+        next[prev][lvl] = n;
+        width[n][lvl] = width[prev][lvl] - steps;
+        width[prev][lvl] = steps + 1;
+        steps += steps_at_level[lvl];
+    }
+    for (uint8_t lvl = d; lvl < OSW_MAX_LEVELS; lvl++) {
+        width[chain[lvl]][lvl]++;
+    }
+
+    count++;
+    return true;
+}
+
+bool OrderStatisticsWindow::remove(float v) {
+    uint8_t chain[OSW_MAX_LEVELS];
+
+    uint8_t node = 0;
+    for (int8_t lvl = OSW_MAX_LEVELS - 1; lvl >= 0; lvl--) {
+        while (next[node][lvl] != OSW_NIL && value[next[node][lvl]] < v) {
+            node = next[node][lvl];
+        }
+        chain[lvl] = node;
+    }
+
+    uint8_t n = next[chain[0]][0];
+    if (n == OSW_NIL || value[n] != v) return false;
+
+    uint8_t d = levels[n];
+    for (uint8_t lvl = 0; lvl < d; lvl++) {
+        uint8_t prev = chain[lvl];
+        width[prev][lvl] += width[n][lvl] - 1;
+        next[prev][lvl] = next[n][lvl];
+    }
+    for (uint8_t lvl = d; lvl < OSW_MAX_LEVELS; lvl++) {
+        width[chain[lvl]][lvl]--;
+    }
+
+    // Return node to the free list
+    next[n][0] = free_head;
+    free_head = n;
+
+    count--;
+    return true;
+}
+
+float OrderStatisticsWindow::at(uint8_t k) const {
+    uint8_t node = 0;
+    uint8_t remaining = k + 1;
+
+    for (int8_t lvl = OSW_MAX_LEVELS - 1; lvl >= 0; lvl--) {
+        while (width[node][lvl] <= remaining) {
+            remaining -= width[node][lvl];
+            node = next[node][lvl];
+        }
+    }
+    return value[node];
+}
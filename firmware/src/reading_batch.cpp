@@ -0,0 +1,105 @@
+// firmware/src/reading_batch.cpp
+
+#include "reading_batch.h"
+#include "aes.h"
+#include <string.h>
+
+void ReadingBatcher::init() {
+    used = 0;
+    readings = 0;
+    first_ms = 0;
+    limit = 0;
+    reading_max = 0;
+    latency_ms = BATCH_LATENCY_MS;
+    resetStats();
+}
+
+void ReadingBatcher::setLatency(uint16_t ms) {
+    latency_ms = ms;
+}
+
+uint16_t ReadingBatcher::latency() const {
+    return latency_ms;
+}
+
+void ReadingBatcher::setCapacity(uint16_t bytes, uint8_t largest) {
+    limit = (bytes < BATCH_MAX_SIZE) ? bytes : BATCH_MAX_SIZE;
+    reading_max = largest;
+}
+
+uint16_t ReadingBatcher::capacity() const {
+    return limit;
+}
+
+uint16_t ReadingBatcher::capacityFor(uint16_t notify_payload) {
+    // IV, then whole blocks; PKCS7 always adds at least one byte
+    if (notify_payload < 2 * AES_BLOCK_SIZE) {
+        return 0;
+    }
+    uint16_t blocks = (notify_payload - AES_BLOCK_SIZE) / AES_BLOCK_SIZE;
+    uint16_t bytes = blocks * AES_BLOCK_SIZE - 1;
+    return (bytes < BATCH_MAX_SIZE) ? bytes : BATCH_MAX_SIZE;
+}
+
+bool ReadingBatcher::fits(uint8_t length) const {
+    // An empty batch always takes one reading, however small the MTU
+    return used == 0 || used + length <= limit;
+}
+
+void ReadingBatcher::add(const uint8_t* reading, uint8_t length, uint32_t now_ms) {
+    if (!fits(length) || used + length > BATCH_MAX_SIZE) {
+        return;
+    }
+    if (used == 0) {
+        first_ms = now_ms;
+    }
+    memcpy(buffer + used, reading, length);
+    used += length;
+    readings++;
+    counters.readings++;
+}
+
+bool ReadingBatcher::full() const {
+    return used > 0 && (latency_ms == 0 || used + reading_max > limit);
+}
+
+bool ReadingBatcher::expired(uint32_t now_ms) const {
+    return used > 0 && now_ms - first_ms >= latency_ms;
+}
+
+const uint8_t* ReadingBatcher::data() const {
+    return buffer;
+}
+
+uint16_t ReadingBatcher::length() const {
+    return used;
+}
+
+uint8_t ReadingBatcher::count() const {
+    return readings;
+}
+
+void ReadingBatcher::take(uint32_t now_ms) {
+    if (used == 0) return;
+
+    if (!full() && expired(now_ms)) {
+        counters.deadline++;
+    } else {
+        counters.full++;
+    }
+    counters.batches++;
+    clear();
+}
+
+void ReadingBatcher::clear() {
+    used = 0;
+    readings = 0;
+}
+
+const BatchStats* ReadingBatcher::stats() const {
+    return &counters;
+}
+
+void ReadingBatcher::resetStats() {
+    memset(&counters, 0, sizeof(counters));
+}
@@ -0,0 +1,148 @@
+// firmware/src/reading_codec.cpp
+
+#include "reading_codec.h"
+#include <math.h>
+
+void ReadingCodec::init() {
+    setChannel(0, SEROTONIN_MIN_NM, SEROTONIN_MAX_NM, CODEC_SCALE_LOG, CODEC_BITS_SEROTONIN);
+    setChannel(1, DOPAMINE_MIN_NM, DOPAMINE_MAX_NM, CODEC_SCALE_LOG, CODEC_BITS_DOPAMINE);
+    setChannel(2, GABA_MIN_NM, GABA_MAX_NM, CODEC_SCALE_LOG, CODEC_BITS_GABA);
+    setChannel(3, CODEC_PH_MIN, CODEC_PH_MAX, CODEC_SCALE_LINEAR, CODEC_BITS_PH);
+    setChannel(4, CODEC_TEMP_MIN_C, CODEC_TEMP_MAX_C, CODEC_SCALE_LINEAR, CODEC_BITS_TEMP);
+    setChannel(5, CALPROTECTIN_MIN_UG_G, CALPROTECTIN_MAX_UG_G, CODEC_SCALE_LOG, CODEC_BITS_CALPROTECTIN);
+}
+
+void ReadingCodec::setChannel(uint8_t ch, float min, float max, uint8_t scale, uint8_t bits) {
+    CodecChannel* c = &channel[ch];
+    c->min = min;
+    c->max = max;
+    c->scale = scale;
+    setBits(ch, bits);
+}
+
+bool ReadingCodec::setBits(uint8_t ch, uint8_t bits) {
+    if (ch >= CODEC_CHANNELS || bits < 1 || bits > CODEC_MAX_BITS) {
+        return false;
+    }
+
+    CodecChannel* c = &channel[ch];
+    float lo = (c->scale == CODEC_SCALE_LOG) ? logf(c->min) : c->min;
+    float hi = (c->scale == CODEC_SCALE_LOG) ? logf(c->max) : c->max;
+    c->bits = bits;
+    c->max_code = (uint16_t)((1UL << bits) - 1);
+    c->origin = lo;
+    c->codes_per_unit = c->max_code / (hi - lo);
+    c->units_per_code = (hi - lo) / c->max_code;
+    return true;
+}
+
+uint8_t ReadingCodec::bits(uint8_t ch) const {
+    return (ch < CODEC_CHANNELS) ? channel[ch].bits : 0;
+}
+
+uint16_t ReadingCodec::quantise(uint8_t ch, float value) const {
+    const CodecChannel* c = &channel[ch];
+
+    // Saturate first: also keeps zero and negatives out of the log
+    if (!(value > c->min)) return 0;
+    if (value >= c->max) return c->max_code;
+
+    float x = (c->scale == CODEC_SCALE_LOG) ? logf(value) : value;
+    float code = (x - c->origin) * c->codes_per_unit + 0.5f;
+    return (code >= c->max_code) ? c->max_code : (uint16_t)code;
+}
+
+float ReadingCodec::dequantise(uint8_t ch, uint16_t code) const {
+    const CodecChannel* c = &channel[ch];
+    float x = c->origin + code * c->units_per_code;
+    return (c->scale == CODEC_SCALE_LOG) ? expf(x) : x;
+}
+
+float ReadingCodec::maxError(uint8_t ch) const {
+    if (ch >= CODEC_CHANNELS) return 0.0f;
+    const CodecChannel* c = &channel[ch];
+
+    // Half a step either side of the code
+    float half = 0.5f * c->units_per_code;
+    return (c->scale == CODEC_SCALE_LOG) ? expf(half) - 1.0f : half;
+}
+
+uint8_t ReadingCodec::size(uint8_t mask) const {
+    uint16_t nbits = CODEC_CHANNELS;
+    for (uint8_t ch = 0; ch < CODEC_CHANNELS; ch++) {
+        if (mask & (1 << ch)) {
+            nbits += channel[ch].bits;
+        }
+    }
+    return (uint8_t)(CODEC_HEADER_SIZE + (nbits + 7) / 8);
+}
+
+uint8_t ReadingCodec::encode(const SensorReading* reading, uint8_t mask, uint8_t* out) const {
+    const float units[CODEC_CHANNELS] = {
+        reading->serotonin_nm, reading->dopamine_nm, reading->gaba_nm,
+        reading->ph_level, reading->temperature_c, reading->calprotectin_ug_g
+    };
+
+    uint32_t t = reading->timestamp_ms;
+    out[0] = (uint8_t)t;
+    out[1] = (uint8_t)(t >> 8);
+    out[2] = (uint8_t)(t >> 16);
+    out[3] = (uint8_t)(t >> 24);
+
+    // LSB-first bit stream; at most 7 + 16 bits pending
+    mask &= (1 << CODEC_CHANNELS) - 1;
+    uint32_t acc = mask;
+    uint8_t pending = CODEC_CHANNELS;
+    uint8_t length = CODEC_HEADER_SIZE;
+    for (uint8_t ch = 0; ch < CODEC_CHANNELS; ch++) {
+        if (!(mask & (1 << ch))) {
+            continue;
+        }
+        acc |= (uint32_t)quantise(ch, units[ch]) << pending;
+        pending += channel[ch].bits;
+        while (pending >= 8) {
+            out[length++] = (uint8_t)acc;
+            acc >>= 8;
+            pending -= 8;
+        }
+    }
+    if (pending) {
+        out[length++] = (uint8_t)acc;
+    }
+    return length;
+}
+
+uint8_t ReadingCodec::decode(const uint8_t* in, uint8_t length, SensorReading* reading) const {
+    float* const units[CODEC_CHANNELS] = {
+        &reading->serotonin_nm, &reading->dopamine_nm, &reading->gaba_nm,
+        &reading->ph_level, &reading->temperature_c, &reading->calprotectin_ug_g
+    };
+
+    if (length <= CODEC_HEADER_SIZE) {
+        return 0;
+    }
+    uint8_t mask = in[CODEC_HEADER_SIZE] & ((1 << CODEC_CHANNELS) - 1);
+    if (!mask || size(mask) > length) {
+        return 0;
+    }
+
+    uint32_t acc = in[CODEC_HEADER_SIZE] >> CODEC_CHANNELS;
+    uint8_t pending = 8 - CODEC_CHANNELS;
+    uint8_t at = CODEC_HEADER_SIZE + 1;
+    for (uint8_t ch = 0; ch < CODEC_CHANNELS; ch++) {
+        if (!(mask & (1 << ch))) {
+            continue;
+        }
+        while (pending < channel[ch].bits) {
+            acc |= (uint32_t)in[at++] << pending;
+            pending += 8;
+        }
+        *units[ch] = dequantise(ch, (uint16_t)(acc & channel[ch].max_code));
+        acc >>= channel[ch].bits;
+        pending -= channel[ch].bits;
+    }
+
+    reading->timestamp_ms = (uint32_t)in[0] | ((uint32_t)in[1] << 8) |
+                            ((uint32_t)in[2] << 16) | ((uint32_t)in[3] << 24);
+    return mask;
+}
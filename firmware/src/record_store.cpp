@@ -0,0 +1,283 @@
+// firmware/src/record_store.cpp
+
+#include "record_store.h"
+#include "crc32.h"
+#include <Arduino.h>
+#include <string.h>
+
+#define RECORD_MAX_PAGES    16
+#define RECORD_ERASED_KEY   0xFFFF
+#define RECORD_PAD(len)     (((uint32_t)(len) + FLASH_WORD_SIZE - 1) & ~(uint32_t)(FLASH_WORD_SIZE - 1))
+
+static uint32_t recordCrc(uint16_t key, uint16_t length, const void* data) {
+    uint32_t crc = crc32(0, &key, sizeof(key));
+    crc = crc32(crc, &length, sizeof(length));
+    return crc32(crc, data, length);
+}
+
+bool RecordStore::init(FlashDevice* device) {
+    uint32_t start_us = micros();
+
+    flash = device;
+    memset(index, 0, sizeof(index));
+    collected = 0;
+    next_seq = 1;
+
+    uint16_t pages = flash->pageCount();
+    if (pages < 2 || pages > RECORD_MAX_PAGES) {
+        return false;
+    }
+
+    // Pages with a valid header, oldest first
+    uint16_t order[RECORD_MAX_PAGES];
+    uint32_t seqs[RECORD_MAX_PAGES];
+    uint16_t valid = 0;
+    for (uint16_t p = 0; p < pages; p++) {
+        RecordPageHeader header;
+        flash->read((uint32_t)p * FLASH_PAGE_SIZE, &header, sizeof(header));
+        if (header.magic != RECORD_PAGE_MAGIC || header.seq == 0xFFFFFFFFUL) {
+            continue;
+        }
+        uint16_t i = valid++;
+        while (i > 0 && seqs[i - 1] > header.seq) {
+            seqs[i] = seqs[i - 1];
+            order[i] = order[i - 1];
+            i--;
+        }
+        seqs[i] = header.seq;
+        order[i] = p;
+    }
+
+    bool ok = true;
+    if (valid == 0) {
+        // Blank or foreign region: start a fresh log
+        for (uint16_t p = 0; p < pages; p++) {
+            ok = flash->ensureErased(p) && ok;
+        }
+        ok = ok && openPage(0);
+    } else {
+        // Later records override earlier ones
+        active_page = order[valid - 1];
+        next_seq = seqs[valid - 1] + 1;
+        for (uint16_t i = 0; i < valid; i++) {
+            scanPage(order[i], i == valid - 1);
+        }
+
+        // The page after the active one is kept erased; if it is not, a
+        // reset interrupted a rotation, so finish collecting it
+        uint16_t spare = (active_page + 1) % pages;
+        if (!flash->blank((uint32_t)spare * FLASH_PAGE_SIZE, FLASH_PAGE_SIZE)) {
+            RecordPageHeader header;
+            flash->read((uint32_t)spare * FLASH_PAGE_SIZE, &header, sizeof(header));
+            if (header.magic == RECORD_PAGE_MAGIC) {
+                ok = collectPage(spare);
+            } else {
+                ok = flash->erasePage(spare);
+            }
+        }
+    }
+
+    load_time_us = micros() - start_us;
+    return ok;
+}
+
+bool RecordStore::scanPage(uint16_t page, bool active) {
+    uint32_t offset = (uint32_t)page * FLASH_PAGE_SIZE + sizeof(RecordPageHeader);
+    uint32_t end = (uint32_t)(page + 1) * FLASH_PAGE_SIZE;
+    uint8_t data[RECORD_MAX_LENGTH];
+    bool clean = true;
+
+    while (offset + sizeof(RecordHeader) <= end) {
+        RecordHeader header;
+        flash->read(offset, &header, sizeof(header));
+
+        if (header.key == RECORD_ERASED_KEY && header.length == 0xFFFF && header.crc == 0xFFFFFFFFUL) {
+            break;      // End of the log in this page
+        }
+
+        uint32_t size = sizeof(RecordHeader) + RECORD_PAD(header.length);
+        if (header.key >= RECORD_MAX_KEYS || header.length > RECORD_MAX_LENGTH || offset + size > end) {
+            // Torn header: nothing after it can be located
+            offset = end;
+            clean = false;
+            break;
+        }
+
+        flash->read(offset + sizeof(RecordHeader), data, header.length);
+        if (recordCrc(header.key, header.length, data) == header.crc) {
+            index[header.key].offset = header.length ? offset + sizeof(RecordHeader) : 0;
+            index[header.key].length = header.length;
+        } else {
+            clean = false;  // Torn write, skipped
+        }
+        offset += size;
+    }
+
+    if (active) {
+        // A write cut short can leave programmed words past the last
+        // header; never program over them
+        write_offset = flash->blank(offset, end - offset) ? offset : end;
+    }
+    return clean;
+}
+
+bool RecordStore::openPage(uint16_t page) {
+    if (!flash->ensureErased(page)) {
+        return false;
+    }
+
+    RecordPageHeader header;
+    header.magic = RECORD_PAGE_MAGIC;
+    header.seq = next_seq++;
+
+    active_page = page;
+    write_offset = (uint32_t)page * FLASH_PAGE_SIZE + sizeof(header);
+    if (!flash->write((uint32_t)page * FLASH_PAGE_SIZE, &header, sizeof(header))) {
+        write_offset = pageEnd();
+        return false;
+    }
+    return true;
+}
+
+bool RecordStore::collectPage(uint16_t page) {
+    uint32_t base = (uint32_t)page * FLASH_PAGE_SIZE;
+    uint8_t data[RECORD_MAX_LENGTH];
+
+    // Copy forward the records nothing newer has replaced
+    for (uint16_t key = 0; key < RECORD_MAX_KEYS; key++) {
+        uint32_t offset = index[key].offset;
+        if (offset >= base && offset < base + FLASH_PAGE_SIZE) {
+            flash->read(offset, data, index[key].length);
+            if (!append(key, data, index[key].length)) {
+                return false;
+            }
+        }
+    }
+
+    collected++;
+    return flash->erasePage(page);
+}
+
+bool RecordStore::rotate() {
+    uint16_t pages = flash->pageCount();
+    uint16_t next = (active_page + 1) % pages;
+
+    if (!openPage(next)) {
+        return false;
+    }
+
+    // Keep the page after the active one erased for the next rotation
+    uint16_t oldest = (next + 1) % pages;
+    if (flash->blank((uint32_t)oldest * FLASH_PAGE_SIZE, FLASH_PAGE_SIZE)) {
+        return true;
+    }
+    return collectPage(oldest);
+}
+
+bool RecordStore::append(uint16_t key, const void* data, uint16_t length) {
+    uint8_t buffer[sizeof(RecordHeader) + RECORD_MAX_LENGTH];
+    uint32_t size = sizeof(RecordHeader) + RECORD_PAD(length);
+
+    if (write_offset + size > pageEnd()) {
+        return false;
+    }
+
+    RecordHeader header;
+    header.key = key;
+    header.length = length;
+    header.crc = recordCrc(key, length, data);
+
+    memset(buffer, 0xFF, size);
+    memcpy(buffer, &header, sizeof(header));
+    if (length) {
+        memcpy(buffer + sizeof(header), data, length);
+    }
+
+    if (!flash->write(write_offset, buffer, size)) {
+        // Part of the record may be programmed; leave the page
+        write_offset = pageEnd();
+        return false;
+    }
+
+    index[key].offset = length ? write_offset + sizeof(RecordHeader) : 0;
+    index[key].length = length;
+    write_offset += size;
+    return true;
+}
+
+bool RecordStore::put(uint16_t key, const void* data, uint16_t length) {
+    if (key >= RECORD_MAX_KEYS || length == 0 || length > RECORD_MAX_LENGTH) {
+        return false;
+    }
+
+    // Rewriting an unchanged value costs no flash
+    if (index[key].offset && index[key].length == length) {
+        uint8_t current[RECORD_MAX_LENGTH];
+        flash->read(index[key].offset, current, length);
+        if (memcmp(current, data, length) == 0) {
+            return true;
+        }
+    }
+
+    uint32_t size = sizeof(RecordHeader) + RECORD_PAD(length);
+    for (uint16_t attempt = 0; attempt < flash->pageCount(); attempt++) {
+        if (write_offset + size <= pageEnd()) {
+            return append(key, data, length);
+        }
+        if (!rotate()) {
+            return false;
+        }
+    }
+    return false;
+}
+
+bool RecordStore::remove(uint16_t key) {
+    if (key >= RECORD_MAX_KEYS) {
+        return false;
+    }
+    if (!index[key].offset) {
+        return true;
+    }
+
+    for (uint16_t attempt = 0; attempt < flash->pageCount(); attempt++) {
+        if (write_offset + sizeof(RecordHeader) <= pageEnd()) {
+            return append(key, NULL, 0);
+        }
+        if (!rotate()) {
+            return false;
+        }
+    }
+    return false;
+}
+
+bool RecordStore::get(uint16_t key, void* data, uint16_t length) const {
+    if (key >= RECORD_MAX_KEYS || !index[key].offset || index[key].length != length) {
+        return false;
+    }
+    flash->read(index[key].offset, data, length);
+    return true;
+}
+
+bool RecordStore::contains(uint16_t key) const {
+    return key < RECORD_MAX_KEYS && index[key].offset != 0;
+}
+
+uint16_t RecordStore::length(uint16_t key) const {
+    return contains(key) ? index[key].length : 0;
+}
+
+uint32_t RecordStore::loadTimeUs() const {
+    return load_time_us;
+}
+
+uint32_t RecordStore::freeBytes() const {
+    return pageEnd() - write_offset;
+}
+
+uint32_t RecordStore::pagesCollected() const {
+    return collected;
+}
+
+uint32_t RecordStore::pageEnd() const {
+    return (uint32_t)(active_page + 1) * FLASH_PAGE_SIZE;
+}
@@ -0,0 +1,209 @@
+// firmware/src/retransmit.cpp
+
+#include "retransmit.h"
+#include <string.h>
+
+void retransmitEncodeAck(uint16_t base, uint32_t bitmap, uint8_t* out) {
+    out[0] = (uint8_t)(base >> 8);
+    out[1] = (uint8_t)base;
+    out[2] = (uint8_t)(bitmap >> 24);
+    out[3] = (uint8_t)(bitmap >> 16);
+    out[4] = (uint8_t)(bitmap >> 8);
+    out[5] = (uint8_t)bitmap;
+}
+
+void retransmitDecodeAck(const uint8_t* in, uint16_t* base, uint32_t* bitmap) {
+    *base = (in[0] << 8) | in[1];
+    *bitmap = ((uint32_t)in[2] << 24) | ((uint32_t)in[3] << 16) | ((uint32_t)in[4] << 8) | in[5];
+}
+
+// Sequence numbers wrap; a is older than b within half the range
+static bool seqBefore(uint16_t a, uint16_t b) {
+    return (int16_t)(a - b) < 0;
+}
+
+void RetransmitBuffer::init() {
+    clear();
+    resetStats();
+}
+
+RetransmitSlot* RetransmitBuffer::oldest() {
+    RetransmitSlot* found = 0;
+    for (uint8_t i = 0; i < RETRANSMIT_DEPTH; i++) {
+        if (slots[i].used && (!found || seqBefore(slots[i].seq, found->seq))) {
+            found = &slots[i];
+        }
+    }
+    return found;
+}
+
+void RetransmitBuffer::store(uint16_t seq, const uint8_t* data, uint8_t length) {
+    if (used == RETRANSMIT_DEPTH) {
+        oldest()->used = false;
+        used--;
+        counters.evicted++;
+    }
+
+    RetransmitSlot* slot = slots;
+    while (slot->used) {
+        slot++;
+    }
+    slot->seq = seq;
+    slot->length = length;
+    slot->used = true;
+    slot->missing = false;
+    slot->probed = false;
+    slot->sends = 1;
+    memcpy(slot->data, data, length);
+    used++;
+    counters.stored++;
+}
+
+uint8_t RetransmitBuffer::acknowledge(uint16_t base, uint32_t bitmap) {
+    counters.acks++;
+
+    // Anything outstanding below the newest packet the central holds is a
+    // hole, not still in flight
+    uint8_t newest = 0;
+    for (uint8_t i = RETRANSMIT_ACK_BITS; i > 0; i--) {
+        if (bitmap & (1UL << (i - 1))) {
+            newest = i;
+            break;
+        }
+    }
+
+    uint8_t acked = 0;
+    for (uint8_t i = 0; i < RETRANSMIT_DEPTH; i++) {
+        RetransmitSlot* slot = &slots[i];
+        if (!slot->used) continue;
+
+        int16_t offset = (int16_t)(slot->seq - base);
+        bool received = offset < 0 ||
+                        (offset >= 1 && offset <= RETRANSMIT_ACK_BITS && (bitmap & (1UL << (offset - 1))));
+        if (received) {
+            slot->used = false;
+            used--;
+            acked++;
+            continue;
+        }
+
+        // A resend may still be on its way: it waits out a whole ack
+        if (slot->probed || (offset < newest && slot->sends == 1)) {
+            slot->missing = true;
+        }
+        slot->probed = true;
+    }
+    counters.acknowledged += acked;
+    return acked;
+}
+
+const RetransmitSlot* RetransmitBuffer::nextMissing() const {
+    const RetransmitSlot* found = 0;
+    for (uint8_t i = 0; i < RETRANSMIT_DEPTH; i++) {
+        if (slots[i].used && slots[i].missing && (!found || seqBefore(slots[i].seq, found->seq))) {
+            found = &slots[i];
+        }
+    }
+    return found;
+}
+
+void RetransmitBuffer::resent(const RetransmitSlot* sent) {
+    RetransmitSlot* slot = &slots[sent - slots];
+    slot->missing = false;
+    slot->probed = false;
+    if (slot->sends < 0xFF) {
+        slot->sends++;
+    }
+    counters.resent++;
+}
+
+uint8_t RetransmitBuffer::count() const {
+    return used;
+}
+
+void RetransmitBuffer::clear() {
+    for (uint8_t i = 0; i < RETRANSMIT_DEPTH; i++) {
+        slots[i].used = false;
+    }
+    used = 0;
+}
+
+const RetransmitStats* RetransmitBuffer::stats() const {
+    return &counters;
+}
+
+void RetransmitBuffer::resetStats() {
+    memset(&counters, 0, sizeof(counters));
+}
+
+void AckWindow::init() {
+    started = false;
+    next = 0;
+    seen = 0;
+    memset(&counters, 0, sizeof(counters));
+}
+
+// next has arrived or been given up: move past it and everything received
+// right after it
+void AckWindow::advance() {
+    bool received;
+    do {
+        received = seen & 1;
+        seen >>= 1;
+        next++;
+    } while (received);
+}
+
+bool AckWindow::receive(uint16_t seq) {
+    if (!started) {
+        started = true;
+        next = seq;
+        seen = 0;
+    }
+
+    int16_t offset = (int16_t)(seq - next);
+    if (offset < 0) {
+        counters.duplicates++;
+        return false;
+    }
+
+    // Too far ahead for the bitmap: the sender has long given up the
+    // oldest gaps
+    while (offset > RETRANSMIT_ACK_BITS) {
+        counters.lost++;
+        advance();
+        offset = (int16_t)(seq - next);
+    }
+
+    if (offset == 0) {
+        if (seen) {
+            counters.recovered++;
+        }
+        advance();
+    } else {
+        uint32_t bit = 1UL << (offset - 1);
+        if (seen & bit) {
+            counters.duplicates++;
+            return false;
+        }
+        seen |= bit;
+    }
+    counters.delivered++;
+    return true;
+}
+
+uint16_t AckWindow::base() const {
+    return next;
+}
+
+uint32_t AckWindow::bitmap() const {
+    return seen;
+}
+
+void AckWindow::encodeAck(uint8_t* out) const {
+    retransmitEncodeAck(next, seen, out);
+}
+
+const AckWindowStats* AckWindow::stats() const {
+    return &counters;
+}
@@ -0,0 +1,262 @@
+// firmware/src/sample_clock.cpp
+
+#include "sample_clock.h"
+#include "adc_driver.h"
+#include "channel_scheduler.h"
+#include "sys_time.h"
+#include <Arduino.h>
+#include <string.h>
+
+#ifdef NRF52
+#include <nrf.h>
+extern "C" {
+#include "nrf_soc.h"
+}
+
+// RTC0 belongs to the SoftDevice and RTC1 to the RTOS tick
+#define CLOCK_RTC               NRF_RTC2
+#define CLOCK_RTC_IRQn          RTC2_IRQn
+#define CAPTURE_TIMER           NRF_TIMER3
+
+// Application PPI channels (the SoftDevice reserves the upper ones)
+#define PPI_CH_SAMPLE           0
+#define PPI_CH_CAPTURE          1
+
+#define RTC_COUNTER_MASK        0x00FFFFFF
+#define RTC_MIN_LEAD_TICKS      2       // CC must lead COUNTER by 2 ticks
+
+static SampleClock* rtc_owner = 0;
+
+extern "C" void RTC2_IRQHandler(void) {
+    if (CLOCK_RTC->EVENTS_COMPARE[0]) {
+        CLOCK_RTC->EVENTS_COMPARE[0] = 0;
+        if (rtc_owner) {
+            rtc_owner->onCompare();
+        }
+    }
+}
+#endif
+
+void jitterRecord(JitterHistogram* histogram, int32_t deviation_us) {
+    if (histogram->count == 0 || deviation_us < histogram->min_us) {
+        histogram->min_us = deviation_us;
+    }
+    if (histogram->count == 0 || deviation_us > histogram->max_us) {
+        histogram->max_us = deviation_us;
+    }
+    histogram->count++;
+
+    // Floor division so small negative deviations land below zero
+    int32_t offset = deviation_us + (JITTER_BINS / 2) * (int32_t)histogram->bin_us;
+    if (offset < 0) {
+        histogram->underflow++;
+        return;
+    }
+    int32_t bin = offset / histogram->bin_us;
+    if (bin >= JITTER_BINS) {
+        histogram->overflow++;
+        return;
+    }
+    histogram->bins[bin]++;
+}
+
+uint64_t SampleClock::msToTicks(uint32_t ms) {
+    return ((uint64_t)ms * SAMPLE_CLOCK_HZ) / 1000;
+}
+
+uint32_t SampleClock::ticksToMs(uint64_t ticks) {
+    return (uint32_t)((ticks * 1000) / SAMPLE_CLOCK_HZ);
+}
+
+void SampleClock::init(AdcDriver* driver) {
+    adc = driver;
+    schedule = 0;
+    running = false;
+    interval_ms = 0;
+    fired_tick = 0;
+    triggers = 0;
+    missed = 0;
+    resetJitter(JITTER_BIN_US);
+}
+
+void SampleClock::resetJitter(uint16_t bin_us) {
+    memset(&histogram, 0, sizeof(histogram));
+    histogram.bin_us = bin_us ? bin_us : 1;
+}
+
+void SampleClock::start(uint16_t ms) {
+    if (ms == 0) return;
+    if (running) stop();
+
+    interval_ms = ms;
+    nominal_us = (uint32_t)ms * 1000;
+    tick_remainder = 0;
+
+    // Keep timestamps on the millis() epoch across restarts
+    base_tick = msToTicks(sysMillis());
+    start_us = sysMicros();
+    next_tick = base_tick;
+    advance();
+    next_index = 0;
+
+    // Every channel is due on tick 0
+    selectChannels();
+    adc->start();
+    adc->setTriggerClock(this);
+
+#ifdef NRF52
+    rtc_owner = this;
+
+    CAPTURE_TIMER->TASKS_STOP = 1;
+    CAPTURE_TIMER->MODE = TIMER_MODE_MODE_Timer;
+    CAPTURE_TIMER->BITMODE = TIMER_BITMODE_BITMODE_32Bit;
+    CAPTURE_TIMER->PRESCALER = 4;                   // 16 MHz / 2^4 = 1 MHz
+    CAPTURE_TIMER->TASKS_CLEAR = 1;
+
+    CLOCK_RTC->TASKS_STOP = 1;
+    CLOCK_RTC->TASKS_CLEAR = 1;
+    CLOCK_RTC->PRESCALER = 0;
+    CLOCK_RTC->CC[0] = (uint32_t)(next_tick - base_tick) & RTC_COUNTER_MASK;
+    CLOCK_RTC->EVENTS_COMPARE[0] = 0;
+    CLOCK_RTC->EVTENSET = RTC_EVTENSET_COMPARE0_Msk;   // Route to PPI
+    CLOCK_RTC->INTENSET = RTC_INTENSET_COMPARE0_Msk;
+
+    // COMPARE0 -> SAADC SAMPLE, and the same event -> TIMER3 capture
+    sd_ppi_channel_assign(PPI_CH_SAMPLE, &CLOCK_RTC->EVENTS_COMPARE[0],
+                          &NRF_SAADC->TASKS_SAMPLE);
+    sd_ppi_channel_assign(PPI_CH_CAPTURE, &CLOCK_RTC->EVENTS_COMPARE[0],
+                          &CAPTURE_TIMER->TASKS_CAPTURE[0]);
+    sd_ppi_channel_enable_set((1 << PPI_CH_SAMPLE) | (1 << PPI_CH_CAPTURE));
+
+    // Above the SAADC so a frame always sees its own trigger tick
+    NVIC_SetPriority(CLOCK_RTC_IRQn, 2);
+    NVIC_ClearPendingIRQ(CLOCK_RTC_IRQn);
+    NVIC_EnableIRQ(CLOCK_RTC_IRQn);
+
+    CAPTURE_TIMER->TASKS_START = 1;
+    CLOCK_RTC->TASKS_START = 1;
+#endif
+
+    running = true;
+}
+
+void SampleClock::stop() {
+    if (!running) return;
+
+#ifdef NRF52
+    sd_ppi_channel_enable_clr((1 << PPI_CH_SAMPLE) | (1 << PPI_CH_CAPTURE));
+    NVIC_DisableIRQ(CLOCK_RTC_IRQn);
+    CLOCK_RTC->INTENCLR = RTC_INTENCLR_COMPARE0_Msk;
+    CLOCK_RTC->EVTENCLR = RTC_EVTENCLR_COMPARE0_Msk;
+    CLOCK_RTC->TASKS_STOP = 1;
+    CAPTURE_TIMER->TASKS_STOP = 1;
+    CAPTURE_TIMER->TASKS_SHUTDOWN = 1;
+    rtc_owner = 0;
+#endif
+
+    adc->setTriggerClock(0);
+    if (schedule) {
+        adc->setScanMask(ADC_ALL_CHANNELS);
+    }
+    running = false;
+}
+
+void SampleClock::setScheduler(const ChannelScheduler* channel_schedule) {
+    schedule = channel_schedule;
+    if (!schedule) {
+        adc->setScanMask(ADC_ALL_CHANNELS);
+    }
+}
+
+void SampleClock::selectChannels() {
+    if (schedule) {
+        adc->setScanMask(schedule->dueMask(next_index));
+    }
+}
+
+bool SampleClock::isRunning() const {
+    return running;
+}
+
+void SampleClock::advance() {
+    // interval_ms * 32.768 ticks, carrying the fraction so the average
+    // period is exact
+    uint32_t scaled = (uint32_t)interval_ms * SAMPLE_CLOCK_HZ + tick_remainder;
+    next_tick += scaled / 1000;
+    tick_remainder = scaled % 1000;
+    next_index++;
+}
+
+void SampleClock::recordPeriod(uint32_t capture_us) {
+    if (triggers > 1) {
+        int32_t period_us = (int32_t)(capture_us - last_capture_us);
+        jitterRecord(&histogram, period_us - (int32_t)nominal_us);
+    }
+    last_capture_us = capture_us;
+}
+
+void SampleClock::onCompare() {
+    fired_tick = next_tick;
+    triggers++;
+
+#ifdef NRF52
+    recordPeriod(CAPTURE_TIMER->CC[0]);
+
+    advance();
+
+    // If this interrupt was held off past the next compare, skip ahead
+    uint32_t counter = CLOCK_RTC->COUNTER;
+    for (;;) {
+        uint32_t cc = (uint32_t)(next_tick - base_tick) & RTC_COUNTER_MASK;
+        uint32_t lead = (cc - counter) & RTC_COUNTER_MASK;
+        if (lead >= RTC_MIN_LEAD_TICKS && lead <= RTC_COUNTER_MASK / 2) {
+            CLOCK_RTC->CC[0] = cc;
+            break;
+        }
+        missed++;
+        advance();
+    }
+
+    // Lands on the scan after the one this compare just started
+    selectChannels();
+#else
+    recordPeriod(sysMicros());
+    selectChannels();
+    advance();
+    adc->onExternalTrigger();
+#endif
+}
+
+void SampleClock::service() {
+#ifndef NRF52
+    if (!running) return;
+
+    uint64_t now_tick = base_tick + ((uint64_t)(sysMicros() - start_us) * SAMPLE_CLOCK_HZ) / 1000000;
+    if (now_tick < next_tick) return;
+
+    onCompare();
+
+    // Triggers that fell entirely behind the loop are lost, as they were
+    // with millis() polling
+    while (next_tick <= now_tick) {
+        missed++;
+        advance();
+    }
+#endif
+}
+
+uint64_t SampleClock::triggerTick() const {
+    return fired_tick;
+}
+
+uint32_t SampleClock::triggerCount() const {
+    return triggers;
+}
+
+uint32_t SampleClock::missedTriggers() const {
+    return missed;
+}
+
+const JitterHistogram* SampleClock::jitter() const {
+    return &histogram;
+}
@@ -0,0 +1,364 @@
+// firmware/src/sample_log.cpp
+
+#include "sample_log.h"
+#include "crc32.h"
+#include <stddef.h>
+#include <string.h>
+
+#define LOG_PAD(len)        (((uint32_t)(len) + FLASH_WORD_SIZE - 1) & ~(uint32_t)(FLASH_WORD_SIZE - 1))
+#define LOG_BLOCK_SIZE_MAX  (sizeof(LogBlockHeader) + LOG_PAD(LOG_BLOCK_MAX))
+
+enum {
+    CURSOR_IDLE,
+    CURSOR_READING,
+    CURSOR_END,
+};
+
+static uint32_t blockCrc(const LogBlockHeader* header, const uint8_t* data) {
+    uint32_t crc = crc32(0, header, offsetof(LogBlockHeader, crc));
+    return crc32(crc, data, header->length);
+}
+
+static bool headerErased(const LogBlockHeader* header) {
+    return header->first == 0xFFFFFFFFUL && header->length == 0xFFFF && header->crc == 0xFFFFFFFFUL;
+}
+
+static bool headerValid(const LogBlockHeader* header) {
+    return header->length > 0 && header->length <= LOG_BLOCK_MAX && header->count > 0;
+}
+
+bool SampleLog::init(FlashDevice* device, uint32_t acked_seq) {
+    flash = device;
+    codec.init();
+    memset(&counters, 0, sizeof(counters));
+    next_seq = acked_seq;
+    acked = acked_seq;
+    next_page_seq = 1;
+    block_length = 0;
+    block_count = 0;
+    block_started = 0;
+    cursor_state = CURSOR_IDLE;
+
+    pages = flash->pageCount();
+    if (pages < 2 || pages > LOG_MAX_PAGES) {
+        pages = 0;
+        return false;
+    }
+
+    // Page sequence 0 marks a page holding no log
+    bool found = false;
+    for (uint16_t p = 0; p < pages; p++) {
+        LogPageHeader header;
+        flash->read((uint32_t)p * FLASH_PAGE_SIZE, &header, sizeof(header));
+        page_seq[p] = 0;
+        page_first[p] = 0;
+        page_end[p] = 0;
+        if (header.magic != LOG_PAGE_MAGIC || header.seq == 0 || header.seq == 0xFFFFFFFFUL) {
+            continue;
+        }
+        page_seq[p] = header.seq;
+        if (!found || header.seq >= next_page_seq) {
+            active_page = p;
+            next_page_seq = header.seq + 1;
+            found = true;
+        }
+    }
+
+    if (!found) {
+        // Blank or foreign region: start a fresh log
+        bool ok = true;
+        for (uint16_t p = 0; p < pages; p++) {
+            ok = flash->ensureErased(p) && ok;
+        }
+        return openPage(0) && ok;
+    }
+
+    for (uint16_t p = 0; p < pages; p++) {
+        if (page_seq[p]) {
+            scanPage(p);
+            if (page_end[p] > next_seq) {
+                next_seq = page_end[p];
+            }
+        }
+    }
+    if (acked > next_seq) {
+        acked = next_seq;
+    }
+    return true;
+}
+
+void SampleLog::scanPage(uint16_t page) {
+    uint32_t offset = (uint32_t)page * FLASH_PAGE_SIZE + sizeof(LogPageHeader);
+    uint32_t end = (uint32_t)(page + 1) * FLASH_PAGE_SIZE;
+    uint8_t data[LOG_BLOCK_MAX];
+    bool any = false;
+
+    while (offset + sizeof(LogBlockHeader) <= end) {
+        LogBlockHeader header;
+        flash->read(offset, &header, sizeof(header));
+        if (headerErased(&header)) {
+            break;      // End of the log in this page
+        }
+
+        uint32_t size = sizeof(LogBlockHeader) + LOG_PAD(header.length);
+        if (!headerValid(&header) || offset + size > end) {
+            // Torn header: nothing after it can be located
+            offset = end;
+            break;
+        }
+
+        if (readBlock(offset, &header, data)) {
+            if (!any) {
+                page_first[page] = header.first;
+                any = true;
+            }
+            page_end[page] = header.first + header.count;
+        } else {
+            counters.corrupt++;
+        }
+        offset += size;
+    }
+
+    if (!any) {
+        page_first[page] = page_end[page] = 0;
+    }
+    if (page != active_page) {
+        return;
+    }
+
+    // A write cut short can leave programmed words past the last header;
+    // never program over them
+    write_offset = flash->blank(offset, end - offset) ? offset : end;
+}
+
+bool SampleLog::openPage(uint16_t page) {
+    // Wrapping: whatever the central never acknowledged here is lost
+    if (page_seq[page] && page_end[page] > page_first[page] && page_end[page] > acked) {
+        uint32_t from = (page_first[page] > acked) ? page_first[page] : acked;
+        counters.overwritten += page_end[page] - from;
+    }
+    page_seq[page] = 0;
+    page_first[page] = page_end[page] = 0;
+
+    uint32_t base = (uint32_t)page * FLASH_PAGE_SIZE;
+    active_page = page;
+    write_offset = base + FLASH_PAGE_SIZE;
+    if (!flash->ensureErased(page)) {
+        return false;
+    }
+
+    LogPageHeader header;
+    header.magic = LOG_PAGE_MAGIC;
+    header.seq = next_page_seq++;
+    if (!flash->write(base, &header, sizeof(header))) {
+        return false;
+    }
+    page_seq[page] = header.seq;
+    write_offset = base + sizeof(header);
+    return true;
+}
+
+bool SampleLog::readBlock(uint32_t offset, LogBlockHeader* header, uint8_t* data) {
+    flash->read(offset, header, sizeof(*header));
+    if (!headerValid(header)) {
+        return false;
+    }
+    flash->read(offset + sizeof(*header), data, header->length);
+    return blockCrc(header, data) == header->crc;
+}
+
+bool SampleLog::nextPage(uint16_t page, uint16_t* next) const {
+    // Pages are opened in ring order, so the following page continues the
+    // log only if it was opened straight after this one
+    uint16_t after = (page + 1) % pages;
+    if (page_seq[after] != page_seq[page] + 1) {
+        return false;
+    }
+    *next = after;
+    return true;
+}
+
+bool SampleLog::append(const SensorReading* reading, uint8_t mask, uint32_t now) {
+    if (pages == 0) return false;
+
+    uint8_t buffer[CODEC_MAX_SIZE];
+    uint8_t length = codec.encode(reading, mask, buffer);
+    if (block_length + length > LOG_BLOCK_MAX && !flush()) {
+        return false;
+    }
+
+    if (block_count == 0) {
+        block_started = now;
+    }
+    memcpy(block + block_length, buffer, length);
+    block_length += length;
+    block_count++;
+    next_seq++;
+    counters.appended++;
+    return true;
+}
+
+bool SampleLog::flush() {
+    if (block_count == 0) return true;
+    if (pages == 0) return false;
+
+    uint32_t size = sizeof(LogBlockHeader) + LOG_PAD(block_length);
+    uint32_t page_end_offset = (uint32_t)(active_page + 1) * FLASH_PAGE_SIZE;
+    if (write_offset + size > page_end_offset) {
+        if (!openPage((active_page + 1) % pages)) {
+            return false;
+        }
+    }
+
+    LogBlockHeader header;
+    header.first = next_seq - block_count;
+    header.length = block_length;
+    header.count = block_count;
+    header.reserved = 0xFF;
+    header.crc = blockCrc(&header, block);
+
+    uint8_t buffer[LOG_BLOCK_SIZE_MAX];
+    memset(buffer, 0xFF, size);
+    memcpy(buffer, &header, sizeof(header));
+    memcpy(buffer + sizeof(header), block, block_length);
+
+    if (!flash->write(write_offset, buffer, size)) {
+        // Part of the block may be programmed; the next one goes to a new page
+        write_offset = (uint32_t)(active_page + 1) * FLASH_PAGE_SIZE;
+        return false;
+    }
+
+    if (page_end[active_page] == page_first[active_page]) {
+        page_first[active_page] = header.first;
+    }
+    page_end[active_page] = header.first + header.count;
+    write_offset += size;
+    counters.blocks++;
+    counters.flash_bytes += size;
+    block_length = 0;
+    block_count = 0;
+    return true;
+}
+
+bool SampleLog::due(uint32_t now) const {
+    return block_count > 0 && now - block_started >= LOG_FLUSH_MS;
+}
+
+uint32_t SampleLog::nextSeq() const {
+    return next_seq;
+}
+
+uint32_t SampleLog::oldestSeq() const {
+    // The page after the active one is the oldest still holding data
+    for (uint16_t i = 1; i <= pages; i++) {
+        uint16_t p = (active_page + i) % pages;
+        if (page_seq[p] && page_end[p] > page_first[p]) {
+            return page_first[p];
+        }
+    }
+    return next_seq - block_count;
+}
+
+void SampleLog::acknowledge(uint32_t seq) {
+    acked = (seq < next_seq) ? seq : next_seq;
+}
+
+uint32_t SampleLog::acknowledged() const {
+    return acked;
+}
+
+uint32_t SampleLog::pending() const {
+    uint32_t oldest = oldestSeq();
+    return next_seq - ((acked > oldest) ? acked : oldest);
+}
+
+void SampleLog::seek(uint32_t seq) {
+    if (pages == 0) return;
+
+    // The last page starting at or before seq, else the oldest
+    bool found = false;
+    for (uint16_t i = 1; i <= pages; i++) {
+        uint16_t p = (active_page + i) % pages;
+        if (!page_seq[p] || page_end[p] == page_first[p]) {
+            continue;
+        }
+        if (!found || page_first[p] <= seq) {
+            cursor_page = p;
+            found = true;
+        }
+    }
+    if (!found) {
+        cursor_page = active_page;
+    }
+
+    cursor_page_seq = page_seq[cursor_page];
+    cursor_offset = (uint32_t)cursor_page * FLASH_PAGE_SIZE + sizeof(LogPageHeader);
+    cursor_seq = seq;
+    cursor_state = CURSOR_READING;
+}
+
+uint16_t SampleLog::readPacket(uint8_t* out, uint16_t* readings) {
+    *readings = 0;
+    if (cursor_state == CURSOR_IDLE) {
+        return 0;
+    }
+
+    while (cursor_state == CURSOR_READING) {
+        // The wrap erased the page under the cursor; find the reading again
+        if (page_seq[cursor_page] != cursor_page_seq) {
+            seek(cursor_seq);
+        }
+
+        uint32_t end = (uint32_t)(cursor_page + 1) * FLASH_PAGE_SIZE;
+        if (cursor_page == active_page && write_offset < end) {
+            end = write_offset;
+        }
+
+        LogBlockHeader header;
+        if (cursor_offset + sizeof(header) <= end) {
+            flash->read(cursor_offset, &header, sizeof(header));
+            if (headerErased(&header) || !headerValid(&header)) {
+                cursor_offset = end;
+                continue;
+            }
+            bool ok = readBlock(cursor_offset, &header, out + LOG_PACKET_HEADER);
+            cursor_offset += sizeof(header) + LOG_PAD(header.length);
+
+            // Corrupt blocks and those the central already has are skipped
+            if (!ok || header.first + header.count <= cursor_seq) {
+                continue;
+            }
+            out[0] = (uint8_t)header.first;
+            out[1] = (uint8_t)(header.first >> 8);
+            out[2] = (uint8_t)(header.first >> 16);
+            out[3] = (uint8_t)(header.first >> 24);
+            *readings = header.count;
+            cursor_seq = header.first + header.count;
+            counters.synced += header.count;
+            return LOG_PACKET_HEADER + header.length;
+        }
+
+        // On to the page opened after this one, if any
+        uint16_t next;
+        if (cursor_page != active_page && nextPage(cursor_page, &next)) {
+            cursor_page = next;
+            cursor_page_seq = page_seq[next];
+            cursor_offset = (uint32_t)next * FLASH_PAGE_SIZE + sizeof(LogPageHeader);
+            continue;
+        }
+        cursor_state = CURSOR_END;
+    }
+
+    // End marker: the number after the last reading in flash
+    uint32_t end_seq = next_seq - block_count;
+    out[0] = (uint8_t)end_seq;
+    out[1] = (uint8_t)(end_seq >> 8);
+    out[2] = (uint8_t)(end_seq >> 16);
+    out[3] = (uint8_t)(end_seq >> 24);
+    cursor_state = CURSOR_IDLE;
+    return LOG_PACKET_HEADER;
+}
+
+const SampleLogStats* SampleLog::stats() const {
+    return &counters;
+}
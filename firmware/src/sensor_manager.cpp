@@ -1,7 +1,13 @@
 // firmware/src/sensor_manager.cpp
 
 #include "sensor_manager.h"
+#include "conversion_kernels.h"
+#include "baseline_tracker.h"
+#include "calibration_lut.h"
+#include "sys_time.h"
 #include <Arduino.h>
+#include <float.h>
+#include <string.h>
 
 // ADC channel assignments
 #define ADC_CHANNEL_SEROTONIN   0
@@ -22,9 +28,30 @@ static float calibration_gain[6] = {1.0f, 1.0f, 1.0f, 1.0f, 1.0f, 1.0f};
 
 // Baseline drift tracking
 static float baseline_values[6] = {0.0f, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f};
-static uint32_t last_baseline_update_ms = 0;
 #define BASELINE_UPDATE_INTERVAL_MS 60000
 
+// Default channel periods: temperature, pH and calprotectin move over
+// minutes, the neurotransmitter channels every sampling interval
+#define PH_PERIOD_MS            5000
+#define TEMP_PERIOD_MS          10000
+#define CALPROTECTIN_PERIOD_MS  60000
+
+// Calibration and self-test procedures
+#define CAL_SETTLE_MS               5000    // Solution stabilisation
+#define CAL_ZERO_SCANS              50
+#define CAL_SCAN_SPACING_US         10000
+#define SELF_TEST_NOISE_SCANS       20
+#define SELF_TEST_SCAN_SPACING_US   100
+#define PROCEDURE_MAX_SCAN_FAILURES 3
+#define PROCEDURE_PROGRESS_STEP     10      // Percent between notifications
+
+enum {
+    PHASE_SETTLE,       // Calibrate: waiting for the blank solution to settle
+    PHASE_ZERO,         // Calibrate: averaging zero-point scans
+    PHASE_RESPONSE,     // Self-test: rail and temperature checks on one scan
+    PHASE_NOISE,        // Self-test: peak-to-peak noise over several scans
+};
+
 // Conversion factors for each analyte
 #define SEROTONIN_MV_TO_NM      3.03f    // mV to nanomolar
 #define DOPAMINE_MV_TO_NM       1.52f
@@ -33,204 +60,699 @@ static uint32_t last_baseline_update_ms = 0;
 #define TEMP_MV_PER_C           10.0f    // Typical for LM35-style sensor
 #define CALPROTECTIN_MV_TO_UG   0.015f
 
+// Per-channel unit conversion: units = zero + per_mv * corrected_mv
+static const float units_per_mv[6] = {
+    SEROTONIN_MV_TO_NM, DOPAMINE_MV_TO_NM, GABA_MV_TO_NM,
+    1.0f / PH_MV_PER_PH, 1.0f / TEMP_MV_PER_C, CALPROTECTIN_MV_TO_UG
+};
+static const float units_at_zero[6] = {0.0f, 0.0f, 0.0f, 7.0f, 0.0f, 0.0f};  // pH 7 is zero-point
+static const float channel_min[6] = {
+    SEROTONIN_MIN_NM, DOPAMINE_MIN_NM, GABA_MIN_NM, -FLT_MAX, -FLT_MAX, 0.0f
+};
+static const float channel_max[6] = {
+    SEROTONIN_MAX_NM, DOPAMINE_MAX_NM, GABA_MAX_NM, FLT_MAX, FLT_MAX, FLT_MAX
+};
+
+// Sensitivity temperature coefficients (fraction per degree C), removed
+// from the response by the table conversion
+#define TEMPCO_AMPEROMETRIC     0.02f       // Enzyme/redox kinetics
+#define TEMPCO_NERNST           0.003354f   // Slope ~ T(K): 1/298.15 K
+#define TEMPCO_IMPEDANCE        0.01f
+
+// Multi-point calibration: standards per channel and the tables built from them
+static CalPoint cal_points[6][CAL_LUT_MAX_POINTS];
+static uint8_t cal_point_count[6] = {0, 0, 0, 0, 0, 0};
+static float temp_coeff[6] = {
+    TEMPCO_AMPEROMETRIC, TEMPCO_AMPEROMETRIC, TEMPCO_AMPEROMETRIC,
+    TEMPCO_NERNST, 0.0f, TEMPCO_IMPEDANCE
+};
+static ChannelLut channel_lut[6];
+static FixedChannelLut channel_lut_fixed[6];
+static uint8_t lut_channels = 0;    // Bit n set: channel An converts through its table
+#define CAL_POINT_NONE  0xFF
+
+// Flash record of one channel's standards
+typedef struct {
+    uint8_t count;
+    uint8_t reserved[3];
+    CalPoint points[CAL_LUT_MAX_POINTS];
+} CalPointsRecord;
+
+// Fused raw-count kernels, rebuilt when calibration or baseline changes
+static ChannelTransform channel_transform[6];
+static FixedChannelTransform channel_fixed[6];
+
+// Fed from every frame of the normal stream, never from extra scans
+static BaselineTracker baseline_tracker;
+
 void SensorManager::init() {
     configureADC();
     
     // Allow sensors to stabilize
-    delay(100);
+    sysDelay(100);
     
     // Initialize baseline values
     for (int i = 0; i < 6; i++) {
         baseline_values[i] = 0.0f;
     }
-    last_baseline_update_ms = millis();
-    
-    // Perform initial baseline reading
-    baselineDriftCorrection();
+    baseline_tracker.init(BASELINE_UPDATE_INTERVAL_MS, false);
+    baseline_tracker.reset(sysMillis());
+    rebuildTransforms();
 }
 
 void SensorManager::configureADC() {
-    // Configure ADC for 12-bit resolution
-    analogReadResolution(ADC_RESOLUTION_BITS);
+    // Scan of A0..A5 into double-buffered EasyDMA frames
+    adc.init();
+    adc.start();
+    clock.init(&adc);
+    sampling_interval_ms = 0;
     
-    // Set reference voltage to internal 3.3V
-    analogReference(AR_INTERNAL);
+    // Sampling interval is the scheduler's base tick
+    for (int i = 0; i < 6; i++) {
+        channel_period_ms[i] = 0;
+        held_raw[i] = 0;
+    }
+    channel_period_ms[ADC_CHANNEL_PH] = PH_PERIOD_MS;
+    channel_period_ms[ADC_CHANNEL_TEMP] = TEMP_PERIOD_MS;
+    channel_period_ms[ADC_CHANNEL_CALPROTECTIN] = CALPROTECTIN_PERIOD_MS;
+    schedule.init(1000);
+    for (uint8_t i = 0; i < 6; i++) {
+        schedule.setPeriod(i, channel_period_ms[i]);
+    }
+    clock.setScheduler(&schedule);
+    reading_mask = ADC_ALL_CHANNELS;
+    procedure = PROCEDURE_NONE;
+    resume_clock = false;
+    point_channel = CAL_POINT_NONE;
+    store = NULL;
+    memset(&status, 0, sizeof(status));
+}
+
+void SensorManager::rebuildTransforms() {
+    const float mv_per_count = ADC_REF_VOLTAGE_MV / (float)ADC_MAX_VALUE;
     
-    // Configure analog input pins
-    pinMode(A0, INPUT);  // Serotonin
-    pinMode(A1, INPUT);  // Dopamine
-    pinMode(A2, INPUT);  // GABA
-    pinMode(A3, INPUT);  // pH
-    pinMode(A4, INPUT);  // Temperature
-    pinMode(A5, INPUT);  // Calprotectin
+    // corrected = (mv - offset) * gain - baseline, then per-analyte units
+    for (int i = 0; i < 6; i++) {
+        buildChannelTransform(&channel_transform[i], mv_per_count,
+                              units_per_mv[i], units_at_zero[i],
+                              calibration_offset[i], calibration_gain[i], baseline_values[i],
+                              channel_min[i], channel_max[i]);
+        buildFixedTransform(&channel_fixed[i], &channel_transform[i]);
+        
+        // Channels with two or more standards use the multi-point table
+        lut_channels &= ~(1 << i);
+        if (cal_point_count[i] >= 2 &&
+            buildChannelLut(&channel_lut[i], cal_points[i], cal_point_count[i],
+                            mv_per_count, baseline_values[i], units_at_zero[i],
+                            temp_coeff[i], channel_min[i], channel_max[i])) {
+            buildFixedLut(&channel_lut_fixed[i], &channel_lut[i]);
+            lut_channels |= (1 << i);
+        }
+    }
 }
 
-float SensorManager::applyCalibration(uint16_t raw_value, uint8_t channel) {
-    if (channel >= 6) return 0.0f;
+void SensorManager::baselineDriftCorrection(const AdcFrame* frame) {
+    // A few multiply-adds per channel; the estimate only moves, and the
+    // kernels are only rebuilt, when a window closes
+    const float mv_per_count = ADC_REF_VOLTAGE_MV / (float)ADC_MAX_VALUE;
+    float mv[6];
+    for (int i = 0; i < 6; i++) {
+        mv[i] = frame->raw[i] * mv_per_count;
+    }
+    if (!baseline_tracker.addSample(mv, frame->timestamp_ms)) {
+        return;
+    }
     
-    // Convert raw ADC to millivolts
-    float voltage_mv = (raw_value * ADC_REF_VOLTAGE_MV) / (float)ADC_MAX_VALUE;
+    for (int i = 0; i < 6; i++) {
+        baseline_values[i] = baseline_tracker.baseline(i);
+    }
+    rebuildTransforms();
+}
+
+void SensorManager::setBaselineWindow(uint32_t window_ms) {
+    baseline_tracker.setWindow(window_ms);
+}
+
+void SensorManager::setDriftFit(bool enabled) {
+    baseline_tracker.setDriftFit(enabled);
+}
+
+float SensorManager::baselineDrift(uint8_t channel) const {
+    return baseline_tracker.driftPerMinute(channel);
+}
+
+void SensorManager::holdAbsentChannels(AdcFrame* frame) {
+    // Channels skipped this tick carry their last conversion, so the
+    // baseline and the kernels always see a full frame
+    for (int i = 0; i < 6; i++) {
+        if (frame->mask & (1 << i)) {
+            held_raw[i] = frame->raw[i];
+        } else {
+            frame->raw[i] = held_raw[i];
+        }
+    }
+    reading_mask = frame->mask;
+}
+
+SensorReading SensorManager::readAnalytes() {
+    // One scan converts all six channels back to back; under the sample
+    // clock, take the next clocked frame instead
+    AdcFrame frame;
+    if (!adc.acquire(&frame) && !adc.fetch(&frame)) {
+        memset(&frame, 0, sizeof(frame));
+        frame.timestamp_ms = sysMillis();
+        frame.mask = ADC_ALL_CHANNELS;
+    }
+    holdAbsentChannels(&frame);
+    
+    // Update baseline if needed
+    baselineDriftCorrection(&frame);
     
-    // Apply calibration: corrected = (raw - offset) * gain
-    float corrected = (voltage_mv - calibration_offset[channel]) * calibration_gain[channel];
+    SensorReading reading = convertRaw(frame.raw);
     
-    // Apply baseline drift correction
-    corrected -= baseline_values[channel];
+    // Timestamp of the trigger, not of the conversion
+    reading.timestamp_ms = frame.timestamp_ms;
     
-    return corrected;
+    return reading;
+}
+
+bool SensorManager::requestReading() {
+    return adc.trigger();
 }
 
-void SensorManager::baselineDriftCorrection() {
-    uint32_t current_time = millis();
+bool SensorManager::takeReading(SensorReading* reading) {
+    // Frames belong to a running procedure once it has claimed the ADC
+    if (procedure != PROCEDURE_NONE && procedure_phase != PHASE_SETTLE) {
+        return false;
+    }
     
-    // Update baseline periodically
-    if (current_time - last_baseline_update_ms < BASELINE_UPDATE_INTERVAL_MS) {
-        return;
+    AdcFrame frame;
+    if (!adc.fetch(&frame)) {
+        return false;
     }
+    holdAbsentChannels(&frame);
     
-    // Take multiple readings and average for stable baseline
-    const int num_samples = 10;
-    float sample_sum[6] = {0.0f, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f};
+    baselineDriftCorrection(&frame);
     
-    for (int i = 0; i < num_samples; i++) {
-        sample_sum[0] += analogRead(A0);
-        sample_sum[1] += analogRead(A1);
-        sample_sum[2] += analogRead(A2);
-        sample_sum[3] += analogRead(A3);
-        sample_sum[4] += analogRead(A4);
-        sample_sum[5] += analogRead(A5);
-        delay(1);
-    }
+    *reading = convertRaw(frame.raw);
+    reading->timestamp_ms = frame.timestamp_ms;
+    return true;
+}
+
+void SensorManager::startSampling(uint16_t interval_ms) {
+    sampling_interval_ms = interval_ms;
+    schedule.setBasePeriod(interval_ms);
     
-    // Apply exponential moving average for smooth baseline tracking
-    const float alpha = 0.1f;
-    for (int i = 0; i < 6; i++) {
-        float avg_mv = ((sample_sum[i] / num_samples) * ADC_REF_VOLTAGE_MV) / ADC_MAX_VALUE;
-        baseline_values[i] = (alpha * avg_mv) + ((1.0f - alpha) * baseline_values[i]);
+    // A procedure holding the ADC restarts the clock when it finishes
+    if (procedure != PROCEDURE_NONE && procedure_phase != PHASE_SETTLE) {
+        resume_clock = true;
+        return;
     }
-    
-    last_baseline_update_ms = current_time;
+    clock.start(interval_ms);
 }
 
-SensorReading SensorManager::readAnalytes() {
+void SensorManager::service() {
+    clock.service();
+}
+
+void SensorManager::stopAcquisition() {
+    resume_clock = false;
+    clock.stop();
+    adc.stop();
+}
+
+const JitterHistogram* SensorManager::samplingJitter() const {
+    return clock.jitter();
+}
+
+void SensorManager::setChannelPeriod(uint8_t channel, uint16_t period_ms) {
+    if (channel >= 6) {
+        return;
+    }
+    channel_period_ms[channel] = period_ms;
+    schedule.setPeriod(channel, period_ms);
+    if (store) {
+        store->put(RECORD_KEY_CHANNEL_PERIODS, channel_period_ms, sizeof(channel_period_ms));
+    }
+}
+
+uint32_t SensorManager::channelPeriod(uint8_t channel) const {
+    return schedule.period(channel);
+}
+
+uint8_t SensorManager::readingMask() const {
+    return reading_mask;
+}
+
+const uint16_t* SensorManager::rawCounts() const {
+    return held_raw;
+}
+
+const ChannelScheduler* SensorManager::channelSchedule() const {
+    return &schedule;
+}
+
+AdcDriver& SensorManager::adcDriver() {
+    return adc;
+}
+
+// Procedures trigger their own scans, so the clock pauses
+bool SensorManager::pauseClock() {
+    bool was_running = clock.isRunning();
+    clock.stop();
+    return was_running;
+}
+
+void SensorManager::resumeClock(bool was_running) {
+    if (was_running) {
+        clock.start(sampling_interval_ms);
+    }
+}
+
+SensorReading SensorManager::convertRaw(const uint16_t* raw) {
     SensorReading reading;
+    float units[6];
     
-    // Update baseline if needed
-    baselineDriftCorrection();
-    
-    // Read and calibrate each channel
-    uint16_t raw_serotonin = analogRead(A0);
-    uint16_t raw_dopamine = analogRead(A1);
-    uint16_t raw_gaba = analogRead(A2);
-    uint16_t raw_ph = analogRead(A3);
-    uint16_t raw_temp = analogRead(A4);
-    uint16_t raw_calprotectin = analogRead(A5);
-    
-    // Apply calibration and convert to final units
-    float serotonin_mv = applyCalibration(raw_serotonin, ADC_CHANNEL_SEROTONIN);
-    float dopamine_mv = applyCalibration(raw_dopamine, ADC_CHANNEL_DOPAMINE);
-    float gaba_mv = applyCalibration(raw_gaba, ADC_CHANNEL_GABA);
-    float ph_mv = applyCalibration(raw_ph, ADC_CHANNEL_PH);
-    float temp_mv = applyCalibration(raw_temp, ADC_CHANNEL_TEMP);
-    float calprotectin_mv = applyCalibration(raw_calprotectin, ADC_CHANNEL_CALPROTECTIN);
-    
-    // Convert to final units
-    reading.serotonin_nm = serotonin_mv * SEROTONIN_MV_TO_NM;
-    reading.dopamine_nm = dopamine_mv * DOPAMINE_MV_TO_NM;
-    reading.gaba_nm = gaba_mv * GABA_MV_TO_NM;
-    reading.ph_level = 7.0f + (ph_mv / PH_MV_PER_PH);  // pH 7 is zero-point
-    reading.temperature_c = temp_mv / TEMP_MV_PER_C;
-    reading.calprotectin_ug_g = calprotectin_mv * CALPROTECTIN_MV_TO_UG;
-    
-    // Clamp values to valid ranges
-    if (reading.serotonin_nm < SEROTONIN_MIN_NM) reading.serotonin_nm = SEROTONIN_MIN_NM;
-    if (reading.serotonin_nm > SEROTONIN_MAX_NM) reading.serotonin_nm = SEROTONIN_MAX_NM;
-    
-    if (reading.dopamine_nm < DOPAMINE_MIN_NM) reading.dopamine_nm = DOPAMINE_MIN_NM;
-    if (reading.dopamine_nm > DOPAMINE_MAX_NM) reading.dopamine_nm = DOPAMINE_MAX_NM;
-    
-    if (reading.gaba_nm < GABA_MIN_NM) reading.gaba_nm = GABA_MIN_NM;
-    if (reading.gaba_nm > GABA_MAX_NM) reading.gaba_nm = GABA_MAX_NM;
-    
-    // Timestamp
-    reading.timestamp_ms = millis();
+    // Calibration, baseline, unit conversion and range clamp in one pass
+    convertChannels(channel_transform, raw, units, 6);
+    
+    // Multi-point channels: temperature first, it compensates the others
+    if (lut_channels) {
+        if (lut_channels & (1 << ADC_CHANNEL_TEMP)) {
+            units[ADC_CHANNEL_TEMP] = convertChannelLut(&channel_lut[ADC_CHANNEL_TEMP],
+                                                        raw[ADC_CHANNEL_TEMP], 1.0f);
+        }
+        float temp_c = units[ADC_CHANNEL_TEMP];
+        for (int i = 0; i < 6; i++) {
+            if (i != ADC_CHANNEL_TEMP && (lut_channels & (1 << i))) {
+                float comp = lutCompensation(&channel_lut[i], temp_c);
+                units[i] = convertChannelLut(&channel_lut[i], raw[i], comp);
+            }
+        }
+    }
+    
+    reading.serotonin_nm = units[ADC_CHANNEL_SEROTONIN];
+    reading.dopamine_nm = units[ADC_CHANNEL_DOPAMINE];
+    reading.gaba_nm = units[ADC_CHANNEL_GABA];
+    reading.ph_level = units[ADC_CHANNEL_PH];
+    reading.temperature_c = units[ADC_CHANNEL_TEMP];
+    reading.calprotectin_ug_g = units[ADC_CHANNEL_CALPROTECTIN];
+    reading.timestamp_ms = 0;
     
     return reading;
 }
 
-void SensorManager::calibrate() {
+void SensorManager::convertRawFixed(const uint16_t* raw, int32_t* out_q) {
+    convertChannelsFixed(channel_fixed, raw, out_q, 6);
+    
+    if (lut_channels) {
+        if (lut_channels & (1 << ADC_CHANNEL_TEMP)) {
+            out_q[ADC_CHANNEL_TEMP] = convertChannelLutFixed(&channel_lut_fixed[ADC_CHANNEL_TEMP],
+                                                             raw[ADC_CHANNEL_TEMP], 1 << CAL_COMP_SHIFT);
+        }
+        int32_t temp_q = out_q[ADC_CHANNEL_TEMP];
+        for (int i = 0; i < 6; i++) {
+            if (i != ADC_CHANNEL_TEMP && (lut_channels & (1 << i))) {
+                int32_t comp_q = lutCompensationFixed(&channel_lut_fixed[i], temp_q);
+                out_q[i] = convertChannelLutFixed(&channel_lut_fixed[i], raw[i], comp_q);
+            }
+        }
+    }
+}
+
+bool SensorManager::startCalibration() {
     // Two-point calibration procedure
     // Assumes calibration solutions are applied externally
+    if (procedure != PROCEDURE_NONE) {
+        return false;
+    }
     
-    // Step 1: Zero-point calibration (blank solution)
-    delay(5000);  // Wait for solution to stabilize
+    beginProcedure(PROCEDURE_CALIBRATE, PHASE_SETTLE);
+    point_channel = CAL_POINT_NONE;
+    for (int i = 0; i < 6; i++) {
+        zero_sum[i] = 0.0f;
+    }
+    return true;
+}
+
+bool SensorManager::startCalibrationPoint(uint8_t channel, float reference_units) {
+    // One standard solution on one channel, same settle and averaging as
+    // the zero point; the channel's table is rebuilt when it completes
+    if (procedure != PROCEDURE_NONE || channel >= 6) {
+        return false;
+    }
+    if (findCalibrationPoint(channel, reference_units) < 0 &&
+        cal_point_count[channel] >= CAL_LUT_MAX_POINTS) {
+        return false;
+    }
     
-    const int num_samples = 50;
-    float zero_sum[6] = {0.0f, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f};
+    beginProcedure(PROCEDURE_CALIBRATE, PHASE_SETTLE);
+    point_channel = channel;
+    point_reference = reference_units;
+    for (int i = 0; i < 6; i++) {
+        zero_sum[i] = 0.0f;
+    }
+    return true;
+}
+
+int SensorManager::findCalibrationPoint(uint8_t channel, float reference_units) const {
+    for (int i = 0; i < cal_point_count[channel]; i++) {
+        if (cal_points[channel][i].units == reference_units) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+void SensorManager::clearCalibrationPoints(uint8_t channel) {
+    for (int i = 0; i < 6; i++) {
+        if (channel >= 6 || channel == i) {
+            cal_point_count[i] = 0;
+            saveCalibrationPoints(i);
+        }
+    }
+    rebuildTransforms();
+}
+
+void SensorManager::saveCalibrationPoints(uint8_t channel) {
+    if (!store) {
+        return;
+    }
+    if (cal_point_count[channel] == 0) {
+        store->remove(RECORD_KEY_CAL_POINTS + channel);
+        return;
+    }
     
-    for (int i = 0; i < num_samples; i++) {
-        zero_sum[0] += analogRead(A0);
-        zero_sum[1] += analogRead(A1);
-        zero_sum[2] += analogRead(A2);
-        zero_sum[3] += analogRead(A3);
-        zero_sum[4] += analogRead(A4);
-        zero_sum[5] += analogRead(A5);
-        delay(10);
+    CalPointsRecord record;
+    memset(&record, 0, sizeof(record));
+    record.count = cal_point_count[channel];
+    memcpy(record.points, cal_points[channel], record.count * sizeof(CalPoint));
+    store->put(RECORD_KEY_CAL_POINTS + channel, &record, sizeof(record));
+}
+
+void SensorManager::setRecordStore(RecordStore* records) {
+    store = records;
+    if (!store) {
+        return;
     }
     
-    // Store zero-point offsets
+    // Absent records keep the factory defaults
+    store->get(RECORD_KEY_CAL_OFFSET, calibration_offset, sizeof(calibration_offset));
+    store->get(RECORD_KEY_TEMP_COEFF, temp_coeff, sizeof(temp_coeff));
+    if (store->get(RECORD_KEY_CHANNEL_PERIODS, channel_period_ms, sizeof(channel_period_ms))) {
+        for (uint8_t i = 0; i < 6; i++) {
+            schedule.setPeriod(i, channel_period_ms[i]);
+        }
+    }
     for (int i = 0; i < 6; i++) {
-        float avg_raw = zero_sum[i] / num_samples;
-        calibration_offset[i] = (avg_raw * ADC_REF_VOLTAGE_MV) / ADC_MAX_VALUE;
+        CalPointsRecord record;
+        if (store->get(RECORD_KEY_CAL_POINTS + i, &record, sizeof(record)) &&
+            record.count <= CAL_LUT_MAX_POINTS) {
+            cal_point_count[i] = record.count;
+            memcpy(cal_points[i], record.points, record.count * sizeof(CalPoint));
+        }
+    }
+    rebuildTransforms();
+}
+
+uint8_t SensorManager::calibrationPoints(uint8_t channel) const {
+    return (channel < 6) ? cal_point_count[channel] : 0;
+}
+
+void SensorManager::setTemperatureCoefficient(uint8_t channel, float per_c) {
+    if (channel >= 6) {
+        return;
+    }
+    temp_coeff[channel] = per_c;
+    if (store) {
+        store->put(RECORD_KEY_TEMP_COEFF, temp_coeff, sizeof(temp_coeff));
+    }
+    rebuildTransforms();
+}
+
+bool SensorManager::startSelfTest() {
+    if (procedure != PROCEDURE_NONE) {
+        return false;
     }
     
-    // Reset baseline values after calibration
-    for (int i = 0; i < 6; i++) {
-        baseline_values[i] = 0.0f;
+    beginProcedure(PROCEDURE_SELF_TEST, PHASE_RESPONSE);
+    return true;
+}
+
+void SensorManager::beginProcedure(ProcedureType type, uint8_t phase) {
+    procedure = type;
+    procedure_phase = phase;
+    phase_start_ms = sysMillis();
+    scans_done = 0;
+    scan_failures = 0;
+    failed_channels = 0;
+    scan_pending = false;
+    resume_clock = false;
+    
+    status.procedure = type;
+    status.outcome = PROCEDURE_RUNNING;
+    status.percent = 0;
+    status.failed_channels = 0;
+    
+    if (phase != PHASE_SETTLE) {
+        claimAdc();
     }
-    last_baseline_update_ms = millis();
 }
 
-bool SensorManager::selfTest() {
-    bool all_passed = true;
+void SensorManager::claimAdc() {
+    // Clocked sampling pauses only while the procedure's own scans run
+    resume_clock = pauseClock();
+    scan_pending = false;
+    scan_start_us = sysMicros() - CAL_SCAN_SPACING_US;
+}
+
+bool SensorManager::procedureScan(uint32_t spacing_us, AdcFrame* frame) {
+    uint32_t now_us = sysMicros();
+    
+    if (adc.fetch(frame)) {
+        scan_pending = false;
+        return true;
+    }
     
+    if (scan_pending) {
+        if (now_us - scan_start_us > ADC_SCAN_TIMEOUT_US) {
+            scan_pending = false;
+            scan_failures++;
+        }
+        return false;
+    }
+    
+    if (now_us - scan_start_us >= spacing_us && adc.trigger()) {
+        scan_pending = true;
+        scan_start_us = now_us;
+    }
+    return false;
+}
+
+bool SensorManager::serviceProcedure() {
+    if (procedure == PROCEDURE_NONE) {
+        return false;
+    }
+    
+    AdcFrame frame;
+    uint8_t percent = status.percent;
+    
+    switch (procedure_phase) {
+        case PHASE_SETTLE: {
+            // Step 1: Zero-point calibration (blank solution)
+            // Wait for solution to stabilize; sampling carries on meanwhile
+            uint32_t elapsed = sysMillis() - phase_start_ms;
+            if (elapsed >= CAL_SETTLE_MS) {
+                procedure_phase = PHASE_ZERO;
+                claimAdc();
+                elapsed = CAL_SETTLE_MS;
+            }
+            percent = (uint8_t)((elapsed * 90) / CAL_SETTLE_MS);
+            break;
+        }
+        
+        case PHASE_ZERO:
+            if (procedureScan(CAL_SCAN_SPACING_US, &frame)) {
+                for (int ch = 0; ch < 6; ch++) {
+                    zero_sum[ch] += frame.raw[ch];
+                }
+                scans_done++;
+            }
+            if (scans_done >= CAL_ZERO_SCANS) {
+                finishCalibration();
+                return true;
+            }
+            percent = 90 + (scans_done * 10) / CAL_ZERO_SCANS;
+            break;
+        
+        case PHASE_RESPONSE:
+            if (procedureScan(0, &frame)) {
+                checkResponse(&frame);
+                procedure_phase = PHASE_NOISE;
+                for (int ch = 0; ch < 6; ch++) {
+                    min_val[ch] = ADC_MAX_VALUE;
+                    max_val[ch] = 0;
+                }
+                percent = 5;
+            }
+            break;
+        
+        case PHASE_NOISE:
+            // Test 2: Check for reasonable noise levels, all channels per scan
+            if (procedureScan(SELF_TEST_SCAN_SPACING_US, &frame)) {
+                for (int ch = 0; ch < 6; ch++) {
+                    if (frame.raw[ch] < min_val[ch]) min_val[ch] = frame.raw[ch];
+                    if (frame.raw[ch] > max_val[ch]) max_val[ch] = frame.raw[ch];
+                }
+                scans_done++;
+            }
+            if (scans_done >= SELF_TEST_NOISE_SCANS) {
+                finishSelfTest();
+                return true;
+            }
+            percent = 5 + (scans_done * 95) / SELF_TEST_NOISE_SCANS;
+            break;
+    }
+    
+    if (scan_failures >= PROCEDURE_MAX_SCAN_FAILURES) {
+        // SAADC did not complete its scans
+        finishProcedure(PROCEDURE_FAILED, 0x3F);
+        return true;
+    }
+    
+    if (percent >= status.percent + PROCEDURE_PROGRESS_STEP) {
+        status.percent = percent;
+        return true;
+    }
+    return false;
+}
+
+void SensorManager::checkResponse(const AdcFrame* frame) {
     // Test 1: Verify ADC is responsive (readings should not be stuck at 0 or max)
     for (int channel = 0; channel < 6; channel++) {
-        uint16_t reading = analogRead(A0 + channel);
+        uint16_t reading = frame->raw[channel];
         if (reading == 0 || reading == ADC_MAX_VALUE) {
             // Sensor may be disconnected or shorted
-            all_passed = false;
+            failed_channels |= (1 << channel);
         }
     }
     
-    // Test 2: Check for reasonable noise levels
-    const int noise_samples = 20;
+    // Test 3: Verify temperature sensor is in reasonable range (-10°C to 50°C)
+    uint16_t temp_raw = frame->raw[ADC_CHANNEL_TEMP];
+    float temp_mv = (temp_raw * ADC_REF_VOLTAGE_MV) / (float)ADC_MAX_VALUE;
+    float temp_c = temp_mv / TEMP_MV_PER_C;
+    if (temp_c < -10.0f || temp_c > 50.0f) {
+        failed_channels |= (1 << ADC_CHANNEL_TEMP);
+    }
+}
+
+void SensorManager::finishSelfTest() {
     for (int channel = 0; channel < 6; channel++) {
-        uint16_t min_val = ADC_MAX_VALUE;
-        uint16_t max_val = 0;
-        
-        for (int i = 0; i < noise_samples; i++) {
-            uint16_t reading = analogRead(A0 + channel);
-            if (reading < min_val) min_val = reading;
-            if (reading > max_val) max_val = reading;
-            delayMicroseconds(100);
-        }
-        
         // Noise should be less than 5% of range
-        uint16_t noise = max_val - min_val;
+        uint16_t noise = max_val[channel] - min_val[channel];
         if (noise > (ADC_MAX_VALUE * 0.05)) {
-            all_passed = false;
+            failed_channels |= (1 << channel);
         }
     }
     
-    // Test 3: Verify temperature sensor is in reasonable range (-10°C to 50°C)
-    uint16_t temp_raw = analogRead(A4);
-    float temp_mv = (temp_raw * ADC_REF_VOLTAGE_MV) / (float)ADC_MAX_VALUE;
-    float temp_c = temp_mv / TEMP_MV_PER_C;
-    if (temp_c < -10.0f || temp_c > 50.0f) {
-        all_passed = false;
+    finishProcedure(failed_channels ? PROCEDURE_FAILED : PROCEDURE_PASSED, failed_channels);
+}
+
+void SensorManager::finishCalibration() {
+    if (point_channel != CAL_POINT_NONE) {
+        recordCalibrationPoint();
+        return;
+    }
+    
+    // Store zero-point offsets
+    for (int i = 0; i < 6; i++) {
+        float avg_raw = zero_sum[i] / CAL_ZERO_SCANS;
+        calibration_offset[i] = (avg_raw * ADC_REF_VOLTAGE_MV) / ADC_MAX_VALUE;
+    }
+    if (store) {
+        store->put(RECORD_KEY_CAL_OFFSET, calibration_offset, sizeof(calibration_offset));
     }
     
-    return all_passed;
+    // Reset baseline values after calibration
+    for (int i = 0; i < 6; i++) {
+        baseline_values[i] = 0.0f;
+    }
+    baseline_tracker.reset(sysMillis());
+    rebuildTransforms();
+    
+    finishProcedure(PROCEDURE_PASSED, 0);
 }
 
+void SensorManager::recordCalibrationPoint() {
+    // Measured in baseline-corrected mV, the same input the table sees
+    const float mv_per_count = ADC_REF_VOLTAGE_MV / (float)ADC_MAX_VALUE;
+    uint16_t avg_raw[6];
+    for (int i = 0; i < 6; i++) {
+        avg_raw[i] = (uint16_t)(zero_sum[i] / CAL_ZERO_SCANS + 0.5f);
+    }
+    
+    CalPoint point;
+    point.mv = (zero_sum[point_channel] / CAL_ZERO_SCANS) * mv_per_count - baseline_values[point_channel];
+    point.units = point_reference;
+    point.temp_c = convertRaw(avg_raw).temperature_c;
+    
+    int slot = findCalibrationPoint(point_channel, point_reference);
+    if (slot < 0) {
+        slot = cal_point_count[point_channel]++;
+    }
+    cal_points[point_channel][slot] = point;
+    saveCalibrationPoints(point_channel);
+    rebuildTransforms();
+    
+    finishProcedure(PROCEDURE_PASSED, 0);
+}
+
+void SensorManager::finishProcedure(ProcedureOutcome outcome, uint8_t failed) {
+    procedure = PROCEDURE_NONE;
+    resumeClock(resume_clock);
+    resume_clock = false;
+    
+    // A scan still in flight lands in the queue as an ordinary reading
+    scan_pending = false;
+    
+    status.outcome = outcome;
+    status.failed_channels = failed;
+    if (outcome != PROCEDURE_ABORTED) {
+        status.percent = 100;
+    }
+}
+
+void SensorManager::abortProcedure() {
+    if (procedure != PROCEDURE_NONE) {
+        finishProcedure(PROCEDURE_ABORTED, 0);
+    }
+}
+
+bool SensorManager::procedureActive() const {
+    return procedure != PROCEDURE_NONE;
+}
+
+const ProcedureStatus* SensorManager::procedureStatus() const {
+    return &status;
+}
+
+void SensorManager::runProcedure() {
+    while (procedure != PROCEDURE_NONE) {
+        serviceProcedure();
+        sysDelayMicroseconds(100);
+    }
+}
+
+void SensorManager::calibrate() {
+    if (startCalibration()) {
+        runProcedure();
+    }
+}
+
+bool SensorManager::selfTest() {
+    if (!startSelfTest()) {
+        return false;
+    }
+    runProcedure();
+    return status.outcome == PROCEDURE_PASSED;
+}
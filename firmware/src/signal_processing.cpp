@@ -4,34 +4,130 @@
 #include <math.h>
 #include <string.h>
 
-// Butterworth low-pass filter coefficients (2nd order, fc=0.05Hz)
-const float b0 = 0.0201, b1 = 0.0402, b2 = 0.0201;
-const float a1 = -1.5610, a2 = 0.6414;
-
+// Butterworth low-pass filter (kernel in signal_processing.h)
 float SignalProcessor::butterworthFilter(float input, FilterState* state) {
-    float output = b0 * input + b1 * state->x1 + b2 * state->x2
-                   - a1 * state->y1 - a2 * state->y2;
-    
-    // Update state
-    state->x2 = state->x1;
-    state->x1 = input;
-    state->y2 = state->y1;
-    state->y1 = output;
-    
-    return output;
+    return butterworthStep(input, state);
 }
 
 // Kalman filter for noise reduction
 float SignalProcessor::kalmanFilter(float measurement, KalmanState* state) {
-    // Prediction
-    state->p = state->p + state->q;
+    return kalmanStep(measurement, state);
+}
+
+// Block processing: work on a local copy of the state so the compiler can
+// keep it in registers, and reuse the scalar kernel for identical rounding
+void SignalProcessor::butterworthFilterBlock(const float* input, float* output, uint16_t count,
+                                             FilterState* state) {
+    FilterState s = *state;
+    for (uint16_t i = 0; i < count; i++) {
+        output[i] = butterworthStep(input[i], &s);
+    }
+    *state = s;
+}
+
+void SignalProcessor::kalmanFilterBlock(const float* input, float* output, uint16_t count,
+                                        KalmanState* state) {
+    KalmanState s = *state;
+    for (uint16_t i = 0; i < count; i++) {
+        output[i] = kalmanStep(input[i], &s);
+    }
+    *state = s;
+}
+
+void SignalProcessor::butterworthFilterBank(const float* input, float* output, uint16_t count,
+                                            uint8_t channels, FilterState* states) {
+    // Channel-major traversal keeps one channel's state live at a time
+    for (uint8_t c = 0; c < channels; c++) {
+        FilterState s = states[c];
+        for (uint16_t i = 0; i < count; i++) {
+            uint32_t idx = (uint32_t)i * channels + c;
+            output[idx] = butterworthStep(input[idx], &s);
+        }
+        states[c] = s;
+    }
+}
+
+void SignalProcessor::kalmanFilterBank(const float* input, float* output, uint16_t count,
+                                       uint8_t channels, KalmanState* states) {
+    for (uint8_t c = 0; c < channels; c++) {
+        KalmanState s = states[c];
+        for (uint16_t i = 0; i < count; i++) {
+            uint32_t idx = (uint32_t)i * channels + c;
+            output[idx] = kalmanStep(input[idx], &s);
+        }
+        states[c] = s;
+    }
+}
+
+// Median absolute deviation about `median` without materialising the
+// deviations: they form two sorted runs either side of the median index,
+// so the k-th smallest is found by bisecting the split between the runs.
+static float windowMAD(const OrderStatisticsWindow* sorted, float median) {
+    uint8_t n = sorted->size();
+    uint8_t m = (n - 1) / 2;            // Lower median index
+    uint8_t len_l = m;                  // median - sorted[m-1-i], ascending in i
+    uint8_t len_r = n - m;              // sorted[m+j] - median, ascending in j
+    uint8_t k = (n - 1) / 2;            // Rank of the MAD among the deviations
+
+    int16_t lo = (k + 1 > len_r) ? (k + 1 - len_r) : 0;
+    int16_t hi = (k + 1 < len_l) ? (k + 1) : len_l;
+
+    while (lo <= hi) {
+        int16_t i = (lo + hi) / 2;      // Deviations taken from the left run
+        int16_t j = k + 1 - i;          // Deviations taken from the right run
+
+        float l_last = (i > 0) ? median - sorted->at(m - i) : -INFINITY;
+        float l_next = (i < len_l) ? median - sorted->at(m - 1 - i) : INFINITY;
+        float r_last = (j > 0) ? sorted->at(m + j - 1) - median : -INFINITY;
+        float r_next = (j < len_r) ? sorted->at(m + j) - median : INFINITY;
+
+        if (l_last > r_next) {
+            hi = i - 1;
+        } else if (r_last > l_next) {
+            lo = i + 1;
+        } else {
+            return (l_last > r_last) ? l_last : r_last;
+        }
+    }
+    return 0.0f;
+}
+
+// Hampel identifier: replace samples further than threshold * 1.4826 * MAD
+// from the window median by the median itself
+float hampelStep(float input, HampelState* state) {
+    if (isnan(input)) {
+        uint8_t n = state->sorted.size();
+        return (n > 0) ? state->sorted.at((n - 1) / 2) : input;
+    }
+    
+    // Slide the window
+    if (state->sorted.size() == state->window) {
+        state->sorted.remove(state->history[state->head]);
+    }
+    state->history[state->head] = input;
+    state->sorted.insert(input);
+    state->head++;
+    if (state->head == state->window) {
+        state->head = 0;
+    }
+    
+    uint8_t n = state->sorted.size();
+    if (n < 3) {
+        return input;
+    }
     
-    // Update
-    float k = state->p / (state->p + state->r);
-    state->x = state->x + k * (measurement - state->x);
-    state->p = (1 - k) * state->p;
+    float median = state->sorted.at((n - 1) / 2);
+    float mad = windowMAD(&state->sorted, median);
     
-    return state->x;
+    if (fabsf(input - median) > state->threshold * 1.4826f * mad) {
+        state->rejected++;
+        return median;
+    }
+    return input;
+}
+
+float SignalProcessor::hampelFilter(float input, HampelState* state) {
+    return hampelStep(input, state);
 }
 
 // Delta encoding for compression (4:1 ratio target)
@@ -72,3 +168,15 @@ void SignalProcessor::initKalmanState(KalmanState* state, float initial_value, f
     state->r = r;
 }
 
+void SignalProcessor::initHampelState(HampelState* state, uint8_t window, float threshold) {
+    if (window < 3) window = 3;
+    if (window > OSW_MAX_SIZE) window = OSW_MAX_SIZE;
+    window |= 1;    // Centred median; OSW_MAX_SIZE is odd
+    
+    state->sorted.init();
+    state->window = window;
+    state->head = 0;
+    state->threshold = threshold;
+    state->rejected = 0;
+}
+
@@ -0,0 +1,266 @@
+// firmware/src/spectral_analysis.cpp
+
+#include "spectral_analysis.h"
+#include <math.h>
+#include <string.h>
+
+// Band edges in cycles per minute, indexed by SpectralBand
+static const float band_edges_cpm[SPECTRAL_NUM_BANDS + 1] = {
+    0.5f, 2.0f, 4.0f, 9.0f, 12.0f
+};
+
+void SpectralAnalyzer::init(float rate_hz, uint16_t window_size, SpectralMode analysis_mode) {
+    // Round the window down to a power of two
+    uint16_t n = 16;
+    while ((uint16_t)(n << 1) <= window_size && (uint16_t)(n << 1) <= SPECTRAL_FFT_MAX_SIZE) {
+        n <<= 1;
+    }
+    window = n;
+    mode = analysis_mode;
+
+    for (uint16_t k = 0; k <= window / 2; k++) {
+        float c = cosf(2.0f * (float)M_PI * k / window);
+        int32_t q = (int32_t)lrintf(c * 32768.0f);
+        if (q > 32767) q = 32767;
+        cos_q15[k] = (int16_t)q;
+    }
+
+    setSampleRate(rate_hz);
+}
+
+void SpectralAnalyzer::setSampleRate(float rate_hz) {
+    sample_rate_hz = rate_hz;
+    head = 0;
+    filled = 0;
+    since_hop = 0;
+    configureDetectors();
+}
+
+void SpectralAnalyzer::configureDetectors() {
+    float step = (SPECTRAL_MAX_CPM - SPECTRAL_MIN_CPM) / (SPECTRAL_MAX_DETECTORS - 1);
+
+    for (uint8_t d = 0; d < SPECTRAL_MAX_DETECTORS; d++) {
+        detector_cpm[d] = SPECTRAL_MIN_CPM + d * step;
+        float omega = 2.0f * (float)M_PI * (detector_cpm[d] / 60.0f) / sample_rate_hz;
+        detector_coeff[d] = 2.0f * cosf(omega);
+    }
+}
+
+int16_t SpectralAnalyzer::sinQ15(uint16_t k) const {
+    // sin(2*pi*k/N) for k in [0, N/2], folded onto the cosine table
+    uint16_t quarter = window / 4;
+    if (k > quarter) k = window / 2 - k;
+    return cos_q15[quarter - k];
+}
+
+float SpectralAnalyzer::hann(uint16_t n) const {
+    uint16_t k = (n <= window / 2) ? n : window - n;
+    return 0.5f - 0.5f * (cos_q15[k] / 32768.0f);
+}
+
+float SpectralAnalyzer::windowedSample(uint16_t n, float mean) const {
+    uint16_t idx = head + n;
+    if (idx >= window) idx -= window;
+    return (ring[idx] - mean) * hann(n);
+}
+
+bool SpectralAnalyzer::addSample(float sample, SpectralFeatures* features) {
+    ring[head] = sample;
+    head++;
+    if (head == window) head = 0;
+    if (filled < window) filled++;
+    since_hop++;
+
+    // Emit every half window once the buffer is full
+    if (filled < window || since_hop < window / 2) {
+        return false;
+    }
+    since_hop = 0;
+
+    float mean = 0.0f;
+    for (uint16_t i = 0; i < window; i++) {
+        mean += ring[i];
+    }
+    mean /= window;
+
+    memset(features, 0, sizeof(SpectralFeatures));
+    features->window_samples = window;
+
+    if (mode == SPECTRAL_MODE_FFT) {
+        analyzeFFT(features, mean);
+    } else {
+        analyzeGoertzel(features, mean);
+    }
+    return true;
+}
+
+// Equivalent noise bandwidth of the Hann window, in bins
+#define HANN_ENBW   1.5f
+
+// Accumulate one spectral line into the band and total powers. Lines are
+// normalised for tone amplitude, so summing them over-counts by the ENBW.
+static void accumulateBand(SpectralFeatures* features, float cpm, float power) {
+    if (cpm < SPECTRAL_MIN_CPM || cpm >= SPECTRAL_MAX_CPM) return;
+    power /= HANN_ENBW;
+
+    for (uint8_t b = 0; b < SPECTRAL_NUM_BANDS; b++) {
+        if (cpm >= band_edges_cpm[b] && cpm < band_edges_cpm[b + 1]) {
+            features->band_power[b] += power;
+            break;
+        }
+    }
+    features->total_power += power;
+}
+
+// Vertex offset of a parabola through three equally spaced points
+static float parabolicOffset(float left, float centre, float right) {
+    float denom = left - 2.0f * centre + right;
+    if (denom == 0.0f) return 0.0f;
+    return 0.5f * (left - right) / denom;
+}
+
+void SpectralAnalyzer::analyzeGoertzel(SpectralFeatures* features, float mean) {
+    // Mean-square power of a sinusoid: 2|X|^2 / (sum of window)^2, sum = N/2
+    float norm = 2.0f / ((window / 2.0f) * (window / 2.0f));
+    float nyquist_cpm = sample_rate_hz * 30.0f;
+    float bin_cpm = sample_rate_hz * 60.0f / window;
+    float step = detector_cpm[1] - detector_cpm[0];
+    float power[SPECTRAL_MAX_DETECTORS];
+
+    for (uint8_t d = 0; d < SPECTRAL_MAX_DETECTORS; d++) {
+        power[d] = 0.0f;
+        if (detector_cpm[d] >= nyquist_cpm) continue;
+
+        float s1 = 0.0f, s2 = 0.0f;
+        float coeff = detector_coeff[d];
+        for (uint16_t n = 0; n < window; n++) {
+            float s0 = windowedSample(n, mean) + coeff * s1 - s2;
+            s2 = s1;
+            s1 = s0;
+        }
+        power[d] = (s1 * s1 + s2 * s2 - coeff * s1 * s2) * norm;
+
+        // Detectors sample the spectrum more sparsely than FFT bins do
+        accumulateBand(features, detector_cpm[d], power[d] * step / bin_cpm);
+    }
+
+    uint8_t peak = 0;
+    for (uint8_t d = 1; d < SPECTRAL_MAX_DETECTORS; d++) {
+        if (power[d] > power[peak]) peak = d;
+    }
+    float offset = 0.0f;
+    if (peak > 0 && peak < SPECTRAL_MAX_DETECTORS - 1) {
+        offset = parabolicOffset(sqrtf(power[peak - 1]), sqrtf(power[peak]),
+                                 sqrtf(power[peak + 1]));
+    }
+    features->dominant_cpm = detector_cpm[peak] + offset * step;
+    features->dominant_power = power[peak];
+}
+
+void SpectralAnalyzer::fftQ15(uint16_t points) {
+    // Bit-reversal permutation
+    for (uint16_t i = 1, j = 0; i < points; i++) {
+        uint16_t bit = points >> 1;
+        for (; j & bit; bit >>= 1) {
+            j ^= bit;
+        }
+        j ^= bit;
+        if (i < j) {
+            int16_t t = work_re[i]; work_re[i] = work_re[j]; work_re[j] = t;
+            t = work_im[i]; work_im[i] = work_im[j]; work_im[j] = t;
+        }
+    }
+
+    // Radix-2 DIT butterflies, scaled by 1/2 per stage to stay in Q15
+    for (uint16_t len = 2; len <= points; len <<= 1) {
+        uint16_t half = len >> 1;
+        uint16_t stride = window / len;     // W_len^j = W_window^(j*stride)
+
+        for (uint16_t i = 0; i < points; i += len) {
+            for (uint16_t j = 0; j < half; j++) {
+                int32_t wr = cos_q15[j * stride];
+                int32_t wi = -sinQ15(j * stride);
+                uint16_t a = i + j;
+                uint16_t b = a + half;
+
+                int32_t tr = (wr * work_re[b] - wi * work_im[b]) >> 15;
+                int32_t ti = (wr * work_im[b] + wi * work_re[b]) >> 15;
+                int32_t ar = work_re[a];
+                int32_t ai = work_im[a];
+
+                work_re[a] = (int16_t)((ar + tr) >> 1);
+                work_im[a] = (int16_t)((ai + ti) >> 1);
+                work_re[b] = (int16_t)((ar - tr) >> 1);
+                work_im[b] = (int16_t)((ai - ti) >> 1);
+            }
+        }
+    }
+}
+
+void SpectralAnalyzer::analyzeFFT(SpectralFeatures* features, float mean) {
+    uint16_t points = window / 2;
+
+    // Block floating point: scale the windowed block to half of Q15 full scale
+    float peak_abs = 0.0f;
+    for (uint16_t n = 0; n < window; n++) {
+        float v = fabsf(windowedSample(n, mean));
+        if (v > peak_abs) peak_abs = v;
+    }
+    if (peak_abs == 0.0f) return;
+    float scale = 16383.0f / peak_abs;
+
+    // Pack even/odd samples as one complex sequence of window/2 points
+    for (uint16_t n = 0; n < points; n++) {
+        work_re[n] = (int16_t)lrintf(windowedSample(2 * n, mean) * scale);
+        work_im[n] = (int16_t)lrintf(windowedSample(2 * n + 1, mean) * scale);
+    }
+
+    fftQ15(points);
+
+    // The FFT output is X/points in Q15, so 2|X|^2/(N/2)^2 reduces to this
+    float norm = 2.0f / (scale * scale);
+    float bin_cpm = sample_rate_hz * 60.0f / window;
+    float power_prev = 0.0f, power_peak = 0.0f, power_next = 0.0f;
+    uint16_t peak = 0;
+    float power_last = 0.0f;
+
+    // Split into the real spectrum, bins 1..points-1
+    for (uint16_t k = 1; k < points; k++) {
+        uint16_t mk = points - k;
+        int32_t zr = work_re[k], zi = work_im[k];
+        int32_t cr = work_re[mk], ci = work_im[mk];
+
+        int32_t er = (zr + cr) >> 1;
+        int32_t ei = (zi - ci) >> 1;
+        int32_t or_ = (zi + ci) >> 1;
+        int32_t oi = (cr - zr) >> 1;
+
+        int32_t c = cos_q15[k];
+        int32_t s = sinQ15(k);
+        int32_t xr = er + ((c * or_ + s * oi) >> 15);
+        int32_t xi = ei + ((c * oi - s * or_) >> 15);
+
+        float power = ((float)xr * xr + (float)xi * xi) * norm;
+        float cpm = k * bin_cpm;
+        accumulateBand(features, cpm, power);
+
+        if (cpm >= SPECTRAL_MIN_CPM && cpm < SPECTRAL_MAX_CPM && power > power_peak) {
+            peak = k;
+            power_peak = power;
+            power_prev = power_last;
+            power_next = -1.0f;         // Filled in by the next bin
+        } else if (power_next < 0.0f) {
+            power_next = power;
+        }
+        power_last = power;
+    }
+
+    if (peak == 0) return;
+
+    float offset = 0.0f;
+    if (power_next >= 0.0f) {
+        offset = parabolicOffset(sqrtf(power_prev), sqrtf(power_peak), sqrtf(power_next));
+    }
+    features->dominant_cpm = (peak + offset) * bin_cpm;
+    features->dominant_power = power_peak;
+}
@@ -0,0 +1,51 @@
+// firmware/src/sys_time.cpp
+
+#include "sys_time.h"
+
+#ifndef NRF52
+#include <Arduino.h>
+
+static bool virtual_time = false;
+static uint64_t virtual_us = 0;
+
+uint32_t sysMillis() {
+    return virtual_time ? (uint32_t)(virtual_us / 1000) : millis();
+}
+
+uint32_t sysMicros() {
+    return virtual_time ? (uint32_t)virtual_us : micros();
+}
+
+void sysDelay(uint32_t ms) {
+    if (virtual_time) {
+        virtual_us += (uint64_t)ms * 1000;
+    } else {
+        delay(ms);
+    }
+}
+
+void sysDelayMicroseconds(uint32_t us) {
+    if (virtual_time) {
+        virtual_us += us;
+    } else {
+        delayMicroseconds(us);
+    }
+}
+
+void sysTimeSetVirtual(bool enabled) {
+    virtual_time = enabled;
+    virtual_us = 0;
+}
+
+bool sysTimeIsVirtual() {
+    return virtual_time;
+}
+
+void sysTimeAdvanceUs(uint64_t us) {
+    virtual_us += us;
+}
+
+uint64_t sysTimeNowUs() {
+    return virtual_time ? virtual_us : micros();
+}
+#endif
@@ -0,0 +1,154 @@
+// firmware/src/telemetry_streams.cpp
+
+#include "telemetry_streams.h"
+#include <string.h>
+
+static void putU16(uint8_t* out, uint16_t value) {
+    out[0] = (uint8_t)value;
+    out[1] = (uint8_t)(value >> 8);
+}
+
+static void putU32(uint8_t* out, uint32_t value) {
+    out[0] = (uint8_t)value;
+    out[1] = (uint8_t)(value >> 8);
+    out[2] = (uint8_t)(value >> 16);
+    out[3] = (uint8_t)(value >> 24);
+}
+
+static void putFloat(uint8_t* out, float value) {
+    uint32_t bits;
+    memcpy(&bits, &value, sizeof(bits));
+    putU32(out, bits);
+}
+
+static void readingUnits(const SensorReading* reading, float* units) {
+    units[0] = reading->serotonin_nm;
+    units[1] = reading->dopamine_nm;
+    units[2] = reading->gaba_nm;
+    units[3] = reading->ph_level;
+    units[4] = reading->temperature_c;
+    units[5] = reading->calprotectin_ug_g;
+}
+
+uint8_t streamEncodeRaw(const uint16_t* counts, uint8_t mask, uint32_t timestamp_ms, uint8_t* out) {
+    mask &= (1 << STREAM_CHANNELS) - 1;
+    putU32(out, timestamp_ms);
+    out[4] = mask;
+
+    // LSB-first bit stream; at most 7 + 12 bits pending
+    uint32_t acc = 0;
+    uint8_t pending = 0;
+    uint8_t length = STREAM_READING_HEADER;
+    for (uint8_t ch = 0; ch < STREAM_CHANNELS; ch++) {
+        if (!(mask & (1 << ch))) {
+            continue;
+        }
+        acc |= (uint32_t)(counts[ch] & ((1 << STREAM_RAW_BITS) - 1)) << pending;
+        pending += STREAM_RAW_BITS;
+        while (pending >= 8) {
+            out[length++] = (uint8_t)acc;
+            acc >>= 8;
+            pending -= 8;
+        }
+    }
+    if (pending) {
+        out[length++] = (uint8_t)acc;
+    }
+    return length;
+}
+
+uint8_t streamEncodeFiltered(const SensorReading* reading, uint8_t mask, uint8_t* out) {
+    float units[STREAM_CHANNELS];
+    readingUnits(reading, units);
+
+    mask &= (1 << STREAM_CHANNELS) - 1;
+    putU32(out, reading->timestamp_ms);
+    out[4] = mask;
+
+    uint8_t length = STREAM_READING_HEADER;
+    for (uint8_t ch = 0; ch < STREAM_CHANNELS; ch++) {
+        if (mask & (1 << ch)) {
+            putFloat(out + length, units[ch]);
+            length += 4;
+        }
+    }
+    return length;
+}
+
+void SummaryStream::init(uint32_t period_ms) {
+    setPeriod(period_ms);
+    restart(0);
+}
+
+void SummaryStream::setPeriod(uint32_t ms) {
+    period_ms = (ms < SUMMARY_PERIOD_MIN_MS) ? SUMMARY_PERIOD_MIN_MS : ms;
+}
+
+uint32_t SummaryStream::period() const {
+    return period_ms;
+}
+
+void SummaryStream::restart(uint32_t now) {
+    start_ms = now;
+    memset(count, 0, sizeof(count));
+    memset(sum, 0, sizeof(sum));
+}
+
+void SummaryStream::add(const SensorReading* reading, uint8_t mask) {
+    float units[STREAM_CHANNELS];
+    readingUnits(reading, units);
+
+    for (uint8_t ch = 0; ch < STREAM_CHANNELS; ch++) {
+        if (!(mask & (1 << ch))) {
+            continue;
+        }
+        if (count[ch] == 0) {
+            min[ch] = units[ch];
+            max[ch] = units[ch];
+        } else {
+            if (units[ch] < min[ch]) min[ch] = units[ch];
+            if (units[ch] > max[ch]) max[ch] = units[ch];
+        }
+        sum[ch] += units[ch];
+        if (count[ch] < 0xFFFF) {
+            count[ch]++;
+        }
+    }
+}
+
+bool SummaryStream::due(uint32_t now) const {
+    if (now - start_ms < period_ms) return false;
+    for (uint8_t ch = 0; ch < STREAM_CHANNELS; ch++) {
+        if (count[ch] > 0) return true;
+    }
+    return false;
+}
+
+uint8_t SummaryStream::take(uint32_t now, uint8_t* out) {
+    uint8_t mask = 0;
+    for (uint8_t ch = 0; ch < STREAM_CHANNELS; ch++) {
+        if (count[ch] > 0) {
+            mask |= 1 << ch;
+        }
+    }
+
+    uint8_t length = 0;
+    if (mask) {
+        putU32(out, start_ms);
+        putU32(out + 4, now - start_ms);
+        out[8] = mask;
+        length = STREAM_SUMMARY_HEADER;
+        for (uint8_t ch = 0; ch < STREAM_CHANNELS; ch++) {
+            if (!(mask & (1 << ch))) {
+                continue;
+            }
+            putU16(out + length, count[ch]);
+            putFloat(out + length + 2, min[ch]);
+            putFloat(out + length + 6, sum[ch] / count[ch]);
+            putFloat(out + length + 10, max[ch]);
+            length += STREAM_SUMMARY_CHANNEL;
+        }
+    }
+    restart(now);
+    return length;
+}
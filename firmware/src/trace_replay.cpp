@@ -0,0 +1,260 @@
+// firmware/src/trace_replay.cpp
+
+#include "trace_replay.h"
+
+#ifndef NRF52
+#include "analyte_chains.h"
+#include "sys_time.h"
+#include <fcntl.h>
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+// Traces are mapped as-is, so the host must share the file's byte order
+static bool hostLittleEndian() {
+    uint16_t probe = 1;
+    return *(const uint8_t*)&probe == 1;
+}
+
+static uint64_t wallMicros() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000ULL + ts.tv_nsec / 1000;
+}
+
+static void* mapFile(const char* path, uint32_t* size) {
+    int fd = ::open(path, O_RDONLY);
+    if (fd < 0) {
+        return NULL;
+    }
+    struct stat st;
+    void* map = NULL;
+    if (fstat(fd, &st) == 0 && st.st_size > 0) {
+        map = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (map == MAP_FAILED) {
+            map = NULL;
+        } else {
+            *size = (uint32_t)st.st_size;
+        }
+    }
+    ::close(fd);
+    return map;
+}
+
+void TraceFile::init() {
+    map = NULL;
+    map_size = 0;
+}
+
+bool TraceFile::open(const char* path) {
+    close();
+    if (!hostLittleEndian()) {
+        return false;
+    }
+
+    map = mapFile(path, &map_size);
+    if (!map) {
+        return false;
+    }
+
+    const TraceHeader* header = (const TraceHeader*)map;
+    uint64_t need = sizeof(TraceHeader) +
+                    (uint64_t)header->frame_count * ADC_SCAN_CHANNELS * sizeof(uint16_t);
+    if (map_size < sizeof(TraceHeader) || header->magic != TRACE_MAGIC ||
+        header->version != TRACE_VERSION || header->channels != ADC_SCAN_CHANNELS ||
+        header->interval_us == 0 || map_size < need) {
+        close();
+        return false;
+    }
+
+    // Sequential reads: let the kernel read ahead
+    madvise(map, map_size, MADV_SEQUENTIAL);
+    return true;
+}
+
+void TraceFile::close() {
+    if (map) {
+        munmap(map, map_size);
+    }
+    map = NULL;
+    map_size = 0;
+}
+
+uint32_t TraceFile::frameCount() const {
+    return map ? ((const TraceHeader*)map)->frame_count : 0;
+}
+
+uint32_t TraceFile::intervalUs() const {
+    return map ? ((const TraceHeader*)map)->interval_us : 0;
+}
+
+const uint16_t* TraceFile::frames() const {
+    return map ? (const uint16_t*)((const uint8_t*)map + sizeof(TraceHeader)) : NULL;
+}
+
+bool TraceFile::write(const char* path, const uint16_t* frames, uint32_t frame_count,
+                      uint32_t interval_us) {
+    if (!hostLittleEndian()) {
+        return false;
+    }
+    FILE* f = fopen(path, "wb");
+    if (!f) {
+        return false;
+    }
+
+    TraceHeader header;
+    header.magic = TRACE_MAGIC;
+    header.version = TRACE_VERSION;
+    header.channels = ADC_SCAN_CHANNELS;
+    header.interval_us = interval_us;
+    header.frame_count = frame_count;
+
+    size_t counts = (size_t)frame_count * ADC_SCAN_CHANNELS;
+    bool ok = fwrite(&header, sizeof(header), 1, f) == 1 &&
+              fwrite(frames, sizeof(uint16_t), counts, f) == counts;
+    return (fclose(f) == 0) && ok;
+}
+
+bool TraceFile::writeSynthetic(const char* path, const AdcSyntheticChannel* channels,
+                               uint32_t frame_count, uint32_t interval_us) {
+    FILE* f = fopen(path, "wb");
+    if (!f) {
+        return false;
+    }
+
+    TraceHeader header;
+    header.magic = TRACE_MAGIC;
+    header.version = TRACE_VERSION;
+    header.channels = ADC_SCAN_CHANNELS;
+    header.interval_us = interval_us;
+    header.frame_count = frame_count;
+    bool ok = hostLittleEndian() && fwrite(&header, sizeof(header), 1, f) == 1;
+
+    AdcDriver adc;
+    adc.init();
+    adc.setSyntheticSource(channels);
+    adc.start();
+    for (uint32_t i = 0; i < frame_count && ok; i++) {
+        AdcFrame frame;
+        ok = adc.acquire(&frame) &&
+             fwrite(frame.raw, sizeof(uint16_t), ADC_SCAN_CHANNELS, f) == ADC_SCAN_CHANNELS;
+    }
+    adc.stop();
+    return (fclose(f) == 0) && ok;
+}
+
+bool replayTrace(SensorManager* sensors, const TraceFile* trace, const char* output,
+                 ReplayStats* stats) {
+    uint32_t count = trace->frameCount();
+    if (count == 0) {
+        return false;
+    }
+
+    FILE* out = NULL;
+    if (output) {
+        out = fopen(output, "wb");
+        if (!out) {
+            return false;
+        }
+        ReplayOutputHeader header;
+        header.magic = TRACE_OUTPUT_MAGIC;
+        header.version = TRACE_VERSION;
+        header.record_size = sizeof(ReplayRecord);
+        header.record_count = count;
+        fwrite(&header, sizeof(header), 1, out);
+    }
+
+    // Same starting state on every run: virtual time from 0, fresh
+    // baseline and filter memory
+    sysTimeSetVirtual(true);
+    sensors->init();
+    sensors->adcDriver().setRecordedSource(trace->frames(), count, false);
+    AnalyteChains chains;
+    chains.configure();
+
+    memset(stats, 0, sizeof(*stats));
+    uint64_t wall_start = wallMicros();
+    bool ok = true;
+    for (uint32_t i = 0; i < count && ok; i++) {
+        sysTimeAdvanceUs(trace->intervalUs());
+        SensorReading raw = sensors->readAnalytes();
+        const SensorReading* filtered = chains.process(&raw, sensors->readingMask());
+
+        if (out) {
+            ReplayRecord record;
+            record.timestamp_ms = filtered->timestamp_ms;
+            record.units[0] = filtered->serotonin_nm;
+            record.units[1] = filtered->dopamine_nm;
+            record.units[2] = filtered->gaba_nm;
+            record.units[3] = filtered->ph_level;
+            record.units[4] = filtered->temperature_c;
+            record.units[5] = filtered->calprotectin_ug_g;
+            ok = fwrite(&record, sizeof(record), 1, out) == 1;
+        }
+        stats->readings++;
+    }
+    stats->wall_us = wallMicros() - wall_start;
+    stats->virtual_us = (uint64_t)stats->readings * trace->intervalUs();
+    if (stats->wall_us) {
+        stats->samples_per_sec = stats->readings * 1e6f / stats->wall_us;
+        stats->speedup = (float)stats->virtual_us / stats->wall_us;
+    }
+
+    sensors->stopAcquisition();
+    sysTimeSetVirtual(false);
+    if (out) {
+        ok = (fclose(out) == 0) && ok;
+    }
+    return ok;
+}
+
+bool diffReplayOutputs(const char* a, const char* b, ReplayDiff* diff) {
+    uint32_t size_a = 0;
+    uint32_t size_b = 0;
+    void* map_a = mapFile(a, &size_a);
+    void* map_b = mapFile(b, &size_b);
+
+    memset(diff, 0, sizeof(*diff));
+    diff->first_mismatch = -1;
+
+    bool ok = map_a && map_b && size_a >= sizeof(ReplayOutputHeader) &&
+              size_b >= sizeof(ReplayOutputHeader);
+    const ReplayOutputHeader* ha = (const ReplayOutputHeader*)map_a;
+    const ReplayOutputHeader* hb = (const ReplayOutputHeader*)map_b;
+    ok = ok && ha->magic == TRACE_OUTPUT_MAGIC && hb->magic == TRACE_OUTPUT_MAGIC &&
+         ha->record_size == sizeof(ReplayRecord) && hb->record_size == sizeof(ReplayRecord);
+
+    if (ok) {
+        uint32_t na = (size_a - sizeof(ReplayOutputHeader)) / sizeof(ReplayRecord);
+        uint32_t nb = (size_b - sizeof(ReplayOutputHeader)) / sizeof(ReplayRecord);
+        const ReplayRecord* ra = (const ReplayRecord*)(ha + 1);
+        const ReplayRecord* rb = (const ReplayRecord*)(hb + 1);
+
+        diff->length_differs = (na != nb);
+        diff->compared = (na < nb) ? na : nb;
+        for (uint32_t i = 0; i < diff->compared; i++) {
+            if (memcmp(&ra[i], &rb[i], sizeof(ReplayRecord)) == 0) {
+                continue;
+            }
+            if (diff->first_mismatch < 0) {
+                diff->first_mismatch = (int32_t)i;
+            }
+            diff->mismatched++;
+            for (uint8_t ch = 0; ch < 6; ch++) {
+                float d = fabsf(ra[i].units[ch] - rb[i].units[ch]);
+                if (d > diff->max_abs[ch]) {
+                    diff->max_abs[ch] = d;
+                }
+            }
+        }
+    }
+
+    if (map_a) munmap(map_a, size_a);
+    if (map_b) munmap(map_b, size_b);
+    return ok;
+}
+#endif
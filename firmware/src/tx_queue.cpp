@@ -0,0 +1,154 @@
+// firmware/src/tx_queue.cpp
+
+#include "tx_queue.h"
+#include "ble_frame.h"
+#include <string.h>
+
+void TxQueue::init() {
+    head = 0;
+    used = 0;
+    congested = false;
+    policy = TX_DROP_NEWEST;
+    memset(seq, 0, sizeof(seq));
+    resetStats();
+}
+
+void TxQueue::setDropPolicy(TxDropPolicy drop) {
+    policy = drop;
+}
+
+TxDropPolicy TxQueue::dropPolicy() const {
+    return (TxDropPolicy)policy;
+}
+
+bool TxQueue::push(uint8_t target, const uint8_t* data, uint16_t length, uint16_t notify_payload) {
+    if (target >= TX_TARGETS || !enqueue(target, seq[target], data, length, notify_payload)) {
+        counters.dropped_newest++;
+        return false;
+    }
+    seq[target]++;
+    return true;
+}
+
+bool TxQueue::resend(uint8_t target, uint16_t packet_seq, const uint8_t* data, uint16_t length,
+                     uint16_t notify_payload) {
+    if (target >= TX_TARGETS || !enqueue(target, packet_seq, data, length, notify_payload)) {
+        counters.dropped_newest++;
+        return false;
+    }
+    return true;
+}
+
+bool TxQueue::enqueue(uint8_t target, uint16_t packet_seq, const uint8_t* data, uint16_t length,
+                      uint16_t notify_payload) {
+    if (notify_payload > TX_SLOT_SIZE) {
+        notify_payload = TX_SLOT_SIZE;
+    }
+    uint8_t needed = frameFragmentsFor(length, notify_payload);
+    if (needed == 0 || needed > TX_QUEUE_DEPTH) {
+        return false;
+    }
+
+    while (TX_QUEUE_DEPTH - used < needed) {
+        if (policy != TX_DROP_OLDEST || !evictOldest()) {
+            return false;
+        }
+    }
+
+    FrameHeader header;
+    header.seq = packet_seq;
+    header.count = needed;
+    header.length = (uint8_t)length;
+
+    uint16_t share = notify_payload - FRAME_HEADER_SIZE;
+    for (uint8_t i = 0; i < needed; i++) {
+        TxSlot* slot = &slots[(head + used) % TX_QUEUE_DEPTH];
+        uint16_t chunk = length - i * share;
+        if (chunk > share) {
+            chunk = share;
+        }
+        header.index = i;
+        frameEncodeHeader(&header, slot->data);
+        memcpy(slot->data + FRAME_HEADER_SIZE, data + i * share, chunk);
+        slot->target = target;
+        slot->length = (uint8_t)(FRAME_HEADER_SIZE + chunk);
+        slot->first = (i == 0);
+        used++;
+    }
+
+    counters.payloads++;
+    counters.fragments += needed;
+    if (used > counters.high_water) {
+        counters.high_water = used;
+    }
+    updateBackpressure();
+    return true;
+}
+
+uint16_t TxQueue::nextSeq(uint8_t target) const {
+    return (target < TX_TARGETS) ? seq[target] : 0;
+}
+
+bool TxQueue::evictOldest() {
+    // A payload already partly handed over has to finish
+    if (used == 0 || !slots[head].first) {
+        return false;
+    }
+
+    do {
+        head = (head + 1) % TX_QUEUE_DEPTH;
+        used--;
+    } while (used > 0 && !slots[head].first);
+
+    counters.dropped_oldest++;
+    return true;
+}
+
+const TxSlot* TxQueue::peek() const {
+    return used ? &slots[head] : 0;
+}
+
+void TxQueue::pop() {
+    if (used == 0) return;
+
+    head = (head + 1) % TX_QUEUE_DEPTH;
+    used--;
+    counters.sent++;
+    updateBackpressure();
+}
+
+uint8_t TxQueue::count() const {
+    return used;
+}
+
+uint8_t TxQueue::space() const {
+    return TX_QUEUE_DEPTH - used;
+}
+
+bool TxQueue::backpressure() const {
+    return congested;
+}
+
+void TxQueue::clear() {
+    head = 0;
+    used = 0;
+    congested = false;
+}
+
+void TxQueue::updateBackpressure() {
+    if (!congested && used >= TX_HIGH_WATERMARK) {
+        congested = true;
+        counters.backpressure++;
+    } else if (congested && used <= TX_LOW_WATERMARK) {
+        congested = false;
+    }
+}
+
+const TxQueueStats* TxQueue::stats() const {
+    return &counters;
+}
+
+void TxQueue::resetStats() {
+    memset(&counters, 0, sizeof(counters));
+    counters.high_water = used;
+}
@@ -0,0 +1,197 @@
+/**
+ * @file test_adc_driver.cpp
+ * @brief Unit tests for the scan-mode ADC driver
+ *
+ * Tests frame hand-off, queue overflow and the host stand-in sources,
+ * and benchmarks the acquisition-to-reading path
+ */
+
+#include <unity.h>
+#include "adc_driver.h"
+#include "sensor_manager.h"
+#include "cycle_counter.h"
+#include <stdio.h>
+
+AdcDriver adc;
+
+void setUp(void) {
+    // Set up runs before each test
+    adc.init();
+}
+
+void tearDown(void) {
+    // Clean up runs after each test
+    adc.stop();
+}
+
+/**
+ * Test one trigger produces exactly one frame of in-range counts
+ */
+void test_adc_trigger_fetch(void) {
+    AdcFrame frame;
+
+    TEST_ASSERT_FALSE(adc.fetch(&frame));
+    TEST_ASSERT_TRUE(adc.trigger());
+
+    uint32_t start_us = micros();
+    while (!adc.fetch(&frame) && micros() - start_us < ADC_SCAN_TIMEOUT_US);
+
+    TEST_ASSERT_EQUAL(0, frame.seq);
+    for (uint8_t ch = 0; ch < ADC_SCAN_CHANNELS; ch++) {
+        TEST_ASSERT_LESS_OR_EQUAL(4095, frame.raw[ch]);
+    }
+    TEST_ASSERT_FALSE(adc.fetch(&frame));
+}
+
+/**
+ * Test frames queue in order and overflow is counted, not overwritten
+ */
+void test_adc_queue_overflow(void) {
+    AdcFrame frame;
+
+    // Trigger past the queue depth without consuming
+    for (uint8_t i = 0; i < ADC_FRAME_QUEUE_DEPTH + 2; i++) {
+        adc.trigger();
+        uint32_t start_us = micros();
+        while (adc.pending() + adc.droppedFrames() <= i &&
+               micros() - start_us < ADC_SCAN_TIMEOUT_US);
+    }
+
+    TEST_ASSERT_EQUAL(ADC_FRAME_QUEUE_DEPTH, adc.pending());
+    TEST_ASSERT_EQUAL(2, adc.droppedFrames());
+
+    uint32_t last_seq = 0;
+    for (uint8_t i = 0; i < ADC_FRAME_QUEUE_DEPTH; i++) {
+        TEST_ASSERT_TRUE(adc.fetch(&frame));
+        if (i > 0) {
+            TEST_ASSERT_EQUAL(last_seq + 1, frame.seq);
+        }
+        last_seq = frame.seq;
+    }
+    TEST_ASSERT_EQUAL(0, adc.pending());
+}
+
+/**
+ * Test acquire() skips frames queued before the call
+ */
+void test_adc_acquire_skips_stale(void) {
+    AdcFrame frame;
+
+    adc.trigger();
+    adc.trigger();
+    delayMicroseconds(ADC_SCAN_TIMEOUT_US);
+
+    TEST_ASSERT_TRUE(adc.acquire(&frame));
+    TEST_ASSERT_EQUAL(0, adc.pending());
+}
+
+#ifndef NRF52
+/**
+ * Test synthetic source level, sine and noise bounds
+ */
+void test_adc_synthetic_source(void) {
+    AdcSyntheticChannel channels[ADC_SCAN_CHANNELS] = {
+        {2000, 0, 0, 0}, {2000, 500, 8, 0}, {100, 0, 0, 10},
+        {0, 0, 0, 0}, {4095, 100, 4, 0}, {3000, 0, 0, 0}
+    };
+    adc.setSyntheticSource(channels);
+    AdcFrame frame;
+
+    for (uint8_t n = 0; n < 16; n++) {
+        TEST_ASSERT_TRUE(adc.acquire(&frame));
+        TEST_ASSERT_EQUAL(2000, frame.raw[0]);
+        TEST_ASSERT_INT_WITHIN(500, 2000, frame.raw[1]);
+        TEST_ASSERT_INT_WITHIN(10, 100, frame.raw[2]);
+        TEST_ASSERT_EQUAL(0, frame.raw[3]);
+        TEST_ASSERT_LESS_OR_EQUAL(4095, frame.raw[4]);     // Saturated
+        TEST_ASSERT_EQUAL(3000, frame.raw[5]);
+    }
+
+    // Quarter period of an 8-frame sine peaks at level + amplitude
+    adc.init();
+    adc.setSyntheticSource(channels);
+    adc.acquire(&frame);
+    adc.acquire(&frame);
+    adc.acquire(&frame);
+    TEST_ASSERT_EQUAL(2500, frame.raw[1]);
+}
+
+/**
+ * Test recorded frames replay in order, end or loop
+ */
+void test_adc_recorded_source(void) {
+    static const uint16_t frames[3 * ADC_SCAN_CHANNELS] = {
+        1, 2, 3, 4, 5, 6,
+        10, 20, 30, 40, 50, 60,
+        100, 200, 300, 400, 500, 600
+    };
+    AdcFrame frame;
+
+    adc.setRecordedSource(frames, 3, false);
+    for (uint8_t n = 0; n < 3; n++) {
+        TEST_ASSERT_TRUE(adc.acquire(&frame));
+        TEST_ASSERT_EQUAL_UINT16_ARRAY(&frames[n * ADC_SCAN_CHANNELS], frame.raw, ADC_SCAN_CHANNELS);
+    }
+    TEST_ASSERT_FALSE(adc.trigger());
+
+    adc.setRecordedSource(frames, 3, true);
+    for (uint8_t n = 0; n < 4; n++) {
+        TEST_ASSERT_TRUE(adc.acquire(&frame));
+    }
+    TEST_ASSERT_EQUAL_UINT16_ARRAY(&frames[0], frame.raw, ADC_SCAN_CHANNELS);
+}
+#endif
+
+/**
+ * Benchmark trigger -> frame -> converted reading
+ */
+void test_adc_acquisition_benchmark(void) {
+    const uint16_t FRAMES = 1000;
+    SensorManager sensors;
+    char msg[96];
+
+    sensors.init();
+    cycle_counter_init();
+
+    uint32_t taken = 0;
+    uint32_t start = cycle_counter_read();
+    for (uint16_t i = 0; i < FRAMES; i++) {
+        SensorReading reading;
+        sensors.requestReading();
+        uint32_t wait_us = micros();
+        while (micros() - wait_us < ADC_SCAN_TIMEOUT_US) {
+            if (sensors.takeReading(&reading)) {
+                taken++;
+                break;
+            }
+        }
+    }
+    uint32_t elapsed = cycle_counter_read() - start;
+    sensors.stopAcquisition();
+
+    snprintf(msg, sizeof(msg), "acquire+convert: %lu ticks/frame (%lu Hz counter)",
+             (unsigned long)(elapsed / FRAMES), (unsigned long)CYCLE_COUNTER_HZ);
+    TEST_MESSAGE(msg);
+    TEST_ASSERT_EQUAL(FRAMES, taken);
+}
+
+void setup() {
+    delay(2000);
+
+    UNITY_BEGIN();
+
+    RUN_TEST(test_adc_trigger_fetch);
+    RUN_TEST(test_adc_queue_overflow);
+    RUN_TEST(test_adc_acquire_skips_stale);
+#ifndef NRF52
+    RUN_TEST(test_adc_synthetic_source);
+    RUN_TEST(test_adc_recorded_source);
+#endif
+    RUN_TEST(test_adc_acquisition_benchmark);
+
+    UNITY_END();
+}
+
+void loop() {
+    // Tests run once in setup()
+}
@@ -0,0 +1,204 @@
+/**
+ * @file test_baseline_tracker.cpp
+ * @brief Unit tests for the incremental baseline drift tracker
+ *
+ * Tests robust window averaging, drift fitting and the timing of
+ * readAnalytes() with baseline tracking in the loop
+ */
+
+#include <unity.h>
+#include "baseline_tracker.h"
+#include "sensor_manager.h"
+#include "cycle_counter.h"
+#include <stdio.h>
+#include <math.h>
+
+BaselineTracker tracker;
+
+static uint32_t noise_state;
+
+// Deterministic noise, uniform in [-amplitude, amplitude]
+static float noise(float amplitude) {
+    noise_state = noise_state * 1664525UL + 1013904223UL;
+    return amplitude * (((noise_state >> 8) & 0xFFFF) / 32767.5f - 1.0f);
+}
+
+// Same level on every channel
+static void fill(float* mv, float level) {
+    for (uint8_t i = 0; i < BASELINE_CHANNELS; i++) {
+        mv[i] = level;
+    }
+}
+
+void setUp(void) {
+    // Set up runs before each test
+    noise_state = 12345;
+    tracker.init(1000, false);
+    tracker.reset(0);
+}
+
+void tearDown(void) {
+    // Clean up runs after each test
+}
+
+/**
+ * Test windows close on time and the EMA converges to a constant level
+ */
+void test_baseline_converges(void) {
+    float mv[BASELINE_CHANNELS];
+    uint32_t closed = 0;
+
+    for (uint32_t t = 1; t <= 100000; t++) {
+        fill(mv, 1000.0f + noise(5.0f));
+        if (tracker.addSample(mv, t)) {
+            closed++;
+        }
+    }
+
+    TEST_ASSERT_EQUAL_UINT32(100, closed);
+    TEST_ASSERT_EQUAL_UINT32(100, tracker.windowsClosed());
+    for (uint8_t i = 0; i < BASELINE_CHANNELS; i++) {
+        TEST_ASSERT_FLOAT_WITHIN(1.0f, 1000.0f, tracker.baseline(i));
+    }
+}
+
+/**
+ * Test spikes do not drag the window average where a plain mean would
+ */
+void test_baseline_rejects_spikes(void) {
+    float mv[BASELINE_CHANNELS];
+    float plain_sum = 0.0f;
+    uint32_t n = 0;
+
+    for (uint32_t t = 1; t <= 1000; t++) {
+        float x = 500.0f + noise(2.0f);
+        if (t % 20 == 0) {
+            x += 500.0f;    // 5% spikes
+        }
+        fill(mv, x);
+        plain_sum += x;
+        n++;
+        tracker.addSample(mv, t);
+    }
+
+    // First window: baseline = alpha * window mean
+    float robust = tracker.baseline(0) / BASELINE_EMA_ALPHA;
+    float plain = plain_sum / n;
+    TEST_ASSERT_EQUAL_UINT32(1, tracker.windowsClosed());
+    TEST_ASSERT_FLOAT_WITHIN(2.0f, 500.0f, robust);
+    TEST_ASSERT_TRUE(fabsf(plain - 500.0f) > 20.0f);
+}
+
+/**
+ * Test the drift fit follows a ramp with less lag than the EMA
+ */
+void test_baseline_drift_fit(void) {
+    BaselineTracker ema;
+    float mv[BASELINE_CHANNELS];
+    float level = 0.0f;
+
+    ema.init(1000, false);
+    ema.reset(0);
+    tracker.setDriftFit(true);
+
+    // 600 mV/min from 1000 mV, 1 sample/ms, 1 s windows
+    for (uint32_t t = 1; t <= 30000; t++) {
+        level = 1000.0f + 0.01f * t;
+        fill(mv, level + noise(2.0f));
+        tracker.addSample(mv, t);
+        ema.addSample(mv, t);
+    }
+
+    // Window means sit half a window behind the close time
+    TEST_ASSERT_FLOAT_WITHIN(30.0f, 600.0f, tracker.driftPerMinute(0));
+    TEST_ASSERT_FLOAT_WITHIN(10.0f, level, tracker.baseline(0));
+    TEST_ASSERT_TRUE(fabsf(level - ema.baseline(0)) > 50.0f);
+}
+
+// Per-call timing statistics, in microseconds
+typedef struct {
+    float mean;
+    float stddev;
+    float max;
+} CallTiming;
+
+static CallTiming timeReads(SensorManager* sensors, uint16_t calls, bool legacy_burst) {
+    float sum = 0.0f;
+    float sum_sq = 0.0f;
+    float max = 0.0f;
+    uint32_t last_burst_ms = millis();
+
+    for (uint16_t i = 0; i < calls; i++) {
+        uint32_t start = cycle_counter_read();
+        sensors->readAnalytes();
+
+        // Pre-stream behaviour: ten extra scans 1 ms apart once per window
+        if (legacy_burst && millis() - last_burst_ms >= 20) {
+            for (uint8_t s = 0; s < 10; s++) {
+                AdcFrame frame;
+                sensors->adcDriver().acquire(&frame);
+                delay(1);
+            }
+            last_burst_ms = millis();
+        }
+        float us = (cycle_counter_read() - start) * 1000000.0f / CYCLE_COUNTER_HZ;
+
+        sum += us;
+        sum_sq += us * us;
+        if (us > max) {
+            max = us;
+        }
+        delayMicroseconds(500);   // Stand-in for the sampling interval
+    }
+
+    CallTiming timing;
+    timing.mean = sum / calls;
+    timing.stddev = sqrtf(fmaxf(sum_sq / calls - timing.mean * timing.mean, 0.0f));
+    timing.max = max;
+    return timing;
+}
+
+/**
+ * Report readAnalytes() timing with blocking baseline bursts and with
+ * the incremental tracker
+ */
+void test_read_analytes_timing(void) {
+    const uint16_t CALLS = 1000;
+    SensorManager sensors;
+    char msg[128];
+
+    sensors.init();
+    sensors.setBaselineWindow(20);
+    cycle_counter_init();
+
+    CallTiming before = timeReads(&sensors, CALLS, true);
+    CallTiming after = timeReads(&sensors, CALLS, false);
+    sensors.stopAcquisition();
+
+    snprintf(msg, sizeof(msg), "readAnalytes with burst: mean %.1f us, stddev %.1f us, max %.1f us",
+             before.mean, before.stddev, before.max);
+    TEST_MESSAGE(msg);
+    snprintf(msg, sizeof(msg), "readAnalytes streamed:   mean %.1f us, stddev %.1f us, max %.1f us",
+             after.mean, after.stddev, after.max);
+    TEST_MESSAGE(msg);
+
+    TEST_ASSERT_TRUE(after.stddev < before.stddev);
+    TEST_ASSERT_TRUE(after.max < before.max);
+}
+
+void setup() {
+    delay(2000);
+
+    UNITY_BEGIN();
+
+    RUN_TEST(test_baseline_converges);
+    RUN_TEST(test_baseline_rejects_spikes);
+    RUN_TEST(test_baseline_drift_fit);
+    RUN_TEST(test_read_analytes_timing);
+
+    UNITY_END();
+}
+
+void loop() {
+    // Tests run once in setup()
+}
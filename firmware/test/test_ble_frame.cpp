@@ -0,0 +1,218 @@
+/**
+ * @file test_ble_frame.cpp
+ * @brief Unit tests for the notification frame layer and reassembler
+ *
+ * Tests header encoding, reassembly across fragments and sequence wrap,
+ * immediate resync after a lost fragment, gap counting, and a lossy
+ * stream end to end
+ */
+
+#include <unity.h>
+#include "ble_frame.h"
+#include "tx_queue.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+TxQueue txQueue;
+FrameReassembler reassembler;
+uint8_t payload[FRAME_MAX_PACKET];
+
+void setUp(void) {
+    // Set up runs before each test
+    txQueue.init();
+    reassembler.init();
+    for (uint16_t i = 0; i < sizeof(payload); i++) {
+        payload[i] = (uint8_t)(i * 7 + 3);
+    }
+}
+
+void tearDown(void) {
+    // Clean up runs after each test
+}
+
+// Queue one packet and move its notifications into frames[]; 0 if refused
+static uint8_t framePacket(uint8_t frames[][TX_SLOT_SIZE], uint8_t* lengths,
+                           uint8_t tag, uint16_t length, uint16_t notify_payload) {
+    uint8_t n = 0;
+    payload[0] = tag;
+    if (!txQueue.push(0, payload, length, notify_payload)) {
+        return 0;
+    }
+    const TxSlot* slot;
+    while ((slot = txQueue.peek()) != 0) {
+        memcpy(frames[n], slot->data, slot->length);
+        lengths[n++] = slot->length;
+        txQueue.pop();
+    }
+    return n;
+}
+
+/**
+ * Test headers round-trip and impossible ones are refused
+ */
+void test_header(void) {
+    FrameHeader header = {0xBEEF, 3, 5, 200};
+    FrameHeader decoded;
+    uint8_t bytes[8] = {0};
+
+    frameEncodeHeader(&header, bytes);
+    TEST_ASSERT_EQUAL_HEX8(0xEF, bytes[0]);
+    TEST_ASSERT_EQUAL_HEX8(0xBE, bytes[1]);
+    TEST_ASSERT_EQUAL_HEX8(0x34, bytes[2]);
+    TEST_ASSERT_TRUE(frameDecodeHeader(bytes, sizeof(bytes), &decoded));
+    TEST_ASSERT_EQUAL_UINT16(0xBEEF, decoded.seq);
+    TEST_ASSERT_EQUAL_UINT8(3, decoded.index);
+    TEST_ASSERT_EQUAL_UINT8(5, decoded.count);
+    TEST_ASSERT_EQUAL_UINT8(200, decoded.length);
+
+    // Index past the count, empty packet, header only
+    bytes[2] = 0x52;
+    TEST_ASSERT_FALSE(frameDecodeHeader(bytes, sizeof(bytes), &decoded));
+    bytes[2] = 0x00;
+    bytes[3] = 0;
+    TEST_ASSERT_FALSE(frameDecodeHeader(bytes, sizeof(bytes), &decoded));
+    bytes[3] = 1;
+    TEST_ASSERT_FALSE(frameDecodeHeader(bytes, FRAME_HEADER_SIZE, &decoded));
+
+    TEST_ASSERT_EQUAL_UINT8(2, frameFragmentsFor(32, 20));
+    TEST_ASSERT_EQUAL_UINT8(1, frameFragmentsFor(240, 244));
+    TEST_ASSERT_EQUAL_UINT8(0, frameFragmentsFor(17 * 16, 20));
+    TEST_ASSERT_EQUAL_UINT8(0, frameFragmentsFor(FRAME_MAX_PACKET + 1, 244));
+}
+
+/**
+ * Test packets reassemble in order, including across the sequence wrap
+ */
+void test_reassembly(void) {
+    uint8_t frames[FRAME_MAX_FRAGMENTS][TX_SLOT_SIZE];
+    uint8_t lengths[FRAME_MAX_FRAGMENTS];
+
+    for (uint16_t p = 0; p < 3; p++) {
+        uint8_t n = framePacket(frames, lengths, (uint8_t)p, 48 + p * 16, 20);
+        TEST_ASSERT_EQUAL_UINT8(3 + p, n);
+        for (uint8_t i = 0; i < n; i++) {
+            TEST_ASSERT_EQUAL(i == n - 1, reassembler.feed(frames[i], lengths[i]));
+        }
+        TEST_ASSERT_EQUAL_UINT16(p, reassembler.packetSeq());
+        TEST_ASSERT_EQUAL_UINT8(48 + p * 16, reassembler.packetLength());
+        TEST_ASSERT_EQUAL_MEMORY(payload, reassembler.packet(), 48 + p * 16);
+    }
+
+    // Hand-built frames either side of 0xFFFF: no gap
+    uint8_t frame[8] = {0, 0, 0x00, 4, 1, 2, 3, 4};
+    FrameHeader header = {0xFFFF, 0, 1, 4};
+    FrameReassembler wrap;
+    wrap.init();
+    frameEncodeHeader(&header, frame);
+    TEST_ASSERT_TRUE(wrap.feed(frame, sizeof(frame)));
+    header.seq = 0;
+    frameEncodeHeader(&header, frame);
+    TEST_ASSERT_TRUE(wrap.feed(frame, sizeof(frame)));
+    TEST_ASSERT_EQUAL_UINT32(0, wrap.stats()->gaps);
+    TEST_ASSERT_EQUAL_UINT32(2, wrap.stats()->packets);
+}
+
+/**
+ * Test a lost fragment costs only its own packet and a lost packet shows
+ * up as a gap
+ */
+void test_resync(void) {
+    uint8_t frames[4][FRAME_MAX_FRAGMENTS][TX_SLOT_SIZE];
+    uint8_t lengths[4][FRAME_MAX_FRAGMENTS];
+    uint8_t counts[4];
+
+    for (uint8_t p = 0; p < 4; p++) {
+        counts[p] = framePacket(frames[p], lengths[p], p, 64, 20);
+    }
+
+    // Packet 0 loses its second fragment; packet 1 arrives whole
+    reassembler.feed(frames[0][0], lengths[0][0]);
+    for (uint8_t i = 2; i < counts[0]; i++) {
+        TEST_ASSERT_FALSE(reassembler.feed(frames[0][i], lengths[0][i]));
+    }
+    for (uint8_t i = 0; i < counts[1]; i++) {
+        TEST_ASSERT_EQUAL(i == counts[1] - 1, reassembler.feed(frames[1][i], lengths[1][i]));
+    }
+    TEST_ASSERT_EQUAL_UINT8(1, reassembler.packet()[0]);
+    TEST_ASSERT_EQUAL_UINT32(1, reassembler.stats()->incomplete);
+    TEST_ASSERT_EQUAL_UINT32(0, reassembler.stats()->gaps);
+
+    // Packet 2 never arrives; joining packet 3 mid-way waits for the next
+    TEST_ASSERT_FALSE(reassembler.feed(frames[3][1], lengths[3][1]));
+    TEST_ASSERT_EQUAL_UINT32(1, reassembler.stats()->gaps);
+    TEST_ASSERT_EQUAL_UINT32(1, reassembler.stats()->lost);
+    TEST_ASSERT_EQUAL_UINT32(2, reassembler.stats()->incomplete);
+
+    // Garbage is counted, not fatal
+    uint8_t junk[3] = {1, 2, 3};
+    TEST_ASSERT_FALSE(reassembler.feed(junk, sizeof(junk)));
+    TEST_ASSERT_EQUAL_UINT32(1, reassembler.stats()->malformed);
+    TEST_ASSERT_EQUAL_UINT32(1, reassembler.stats()->packets);
+}
+
+/**
+ * Test a session with random notification loss keeps every packet whose
+ * notifications all arrived
+ */
+void test_lossy_stream(void) {
+    static uint8_t frames[FRAME_MAX_FRAGMENTS][TX_SLOT_SIZE];
+    uint8_t lengths[FRAME_MAX_FRAGMENTS];
+    const uint16_t PACKETS = 2000;
+    uint32_t intact = 0;
+    uint32_t dropped = 0;
+    uint32_t notifications = 0;
+    char msg[160];
+
+    srand(42);
+    for (uint16_t p = 0; p < PACKETS; p++) {
+        uint16_t length = 16 + 16 * (rand() % 6);
+        uint8_t n = framePacket(frames, lengths, (uint8_t)p, length, 20);
+        bool whole = true;
+        bool delivered = false;
+
+        for (uint8_t i = 0; i < n; i++) {
+            notifications++;
+            if (rand() % 100 < 3) {
+                whole = false;
+                dropped++;
+                continue;
+            }
+            delivered |= reassembler.feed(frames[i], lengths[i]);
+        }
+        TEST_ASSERT_EQUAL(whole, delivered);
+        if (delivered) {
+            TEST_ASSERT_EQUAL_UINT8((uint8_t)p, reassembler.packet()[0]);
+            TEST_ASSERT_EQUAL_UINT8(length, reassembler.packetLength());
+            intact++;
+        }
+    }
+
+    const FrameStats* stats = reassembler.stats();
+    TEST_ASSERT_EQUAL_UINT32(intact, stats->packets);
+    TEST_ASSERT_EQUAL_UINT32(PACKETS, stats->packets + stats->incomplete + stats->lost);
+    TEST_ASSERT_EQUAL_UINT32(0, stats->malformed);
+
+    snprintf(msg, sizeof(msg),
+             "%lu/%lu notifications lost: %lu/%u packets delivered, %lu incomplete, %lu unseen in %lu gaps",
+             (unsigned long)dropped, (unsigned long)notifications, (unsigned long)stats->packets, PACKETS,
+             (unsigned long)stats->incomplete, (unsigned long)stats->lost, (unsigned long)stats->gaps);
+    TEST_MESSAGE(msg);
+}
+
+void setup() {
+    delay(2000);
+
+    UNITY_BEGIN();
+
+    RUN_TEST(test_header);
+    RUN_TEST(test_reassembly);
+    RUN_TEST(test_resync);
+    RUN_TEST(test_lossy_stream);
+
+    UNITY_END();
+}
+
+void loop() {
+    // Tests run once in setup()
+}
@@ -0,0 +1,156 @@
+/**
+ * @file test_ble_link.cpp
+ * @brief Unit tests for BLE MTU / data length negotiation and sizing
+ *
+ * Tests negotiation against centrals of different capability, how many
+ * notifications and link-layer packets a payload costs, the transmit
+ * statistics, and PHY selection with its air time
+ */
+
+#include <unity.h>
+#include "ble_link.h"
+#include "sys_time.h"
+#include <stdio.h>
+
+BleLink link;
+
+void setUp(void) {
+    // Set up runs before each test
+    sysTimeSetVirtual(true);
+    link.init();
+}
+
+void tearDown(void) {
+    // Clean up runs after each test
+    sysTimeSetVirtual(false);
+}
+
+/**
+ * Test a central without an MTU exchange keeps the 20-byte notifications
+ */
+void test_default_link(void) {
+    link.onConnect("00:11:22:33:44:55");
+
+    TEST_ASSERT_EQUAL_UINT16(BLE_ATT_MTU_DEFAULT, link.attMtu());
+    TEST_ASSERT_EQUAL_UINT16(BLE_DATA_LENGTH_DEFAULT, link.dataLength());
+    TEST_ASSERT_EQUAL_UINT16(20, link.notifyPayload());
+
+    // 64-byte encrypted reading: four notifications, one LL packet each
+    TEST_ASSERT_EQUAL_UINT16(4, link.notificationsFor(64));
+    TEST_ASSERT_EQUAL_UINT16(4, link.linkPacketsFor(64));
+    TEST_ASSERT_EQUAL_UINT16(1, link.notificationsFor(16));
+}
+
+/**
+ * Test the negotiated values are the smaller of both sides, capped at
+ * what the controller supports
+ */
+void test_negotiation(void) {
+    link.setPeer(185, 251);
+    link.onConnect("00:11:22:33:44:55");
+    TEST_ASSERT_EQUAL_UINT16(185, link.attMtu());
+    TEST_ASSERT_EQUAL_UINT16(251, link.dataLength());
+    TEST_ASSERT_EQUAL_UINT16(182, link.notifyPayload());
+
+    link.setPeer(517, 251);
+    link.onConnect("00:11:22:33:44:55");
+    TEST_ASSERT_EQUAL_UINT16(BLE_ATT_MTU_MAX, link.attMtu());
+    TEST_ASSERT_EQUAL_UINT16(1, link.notificationsFor(64));
+    TEST_ASSERT_EQUAL_UINT16(1, link.linkPacketsFor(64));
+    TEST_ASSERT_EQUAL_UINT16(1, link.linkPacketsFor(244));
+    TEST_ASSERT_EQUAL_UINT16(2, link.notificationsFor(245));
+
+    // Large MTU without DLE: one notification, fragmented on the link
+    link.setPeer(247, 27);
+    link.onConnect("00:11:22:33:44:55");
+    TEST_ASSERT_EQUAL_UINT16(1, link.notificationsFor(64));
+    TEST_ASSERT_EQUAL_UINT16(3, link.linkPacketsFor(64));
+
+    // Disconnect falls back until the next exchange
+    link.onDisconnect();
+    TEST_ASSERT_EQUAL_UINT16(BLE_ATT_MTU_DEFAULT, link.attMtu());
+    TEST_ASSERT_EQUAL_UINT16(BLE_DATA_LENGTH_DEFAULT, link.dataLength());
+}
+
+/**
+ * Test throughput and notifications per payload over a window
+ */
+void test_link_stats(void) {
+    BleLinkStats stats;
+    char msg[96];
+
+    // 64 readings of 64 bytes over 2 s at the default MTU
+    link.onConnect("00:11:22:33:44:55");
+    for (uint8_t i = 0; i < 64; i++) {
+        link.record(64, link.notificationsFor(64));
+    }
+    sysDelay(2000);
+    link.stats(&stats);
+    TEST_ASSERT_EQUAL_UINT32(64, stats.payloads);
+    TEST_ASSERT_EQUAL_UINT32(256, stats.notifications);
+    TEST_ASSERT_EQUAL_UINT32(256, stats.link_packets);
+    TEST_ASSERT_EQUAL_UINT32(2048, stats.bytes_per_sec);
+    TEST_ASSERT_EQUAL_UINT16(400, stats.notifications_per_payload_x100);
+    uint32_t default_notifications = stats.notifications;
+
+    // The same readings once MTU and data length are negotiated
+    link.setPeer(247, 251);
+    link.onConnect("00:11:22:33:44:55");
+    link.stats(&stats);
+    TEST_ASSERT_EQUAL_UINT32(0, stats.payloads);
+    for (uint8_t i = 0; i < 64; i++) {
+        link.record(64, link.notificationsFor(64));
+    }
+    sysDelay(1000);
+    link.stats(&stats);
+    TEST_ASSERT_EQUAL_UINT32(64, stats.notifications);
+    TEST_ASSERT_EQUAL_UINT32(64, stats.link_packets);
+    TEST_ASSERT_EQUAL_UINT32(4096, stats.bytes_per_sec);
+    TEST_ASSERT_EQUAL_UINT16(100, stats.notifications_per_payload_x100);
+
+    snprintf(msg, sizeof(msg), "64-byte reading: %lu -> %lu notifications per 64 readings",
+             (unsigned long)default_notifications, (unsigned long)stats.notifications);
+    TEST_MESSAGE(msg);
+}
+
+/**
+ * Test the PHY follows what the central supports and a full notification
+ * takes roughly half the air time on the 2M PHY
+ */
+void test_phy_air_time(void) {
+    link.setPeer(247, 251, BLE_PHY_1M);
+    link.onConnect("00:11:22:33:44:55");
+    TEST_ASSERT_EQUAL_UINT8(BLE_PHY_1M, link.phy());
+    link.setPhy(BLE_PHY_2M);
+    TEST_ASSERT_EQUAL_UINT8(BLE_PHY_1M, link.phy());
+
+    // 251-byte LL packet, empty acknowledgement, two inter-frame spaces
+    TEST_ASSERT_EQUAL_UINT32(2468, link.airTimeUsFor(244));
+
+    link.setPeer(247, 251, BLE_PHY_2M);
+    link.onConnect("00:11:22:33:44:55");
+    link.setPhy(BLE_PHY_2M);
+    TEST_ASSERT_EQUAL_UINT8(BLE_PHY_2M, link.phy());
+    TEST_ASSERT_EQUAL_UINT32(1392, link.airTimeUsFor(244));
+
+    // A new connection starts on the 1M PHY again
+    link.onConnect("00:11:22:33:44:55");
+    TEST_ASSERT_EQUAL_UINT8(BLE_PHY_1M, link.phy());
+}
+
+void setup() {
+    delay(2000);
+
+    UNITY_BEGIN();
+
+    RUN_TEST(test_default_link);
+    RUN_TEST(test_negotiation);
+    RUN_TEST(test_link_stats);
+    RUN_TEST(test_phy_air_time);
+
+    UNITY_END();
+}
+
+void loop() {
+    // Tests run once in setup()
+}
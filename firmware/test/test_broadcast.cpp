@@ -0,0 +1,149 @@
+/**
+ * @file test_broadcast.cpp
+ * @brief Unit tests for the advertised reading snapshot
+ *
+ * Tests the sealed snapshot fits a legacy advertising packet, opens to the
+ * same reading, and that receivers refuse tampered, foreign and replayed
+ * payloads
+ */
+
+#include <unity.h>
+#include "broadcast.h"
+#include "reading_codec.h"
+#include <string.h>
+
+static const uint8_t key[16] = {
+    0x2B, 0x7E, 0x15, 0x16, 0x28, 0xAE, 0xD2, 0xA6, 0xAB, 0xF7, 0x15, 0x88, 0x09, 0xCF, 0x4F, 0x3C
+};
+
+ReadingCodec codec;
+BroadcastKeys keys;
+BroadcastReceiver receiver;
+
+static uint8_t sealReading(uint32_t counter, uint8_t* out) {
+    SensorReading r;
+    r.serotonin_nm = 250.0f;
+    r.dopamine_nm = 120.0f;
+    r.gaba_nm = 900.0f;
+    r.ph_level = 6.8f;
+    r.temperature_c = 37.2f;
+    r.calprotectin_ug_g = 40.0f;
+    r.timestamp_ms = 60000 + counter;
+
+    uint8_t plain[CODEC_MAX_SIZE];
+    uint8_t length = codec.encode(&r, 0x3F, plain);
+    return broadcastSeal(&keys, counter, plain, length, out);
+}
+
+void setUp(void) {
+    // Set up runs before each test
+    codec.init();
+    broadcastDeriveKeys(key, &keys);
+    receiver.init(key);
+}
+
+void tearDown(void) {
+    // Clean up runs after each test
+}
+
+/**
+ * Test a full reading seals into the advertising packet and opens back to
+ * it; the ciphertext changes with the counter
+ */
+void test_seal_open(void) {
+    uint8_t payload[BROADCAST_MAX_SIZE];
+    uint8_t length = sealReading(7, payload);
+    TEST_ASSERT_EQUAL_UINT8(BROADCAST_MAX_SIZE, length);
+    TEST_ASSERT_TRUE(BROADCAST_ADV_OVERHEAD + length <= BROADCAST_ADV_MAX);
+    TEST_ASSERT_EQUAL_UINT8(BROADCAST_VERSION, payload[0]);
+    TEST_ASSERT_EQUAL_UINT8(7, payload[1]);
+
+    uint32_t counter = 0;
+    uint8_t plain[BROADCAST_MAX_PLAIN];
+    uint8_t plain_length = broadcastOpen(&keys, payload, length, &counter, plain);
+    TEST_ASSERT_EQUAL_UINT8(12, plain_length);
+    TEST_ASSERT_EQUAL_UINT32(7, counter);
+
+    SensorReading r;
+    TEST_ASSERT_EQUAL_UINT8(0x3F, codec.decode(plain, plain_length, &r));
+    TEST_ASSERT_EQUAL_UINT32(60007, r.timestamp_ms);
+    TEST_ASSERT_FLOAT_WITHIN(250.0f * 0.005f, 250.0f, r.serotonin_nm);
+    TEST_ASSERT_FLOAT_WITHIN(0.01f, 6.8f, r.ph_level);
+
+    // Next counter: a new keystream for the same reading layout
+    uint8_t other[BROADCAST_MAX_SIZE];
+    sealReading(8, other);
+    TEST_ASSERT_FALSE(memcmp(payload + BROADCAST_HEADER_SIZE, other + BROADCAST_HEADER_SIZE,
+                             BROADCAST_MAX_PLAIN) == 0);
+}
+
+/**
+ * Test any changed byte, a truncated payload and a different key are all
+ * refused
+ */
+void test_forgery(void) {
+    uint8_t payload[BROADCAST_MAX_SIZE];
+    uint8_t length = sealReading(100, payload);
+    uint32_t counter;
+    uint8_t plain[BROADCAST_MAX_PLAIN];
+
+    for (uint8_t i = 0; i < length; i++) {
+        uint8_t tampered[BROADCAST_MAX_SIZE];
+        memcpy(tampered, payload, length);
+        tampered[i] ^= 0x01;
+        TEST_ASSERT_EQUAL_UINT8(0, broadcastOpen(&keys, tampered, length, &counter, plain));
+    }
+    TEST_ASSERT_EQUAL_UINT8(0, broadcastOpen(&keys, payload, length - 1, &counter, plain));
+
+    uint8_t other_key[16];
+    memcpy(other_key, key, sizeof(other_key));
+    other_key[15] ^= 0x80;
+    BroadcastKeys other;
+    broadcastDeriveKeys(other_key, &other);
+    TEST_ASSERT_EQUAL_UINT8(0, broadcastOpen(&other, payload, length, &counter, plain));
+}
+
+/**
+ * Test the receiver takes each counter once and only moving forward, the
+ * way a hub sees repeated and replayed advertisements
+ */
+void test_replay(void) {
+    uint8_t first[BROADCAST_MAX_SIZE];
+    uint8_t second[BROADCAST_MAX_SIZE];
+    uint8_t length = sealReading(1000, first);
+    sealReading(1001, second);
+    uint32_t counter;
+    uint8_t plain[BROADCAST_MAX_PLAIN];
+
+    TEST_ASSERT_EQUAL_UINT8(12, receiver.receive(first, length, &counter, plain));
+    TEST_ASSERT_EQUAL_UINT32(1000, counter);
+
+    // The same advertisement heard again, then an old one replayed
+    TEST_ASSERT_EQUAL_UINT8(0, receiver.receive(first, length, &counter, plain));
+    TEST_ASSERT_EQUAL_UINT8(12, receiver.receive(second, length, &counter, plain));
+    TEST_ASSERT_EQUAL_UINT8(0, receiver.receive(first, length, &counter, plain));
+
+    second[3] ^= 0xFF;
+    TEST_ASSERT_EQUAL_UINT8(0, receiver.receive(second, length, &counter, plain));
+
+    const BroadcastStats* stats = receiver.stats();
+    TEST_ASSERT_EQUAL_UINT32(2, stats->accepted);
+    TEST_ASSERT_EQUAL_UINT32(2, stats->replayed);
+    TEST_ASSERT_EQUAL_UINT32(1, stats->forged);
+}
+
+void setup() {
+    delay(2000);
+
+    UNITY_BEGIN();
+
+    RUN_TEST(test_seal_open);
+    RUN_TEST(test_forgery);
+    RUN_TEST(test_replay);
+
+    UNITY_END();
+}
+
+void loop() {
+    // Tests run once in setup()
+}
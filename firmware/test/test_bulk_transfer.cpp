@@ -0,0 +1,286 @@
+/**
+ * @file test_bulk_transfer.cpp
+ * @brief Unit tests for the credit-paced history download
+ *
+ * Tests the offline log arriving whole and in order over the link loopback,
+ * the transfer holding at zero credits and resuming on a grant, and the
+ * throughput at each PHY and MTU, on the virtual clock
+ */
+
+#include <unity.h>
+#include "bulk_transfer.h"
+#include "link_loopback.h"
+#include "sample_log.h"
+#include "reading_codec.h"
+#include "ble_frame.h"
+#include "aes.h"
+#include "sys_time.h"
+#include <stdio.h>
+#include <string.h>
+
+#define FLASH_IMAGE     "/tmp/symbion_test_bulk.bin"
+#define OFFLINE         3000    // 50 minutes at one reading a second
+#define CREDITS         16      // Packets the central can buffer
+#define CREDIT_BATCH    8       // Returned once this many are processed
+
+FlashDevice flash;
+SampleLog sampleLog;
+BulkTransfer bulk;
+BleLink link;
+TxQueue txQueue;
+LinkLoopback loopback;
+const uint8_t key[16] = {0x2b, 0x7e, 0x15, 0x16, 0x28, 0xae, 0xd2, 0xa6,
+                         0xab, 0xf7, 0x15, 0x88, 0x09, 0xcf, 0x4f, 0x3c};
+
+// The app's side: reassemble, decrypt, check numbering, return credits
+typedef struct {
+    FrameReassembler frames;
+    ReadingCodec codec;
+    bool granting;
+    uint32_t granted;       // Credits handed out, the initial ones included
+    uint32_t packets;
+    uint32_t processed;     // Since credits were last returned
+    uint32_t readings;
+    uint32_t next;          // Expected first reading of the next packet
+    uint32_t end;           // From the end marker
+    bool done;
+    bool contiguous;
+    bool overrun;           // More packets than credits
+} Central;
+
+Central central;
+
+static void centralReset(uint32_t from) {
+    central.frames.init();
+    central.codec.init();
+    central.granting = true;
+    central.granted = CREDITS;
+    central.packets = 0;
+    central.processed = 0;
+    central.readings = 0;
+    central.next = from;
+    central.end = 0;
+    central.done = false;
+    central.contiguous = true;
+    central.overrun = false;
+}
+
+static void centralReceive(uint8_t target, const uint8_t* data, uint8_t length, void* context) {
+    (void)target;
+    (void)context;
+    if (!central.frames.feed(data, length)) return;
+
+    uint8_t packet[FRAME_MAX_PACKET];
+    uint16_t plain = aes128_decrypt(central.frames.packet(), packet, key, central.frames.packetLength());
+    if (plain < LOG_PACKET_HEADER) {
+        central.contiguous = false;
+        return;
+    }
+
+    central.packets++;
+    if (central.packets > central.granted) {
+        central.overrun = true;
+    }
+
+    uint32_t first = packet[0] | (packet[1] << 8) | (packet[2] << 16) | ((uint32_t)packet[3] << 24);
+    if (plain == LOG_PACKET_HEADER) {
+        central.end = first;
+        central.done = true;
+        return;
+    }
+    if (first != central.next) {
+        central.contiguous = false;
+    }
+
+    uint16_t at = LOG_PACKET_HEADER;
+    uint32_t count = 0;
+    while (at < plain) {
+        SensorReading r;
+        uint8_t mask = central.codec.decode(packet + at, plain - at, &r);
+        if (mask == 0 || r.timestamp_ms != (first + count) * 1000) {
+            central.contiguous = false;
+            break;
+        }
+        at += central.codec.size(mask);
+        count++;
+    }
+    central.readings += count;
+    central.next = first + count;
+
+    if (central.granting && ++central.processed == CREDIT_BATCH) {
+        central.processed = 0;
+        central.granted += CREDIT_BATCH;
+        bulk.grant(CREDIT_BATCH);
+    }
+}
+
+// The firmware's main loop while a transfer runs
+static void firmwarePump(void* context) {
+    (void)context;
+    bulk.service(&sampleLog, &txQueue, &link, 0, key, sysMillis());
+}
+
+static void logReadings(uint32_t count) {
+    for (uint32_t i = 0; i < count; i++) {
+        SensorReading r;
+        memset(&r, 0, sizeof(r));
+        r.timestamp_ms = i * 1000;
+        r.serotonin_nm = 100.0f + (i % 50);
+        r.dopamine_nm = 200.0f;
+        r.gaba_nm = 1000.0f;
+        r.ph_level = 6.5f;
+        r.temperature_c = 37.0f;
+        r.calprotectin_ug_g = 50.0f;
+        sampleLog.append(&r, ADC_ALL_CHANNELS, i * 1000);
+    }
+    sampleLog.flush();
+}
+
+// Connect with what the central supports and download from the start
+static void connect(uint16_t mtu, uint16_t data_length, uint8_t phy) {
+    link.setPeer(mtu, data_length, phy);
+    link.onConnect("");
+    txQueue.init();
+    loopback.init(&link, &txQueue);
+    loopback.setPump(firmwarePump, 0);
+    loopback.setReceiver(centralReceive, 0);
+
+    centralReset(0);
+    sampleLog.seek(0);
+    link.setPhy(BLE_PHY_2M);
+    bulk.start(CREDITS, sysMillis());
+}
+
+static void runTransfer(uint32_t max_events) {
+    for (uint32_t i = 0; i < max_events && !central.done; i++) {
+        loopback.connectionEvent();
+    }
+}
+
+void setUp(void) {
+    // Set up runs before each test
+    remove(FLASH_IMAGE);
+    sysTimeSetVirtual(true);
+    flash.init(FLASH_LOG_BASE, FLASH_LOG_PAGES);
+    flash.open(FLASH_IMAGE, FLASH_LOG_PAGES);
+    sampleLog.init(&flash);
+    logReadings(OFFLINE);
+    link.init();
+    bulk.init();
+}
+
+void tearDown(void) {
+    // Clean up runs after each test
+    flash.close();
+    remove(FLASH_IMAGE);
+    sysTimeSetVirtual(false);
+}
+
+/**
+ * Test the whole log arrives in order, ends with the marker and never
+ * outruns the central's credits
+ */
+void test_bulk_delivers_log(void) {
+    connect(BLE_ATT_MTU_MAX, BLE_DATA_LENGTH_MAX, BLE_PHY_2M);
+    runTransfer(10000);
+
+    TEST_ASSERT_TRUE(central.done);
+    TEST_ASSERT_TRUE(central.contiguous);
+    TEST_ASSERT_FALSE(central.overrun);
+    TEST_ASSERT_EQUAL_UINT32(OFFLINE, central.readings);
+    TEST_ASSERT_EQUAL_UINT32(OFFLINE, central.end);
+    TEST_ASSERT_EQUAL_UINT32(0, central.frames.stats()->lost);
+
+    const BulkStats* stats = bulk.stats();
+    TEST_ASSERT_FALSE(bulk.active());
+    TEST_ASSERT_EQUAL_UINT32(OFFLINE, stats->readings);
+    TEST_ASSERT_EQUAL_UINT32(central.packets, stats->packets);
+    TEST_ASSERT_EQUAL_UINT8(BLE_PHY_2M, stats->phy);
+    TEST_ASSERT_TRUE(stats->elapsed_ms > 0);
+    TEST_ASSERT_TRUE(stats->bytes_per_sec > 0);
+}
+
+/**
+ * Test the transfer holds once the credits are spent and carries on from
+ * the same place when the central grants more
+ */
+void test_credits_pace_transfer(void) {
+    connect(BLE_ATT_MTU_MAX, BLE_DATA_LENGTH_MAX, BLE_PHY_2M);
+    central.granting = false;
+    runTransfer(100);
+
+    TEST_ASSERT_FALSE(central.done);
+    TEST_ASSERT_TRUE(bulk.active());
+    TEST_ASSERT_EQUAL_UINT32(CREDITS, central.packets);
+    TEST_ASSERT_TRUE(bulk.stats()->credit_stalls > 0);
+    TEST_ASSERT_TRUE(loopback.stats()->idle_events > 0);
+
+    central.granting = true;
+    central.granted += CREDITS;
+    bulk.grant(CREDITS);
+    runTransfer(10000);
+
+    TEST_ASSERT_TRUE(central.done);
+    TEST_ASSERT_TRUE(central.contiguous);
+    TEST_ASSERT_FALSE(central.overrun);
+    TEST_ASSERT_EQUAL_UINT32(OFFLINE, central.readings);
+}
+
+/**
+ * Test the 2M PHY beats the 1M PHY at the largest MTU, and report what
+ * each link achieves
+ */
+void test_bulk_throughput(void) {
+    typedef struct {
+        const char* name;
+        uint16_t mtu;
+        uint16_t data_length;
+        uint8_t phy;
+    } LinkCase;
+    const LinkCase cases[3] = {
+        {"MTU 247 2M", BLE_ATT_MTU_MAX, BLE_DATA_LENGTH_MAX, BLE_PHY_2M},
+        {"MTU 247 1M", BLE_ATT_MTU_MAX, BLE_DATA_LENGTH_MAX, BLE_PHY_1M},
+        {"MTU 23 1M", BLE_ATT_MTU_DEFAULT, BLE_DATA_LENGTH_DEFAULT, BLE_PHY_1M},
+    };
+    uint32_t rate[3];
+
+    for (uint8_t c = 0; c < 3; c++) {
+        bulk.init();
+        connect(cases[c].mtu, cases[c].data_length, cases[c].phy);
+        runTransfer(100000);
+
+        TEST_ASSERT_TRUE(central.done);
+        TEST_ASSERT_TRUE(central.contiguous);
+        TEST_ASSERT_FALSE(central.overrun);
+        TEST_ASSERT_EQUAL_UINT32(OFFLINE, central.readings);
+        TEST_ASSERT_EQUAL_UINT8(cases[c].phy, bulk.stats()->phy);
+
+        const BulkStats* stats = bulk.stats();
+        rate[c] = stats->bytes_per_sec;
+        char msg[128];
+        snprintf(msg, sizeof(msg), "%s: %lu readings in %lu ms, %.1f kB/s, %.0f%% of events used",
+                 cases[c].name, (unsigned long)stats->readings, (unsigned long)stats->elapsed_ms,
+                 stats->bytes_per_sec / 1000.0f,
+                 100.0f * loopback.stats()->air_us / ((float)loopback.stats()->events * LOOPBACK_INTERVAL_US));
+        TEST_MESSAGE(msg);
+    }
+
+    TEST_ASSERT_TRUE(rate[0] > rate[1]);
+    TEST_ASSERT_TRUE(rate[1] > rate[2]);
+}
+
+void setup() {
+    delay(2000);
+
+    UNITY_BEGIN();
+
+    RUN_TEST(test_bulk_delivers_log);
+    RUN_TEST(test_credits_pace_transfer);
+    RUN_TEST(test_bulk_throughput);
+
+    UNITY_END();
+}
+
+void loop() {
+    // Tests run once in setup()
+}
@@ -0,0 +1,215 @@
+/**
+ * @file test_calibration_lut.cpp
+ * @brief Unit tests for multi-point calibration lookup tables
+ *
+ * Tests table construction, grid lookup against the calibration curve,
+ * temperature compensation and the calibration-point procedure
+ */
+
+#include <unity.h>
+#include "calibration_lut.h"
+#include "sensor_manager.h"
+#include <math.h>
+
+#define MV_PER_COUNT    (3300.0f / 4095.0f)
+
+ChannelLut lut;
+FixedChannelLut fixedLut;
+
+void setUp(void) {
+    // Set up runs before each test
+}
+
+void tearDown(void) {
+    // Clean up runs after each test
+}
+
+/**
+ * Test two standards reproduce the straight line through them
+ */
+void test_lut_two_points(void) {
+    CalPoint points[2] = {
+        {400.0f, 100.0f, 25.0f},
+        {1200.0f, 900.0f, 25.0f},
+    };
+
+    TEST_ASSERT_TRUE(buildChannelLut(&lut, points, 2, MV_PER_COUNT, 0.0f, 0.0f,
+                                     0.02f, -1e9f, 1e9f));
+    TEST_ASSERT_FLOAT_WITHIN(1e-4f, 25.0f, lut.ref_temp_c);
+
+    for (uint16_t raw = 0; raw < 4096; raw += 37) {
+        float expected = 100.0f + (raw * MV_PER_COUNT - 400.0f);
+        TEST_ASSERT_FLOAT_WITHIN(0.01f, expected, convertChannelLut(&lut, raw, 1.0f));
+    }
+}
+
+/**
+ * Test a curved response follows each segment, order and repeats ignored
+ */
+void test_lut_piecewise(void) {
+    CalPoint points[4] = {
+        {2000.0f, 1000.0f, 36.0f},
+        {500.0f, 100.0f, 38.0f},
+        {1000.0f, 600.0f, 37.0f},
+        {1000.2f, 600.0f, 37.0f},     // Same standard measured twice
+    };
+
+    TEST_ASSERT_TRUE(buildChannelLut(&lut, points, 4, MV_PER_COUNT, 0.0f, 0.0f,
+                                     0.0f, -1e9f, 1e9f));
+    TEST_ASSERT_FLOAT_WITHIN(1e-4f, 37.0f, lut.ref_temp_c);
+
+    // Away from the knee the grid reproduces the segments exactly
+    uint16_t raw = (uint16_t)(750.0f / MV_PER_COUNT);
+    TEST_ASSERT_FLOAT_WITHIN(0.05f, 100.0f + (raw * MV_PER_COUNT - 500.0f),
+                             convertChannelLut(&lut, raw, 1.0f));
+    raw = (uint16_t)(1500.0f / MV_PER_COUNT);
+    TEST_ASSERT_FLOAT_WITHIN(0.05f, 600.0f + 0.4f * (raw * MV_PER_COUNT - 1000.0f),
+                             convertChannelLut(&lut, raw, 1.0f));
+
+    // Within one cell of the knee, no worse than the chord across it
+    raw = (uint16_t)(1000.0f / MV_PER_COUNT);
+    TEST_ASSERT_FLOAT_WITHIN(0.6f * 128 * MV_PER_COUNT, 600.0f, convertChannelLut(&lut, raw, 1.0f));
+
+    // Monotone like the points
+    float prev = convertChannelLut(&lut, 0, 1.0f);
+    for (uint16_t r = 1; r < 4096; r++) {
+        float v = convertChannelLut(&lut, r, 1.0f);
+        TEST_ASSERT_TRUE(v >= prev);
+        prev = v;
+    }
+}
+
+/**
+ * Test degenerate point sets leave the table unbuilt
+ */
+void test_lut_rejects_single_standard(void) {
+    CalPoint points[2] = {
+        {800.0f, 50.0f, 25.0f},
+        {800.1f, 50.0f, 25.0f},
+    };
+
+    TEST_ASSERT_FALSE(buildChannelLut(&lut, points, 1, MV_PER_COUNT, 0.0f, 0.0f, 0.0f, -1e9f, 1e9f));
+    TEST_ASSERT_FALSE(buildChannelLut(&lut, points, 2, MV_PER_COUNT, 0.0f, 0.0f, 0.0f, -1e9f, 1e9f));
+}
+
+/**
+ * Test temperature divides the response about the zero point, and the
+ * fixed-point table agrees with the float one
+ */
+void test_lut_temperature_and_fixed(void) {
+    CalPoint points[2] = {
+        {0.0f, 7.0f, 25.0f},
+        {591.6f, -3.0f, 25.0f},     // pH 7 at 0 mV, -59.16 mV/pH
+    };
+
+    TEST_ASSERT_TRUE(buildChannelLut(&lut, points, 2, MV_PER_COUNT, 0.0f, 7.0f,
+                                     0.003354f, 0.0f, 14.0f));
+    buildFixedLut(&fixedLut, &lut);
+
+    uint16_t raw = (uint16_t)(295.8f / MV_PER_COUNT);
+    float at_ref = convertChannelLut(&lut, raw, lutCompensation(&lut, 25.0f));
+    float warm = convertChannelLut(&lut, raw, lutCompensation(&lut, 37.0f));
+    TEST_ASSERT_FLOAT_WITHIN(0.01f, 2.0f, at_ref);
+    TEST_ASSERT_FLOAT_WITHIN(0.01f, 7.0f - 5.0f / (1.0f + 0.003354f * 12.0f), warm);
+
+    for (uint16_t r = 0; r < 4096; r += 13) {
+        for (int t = 20; t <= 45; t += 5) {
+            float expected = convertChannelLut(&lut, r, lutCompensation(&lut, (float)t));
+            int32_t q = convertChannelLutFixed(&fixedLut, r, lutCompensationFixed(&fixedLut, t << FIXED_FRAC_BITS));
+            TEST_ASSERT_FLOAT_WITHIN(3.0f / (1 << FIXED_FRAC_BITS), expected, q / (float)(1 << FIXED_FRAC_BITS));
+        }
+    }
+}
+
+/**
+ * Test an amperometric response that rises with temperature converts to
+ * the same concentration at any temperature
+ */
+void test_lut_temperature_cancels_drift(void) {
+    CalPoint points[2] = {
+        {200.0f, 100.0f, 25.0f},
+        {1000.0f, 500.0f, 25.0f},   // 0.5 nM/mV through zero
+    };
+
+    TEST_ASSERT_TRUE(buildChannelLut(&lut, points, 2, MV_PER_COUNT, 0.0f, 0.0f,
+                                     0.02f, -1e9f, 1e9f));
+    buildFixedLut(&fixedLut, &lut);
+
+    for (int t = 20; t <= 45; t += 5) {
+        // Sensor reads 2 %/C high when warm
+        float mv = 800.0f * (1.0f + 0.02f * (t - 25));
+        uint16_t raw = (uint16_t)(mv / MV_PER_COUNT + 0.5f);
+        float tolerance = 0.5f * MV_PER_COUNT;
+        TEST_ASSERT_FLOAT_WITHIN(tolerance, 400.0f,
+                                 convertChannelLut(&lut, raw, lutCompensation(&lut, (float)t)));
+        int32_t q = convertChannelLutFixed(&fixedLut, raw, lutCompensationFixed(&fixedLut, t << FIXED_FRAC_BITS));
+        TEST_ASSERT_FLOAT_WITHIN(tolerance, 400.0f, q / (float)(1 << FIXED_FRAC_BITS));
+    }
+}
+
+/**
+ * Test two calibration standards switch a channel to its table
+ */
+void test_calibration_points_procedure(void) {
+    SensorManager sensors;
+    AdcSyntheticChannel synthetic[ADC_SCAN_CHANNELS] = {
+        {500, 0, 1, 0}, {1000, 0, 1, 0}, {1000, 0, 1, 0},
+        {20, 0, 1, 0}, {459, 0, 1, 0}, {1000, 0, 1, 0},
+    };
+
+    sensors.init();
+    sensors.clearCalibrationPoints(0xFF);
+    sensors.adcDriver().setSyntheticSource(synthetic);
+
+    // Serotonin standards of 100 nM and 1000 nM
+    TEST_ASSERT_TRUE(sensors.startCalibrationPoint(0, 100.0f));
+    while (sensors.procedureActive()) {
+        sensors.serviceProcedure();
+    }
+    synthetic[0].level = 1500;
+    sensors.adcDriver().setSyntheticSource(synthetic);
+    TEST_ASSERT_TRUE(sensors.startCalibrationPoint(0, 1000.0f));
+    while (sensors.procedureActive()) {
+        sensors.serviceProcedure();
+    }
+    TEST_ASSERT_EQUAL(PROCEDURE_PASSED, sensors.procedureStatus()->outcome);
+    TEST_ASSERT_EQUAL(2, sensors.calibrationPoints(0));
+
+    // Halfway between the standards at the calibration temperature
+    uint16_t raw[6] = {1000, 1000, 1000, 20, 459, 1000};
+    TEST_ASSERT_FLOAT_WITHIN(0.5f, 550.0f, sensors.convertRaw(raw).serotonin_nm);
+
+    // Warmer by 100 counts on A4: the +2%/C sensor drift is taken out
+    raw[4] = 559;
+    float dt = 100 * MV_PER_COUNT / 10.0f;
+    TEST_ASSERT_FLOAT_WITHIN(0.5f, 550.0f / (1.0f + 0.02f * dt), sensors.convertRaw(raw).serotonin_nm);
+
+    // Remeasuring a standard replaces it rather than adding one
+    TEST_ASSERT_TRUE(sensors.startCalibrationPoint(0, 1000.0f));
+    sensors.abortProcedure();
+    TEST_ASSERT_EQUAL(2, sensors.calibrationPoints(0));
+
+    sensors.clearCalibrationPoints(0);
+    TEST_ASSERT_EQUAL(0, sensors.calibrationPoints(0));
+    TEST_ASSERT_FALSE(sensors.startCalibrationPoint(6, 1.0f));
+    sensors.stopAcquisition();
+}
+
+void setup() {
+    delay(2000);
+
+    UNITY_BEGIN();
+
+    RUN_TEST(test_lut_two_points);
+    RUN_TEST(test_lut_piecewise);
+    RUN_TEST(test_lut_rejects_single_standard);
+    RUN_TEST(test_lut_temperature_and_fixed);
+    RUN_TEST(test_lut_temperature_cancels_drift);
+    RUN_TEST(test_calibration_points_procedure);
+
+    UNITY_END();
+}
+
+void loop() {
+    // Tests run once in setup()
+}
@@ -0,0 +1,155 @@
+/**
+ * @file test_channel_scheduler.cpp
+ * @brief Unit tests for per-channel multi-rate sampling
+ *
+ * Tests period rounding and due masks, masked clocked scans, and the
+ * conversion count against scanning every channel
+ */
+
+#include <unity.h>
+#include "channel_scheduler.h"
+#include "sample_clock.h"
+#include "adc_driver.h"
+#include <stdio.h>
+#include <math.h>
+
+AdcDriver adc;
+SampleClock sampleClock;
+ChannelScheduler schedule;
+
+void setUp(void) {
+    // Set up runs before each test
+    adc.init();
+    sampleClock.init(&adc);
+    schedule.init(10);
+}
+
+void tearDown(void) {
+    // Clean up runs after each test
+    sampleClock.stop();
+    adc.stop();
+}
+
+// Collect clocked frames until count arrive or the timeout expires
+static uint16_t collectFrames(AdcFrame* frames, uint16_t count, uint32_t timeout_ms) {
+    uint16_t n = 0;
+    uint32_t start = millis();
+
+    while (n < count && millis() - start < timeout_ms) {
+        sampleClock.service();
+        while (n < count && adc.fetch(&frames[n])) {
+            n++;
+        }
+    }
+    return n;
+}
+
+/**
+ * Test periods round to whole base ticks and the due masks follow them
+ */
+void test_due_masks(void) {
+    schedule.setPeriod(3, 50);      // Every 5th tick
+    schedule.setPeriod(4, 104);     // Rounds to 100 ms
+    schedule.setPeriod(5, 5);       // Below the base: every tick
+
+    TEST_ASSERT_EQUAL_UINT32(10, schedule.period(0));
+    TEST_ASSERT_EQUAL_UINT32(50, schedule.period(3));
+    TEST_ASSERT_EQUAL_UINT32(100, schedule.period(4));
+    TEST_ASSERT_EQUAL_UINT32(10, schedule.period(5));
+
+    // Tick 0 converts everything, slow channels land on fast ticks
+    TEST_ASSERT_EQUAL_HEX8(0x3F, schedule.dueMask(0));
+    TEST_ASSERT_EQUAL_HEX8(0x27, schedule.dueMask(1));
+    TEST_ASSERT_EQUAL_HEX8(0x2F, schedule.dueMask(5));
+    TEST_ASSERT_EQUAL_HEX8(0x3F, schedule.dueMask(10));
+
+    // Changing the base keeps the periods in ms
+    schedule.setBasePeriod(25);
+    TEST_ASSERT_EQUAL_UINT32(50, schedule.period(3));
+    TEST_ASSERT_EQUAL_UINT32(100, schedule.period(4));
+
+    // (4 + 1/2 + 1/4) / 6 of the conversions
+    TEST_ASSERT_EQUAL_UINT8(79, schedule.conversionPercent());
+}
+
+/**
+ * Test a tick is never empty: the fastest channel runs every tick
+ */
+void test_no_empty_ticks(void) {
+    for (uint8_t ch = 0; ch < SCHED_CHANNELS; ch++) {
+        schedule.setPeriod(ch, 40 + ch * 10);
+    }
+    TEST_ASSERT_EQUAL_UINT32(10, schedule.period(0));
+    for (uint32_t tick = 0; tick < 200; tick++) {
+        TEST_ASSERT_TRUE(schedule.dueMask(tick) & 0x01);
+    }
+
+    // Periods past the divider range saturate rather than wrap
+    schedule.setPeriod(5, 60000);
+    TEST_ASSERT_EQUAL_UINT32(10UL * SCHED_MAX_DIVIDER, schedule.period(5));
+}
+
+/**
+ * Test clocked scans convert only the due channels and report which
+ */
+void test_masked_clocked_scans(void) {
+    const uint16_t FRAMES = 40;
+    AdcFrame frames[FRAMES];
+
+    schedule.setBasePeriod(5);
+    schedule.setPeriod(3, 20);
+    schedule.setPeriod(4, 40);
+    schedule.setPeriod(5, 100);
+    sampleClock.setScheduler(&schedule);
+
+    uint32_t before = adc.conversions();
+    sampleClock.start(5);
+    uint16_t n = collectFrames(frames, FRAMES, 1000);
+    sampleClock.stop();
+    uint32_t converted = adc.conversions() - before;
+
+    TEST_ASSERT_EQUAL(FRAMES, n);
+
+    // Each frame's mask is the one due on its tick; 5 ms = 163.84 ticks
+    uint32_t expected = 0;
+    for (uint16_t i = 0; i < n; i++) {
+        float periods = (frames[i].tick - frames[0].tick) / 163.84f;
+        uint32_t tick = (uint32_t)floorf(periods + 0.5f);
+        uint8_t mask = schedule.dueMask(tick);
+        TEST_ASSERT_EQUAL_HEX8(mask, frames[i].mask);
+        for (uint8_t ch = 0; ch < 6; ch++) {
+            expected += (mask >> ch) & 1;
+            if (!(mask & (1 << ch))) {
+                TEST_ASSERT_EQUAL_UINT16(0, frames[i].raw[ch]);
+            }
+        }
+    }
+    TEST_ASSERT_TRUE(converted >= expected);
+    TEST_ASSERT_TRUE(converted < 6UL * n);
+
+    // Software scans after the clock stops convert every channel again
+    AdcFrame frame;
+    TEST_ASSERT_TRUE(adc.acquire(&frame));
+    TEST_ASSERT_EQUAL_HEX8(ADC_ALL_CHANNELS, frame.mask);
+
+    char msg[96];
+    snprintf(msg, sizeof(msg), "%lu conversions for %u frames (%u%% of scanning all six)",
+             (unsigned long)converted, n, (unsigned)(100UL * converted / (6UL * n)));
+    TEST_MESSAGE(msg);
+}
+
+void setup() {
+    delay(2000);
+
+    UNITY_BEGIN();
+
+    RUN_TEST(test_due_masks);
+    RUN_TEST(test_no_empty_ticks);
+    RUN_TEST(test_masked_clocked_scans);
+
+    UNITY_END();
+}
+
+void loop() {
+    // Tests run once in setup()
+}
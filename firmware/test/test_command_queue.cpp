@@ -0,0 +1,243 @@
+/**
+ * @file test_command_queue.cpp
+ * @brief Unit tests for the control command queue and handler table
+ *
+ * Tests commands are kept in arrival order through wrap-around, a full
+ * ring drops rather than overwrites, handlers are looked up and length
+ * checked, and the acknowledgement and status encodings the app decodes
+ */
+
+#include <unity.h>
+#include "command_queue.h"
+#include "sys_time.h"
+#include <stdio.h>
+#include <string.h>
+
+CommandQueue queue;
+CommandTable table;
+
+static uint8_t calls;
+static uint8_t last_length;
+static uint8_t last_arg;
+
+static uint8_t countingHandler(const uint8_t* args, uint8_t length, void* context) {
+    calls++;
+    last_length = length;
+    last_arg = length ? args[0] : 0;
+    return context ? *(uint8_t*)context : CMD_STATUS_OK;
+}
+
+static uint8_t otherHandler(const uint8_t* args, uint8_t length, void* context) {
+    (void)args;
+    (void)length;
+    (void)context;
+    return CMD_STATUS_BUSY;
+}
+
+void setUp(void) {
+    // Set up runs before each test
+    queue.init();
+    table.init();
+    calls = 0;
+    last_length = 0;
+    last_arg = 0;
+}
+
+void tearDown(void) {
+    // Clean up runs after each test
+}
+
+/**
+ * Test commands come out in the order written, across many wraps of the
+ * 8-bit indices
+ */
+void test_queue_order(void) {
+    uint8_t cmd[3];
+    for (uint16_t i = 0; i < 600; i++) {
+        cmd[0] = (uint8_t)i;
+        cmd[1] = (uint8_t)(i >> 8);
+        cmd[2] = 0xAA;
+        TEST_ASSERT_TRUE(queue.push(cmd, sizeof(cmd), i * 10));
+        if (i % 3 == 2) {
+            // Drain in bursts, as the main loop does
+            while (queue.count() > 0) {
+                const Command* c = queue.peek();
+                TEST_ASSERT_EQUAL_UINT8(3, c->length);
+                TEST_ASSERT_EQUAL_UINT8(0xAA, c->data[2]);
+                queue.pop();
+            }
+        }
+    }
+    TEST_ASSERT_NULL(queue.peek());
+    TEST_ASSERT_EQUAL_UINT32(600, queue.received());
+    TEST_ASSERT_EQUAL_UINT32(0, queue.dropped());
+
+    // Oldest first, with its arrival time
+    cmd[0] = 1;
+    queue.push(cmd, 1, 100);
+    cmd[0] = 2;
+    queue.push(cmd, 1, 200);
+    TEST_ASSERT_EQUAL_UINT8(1, queue.peek()->data[0]);
+    TEST_ASSERT_EQUAL_UINT32(100, queue.peek()->received_us);
+    queue.pop();
+    TEST_ASSERT_EQUAL_UINT8(2, queue.peek()->data[0]);
+    TEST_ASSERT_EQUAL_UINT32(200, queue.peek()->received_us);
+}
+
+/**
+ * Test a full ring refuses new commands and keeps the queued ones, and
+ * writes longer than the characteristic are cut to fit
+ */
+void test_queue_full(void) {
+    uint8_t cmd[CMD_MAX_LENGTH + 4];
+    memset(cmd, 0x55, sizeof(cmd));
+
+    for (uint8_t i = 0; i < CMD_QUEUE_DEPTH; i++) {
+        cmd[0] = i;
+        TEST_ASSERT_TRUE(queue.push(cmd, 1, 0));
+    }
+    cmd[0] = 0xEE;
+    TEST_ASSERT_FALSE(queue.push(cmd, 1, 0));
+    TEST_ASSERT_EQUAL_UINT8(CMD_QUEUE_DEPTH, queue.count());
+    TEST_ASSERT_EQUAL_UINT32(CMD_QUEUE_DEPTH + 1, queue.received());
+    TEST_ASSERT_EQUAL_UINT32(1, queue.dropped());
+    TEST_ASSERT_EQUAL_UINT8(0, queue.peek()->data[0]);
+
+    queue.pop();
+    TEST_ASSERT_TRUE(queue.push(cmd, sizeof(cmd), 0));
+    for (uint8_t i = 1; i < CMD_QUEUE_DEPTH; i++) {
+        TEST_ASSERT_EQUAL_UINT8(i, queue.peek()->data[0]);
+        queue.pop();
+    }
+    TEST_ASSERT_EQUAL_UINT8(CMD_MAX_LENGTH, queue.peek()->length);
+    TEST_ASSERT_EQUAL_UINT8(0xEE, queue.peek()->data[0]);
+}
+
+/**
+ * Test dispatch finds the handler, passes the arguments without the
+ * command byte, refuses short and unknown commands, and lets a later
+ * registration replace an earlier one
+ */
+void test_table_dispatch(void) {
+    uint8_t rejected = CMD_STATUS_REJECTED;
+    TEST_ASSERT_TRUE(table.add(0x05, 2, countingHandler));
+    TEST_ASSERT_TRUE(table.add(0x06, 0, countingHandler, &rejected));
+
+    Command c;
+    c.length = 3;
+    c.data[0] = 0x05;
+    c.data[1] = 0x12;
+    c.data[2] = 0x34;
+    TEST_ASSERT_EQUAL_UINT8(CMD_STATUS_OK, table.dispatch(&c));
+    TEST_ASSERT_EQUAL_UINT8(1, calls);
+    TEST_ASSERT_EQUAL_UINT8(2, last_length);
+    TEST_ASSERT_EQUAL_UINT8(0x12, last_arg);
+
+    // Too short: the handler never runs
+    c.length = 2;
+    TEST_ASSERT_EQUAL_UINT8(CMD_STATUS_BAD_LENGTH, table.dispatch(&c));
+    TEST_ASSERT_EQUAL_UINT8(1, calls);
+
+    // The context carries the handler's answer
+    c.length = 1;
+    c.data[0] = 0x06;
+    TEST_ASSERT_EQUAL_UINT8(CMD_STATUS_REJECTED, table.dispatch(&c));
+
+    c.data[0] = 0x7F;
+    TEST_ASSERT_EQUAL_UINT8(CMD_STATUS_UNKNOWN, table.dispatch(&c));
+    c.length = 0;
+    TEST_ASSERT_EQUAL_UINT8(CMD_STATUS_BAD_LENGTH, table.dispatch(&c));
+
+    // Replacing keeps the table size
+    TEST_ASSERT_TRUE(table.add(0x06, 0, otherHandler));
+    c.length = 1;
+    c.data[0] = 0x06;
+    TEST_ASSERT_EQUAL_UINT8(CMD_STATUS_BUSY, table.dispatch(&c));
+    for (uint8_t i = 2; i < CMD_MAX_HANDLERS; i++) {
+        TEST_ASSERT_TRUE(table.add(0x20 + i, 0, countingHandler));
+    }
+    TEST_ASSERT_FALSE(table.add(0x7F, 0, countingHandler));
+    TEST_ASSERT_TRUE(table.add(0x05, 0, otherHandler));
+}
+
+/**
+ * Test the acknowledgement and status layouts byte by byte
+ */
+void test_encoding(void) {
+    uint8_t out[RESP_STATUS_SIZE];
+
+    TEST_ASSERT_EQUAL_UINT8(RESP_ACK_SIZE, commandEncodeAck(0x07, CMD_STATUS_BUSY, 9, 0x01020304, out));
+    const uint8_t ack[] = {RESP_ACK, 0x07, CMD_STATUS_BUSY, 9, 0x04, 0x03, 0x02, 0x01};
+    TEST_ASSERT_EQUAL_UINT8_ARRAY(ack, out, RESP_ACK_SIZE);
+
+    DeviceStatus status;
+    status.flags = STATUS_SAMPLING | STATUS_BULK;
+    status.battery_percent = 87;
+    status.sampling_interval_ms = 1000;
+    status.uptime_s = 0x00010203;
+    status.log_pending = 5;
+    status.conn_interval = 64;
+    status.conn_latency = 7;
+    status.phy = 2;
+    status.procedure_percent = 50;
+    status.command_drops = 1;
+    TEST_ASSERT_EQUAL_UINT8(RESP_STATUS_SIZE, commandEncodeStatus(&status, out));
+    const uint8_t expected[] = {RESP_STATUS, 0x09, 87, 0xE8, 0x03, 0x03, 0x02, 0x01, 0x00,
+                                5, 0, 0, 0, 64, 0, 7, 2, 50, 1};
+    TEST_ASSERT_EQUAL_UINT8_ARRAY(expected, out, RESP_STATUS_SIZE);
+    TEST_ASSERT_TRUE(RESP_STATUS_SIZE <= CMD_MAX_LENGTH);
+}
+
+/**
+ * Test the latency from a write to its dispatch when the main loop is
+ * busy for a while, and report it
+ */
+void test_latency(void) {
+    sysTimeSetVirtual(true);
+    table.add(0x01, 0, countingHandler);
+
+    uint8_t cmd[1] = {0x01};
+    uint32_t worst = 0;
+    uint32_t total = 0;
+    for (uint8_t i = 0; i < 20; i++) {
+        // Written at some point during a 2 ms pass of the main loop
+        sysTimeAdvanceUs(137 * i % 2000);
+        queue.push(cmd, 1, sysMicros());
+        sysTimeAdvanceUs(2000 - 137 * i % 2000);
+
+        const Command* c = queue.peek();
+        TEST_ASSERT_NOT_NULL(c);
+        TEST_ASSERT_EQUAL_UINT8(CMD_STATUS_OK, table.dispatch(c));
+        uint32_t latency = sysMicros() - c->received_us;
+        queue.pop();
+        if (latency > worst) worst = latency;
+        total += latency;
+    }
+    sysTimeSetVirtual(false);
+
+    TEST_ASSERT_EQUAL_UINT8(20, calls);
+    TEST_ASSERT_TRUE(worst <= 2000);
+
+    char msg[96];
+    snprintf(msg, sizeof(msg), "Command latency over a 2 ms loop: avg %lu us, max %lu us",
+             (unsigned long)(total / 20), (unsigned long)worst);
+    TEST_MESSAGE(msg);
+}
+
+void setup() {
+    delay(2000);
+
+    UNITY_BEGIN();
+
+    RUN_TEST(test_queue_order);
+    RUN_TEST(test_queue_full);
+    RUN_TEST(test_table_dispatch);
+    RUN_TEST(test_encoding);
+    RUN_TEST(test_latency);
+
+    UNITY_END();
+}
+
+void loop() {
+    // Tests run once in setup()
+}
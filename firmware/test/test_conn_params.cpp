@@ -0,0 +1,225 @@
+/**
+ * @file test_conn_params.cpp
+ * @brief Unit tests for the connection parameter policy
+ *
+ * Tests the interval and slave latency chosen for each sampling and
+ * batching setup, the limits centrals impose, when renegotiation happens,
+ * and the estimated radio duty cycle against the central's default
+ */
+
+#include <unity.h>
+#include "conn_params.h"
+#include "ble_link.h"
+#include "ble_frame.h"
+#include "reading_batch.h"
+#include "sys_time.h"
+#include <stdio.h>
+#include <string.h>
+
+#define READING_SIZE    12      // Compact reading, every channel
+
+BleLink link;
+ConnParamPolicy policy;
+
+static void demandFor(ConnDemand* demand, uint16_t sample_ms, uint16_t latency_ms) {
+    memset(demand, 0, sizeof(*demand));
+    demand->sample_interval_ms = sample_ms;
+    demand->batch_capacity = ReadingBatcher::capacityFor(link.notifyPayload() - FRAME_HEADER_SIZE);
+    demand->batch_latency_ms = latency_ms;
+    demand->reading_size = READING_SIZE;
+}
+
+// What iOS accepts, which Android does as well
+static void assertAcceptable(const ConnParams* p) {
+    TEST_ASSERT_TRUE(p->interval_min >= 12);
+    TEST_ASSERT_TRUE(p->interval_max == 12 || p->interval_max >= p->interval_min + 12);
+    TEST_ASSERT_TRUE(p->latency <= 30);
+    uint32_t sleep_ms = (uint32_t)p->interval_max * CONN_UNIT_US * (p->latency + 1) / 1000;
+    TEST_ASSERT_TRUE(sleep_ms <= 2000);
+    TEST_ASSERT_TRUE(p->timeout * CONN_TIMEOUT_UNIT_MS <= 6000);
+    TEST_ASSERT_TRUE(p->timeout * CONN_TIMEOUT_UNIT_MS > 2 * sleep_ms);
+}
+
+void setUp(void) {
+    // Set up runs before each test
+    link.init();
+    link.setPeer(BLE_ATT_MTU_MAX, BLE_DATA_LENGTH_MAX);
+    link.onConnect("");
+    policy.init();
+}
+
+void tearDown(void) {
+    // Clean up runs after each test
+}
+
+/**
+ * Test streaming picks a short interval and sleeps about one payload
+ * period between wake-ups
+ */
+void test_stream_params(void) {
+    ConnDemand demand;
+    ConnParams p;
+
+    // 1 Hz, batched for up to a second: a payload a second
+    demandFor(&demand, 1000, 1000);
+    ConnParamPolicy::choose(&demand, &link, &p);
+    TEST_ASSERT_EQUAL_UINT8(CONN_MODE_STREAM, p.mode);
+    TEST_ASSERT_EQUAL_UINT32(1000, p.payload_period_ms);
+    TEST_ASSERT_EQUAL_UINT16(CONN_STREAM_INTERVAL_MAX, p.interval_min);
+    TEST_ASSERT_EQUAL_UINT16(7, p.latency);
+    assertAcceptable(&p);
+
+    // 10 Hz batched: ten readings a payload, the same period
+    demandFor(&demand, 100, 1000);
+    ConnParamPolicy::choose(&demand, &link, &p);
+    TEST_ASSERT_EQUAL_UINT32(1000, p.payload_period_ms);
+    TEST_ASSERT_EQUAL_UINT16(7, p.latency);
+
+    // 10 Hz unbatched: every reading goes at once
+    demandFor(&demand, 100, 0);
+    ConnParamPolicy::choose(&demand, &link, &p);
+    TEST_ASSERT_EQUAL_UINT32(100, p.payload_period_ms);
+    TEST_ASSERT_EQUAL_UINT16(CONN_STREAM_INTERVAL_MIN, p.interval_min);
+    TEST_ASSERT_EQUAL_UINT16(1, p.latency);
+    assertAcceptable(&p);
+
+    // 10 Hz at MTU 23: one reading fills a notification
+    link.setPeer(BLE_ATT_MTU_DEFAULT, BLE_DATA_LENGTH_DEFAULT);
+    link.onConnect("");
+    demandFor(&demand, 100, 1000);
+    ConnParamPolicy::choose(&demand, &link, &p);
+    TEST_ASSERT_EQUAL_UINT32(100, p.payload_period_ms);
+    assertAcceptable(&p);
+}
+
+/**
+ * Test bulk transfer and backlog tighten the interval with no latency,
+ * and idle relaxes to the longest sleep allowed
+ */
+void test_modes(void) {
+    ConnDemand demand;
+    ConnParams p;
+
+    demandFor(&demand, 1000, 1000);
+    demand.bulk = true;
+    ConnParamPolicy::choose(&demand, &link, &p);
+    TEST_ASSERT_EQUAL_UINT8(CONN_MODE_BULK, p.mode);
+    TEST_ASSERT_EQUAL_UINT16(CONN_BULK_INTERVAL, p.interval_min);
+    TEST_ASSERT_EQUAL_UINT16(CONN_BULK_INTERVAL, p.interval_max);
+    TEST_ASSERT_EQUAL_UINT16(0, p.latency);
+    assertAcceptable(&p);
+
+    demand.bulk = false;
+    demand.backlog = true;
+    ConnParamPolicy::choose(&demand, &link, &p);
+    TEST_ASSERT_EQUAL_UINT8(CONN_MODE_BACKLOG, p.mode);
+    TEST_ASSERT_EQUAL_UINT16(CONN_BACKLOG_INTERVAL_MIN, p.interval_min);
+    TEST_ASSERT_EQUAL_UINT16(0, p.latency);
+    assertAcceptable(&p);
+
+    demandFor(&demand, 0, 1000);
+    ConnParamPolicy::choose(&demand, &link, &p);
+    TEST_ASSERT_EQUAL_UINT8(CONN_MODE_IDLE, p.mode);
+    TEST_ASSERT_EQUAL_UINT16(CONN_IDLE_INTERVAL, p.interval_min);
+    TEST_ASSERT_EQUAL_UINT16(16, p.latency);
+    assertAcceptable(&p);
+}
+
+/**
+ * Test requests wait for the connection to settle, tighten at once,
+ * loosen only after the hold-off, and reach the link
+ */
+void test_renegotiation(void) {
+    ConnDemand demand;
+    ConnParams p;
+    policy.reset(0);
+    demandFor(&demand, 1000, 1000);
+
+    TEST_ASSERT_FALSE(policy.update(&demand, &link, 1000, &p));
+    TEST_ASSERT_TRUE(policy.update(&demand, &link, CONN_SETTLE_MS, &p));
+    TEST_ASSERT_EQUAL_UINT8(CONN_MODE_STREAM, p.mode);
+    TEST_ASSERT_FALSE(policy.update(&demand, &link, CONN_SETTLE_MS + 100, &p));
+
+    link.requestConnParams(p.interval_min, p.interval_max, p.latency, p.timeout);
+    TEST_ASSERT_EQUAL_UINT16(p.interval_max, link.connInterval());
+    TEST_ASSERT_EQUAL_UINT16(p.latency, link.connLatency());
+
+    // A bulk transfer tightens straight away
+    demand.bulk = true;
+    TEST_ASSERT_TRUE(policy.update(&demand, &link, 6000, &p));
+    TEST_ASSERT_EQUAL_UINT8(CONN_MODE_BULK, p.mode);
+
+    // Back to streaming only after the hold-off
+    demand.bulk = false;
+    TEST_ASSERT_FALSE(policy.update(&demand, &link, 7000, &p));
+    TEST_ASSERT_EQUAL_UINT8(CONN_MODE_BULK, policy.requested()->mode);
+    TEST_ASSERT_TRUE(policy.update(&demand, &link, 6000 + CONN_RELAX_HOLDOFF_MS, &p));
+    TEST_ASSERT_EQUAL_UINT8(CONN_MODE_STREAM, p.mode);
+    TEST_ASSERT_EQUAL_UINT32(3, policy.requests());
+
+    // A bulk transfer right after connecting does not wait to settle
+    policy.reset(20000);
+    demand.bulk = true;
+    TEST_ASSERT_TRUE(policy.update(&demand, &link, 20000, &p));
+
+    // A central that refuses keeps its parameters
+    link.setPeerAcceptsConnParams(false);
+    uint16_t before = link.connInterval();
+    link.requestConnParams(p.interval_min, p.interval_max, p.latency, p.timeout);
+    TEST_ASSERT_EQUAL_UINT16(before, link.connInterval());
+    TEST_ASSERT_EQUAL_UINT8(1, link.connParamRejects());
+}
+
+/**
+ * Test the estimated duty cycle orders the modes sensibly and report the
+ * saving over a central's default 30 ms interval with no latency
+ */
+void test_duty_cycle(void) {
+    ConnDemand demand;
+    ConnParams idle, slow, fast, bulk;
+
+    demandFor(&demand, 0, 1000);
+    ConnParamPolicy::choose(&demand, &link, &idle);
+    demandFor(&demand, 1000, 1000);
+    ConnParamPolicy::choose(&demand, &link, &slow);
+    demandFor(&demand, 100, 0);
+    ConnParamPolicy::choose(&demand, &link, &fast);
+    demand.bulk = true;
+    ConnParamPolicy::choose(&demand, &link, &bulk);
+
+    TEST_ASSERT_TRUE(idle.duty_x100 < slow.duty_x100);
+    TEST_ASSERT_TRUE(slow.duty_x100 < fast.duty_x100);
+    TEST_ASSERT_TRUE(fast.duty_x100 < bulk.duty_x100);
+
+    // The same 1 Hz stream on the central's default parameters
+    ConnParams central = slow;
+    central.interval_min = BLE_CONN_INTERVAL_DEFAULT;
+    central.interval_max = BLE_CONN_INTERVAL_DEFAULT;
+    central.latency = 0;
+    uint16_t air = link.airTimeUsFor(2 * 16 + FRAME_HEADER_SIZE);
+    uint16_t default_duty = ConnParamPolicy::dutyCycleX100(&central, 1000, air);
+    TEST_ASSERT_TRUE(slow.duty_x100 * 4 < default_duty);
+
+    char msg[160];
+    snprintf(msg, sizeof(msg), "Radio duty: idle %.2f%% | 1 Hz %.2f%% (default 30 ms: %.2f%%) | 10 Hz unbatched %.2f%% | bulk %.2f%%",
+             idle.duty_x100 / 100.0f, slow.duty_x100 / 100.0f, default_duty / 100.0f,
+             fast.duty_x100 / 100.0f, bulk.duty_x100 / 100.0f);
+    TEST_MESSAGE(msg);
+}
+
+void setup() {
+    delay(2000);
+
+    UNITY_BEGIN();
+
+    RUN_TEST(test_stream_params);
+    RUN_TEST(test_modes);
+    RUN_TEST(test_renegotiation);
+    RUN_TEST(test_duty_cycle);
+
+    UNITY_END();
+}
+
+void loop() {
+    // Tests run once in setup()
+}
@@ -0,0 +1,126 @@
+/**
+ * @file test_conversion_kernels.cpp
+ * @brief Unit tests for raw-ADC conversion kernels
+ * 
+ * Tests fused affine + saturate kernels against the step-by-step
+ * calibration chain, and the integer-only variant against the float one
+ */
+
+#include <unity.h>
+#include "conversion_kernels.h"
+#include <math.h>
+
+#define MV_PER_COUNT    (3300.0f / 4095.0f)
+
+void setUp(void) {
+    // Set up runs before each test
+}
+
+void tearDown(void) {
+    // Clean up runs after each test
+}
+
+/**
+ * Test fused kernel matches the step-by-step conversion
+ */
+void test_kernel_matches_reference_chain(void) {
+    ChannelTransform t;
+    const float offset_mv = 120.0f, gain = 1.07f, baseline_mv = 15.0f;
+    buildChannelTransform(&t, MV_PER_COUNT, 3.03f, 0.0f, offset_mv, gain, baseline_mv,
+                          -1.0e9f, 1.0e9f);
+    
+    for (uint16_t raw = 0; raw <= 4095; raw += 7) {
+        float mv = (raw * 3300) / 4095.0f;
+        float expected = ((mv - offset_mv) * gain - baseline_mv) * 3.03f;
+        TEST_ASSERT_FLOAT_WITHIN(0.01f, expected, convertChannel(&t, raw));
+    }
+}
+
+/**
+ * Test pH zero-point and Nernst slope are folded into the offset
+ */
+void test_kernel_ph_zero_point(void) {
+    ChannelTransform t;
+    buildChannelTransform(&t, MV_PER_COUNT, 1.0f / 59.16f, 7.0f, 0.0f, 1.0f, 0.0f,
+                          -1.0e9f, 1.0e9f);
+    
+    TEST_ASSERT_FLOAT_WITHIN(1e-5f, 7.0f, convertChannel(&t, 0));
+    TEST_ASSERT_FLOAT_WITHIN(1e-3f, 7.0f + 3300.0f / 59.16f, convertChannel(&t, 4095));
+}
+
+/**
+ * Test saturation at the analyte range
+ */
+void test_kernel_saturates(void) {
+    ChannelTransform t;
+    buildChannelTransform(&t, MV_PER_COUNT, 3.03f, 0.0f, 0.0f, 1.0f, 0.0f, 10.0f, 5000.0f);
+    
+    TEST_ASSERT_EQUAL_FLOAT(10.0f, convertChannel(&t, 0));
+    TEST_ASSERT_EQUAL_FLOAT(5000.0f, convertChannel(&t, 4095));
+}
+
+/**
+ * Test integer-only kernel tracks the float kernel to 1 LSB
+ */
+void test_fixed_kernel_matches_float(void) {
+    const float per_mv[] = {3.03f, 1.52f, 15.15f, 1.0f / 59.16f, 0.1f, 0.015f};
+    const float zero[] = {0.0f, 0.0f, 0.0f, 7.0f, 0.0f, 0.0f};
+    ChannelTransform t[6];
+    FixedChannelTransform f[6];
+    
+    for (uint8_t c = 0; c < 6; c++) {
+        buildChannelTransform(&t[c], MV_PER_COUNT, per_mv[c], zero[c], 35.0f, 0.98f, 4.0f,
+                              -1.0e6f, 1.0e6f);
+        buildFixedTransform(&f[c], &t[c]);
+    }
+    
+    uint16_t raw[6];
+    float units[6];
+    int32_t units_q[6];
+    
+    for (uint16_t r = 0; r <= 4095; r += 13) {
+        for (uint8_t c = 0; c < 6; c++) {
+            raw[c] = (r + c * 500) & 0x0FFF;
+        }
+        convertChannels(t, raw, units, 6);
+        convertChannelsFixed(f, raw, units_q, 6);
+        
+        for (uint8_t c = 0; c < 6; c++) {
+            float fixed_units = units_q[c] / (float)(1 << FIXED_FRAC_BITS);
+            TEST_ASSERT_FLOAT_WITHIN(1.5f / (1 << FIXED_FRAC_BITS) + fabsf(units[c]) * 1e-5f,
+                                     units[c], fixed_units);
+        }
+    }
+}
+
+/**
+ * Test unbounded channels do not overflow the fixed-point limits
+ */
+void test_fixed_kernel_unbounded_limits(void) {
+    ChannelTransform t;
+    FixedChannelTransform f;
+    buildChannelTransform(&t, MV_PER_COUNT, 0.1f, 0.0f, 0.0f, 1.0f, 0.0f, -3.4e38f, 3.4e38f);
+    buildFixedTransform(&f, &t);
+    
+    TEST_ASSERT_EQUAL_INT32(INT32_MIN, f.min_q);
+    TEST_ASSERT_EQUAL_INT32(INT32_MAX, f.max_q);
+    TEST_ASSERT_FLOAT_WITHIN(0.01f, 330.0f, convertChannelFixed(&f, 4095) / 256.0f);
+}
+
+void setup() {
+    delay(2000);
+    
+    UNITY_BEGIN();
+    
+    RUN_TEST(test_kernel_matches_reference_chain);
+    RUN_TEST(test_kernel_ph_zero_point);
+    RUN_TEST(test_kernel_saturates);
+    RUN_TEST(test_fixed_kernel_matches_float);
+    RUN_TEST(test_fixed_kernel_unbounded_limits);
+    
+    UNITY_END();
+}
+
+void loop() {
+    // Tests run once in setup()
+}
@@ -0,0 +1,218 @@
+/**
+ * @file test_reading_batch.cpp
+ * @brief Unit tests for batching compact readings per notification
+ *
+ * Tests capacity from the negotiated MTU, size and deadline flushes, and
+ * bytes on air per reading at different latency settings
+ */
+
+#include <unity.h>
+#include "reading_batch.h"
+#include "reading_codec.h"
+#include "ble_link.h"
+#include "ble_frame.h"
+#include "aes.h"
+#include "sys_time.h"
+#include <stdio.h>
+#include <string.h>
+
+ReadingBatcher batcher;
+ReadingCodec codec;
+BleLink link;
+SensorReading reading;
+
+void setUp(void) {
+    // Set up runs before each test
+    batcher.init();
+    codec.init();
+    link.init();
+    memset(&reading, 0, sizeof(reading));
+    reading.serotonin_nm = 120.0f;
+    reading.dopamine_nm = 300.0f;
+    reading.gaba_nm = 800.0f;
+    reading.ph_level = 6.8f;
+    reading.temperature_c = 37.0f;
+    reading.calprotectin_ug_g = 40.0f;
+}
+
+void tearDown(void) {
+    // Clean up runs after each test
+}
+
+// Take the batch and account it as one encrypted, framed payload
+static void flush(uint32_t now) {
+    uint16_t encrypted = AES_BLOCK_SIZE + aes_padded_length(batcher.length());
+    uint8_t fragments = frameFragmentsFor(encrypted, link.notifyPayload());
+    link.record(encrypted + fragments * FRAME_HEADER_SIZE, fragments, batcher.count());
+    batcher.take(now);
+}
+
+// Same order as BLECommsManager: deadline, room, then full
+static void send(uint8_t mask, uint32_t now) {
+    uint8_t buffer[CODEC_MAX_SIZE];
+    reading.timestamp_ms = now;
+    uint8_t length = codec.encode(&reading, mask, buffer);
+
+    if (batcher.expired(now)) {
+        flush(now);
+    }
+    uint16_t framed = link.notifyPayload() - FRAME_HEADER_SIZE;
+    batcher.setCapacity(ReadingBatcher::capacityFor(framed), codec.size(ADC_ALL_CHANNELS));
+    if (!batcher.fits(length)) {
+        flush(now);
+    }
+    batcher.add(buffer, length, now);
+    if (batcher.full()) {
+        flush(now);
+    }
+}
+
+/**
+ * Test a full batch's IV and ciphertext fit one notification
+ */
+void test_capacity(void) {
+    TEST_ASSERT_EQUAL_UINT16(0, ReadingBatcher::capacityFor(20));
+    TEST_ASSERT_EQUAL_UINT16(0, ReadingBatcher::capacityFor(31));
+    TEST_ASSERT_EQUAL_UINT16(15, ReadingBatcher::capacityFor(32));
+    TEST_ASSERT_EQUAL_UINT16(159, ReadingBatcher::capacityFor(182));
+    TEST_ASSERT_EQUAL_UINT16(BATCH_MAX_SIZE, ReadingBatcher::capacityFor(244));
+
+    for (uint16_t payload = 32; payload <= 244; payload++) {
+        uint16_t capacity = ReadingBatcher::capacityFor(payload);
+        TEST_ASSERT_TRUE(AES_BLOCK_SIZE + aes_padded_length(capacity) <= payload);
+    }
+}
+
+/**
+ * Test readings accumulate until another full reading would not fit
+ */
+void test_size_flush(void) {
+    uint8_t buffer[CODEC_MAX_SIZE];
+    uint8_t length = codec.encode(&reading, 0x07, buffer);
+    TEST_ASSERT_EQUAL_UINT8(9, length);
+
+    batcher.setCapacity(BATCH_MAX_SIZE, codec.size(ADC_ALL_CHANNELS));
+    uint8_t added = 0;
+    while (!batcher.full()) {
+        TEST_ASSERT_TRUE(batcher.fits(length));
+        batcher.add(buffer, length, 0);
+        added++;
+    }
+    TEST_ASSERT_EQUAL_UINT8(24, added);
+    TEST_ASSERT_EQUAL_UINT16(216, batcher.length());
+    TEST_ASSERT_FALSE(batcher.expired(10));
+
+    // Concatenated readings decode back one after another
+    SensorReading decoded;
+    uint16_t at = 0;
+    for (uint8_t i = 0; i < added; i++) {
+        TEST_ASSERT_EQUAL_HEX8(0x07, codec.decode(batcher.data() + at, batcher.length() - at, &decoded));
+        at += codec.size(0x07);
+    }
+    TEST_ASSERT_EQUAL_UINT16(batcher.length(), at);
+
+    batcher.take(10);
+    TEST_ASSERT_EQUAL_UINT8(0, batcher.count());
+    TEST_ASSERT_EQUAL_UINT32(1, batcher.stats()->full);
+    TEST_ASSERT_EQUAL_UINT32(24, batcher.stats()->readings);
+}
+
+/**
+ * Test a partial batch is due at the latency deadline, 0 latency sends
+ * each reading alone, and a small MTU still carries one reading
+ */
+void test_deadline_flush(void) {
+    uint8_t buffer[CODEC_MAX_SIZE];
+    uint8_t length = codec.encode(&reading, 0x07, buffer);
+
+    batcher.setLatency(2000);
+    batcher.setCapacity(BATCH_MAX_SIZE, codec.size(ADC_ALL_CHANNELS));
+    batcher.add(buffer, length, 5000);
+    batcher.add(buffer, length, 6000);
+    TEST_ASSERT_FALSE(batcher.expired(6999));
+    TEST_ASSERT_TRUE(batcher.expired(7000));
+    batcher.take(7000);
+    TEST_ASSERT_EQUAL_UINT32(1, batcher.stats()->deadline);
+
+    batcher.setLatency(0);
+    batcher.add(buffer, length, 8000);
+    TEST_ASSERT_TRUE(batcher.full());
+    batcher.take(8000);
+
+    // Default MTU: no room to batch, the reading goes fragmented
+    batcher.setLatency(1000);
+    batcher.setCapacity(ReadingBatcher::capacityFor(20), codec.size(ADC_ALL_CHANNELS));
+    TEST_ASSERT_TRUE(batcher.fits(length));
+    batcher.add(buffer, length, 9000);
+    TEST_ASSERT_TRUE(batcher.full());
+    TEST_ASSERT_FALSE(batcher.fits(length));
+}
+
+// Ten minutes at 1 Hz with the default channel periods
+static uint16_t airBytesPerReading(uint16_t latency_ms, uint16_t mtu, uint16_t data_length,
+                                   uint32_t* readings) {
+    BleLinkStats stats;
+
+    link.setPeer(mtu, data_length);
+    link.onConnect("00:11:22:33:44:55");
+    batcher.init();
+    batcher.setLatency(latency_ms);
+
+    for (uint32_t t = 0; t < 600; t++) {
+        uint8_t mask = 0x07;
+        if (t % 5 == 0) mask |= 0x08;
+        if (t % 10 == 0) mask |= 0x10;
+        if (t % 60 == 0) mask |= 0x20;
+        send(mask, t * 1000);
+    }
+    flush(600000);
+
+    link.stats(&stats);
+    *readings = stats.readings;
+    return stats.air_bytes_per_reading;
+}
+
+/**
+ * Test batching cuts bytes on air per reading as the latency grows
+ */
+void test_air_bytes_per_reading(void) {
+    static const uint16_t latencies[] = {0, 1000, 2000, 5000, 10000, 30000};
+    uint16_t bytes[6];
+    uint32_t readings;
+    char msg[160];
+
+    uint16_t unbatched_small_mtu = airBytesPerReading(0, 23, 27, &readings);
+    TEST_ASSERT_EQUAL_UINT32(600, readings);
+    for (uint8_t i = 0; i < 6; i++) {
+        bytes[i] = airBytesPerReading(latencies[i], 247, 251, &readings);
+        TEST_ASSERT_EQUAL_UINT32(600, readings);
+    }
+
+    TEST_ASSERT_TRUE(bytes[0] < unbatched_small_mtu);
+    for (uint8_t i = 1; i < 6; i++) {
+        TEST_ASSERT_TRUE(bytes[i] <= bytes[i - 1]);
+    }
+    TEST_ASSERT_TRUE(bytes[4] * 3 < bytes[0]);
+
+    snprintf(msg, sizeof(msg),
+             "B on air/reading: MTU 23 %u | MTU 247 latency 0 s %u, 1 s %u, 2 s %u, 5 s %u, 10 s %u, 30 s %u",
+             unbatched_small_mtu, bytes[0], bytes[1], bytes[2], bytes[3], bytes[4], bytes[5]);
+    TEST_MESSAGE(msg);
+}
+
+void setup() {
+    delay(2000);
+
+    UNITY_BEGIN();
+
+    RUN_TEST(test_capacity);
+    RUN_TEST(test_size_flush);
+    RUN_TEST(test_deadline_flush);
+    RUN_TEST(test_air_bytes_per_reading);
+
+    UNITY_END();
+}
+
+void loop() {
+    // Tests run once in setup()
+}
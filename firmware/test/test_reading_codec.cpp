@@ -0,0 +1,181 @@
+/**
+ * @file test_reading_codec.cpp
+ * @brief Unit tests for the compact SensorReading wire format
+ *
+ * Tests the little-endian layout, encoded sizes, round-trip error bounds
+ * across each range, saturation, and rejection of short buffers
+ */
+
+#include <unity.h>
+#include "reading_codec.h"
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+
+ReadingCodec codec;
+
+void setUp(void) {
+    // Set up runs before each test
+    codec.init();
+}
+
+void tearDown(void) {
+    // Clean up runs after each test
+}
+
+static float channelValue(const SensorReading* r, uint8_t ch) {
+    const float units[CODEC_CHANNELS] = {
+        r->serotonin_nm, r->dopamine_nm, r->gaba_nm,
+        r->ph_level, r->temperature_c, r->calprotectin_ug_g
+    };
+    return units[ch];
+}
+
+static void setChannelValue(SensorReading* r, uint8_t ch, float value) {
+    float* const units[CODEC_CHANNELS] = {
+        &r->serotonin_nm, &r->dopamine_nm, &r->gaba_nm,
+        &r->ph_level, &r->temperature_c, &r->calprotectin_ug_g
+    };
+    *units[ch] = value;
+}
+
+/**
+ * Test a full reading is 12 bytes with a little-endian timestamp and the
+ * mask in the low bits of the first payload byte
+ */
+void test_layout_and_size(void) {
+    SensorReading reading = {120.0f, 300.0f, 2000.0f, 6.8f, 37.0f, 40.0f, 0x12345678UL};
+    uint8_t buffer[CODEC_MAX_SIZE];
+
+    TEST_ASSERT_EQUAL_UINT8(12, codec.size(0x3F));
+    TEST_ASSERT_EQUAL_UINT8(9, codec.size(0x07));
+    TEST_ASSERT_EQUAL_UINT8(12, codec.encode(&reading, 0x3F, buffer));
+    TEST_ASSERT_EQUAL_HEX8(0x78, buffer[0]);
+    TEST_ASSERT_EQUAL_HEX8(0x56, buffer[1]);
+    TEST_ASSERT_EQUAL_HEX8(0x34, buffer[2]);
+    TEST_ASSERT_EQUAL_HEX8(0x12, buffer[3]);
+    TEST_ASSERT_EQUAL_HEX8(0x3F, buffer[4] & 0x3F);
+
+    // pH alone: mask 0x08, then its 10-bit code from bit 6
+    uint16_t code = (uint16_t)(6.8f / 14.0f * 1023.0f + 0.5f);
+    TEST_ASSERT_EQUAL_UINT8(6, codec.encode(&reading, 0x08, buffer));
+    TEST_ASSERT_EQUAL_HEX8(0x08 | ((code & 0x03) << 6), buffer[4]);
+    TEST_ASSERT_EQUAL_HEX8(code >> 2, buffer[5]);
+}
+
+/**
+ * Test the round-trip error stays inside the documented bound across each
+ * channel's range
+ */
+void test_error_bounds(void) {
+    SensorReading reading;
+    SensorReading out;
+    uint8_t buffer[CODEC_MAX_SIZE];
+    const float lo[CODEC_CHANNELS] = {SEROTONIN_MIN_NM, DOPAMINE_MIN_NM, GABA_MIN_NM,
+                                      CODEC_PH_MIN, CODEC_TEMP_MIN_C, CALPROTECTIN_MIN_UG_G};
+    const float hi[CODEC_CHANNELS] = {SEROTONIN_MAX_NM, DOPAMINE_MAX_NM, GABA_MAX_NM,
+                                      CODEC_PH_MAX, CODEC_TEMP_MAX_C, CALPROTECTIN_MAX_UG_G};
+    const bool log_scale[CODEC_CHANNELS] = {true, true, true, false, false, true};
+    char msg[96];
+
+    for (uint8_t ch = 0; ch < CODEC_CHANNELS; ch++) {
+        float bound = codec.maxError(ch);
+        float worst = 0.0f;
+        for (uint16_t i = 0; i <= 1000; i++) {
+            float f = i / 1000.0f;
+            float value = log_scale[ch] ? lo[ch] * powf(hi[ch] / lo[ch], f)
+                                        : lo[ch] + f * (hi[ch] - lo[ch]);
+            memset(&reading, 0, sizeof(reading));
+            setChannelValue(&reading, ch, value);
+            uint8_t length = codec.encode(&reading, 1 << ch, buffer);
+            TEST_ASSERT_EQUAL_HEX8(1 << ch, codec.decode(buffer, length, &out));
+
+            float got = channelValue(&out, ch);
+            float err = log_scale[ch] ? fabsf(got - value) / value : fabsf(got - value);
+            if (err > worst) worst = err;
+        }
+        TEST_ASSERT_TRUE(worst <= bound * 1.01f);
+        snprintf(msg, sizeof(msg), "A%u: %u bits, worst %.5f, bound %.5f%s",
+                 ch, codec.bits(ch), worst, bound, log_scale[ch] ? " (relative)" : "");
+        TEST_MESSAGE(msg);
+    }
+
+    // Documented default bounds
+    TEST_ASSERT_TRUE(codec.maxError(0) < 0.0035f);
+    TEST_ASSERT_TRUE(codec.maxError(3) < 0.007f);
+    TEST_ASSERT_TRUE(codec.maxError(4) <= 0.0501f);
+}
+
+/**
+ * Test out-of-range values saturate and absent channels are untouched
+ */
+void test_saturation_and_sparse(void) {
+    SensorReading reading = {0.0f, -5.0f, 1.0e6f, 15.0f, 10.0f, 9000.0f, 42};
+    SensorReading out = {-1.0f, -1.0f, -1.0f, -1.0f, -1.0f, -1.0f, 0};
+    uint8_t buffer[CODEC_MAX_SIZE];
+
+    uint8_t length = codec.encode(&reading, 0x3F, buffer);
+    TEST_ASSERT_EQUAL_HEX8(0x3F, codec.decode(buffer, length, &out));
+    TEST_ASSERT_FLOAT_WITHIN(0.01f, SEROTONIN_MIN_NM, out.serotonin_nm);
+    TEST_ASSERT_FLOAT_WITHIN(0.01f, DOPAMINE_MIN_NM, out.dopamine_nm);
+    TEST_ASSERT_FLOAT_WITHIN(1.0f, GABA_MAX_NM, out.gaba_nm);
+    TEST_ASSERT_FLOAT_WITHIN(0.001f, CODEC_PH_MAX, out.ph_level);
+    TEST_ASSERT_FLOAT_WITHIN(0.001f, CODEC_TEMP_MIN_C, out.temperature_c);
+    TEST_ASSERT_FLOAT_WITHIN(0.5f, CALPROTECTIN_MAX_UG_G, out.calprotectin_ug_g);
+    TEST_ASSERT_EQUAL_UINT32(42, out.timestamp_ms);
+
+    // Only temperature present
+    out.serotonin_nm = -1.0f;
+    reading.temperature_c = 36.6f;
+    length = codec.encode(&reading, 0x10, buffer);
+    TEST_ASSERT_EQUAL_HEX8(0x10, codec.decode(buffer, length, &out));
+    TEST_ASSERT_FLOAT_WITHIN(0.05f, 36.6f, out.temperature_c);
+    TEST_ASSERT_EQUAL_FLOAT(-1.0f, out.serotonin_nm);
+}
+
+/**
+ * Test short, empty and truncated buffers are refused, and other widths
+ * round-trip when both sides agree on them
+ */
+void test_rejects_and_widths(void) {
+    SensorReading reading = {500.0f, 500.0f, 5000.0f, 7.0f, 37.0f, 100.0f, 7};
+    SensorReading out;
+    uint8_t buffer[CODEC_MAX_SIZE];
+
+    uint8_t length = codec.encode(&reading, 0x3F, buffer);
+    TEST_ASSERT_EQUAL_HEX8(0, codec.decode(buffer, length - 1, &out));
+    TEST_ASSERT_EQUAL_HEX8(0, codec.decode(buffer, CODEC_HEADER_SIZE, &out));
+    buffer[CODEC_HEADER_SIZE] &= ~0x3F;
+    TEST_ASSERT_EQUAL_HEX8(0, codec.decode(buffer, length, &out));
+
+    TEST_ASSERT_FALSE(codec.setBits(0, 0));
+    TEST_ASSERT_FALSE(codec.setBits(0, CODEC_MAX_BITS + 1));
+    TEST_ASSERT_FALSE(codec.setBits(CODEC_CHANNELS, 8));
+    for (uint8_t ch = 0; ch < CODEC_CHANNELS; ch++) {
+        TEST_ASSERT_TRUE(codec.setBits(ch, CODEC_MAX_BITS));
+    }
+    TEST_ASSERT_EQUAL_UINT8(CODEC_MAX_SIZE, codec.size(0x3F));
+    length = codec.encode(&reading, 0x3F, buffer);
+    TEST_ASSERT_EQUAL_UINT8(CODEC_MAX_SIZE, length);
+    TEST_ASSERT_EQUAL_HEX8(0x3F, codec.decode(buffer, length, &out));
+    TEST_ASSERT_FLOAT_WITHIN(0.1f, 500.0f, out.serotonin_nm);
+    TEST_ASSERT_FLOAT_WITHIN(0.001f, 7.0f, out.ph_level);
+    TEST_ASSERT_FLOAT_WITHIN(0.02f, 100.0f, out.calprotectin_ug_g);
+}
+
+void setup() {
+    delay(2000);
+
+    UNITY_BEGIN();
+
+    RUN_TEST(test_layout_and_size);
+    RUN_TEST(test_error_bounds);
+    RUN_TEST(test_saturation_and_sparse);
+    RUN_TEST(test_rejects_and_widths);
+
+    UNITY_END();
+}
+
+void loop() {
+    // Tests run once in setup()
+}
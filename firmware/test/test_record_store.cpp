@@ -0,0 +1,218 @@
+/**
+ * @file test_record_store.cpp
+ * @brief Unit tests for the flash-backed record store
+ *
+ * Tests persistence across reboots, page rotation and wear, recovery from
+ * torn writes, and boot-time load on the file-backed flash emulator
+ */
+
+#include <unity.h>
+#include "record_store.h"
+#include "key_manager.h"
+#include "cycle_counter.h"
+#include <stdio.h>
+#include <string.h>
+
+#define FLASH_IMAGE     "/tmp/symbion_test_flash.bin"
+
+FlashDevice flash;
+RecordStore store;
+
+// Power cycle: drop RAM state and rebuild it from the image
+static void reboot(void) {
+    flash.close();
+    flash.init();
+    TEST_ASSERT_TRUE(flash.open(FLASH_IMAGE, FLASH_STORE_PAGES));
+    TEST_ASSERT_TRUE(store.init(&flash));
+}
+
+void setUp(void) {
+    // Set up runs before each test
+    remove(FLASH_IMAGE);
+    flash.init();
+    flash.open(FLASH_IMAGE, FLASH_STORE_PAGES);
+    store.init(&flash);
+}
+
+void tearDown(void) {
+    // Clean up runs after each test
+    flash.close();
+    remove(FLASH_IMAGE);
+}
+
+/**
+ * Test records survive a reboot, the newest value wins and removal sticks
+ */
+void test_records_persist(void) {
+    float offsets[6] = {1.0f, 2.0f, 3.0f, 4.0f, 5.0f, 6.0f};
+    uint16_t interval = 250;
+    uint16_t out16 = 0;
+    float out[6];
+
+    TEST_ASSERT_TRUE(store.put(RECORD_KEY_CAL_OFFSET, offsets, sizeof(offsets)));
+    TEST_ASSERT_TRUE(store.put(RECORD_KEY_SAMPLING_INTERVAL, &interval, sizeof(interval)));
+    interval = 500;
+    TEST_ASSERT_TRUE(store.put(RECORD_KEY_SAMPLING_INTERVAL, &interval, sizeof(interval)));
+    TEST_ASSERT_TRUE(store.put(RECORD_KEY_TEMP_COEFF, offsets, sizeof(offsets)));
+    TEST_ASSERT_TRUE(store.remove(RECORD_KEY_TEMP_COEFF));
+
+    reboot();
+
+    TEST_ASSERT_TRUE(store.get(RECORD_KEY_CAL_OFFSET, out, sizeof(out)));
+    TEST_ASSERT_EQUAL_MEMORY(offsets, out, sizeof(out));
+    TEST_ASSERT_TRUE(store.get(RECORD_KEY_SAMPLING_INTERVAL, &out16, sizeof(out16)));
+    TEST_ASSERT_EQUAL_UINT16(500, out16);
+    TEST_ASSERT_FALSE(store.contains(RECORD_KEY_TEMP_COEFF));
+    TEST_ASSERT_FALSE(store.contains(RECORD_KEY_MASTER_KEY));
+
+    // Size mismatch and out-of-range keys are refused
+    TEST_ASSERT_FALSE(store.get(RECORD_KEY_CAL_OFFSET, out, 4));
+    TEST_ASSERT_FALSE(store.put(RECORD_MAX_KEYS, &interval, sizeof(interval)));
+    TEST_ASSERT_FALSE(store.put(RECORD_KEY_MASTER_KEY, out, RECORD_MAX_LENGTH + 1));
+}
+
+/**
+ * Test rewriting an unchanged value does not touch flash
+ */
+void test_unchanged_put_skipped(void) {
+    uint16_t interval = 1000;
+
+    TEST_ASSERT_TRUE(store.put(RECORD_KEY_SAMPLING_INTERVAL, &interval, sizeof(interval)));
+    uint32_t free_bytes = store.freeBytes();
+    TEST_ASSERT_TRUE(store.put(RECORD_KEY_SAMPLING_INTERVAL, &interval, sizeof(interval)));
+    TEST_ASSERT_EQUAL_UINT32(free_bytes, store.freeBytes());
+}
+
+/**
+ * Test pages rotate evenly and live records are carried forward
+ */
+void test_wear_levelling(void) {
+    uint8_t key_material[16];
+    uint32_t value;
+
+    memset(key_material, 0xA5, sizeof(key_material));
+    TEST_ASSERT_TRUE(store.put(RECORD_KEY_MASTER_KEY, key_material, sizeof(key_material)));
+
+    // Rewrite one setting until every page has been recycled many times
+    for (value = 0; value < 5000; value++) {
+        TEST_ASSERT_TRUE(store.put(RECORD_KEY_SAMPLING_INTERVAL, &value, sizeof(value)));
+    }
+    TEST_ASSERT_TRUE(store.pagesCollected() >= 8);
+
+    uint32_t min_erases = 0xFFFFFFFFUL;
+    uint32_t max_erases = 0;
+    for (uint16_t p = 0; p < FLASH_STORE_PAGES; p++) {
+        uint32_t n = flash.eraseCount(p);
+        if (n < min_erases) min_erases = n;
+        if (n > max_erases) max_erases = n;
+    }
+    TEST_ASSERT_TRUE(max_erases - min_erases <= 1);
+
+    reboot();
+
+    uint8_t loaded[16];
+    TEST_ASSERT_TRUE(store.get(RECORD_KEY_MASTER_KEY, loaded, sizeof(loaded)));
+    TEST_ASSERT_EQUAL_MEMORY(key_material, loaded, sizeof(loaded));
+    TEST_ASSERT_TRUE(store.get(RECORD_KEY_SAMPLING_INTERVAL, &value, sizeof(value)));
+    TEST_ASSERT_EQUAL_UINT32(4999, value);
+}
+
+/**
+ * Test a write torn by power loss leaves the previous value readable
+ */
+void test_torn_write_recovery(void) {
+    float before[6] = {10.0f, 20.0f, 30.0f, 40.0f, 50.0f, 60.0f};
+    float after[6] = {11.0f, 21.0f, 31.0f, 41.0f, 51.0f, 61.0f};
+    float out[6];
+
+    TEST_ASSERT_TRUE(store.put(RECORD_KEY_CAL_OFFSET, before, sizeof(before)));
+
+    // Power fails partway through the new record's data
+    flash.failAfter(sizeof(RecordHeader) + 10);
+    TEST_ASSERT_FALSE(store.put(RECORD_KEY_CAL_OFFSET, after, sizeof(after)));
+
+    reboot();
+
+    TEST_ASSERT_TRUE(store.get(RECORD_KEY_CAL_OFFSET, out, sizeof(out)));
+    TEST_ASSERT_EQUAL_MEMORY(before, out, sizeof(out));
+
+    // Writes resume past the damage
+    TEST_ASSERT_TRUE(store.put(RECORD_KEY_CAL_OFFSET, after, sizeof(after)));
+    reboot();
+    TEST_ASSERT_TRUE(store.get(RECORD_KEY_CAL_OFFSET, out, sizeof(out)));
+    TEST_ASSERT_EQUAL_MEMORY(after, out, sizeof(out));
+}
+
+/**
+ * Test the encryption key is provisioned once and loaded on later boots
+ */
+void test_key_persists(void) {
+    KeyManager keys;
+    uint8_t master[16];
+    for (uint8_t i = 0; i < 16; i++) {
+        master[i] = i * 7;
+    }
+
+    keys.init(&store);
+    TEST_ASSERT_FALSE(keys.isProvisioned());
+    TEST_ASSERT_TRUE(keys.provisionKey(master, 16));
+
+    reboot();
+    keys.init(&store);
+    TEST_ASSERT_TRUE(keys.isProvisioned());
+
+    keys.wipeKeys();
+    reboot();
+    keys.init(&store);
+    TEST_ASSERT_FALSE(keys.isProvisioned());
+}
+
+/**
+ * Report boot-time load and lookup cost with a full set of records
+ */
+void test_load_timing(void) {
+    uint8_t record[RECORD_MAX_LENGTH];
+    char msg[128];
+
+    // Every key at full length, several generations deep
+    for (uint8_t gen = 0; gen < 3; gen++) {
+        for (uint16_t key = 0; key < RECORD_MAX_KEYS; key++) {
+            memset(record, key + gen, sizeof(record));
+            TEST_ASSERT_TRUE(store.put(key, record, sizeof(record)));
+        }
+    }
+
+    reboot();
+
+    cycle_counter_init();
+    uint32_t start = cycle_counter_read();
+    for (uint16_t i = 0; i < 1000; i++) {
+        store.get(i % RECORD_MAX_KEYS, record, sizeof(record));
+    }
+    uint32_t per_get = (cycle_counter_read() - start) / 1000;
+
+    TEST_ASSERT_EQUAL_UINT8(999 % RECORD_MAX_KEYS + 2, record[0]);
+    snprintf(msg, sizeof(msg), "boot load %lu us for %u records; get %lu ticks (%lu Hz counter)",
+             (unsigned long)store.loadTimeUs(), RECORD_MAX_KEYS,
+             (unsigned long)per_get, (unsigned long)CYCLE_COUNTER_HZ);
+    TEST_MESSAGE(msg);
+}
+
+void setup() {
+    delay(2000);
+
+    UNITY_BEGIN();
+
+    RUN_TEST(test_records_persist);
+    RUN_TEST(test_unchanged_put_skipped);
+    RUN_TEST(test_wear_levelling);
+    RUN_TEST(test_torn_write_recovery);
+    RUN_TEST(test_key_persists);
+    RUN_TEST(test_load_timing);
+
+    UNITY_END();
+}
+
+void loop() {
+    // Tests run once in setup()
+}
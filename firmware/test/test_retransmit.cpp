@@ -0,0 +1,297 @@
+/**
+ * @file test_retransmit.cpp
+ * @brief Unit tests for selective-repeat delivery of sensor data
+ *
+ * Tests the central's acknowledgement window, which packets the firmware
+ * resends for a given acknowledgement, and delivery of a live stream over
+ * a lossy link loopback against plain notifications, on the virtual clock
+ */
+
+#include <unity.h>
+#include "retransmit.h"
+#include "link_loopback.h"
+#include "tx_queue.h"
+#include "ble_frame.h"
+#include "sys_time.h"
+#include <stdio.h>
+#include <string.h>
+
+#define PACKETS         2000
+#define PACKET_SIZE     48      // An encrypted full reading
+#define PACKET_EVENTS   8       // One packet every 60 ms
+#define ACK_EVENTS      33      // About the app's 250 ms
+#define DRAIN_EVENTS    2000    // After the last packet
+
+RetransmitBuffer retransmit;
+AckWindow window;
+BleLink link;
+TxQueue txQueue;
+LinkLoopback loopback;
+
+// One simulated stream: what the firmware sent, what the app received
+typedef struct {
+    FrameReassembler frames;
+    bool acking;
+    uint32_t produced;
+    uint32_t refused;           // Pushes the queue turned down
+    uint32_t delivered;
+    uint32_t repeated;          // Passed to the app twice
+    uint32_t worst_events;      // Longest send to delivery
+    uint32_t sent_at[PACKETS];
+    bool received[PACKETS];
+} Stream;
+
+Stream stream;
+
+static void fillPacket(uint32_t index, uint8_t* out) {
+    memset(out, (uint8_t)index, PACKET_SIZE);
+    out[0] = (uint8_t)index;
+    out[1] = (uint8_t)(index >> 8);
+    out[2] = (uint8_t)(index >> 16);
+    out[3] = (uint8_t)(index >> 24);
+}
+
+// The firmware's main loop: resends first, into room short of
+// backpressure, then the readings that have come due
+static void firmwarePump(void* context) {
+    (void)context;
+    uint16_t payload = link.notifyPayload();
+    const RetransmitSlot* slot;
+    while (stream.acking && !txQueue.backpressure() && (slot = retransmit.nextMissing()) != 0) {
+        if (frameFragmentsFor(slot->length, payload) > txQueue.space() ||
+            !txQueue.resend(0, slot->seq, slot->data, slot->length, payload)) {
+            break;
+        }
+        retransmit.resent(slot);
+    }
+
+    uint32_t event = loopback.stats()->events;
+    while (stream.produced < PACKETS && stream.produced * PACKET_EVENTS <= event) {
+        uint8_t packet[PACKET_SIZE];
+        fillPacket(stream.produced, packet);
+        uint16_t seq = txQueue.nextSeq(0);
+        if (txQueue.push(0, packet, PACKET_SIZE, payload)) {
+            retransmit.store(seq, packet, PACKET_SIZE);
+        } else {
+            stream.refused++;
+        }
+        stream.sent_at[stream.produced++] = event;
+    }
+}
+
+// The app: reassemble, drop what it already has by sequence number
+static void centralReceive(uint8_t target, const uint8_t* data, uint8_t length, void* context) {
+    (void)target;
+    (void)context;
+    if (!stream.frames.feed(data, length)) return;
+    if (stream.acking && !window.receive(stream.frames.packetSeq())) return;
+
+    const uint8_t* packet = stream.frames.packet();
+    uint32_t index = packet[0] | (packet[1] << 8) | (packet[2] << 16) | ((uint32_t)packet[3] << 24);
+    if (index >= PACKETS) return;
+    if (stream.received[index]) {
+        stream.repeated++;
+        return;
+    }
+    stream.received[index] = true;
+    stream.delivered++;
+
+    uint32_t waited = loopback.stats()->events - stream.sent_at[index];
+    if (waited > stream.worst_events) {
+        stream.worst_events = waited;
+    }
+}
+
+static void runStream(uint16_t loss_per_mille, bool acking) {
+    memset(&stream, 0, sizeof(stream));
+    stream.frames.init();
+    stream.acking = acking;
+    retransmit.init();
+    window.init();
+    txQueue.init();
+    link.onConnect("");
+    loopback.init(&link, &txQueue);
+    loopback.setPump(firmwarePump, 0);
+    loopback.setReceiver(centralReceive, 0);
+    loopback.setLoss(loss_per_mille, 12345);
+
+    uint32_t events = PACKETS * PACKET_EVENTS + DRAIN_EVENTS;
+    for (uint32_t i = 1; i <= events && stream.delivered < PACKETS; i++) {
+        loopback.connectionEvent();
+
+        // A write with response: acknowledgements themselves are not lost
+        if (acking && i % ACK_EVENTS == 0 && window.stats()->delivered) {
+            uint8_t ack[RETRANSMIT_ACK_SIZE];
+            uint16_t base;
+            uint32_t bitmap;
+            window.encodeAck(ack);
+            retransmitDecodeAck(ack, &base, &bitmap);
+            retransmit.acknowledge(base, bitmap);
+        }
+    }
+}
+
+void setUp(void) {
+    // Set up runs before each test
+    sysTimeSetVirtual(true);
+    link.init();
+    link.setPeer(BLE_ATT_MTU_MAX, BLE_DATA_LENGTH_MAX, BLE_PHY_1M);
+    retransmit.init();
+    window.init();
+}
+
+void tearDown(void) {
+    // Clean up runs after each test
+    sysTimeSetVirtual(false);
+}
+
+/**
+ * Test the window acknowledges in order, keeps later packets in the bitmap,
+ * drops duplicates and slides past a gap too old to be resent
+ */
+void test_ack_window(void) {
+    uint8_t ack[RETRANSMIT_ACK_SIZE];
+
+    TEST_ASSERT_TRUE(window.receive(100));
+    TEST_ASSERT_TRUE(window.receive(101));
+    TEST_ASSERT_EQUAL_UINT16(102, window.base());
+    TEST_ASSERT_EQUAL_UINT32(0, window.bitmap());
+
+    // 102 and 104 lost
+    TEST_ASSERT_TRUE(window.receive(103));
+    TEST_ASSERT_TRUE(window.receive(105));
+    TEST_ASSERT_EQUAL_UINT16(102, window.base());
+    TEST_ASSERT_EQUAL_UINT32(0x05, window.bitmap());
+    window.encodeAck(ack);
+    TEST_ASSERT_EQUAL_UINT8(0, ack[0]);
+    TEST_ASSERT_EQUAL_UINT8(102, ack[1]);
+    TEST_ASSERT_EQUAL_UINT8(0x05, ack[5]);
+
+    // Resends fill the holes; a second copy is refused
+    TEST_ASSERT_TRUE(window.receive(102));
+    TEST_ASSERT_EQUAL_UINT16(104, window.base());
+    TEST_ASSERT_TRUE(window.receive(104));
+    TEST_ASSERT_EQUAL_UINT16(106, window.base());
+    TEST_ASSERT_FALSE(window.receive(104));
+    TEST_ASSERT_FALSE(window.receive(101));
+
+    // 106 never comes: given up once 139 needs the bitmap
+    TEST_ASSERT_TRUE(window.receive(107));
+    TEST_ASSERT_TRUE(window.receive(139));
+    TEST_ASSERT_EQUAL_UINT16(108, window.base());
+
+    // Across the wrap
+    window.init();
+    TEST_ASSERT_TRUE(window.receive(0xFFFE));
+    TEST_ASSERT_TRUE(window.receive(0x0001));
+    TEST_ASSERT_EQUAL_UINT16(0xFFFF, window.base());
+    TEST_ASSERT_EQUAL_UINT32(0x02, window.bitmap());
+
+    const AckWindowStats* stats = window.stats();
+    TEST_ASSERT_EQUAL_UINT32(2, stats->delivered);
+    TEST_ASSERT_EQUAL_UINT32(0, stats->lost);
+}
+
+/**
+ * Test holes below a received packet are resent at once, the tail only
+ * after a whole ack, a resend only after another whole ack, and the oldest
+ * packet is given up when the buffer is full
+ */
+void test_selective_resend(void) {
+    uint8_t packet[PACKET_SIZE];
+    for (uint16_t seq = 10; seq < 16; seq++) {
+        fillPacket(seq, packet);
+        retransmit.store(seq, packet, PACKET_SIZE);
+    }
+
+    // Received 10, 11, 13; 12 is a hole, 14 and 15 may be in flight
+    TEST_ASSERT_EQUAL_UINT8(3, retransmit.acknowledge(12, 0x01));
+    TEST_ASSERT_EQUAL_UINT8(3, retransmit.count());
+    const RetransmitSlot* slot = retransmit.nextMissing();
+    TEST_ASSERT_NOT_NULL(slot);
+    TEST_ASSERT_EQUAL_UINT16(12, slot->seq);
+    TEST_ASSERT_EQUAL_UINT8(12, slot->data[0]);
+    retransmit.resent(slot);
+    TEST_ASSERT_NULL(retransmit.nextMissing());
+
+    // Still no 12 (resend in flight), 14 or 15: only the tail goes
+    retransmit.acknowledge(12, 0x01);
+    slot = retransmit.nextMissing();
+    TEST_ASSERT_EQUAL_UINT16(14, slot->seq);
+    retransmit.resent(slot);
+    slot = retransmit.nextMissing();
+    TEST_ASSERT_EQUAL_UINT16(15, slot->seq);
+    retransmit.resent(slot);
+    TEST_ASSERT_NULL(retransmit.nextMissing());
+
+    // A whole ack later the resend of 12 is taken as lost too
+    retransmit.acknowledge(12, 0x07);
+    slot = retransmit.nextMissing();
+    TEST_ASSERT_EQUAL_UINT16(12, slot->seq);
+    TEST_ASSERT_EQUAL_UINT8(1, retransmit.count());
+    TEST_ASSERT_EQUAL_UINT8(1, retransmit.acknowledge(16, 0));
+    TEST_ASSERT_EQUAL_UINT8(0, retransmit.count());
+
+    // Full: the oldest unacknowledged packet makes room
+    for (uint16_t seq = 0; seq <= RETRANSMIT_DEPTH; seq++) {
+        retransmit.store(100 + seq, packet, PACKET_SIZE);
+    }
+    TEST_ASSERT_EQUAL_UINT8(RETRANSMIT_DEPTH, retransmit.count());
+    retransmit.acknowledge(100, 0);
+    retransmit.acknowledge(100, 0);
+    TEST_ASSERT_EQUAL_UINT16(101, retransmit.nextMissing()->seq);
+
+    const RetransmitStats* stats = retransmit.stats();
+    TEST_ASSERT_EQUAL_UINT32(6 + RETRANSMIT_DEPTH + 1, stats->stored);
+    TEST_ASSERT_EQUAL_UINT32(6, stats->acknowledged);
+    TEST_ASSERT_EQUAL_UINT32(3, stats->resent);
+    TEST_ASSERT_EQUAL_UINT32(1, stats->evicted);
+}
+
+/**
+ * Test every packet of a live stream reaches the app exactly once over a
+ * link dropping one notification in ten, without holding back new
+ * packets, and report what plain notifications lose on the same link
+ */
+void test_lossy_link(void) {
+    runStream(100, false);
+    uint32_t plain_delivered = stream.delivered;
+    TEST_ASSERT_TRUE(plain_delivered < PACKETS);
+    TEST_ASSERT_TRUE(loopback.stats()->dropped > 0);
+
+    runStream(100, true);
+    TEST_ASSERT_EQUAL_UINT32(PACKETS, stream.produced);
+    TEST_ASSERT_EQUAL_UINT32(0, stream.refused);
+    TEST_ASSERT_EQUAL_UINT32(PACKETS, stream.delivered);
+    TEST_ASSERT_EQUAL_UINT32(0, stream.repeated);
+    TEST_ASSERT_EQUAL_UINT32(0, retransmit.stats()->evicted);
+    TEST_ASSERT_TRUE(window.stats()->recovered > 0);
+    TEST_ASSERT_TRUE(stream.frames.stats()->late > 0);
+
+    const RetransmitStats* stats = retransmit.stats();
+    char msg[200];
+    snprintf(msg, sizeof(msg),
+             "10%% loss: plain %lu/%d delivered | selective repeat %lu/%d, %lu resent (%.1f%% extra), "
+             "%lu duplicates dropped, worst delay %.0f ms",
+             (unsigned long)plain_delivered, PACKETS, (unsigned long)stream.delivered, PACKETS,
+             (unsigned long)stats->resent, 100.0f * stats->resent / PACKETS,
+             (unsigned long)window.stats()->duplicates,
+             stream.worst_events * LOOPBACK_INTERVAL_US / 1000.0f);
+    TEST_MESSAGE(msg);
+}
+
+void setup() {
+    delay(2000);
+
+    UNITY_BEGIN();
+
+    RUN_TEST(test_ack_window);
+    RUN_TEST(test_selective_resend);
+    RUN_TEST(test_lossy_link);
+
+    UNITY_END();
+}
+
+void loop() {
+    // Tests run once in setup()
+}
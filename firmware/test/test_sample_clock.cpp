@@ -0,0 +1,172 @@
+/**
+ * @file test_sample_clock.cpp
+ * @brief Unit tests for the hardware sampling clock
+ *
+ * Tests tick arithmetic, jitter histogram binning and clocked acquisition
+ */
+
+#include <unity.h>
+#include "sample_clock.h"
+#include "adc_driver.h"
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+
+AdcDriver adc;
+SampleClock sampleClock;
+
+void setUp(void) {
+    // Set up runs before each test
+    adc.init();
+    sampleClock.init(&adc);
+}
+
+void tearDown(void) {
+    // Clean up runs after each test
+    sampleClock.stop();
+    adc.stop();
+}
+
+// Collect clocked frames until count arrive or the timeout expires
+static uint16_t collectFrames(AdcFrame* frames, uint16_t count, uint32_t timeout_ms) {
+    uint16_t n = 0;
+    uint32_t start = millis();
+
+    while (n < count && millis() - start < timeout_ms) {
+        sampleClock.service();
+        while (n < count && adc.fetch(&frames[n])) {
+            n++;
+        }
+    }
+    return n;
+}
+
+/**
+ * Test tick/ms conversions on the 32.768 kHz clock
+ */
+void test_clock_tick_conversion(void) {
+    TEST_ASSERT_EQUAL_UINT32(32768, (uint32_t)SampleClock::msToTicks(1000));
+    TEST_ASSERT_EQUAL_UINT32(1000, SampleClock::ticksToMs(32768));
+    TEST_ASSERT_INT_WITHIN(1, 30, SampleClock::ticksToMs(SampleClock::msToTicks(30)));
+
+    // Beyond 32-bit ticks (36 hours)
+    uint64_t ticks = SampleClock::msToTicks(200000000UL);
+    TEST_ASSERT_EQUAL_UINT32(200000000UL, SampleClock::ticksToMs(ticks));
+}
+
+/**
+ * Test jitter histogram binning around zero deviation
+ */
+void test_jitter_histogram_bins(void) {
+    JitterHistogram h;
+    memset(&h, 0, sizeof(h));
+    h.bin_us = 32;
+
+    jitterRecord(&h, 0);
+    jitterRecord(&h, 31);
+    jitterRecord(&h, -1);
+    jitterRecord(&h, 32);
+    jitterRecord(&h, -256);
+    jitterRecord(&h, -257);
+    jitterRecord(&h, 255);
+    jitterRecord(&h, 256);
+
+    TEST_ASSERT_EQUAL_UINT32(2, h.bins[JITTER_BINS / 2]);
+    TEST_ASSERT_EQUAL_UINT32(1, h.bins[JITTER_BINS / 2 - 1]);
+    TEST_ASSERT_EQUAL_UINT32(1, h.bins[JITTER_BINS / 2 + 1]);
+    TEST_ASSERT_EQUAL_UINT32(1, h.bins[0]);
+    TEST_ASSERT_EQUAL_UINT32(1, h.bins[JITTER_BINS - 1]);
+    TEST_ASSERT_EQUAL_UINT32(1, h.underflow);
+    TEST_ASSERT_EQUAL_UINT32(1, h.overflow);
+    TEST_ASSERT_EQUAL_UINT32(8, h.count);
+    TEST_ASSERT_EQUAL_INT32(-257, h.min_us);
+    TEST_ASSERT_EQUAL_INT32(256, h.max_us);
+}
+
+/**
+ * Test clocked frames are stamped with trigger ticks at the nominal period
+ */
+void test_clock_frame_ticks(void) {
+    const uint16_t FRAMES = 20;
+    AdcFrame frames[FRAMES];
+
+    sampleClock.start(5);
+    uint16_t n = collectFrames(frames, FRAMES, 500);
+    sampleClock.stop();
+
+    TEST_ASSERT_EQUAL(FRAMES, n);
+
+    // 5 ms = 163.84 ticks: each period is a whole number of nominal
+    // periods to within one tick, as the fraction carries between them
+    for (uint16_t i = 1; i < n; i++) {
+        float period = (float)(frames[i].tick - frames[i - 1].tick);
+        float periods = floorf(period / 163.84f + 0.5f);
+        TEST_ASSERT_TRUE(periods >= 1.0f);
+        TEST_ASSERT_FLOAT_WITHIN(1.0f, periods * 163.84f, period);
+        TEST_ASSERT_EQUAL_UINT32(SampleClock::ticksToMs(frames[i].tick), frames[i].timestamp_ms);
+    }
+    
+    float span = (float)(frames[n - 1].tick - frames[0].tick);
+    float periods = floorf(span / 163.84f + 0.5f);
+    TEST_ASSERT_FLOAT_WITHIN(1.0f, periods * 163.84f, span);
+}
+
+/**
+ * Test the clock owns SAMPLE while running and releases it on stop
+ */
+void test_clock_owns_trigger(void) {
+    AdcFrame frame;
+
+    sampleClock.start(10);
+    TEST_ASSERT_FALSE(adc.trigger());
+    TEST_ASSERT_FALSE(adc.acquire(&frame));
+
+    sampleClock.stop();
+    while (adc.fetch(&frame));
+    TEST_ASSERT_TRUE(adc.acquire(&frame));
+}
+
+/**
+ * Test the jitter histogram counts every measured period
+ */
+void test_clock_jitter_report(void) {
+    AdcFrame frames[30];
+    char msg[128];
+
+    sampleClock.start(5);
+    collectFrames(frames, 30, 500);
+    sampleClock.stop();
+
+    const JitterHistogram* j = sampleClock.jitter();
+    TEST_ASSERT_EQUAL_UINT32(sampleClock.triggerCount() - 1, j->count);
+
+    uint32_t binned = j->underflow + j->overflow;
+    for (uint8_t b = 0; b < JITTER_BINS; b++) {
+        binned += j->bins[b];
+    }
+    TEST_ASSERT_EQUAL_UINT32(j->count, binned);
+
+    snprintf(msg, sizeof(msg), "period deviation: min %ld us, max %ld us, %lu/%lu within +/-%u us",
+             (long)j->min_us, (long)j->max_us,
+             (unsigned long)(j->bins[JITTER_BINS / 2 - 1] + j->bins[JITTER_BINS / 2]),
+             (unsigned long)j->count, j->bin_us);
+    TEST_MESSAGE(msg);
+}
+
+void setup() {
+    delay(2000);
+
+    UNITY_BEGIN();
+
+    RUN_TEST(test_clock_tick_conversion);
+    RUN_TEST(test_jitter_histogram_bins);
+    RUN_TEST(test_clock_frame_ticks);
+    RUN_TEST(test_clock_owns_trigger);
+    RUN_TEST(test_clock_jitter_report);
+
+    UNITY_END();
+}
+
+void loop() {
+    // Tests run once in setup()
+}
@@ -0,0 +1,308 @@
+/**
+ * @file test_sample_log.cpp
+ * @brief Unit tests for the offline sample log
+ *
+ * Tests persistence across reboots, capacity and wrap-around, recovery from
+ * torn blocks, and catch-up packets resuming from the acknowledgement, on
+ * the file-backed flash emulator
+ */
+
+#include <unity.h>
+#include "sample_log.h"
+#include "reading_codec.h"
+#include "ble_link.h"
+#include "ble_frame.h"
+#include "aes.h"
+#include <stdio.h>
+#include <string.h>
+
+#define FLASH_IMAGE     "/tmp/symbion_test_log.bin"
+
+FlashDevice flash;
+SampleLog sampleLog;
+ReadingCodec codec;
+
+// Power cycle: drop RAM state and rebuild it from the image
+static void reboot(uint32_t acked) {
+    flash.close();
+    flash.init(FLASH_LOG_BASE, FLASH_LOG_PAGES);
+    TEST_ASSERT_TRUE(flash.open(FLASH_IMAGE, FLASH_LOG_PAGES));
+    TEST_ASSERT_TRUE(sampleLog.init(&flash, acked));
+}
+
+// One reading a second, every channel, timestamped with its index
+static void logReadings(uint32_t from, uint32_t count) {
+    for (uint32_t i = from; i < from + count; i++) {
+        SensorReading r;
+        memset(&r, 0, sizeof(r));
+        r.timestamp_ms = i * 1000;
+        r.serotonin_nm = 100.0f + (i % 50);
+        r.dopamine_nm = 200.0f;
+        r.gaba_nm = 1000.0f;
+        r.ph_level = 6.5f;
+        r.temperature_c = 37.0f;
+        r.calprotectin_ug_g = 50.0f;
+        sampleLog.append(&r, ADC_ALL_CHANNELS, i * 1000);
+    }
+}
+
+typedef struct {
+    uint32_t packets;
+    uint32_t readings;
+    uint32_t first;         // Of the first packet
+    uint32_t end;           // From the end marker
+    uint32_t bytes;         // Packet bytes
+    bool contiguous;        // Every packet continued the one before
+} SyncResult;
+
+// Drain a sync, checking each reading's timestamp against its number
+static void drainSync(uint32_t from, uint32_t max_packets, SyncResult* result) {
+    uint8_t packet[LOG_PACKET_MAX];
+    uint16_t readings;
+    uint16_t length;
+    uint32_t expect = 0;
+
+    memset(result, 0, sizeof(*result));
+    result->contiguous = true;
+    sampleLog.seek(from);
+
+    while (result->packets < max_packets && (length = sampleLog.readPacket(packet, &readings)) > 0) {
+        uint32_t first = packet[0] | (packet[1] << 8) | (packet[2] << 16) | ((uint32_t)packet[3] << 24);
+        if (readings == 0) {
+            result->end = first;
+            break;
+        }
+        if (result->packets == 0) {
+            result->first = first;
+        } else if (first != expect) {
+            result->contiguous = false;
+        }
+
+        uint16_t at = LOG_PACKET_HEADER;
+        for (uint16_t i = 0; i < readings; i++) {
+            SensorReading r;
+            uint8_t mask = codec.decode(packet + at, length - at, &r);
+            if (mask != ADC_ALL_CHANNELS || r.timestamp_ms != (first + i) * 1000) {
+                result->contiguous = false;
+                break;
+            }
+            at += codec.size(mask);
+        }
+        expect = first + readings;
+        result->packets++;
+        result->readings += readings;
+        result->bytes += length;
+    }
+}
+
+void setUp(void) {
+    // Set up runs before each test
+    remove(FLASH_IMAGE);
+    codec.init();
+    flash.init(FLASH_LOG_BASE, FLASH_LOG_PAGES);
+    flash.open(FLASH_IMAGE, FLASH_LOG_PAGES);
+    sampleLog.init(&flash);
+}
+
+void tearDown(void) {
+    // Clean up runs after each test
+    flash.close();
+    remove(FLASH_IMAGE);
+}
+
+/**
+ * Test logged readings survive a reboot and numbering carries on; the
+ * block still in RAM is all a reset loses
+ */
+void test_log_persists(void) {
+    logReadings(0, 100);
+    TEST_ASSERT_EQUAL_UINT32(100, sampleLog.nextSeq());
+    TEST_ASSERT_TRUE(sampleLog.stats()->blocks > 0);
+    TEST_ASSERT_TRUE(sampleLog.flush());
+
+    // Five more never reach flash
+    logReadings(100, 5);
+    TEST_ASSERT_FALSE(sampleLog.due(104000));
+    TEST_ASSERT_TRUE(sampleLog.due(100000 + LOG_FLUSH_MS));
+    reboot(0);
+
+    TEST_ASSERT_EQUAL_UINT32(100, sampleLog.nextSeq());
+    TEST_ASSERT_EQUAL_UINT32(0, sampleLog.oldestSeq());
+    TEST_ASSERT_EQUAL_UINT32(100, sampleLog.pending());
+
+    SyncResult sync;
+    drainSync(0, 1000, &sync);
+    TEST_ASSERT_TRUE(sync.contiguous);
+    TEST_ASSERT_EQUAL_UINT32(0, sync.first);
+    TEST_ASSERT_EQUAL_UINT32(100, sync.readings);
+    TEST_ASSERT_EQUAL_UINT32(100, sync.end);
+
+    // A fresh log continues from the saved acknowledgement
+    flash.erasePage(0);
+    flash.erasePage(1);
+    reboot(5000);
+    TEST_ASSERT_EQUAL_UINT32(5000, sampleLog.nextSeq());
+    TEST_ASSERT_EQUAL_UINT32(0, sampleLog.pending());
+}
+
+/**
+ * Test the ring wraps onto its oldest page, counting only unacknowledged
+ * readings as lost, and report the capacity
+ */
+void test_wrap_capacity(void) {
+    const uint32_t TOTAL = 8000;
+
+    logReadings(0, 2000);
+    sampleLog.acknowledge(2000);
+    logReadings(2000, TOTAL - 2000);
+    sampleLog.flush();
+
+    uint32_t oldest = sampleLog.oldestSeq();
+    uint32_t held = TOTAL - oldest;
+    const SampleLogStats* stats = sampleLog.stats();
+    TEST_ASSERT_TRUE(oldest > 2000);
+    TEST_ASSERT_EQUAL_UINT32(TOTAL, sampleLog.nextSeq());
+    TEST_ASSERT_EQUAL_UINT32(held, sampleLog.pending());
+    TEST_ASSERT_EQUAL_UINT32(oldest - 2000, stats->overwritten);
+
+    // The oldest reading still there comes out first
+    SyncResult sync;
+    drainSync(0, 1000, &sync);
+    TEST_ASSERT_TRUE(sync.contiguous);
+    TEST_ASSERT_EQUAL_UINT32(oldest, sync.first);
+    TEST_ASSERT_EQUAL_UINT32(held, sync.readings);
+
+    char msg[128];
+    snprintf(msg, sizeof(msg), "%lu readings held in %u KB (%.1f B each in flash), %.1f h at 1 Hz",
+             (unsigned long)held, FLASH_LOG_PAGES * FLASH_PAGE_SIZE / 1024,
+             (float)stats->flash_bytes / stats->appended, held / 3600.0f);
+    TEST_MESSAGE(msg);
+}
+
+/**
+ * Test a block torn by a reset is skipped and the log carries on after it
+ */
+void test_torn_block(void) {
+    logReadings(0, 40);
+    sampleLog.flush();
+
+    // Power fails half way through the next block
+    logReadings(40, 10);
+    flash.failAfter(40);
+    TEST_ASSERT_FALSE(sampleLog.flush());
+    reboot(0);
+
+    TEST_ASSERT_EQUAL_UINT32(1, sampleLog.stats()->corrupt);
+    TEST_ASSERT_EQUAL_UINT32(40, sampleLog.nextSeq());
+
+    logReadings(40, 20);
+    sampleLog.flush();
+    reboot(0);
+
+    SyncResult sync;
+    drainSync(0, 1000, &sync);
+    TEST_ASSERT_TRUE(sync.contiguous);
+    TEST_ASSERT_EQUAL_UINT32(60, sync.readings);
+    TEST_ASSERT_EQUAL_UINT32(60, sync.end);
+}
+
+/**
+ * Test a sync cut short resumes from the acknowledgement after a reboot
+ * and a later disconnected spell
+ */
+void test_sync_resumes(void) {
+    logReadings(0, 1000);
+    sampleLog.flush();
+
+    // The central takes a few packets and acknowledges them, then drops
+    SyncResult sync;
+    drainSync(0, 10, &sync);
+    TEST_ASSERT_EQUAL_UINT32(10, sync.packets);
+    uint32_t acked = sync.first + sync.readings;
+    sampleLog.acknowledge(acked);
+
+    logReadings(1000, 500);
+    sampleLog.flush();
+    reboot(acked);
+    TEST_ASSERT_EQUAL_UINT32(acked, sampleLog.acknowledged());
+    TEST_ASSERT_EQUAL_UINT32(1500 - acked, sampleLog.pending());
+
+    drainSync(sampleLog.acknowledged(), 1000, &sync);
+    TEST_ASSERT_TRUE(sync.contiguous);
+    TEST_ASSERT_EQUAL_UINT32(acked, sync.first);
+    TEST_ASSERT_EQUAL_UINT32(1500 - acked, sync.readings);
+    TEST_ASSERT_EQUAL_UINT32(1500, sync.end);
+
+    // Nothing left after the end marker until the next seek
+    uint8_t packet[LOG_PACKET_MAX];
+    uint16_t readings;
+    TEST_ASSERT_EQUAL_UINT16(0, sampleLog.readPacket(packet, &readings));
+}
+
+/**
+ * Test catch-up packets fill a notification at the largest MTU and report
+ * what 50 minutes offline costs to send
+ */
+void test_catch_up_throughput(void) {
+    const uint32_t OFFLINE = 3000;  // 50 minutes at one reading a second
+    BleLink link;
+    link.init();
+
+    logReadings(0, OFFLINE);
+    sampleLog.flush();
+
+    // Encrypted and framed as the firmware queues them
+    uint32_t air[2] = {0, 0};
+    uint32_t notifications[2] = {0, 0};
+    const uint16_t mtus[2] = {BLE_ATT_MTU_MAX, BLE_ATT_MTU_DEFAULT};
+    uint8_t key[16] = {0};
+    uint32_t readings = 0;
+    for (uint8_t m = 0; m < 2; m++) {
+        link.setPeer(mtus[m], BLE_DATA_LENGTH_MAX);
+        link.onConnect("");
+        sampleLog.seek(0);
+
+        uint8_t packet[LOG_PACKET_MAX];
+        uint8_t encrypted[LOG_PACKET_MAX + 2 * 16];
+        uint16_t count;
+        uint16_t length;
+        readings = 0;
+        while ((length = sampleLog.readPacket(packet, &count)) > 0) {
+            uint16_t encrypted_len = aes128_encrypt(packet, encrypted, key, length);
+            uint8_t fragments = frameFragmentsFor(encrypted_len, link.notifyPayload());
+            TEST_ASSERT_TRUE(fragments > 0);
+            if (mtus[m] == BLE_ATT_MTU_MAX) {
+                TEST_ASSERT_EQUAL_UINT8(1, fragments);
+            }
+            uint16_t framed = encrypted_len + fragments * FRAME_HEADER_SIZE;
+            notifications[m] += fragments;
+            air[m] += link.airBytesFor(framed);
+            readings += count;
+        }
+    }
+    TEST_ASSERT_EQUAL_UINT32(OFFLINE, readings);
+
+    char msg[160];
+    snprintf(msg, sizeof(msg), "%lu readings: MTU 247 %lu notifications, %.1f B on air each | MTU 23 %lu, %.1f B",
+             (unsigned long)readings, (unsigned long)notifications[0], (float)air[0] / readings,
+             (unsigned long)notifications[1], (float)air[1] / readings);
+    TEST_MESSAGE(msg);
+}
+
+void setup() {
+    delay(2000);
+
+    UNITY_BEGIN();
+
+    RUN_TEST(test_log_persists);
+    RUN_TEST(test_wrap_capacity);
+    RUN_TEST(test_torn_block);
+    RUN_TEST(test_sync_resumes);
+    RUN_TEST(test_catch_up_throughput);
+
+    UNITY_END();
+}
+
+void loop() {
+    // Tests run once in setup()
+}
@@ -149,6 +149,85 @@ void test_adc_range(void) {
     TEST_ASSERT_GREATER_OR_EQUAL(0.0, reading.calprotectin_ug_g);
 }
 
+/**
+ * Test self-test advances incrementally and reports monotonic progress
+ */
+void test_self_test_incremental(void) {
+    TEST_ASSERT_TRUE(sensorMgr.startSelfTest());
+    TEST_ASSERT_TRUE(sensorMgr.procedureActive());
+    
+    const ProcedureStatus* status = sensorMgr.procedureStatus();
+    TEST_ASSERT_EQUAL(PROCEDURE_SELF_TEST, status->procedure);
+    TEST_ASSERT_EQUAL(PROCEDURE_RUNNING, status->outcome);
+    
+    uint16_t steps = 0;
+    uint8_t last_percent = 0;
+    uint32_t start = millis();
+    while (sensorMgr.procedureActive() && millis() - start < 1000) {
+        if (sensorMgr.serviceProcedure()) {
+            TEST_ASSERT_GREATER_OR_EQUAL(last_percent, status->percent);
+            last_percent = status->percent;
+        }
+        steps++;
+    }
+    
+    // One scan per step at most, so many steps rather than one long call
+    TEST_ASSERT_FALSE(sensorMgr.procedureActive());
+    TEST_ASSERT_GREATER_THAN(20, steps);
+    TEST_ASSERT_EQUAL(100, status->percent);
+    TEST_ASSERT_EQUAL(PROCEDURE_PASSED, status->outcome);
+}
+
+/**
+ * Test a second procedure is refused while one runs, and abort is clean
+ */
+void test_procedure_abort(void) {
+    TEST_ASSERT_TRUE(sensorMgr.startCalibration());
+    TEST_ASSERT_FALSE(sensorMgr.startSelfTest());
+    TEST_ASSERT_FALSE(sensorMgr.startCalibration());
+    
+    for (int i = 0; i < 10; i++) {
+        sensorMgr.serviceProcedure();
+    }
+    sensorMgr.abortProcedure();
+    
+    const ProcedureStatus* status = sensorMgr.procedureStatus();
+    TEST_ASSERT_FALSE(sensorMgr.procedureActive());
+    TEST_ASSERT_EQUAL(PROCEDURE_CALIBRATE, status->procedure);
+    TEST_ASSERT_EQUAL(PROCEDURE_ABORTED, status->outcome);
+    TEST_ASSERT_LESS_THAN(100, status->percent);
+    
+    // The ADC is usable again
+    TEST_ASSERT_TRUE(sensorMgr.startSelfTest());
+    sensorMgr.abortProcedure();
+}
+
+/**
+ * Test clocked readings keep flowing while calibration settles
+ */
+void test_sampling_during_calibration(void) {
+    SensorReading reading;
+    uint16_t readings = 0;
+    
+    sensorMgr.startSampling(10);
+    TEST_ASSERT_TRUE(sensorMgr.startCalibration());
+    
+    uint32_t start = millis();
+    while (millis() - start < 200) {
+        sensorMgr.service();
+        sensorMgr.serviceProcedure();
+        if (sensorMgr.takeReading(&reading)) {
+            readings++;
+        }
+    }
+    
+    TEST_ASSERT_TRUE(sensorMgr.procedureActive());
+    TEST_ASSERT_GREATER_THAN(10, readings);
+    
+    sensorMgr.abortProcedure();
+    sensorMgr.stopAcquisition();
+}
+
 void setup() {
     delay(2000); // Wait for board initialization
     
@@ -160,6 +239,9 @@ void setup() {
     RUN_TEST(test_sensor_calibration);
     RUN_TEST(test_sensor_multiple_readings);
     RUN_TEST(test_adc_range);
+    RUN_TEST(test_self_test_incremental);
+    RUN_TEST(test_procedure_abort);
+    RUN_TEST(test_sampling_during_calibration);
     
     UNITY_END();
 }
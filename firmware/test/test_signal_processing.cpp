@@ -7,7 +7,12 @@
 
 #include <unity.h>
 #include "signal_processing.h"
+#include "pipeline.h"
+#include "cycle_counter.h"
 #include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
 
 SignalProcessor sigProc;
 
@@ -223,6 +228,297 @@ void test_filter_state_persistence(void) {
     TEST_ASSERT_EQUAL_FLOAT(out1, out2);
 }
 
+/**
+ * Test Hampel filter removes an isolated spike
+ */
+void test_hampel_rejects_spike(void) {
+    static HampelState state;
+    SignalProcessor::initHampelState(&state, 7, 3.0f);
+    
+    float output = 0.0f;
+    for (int i = 0; i < 20; i++) {
+        float input = 100.0f + ((i % 3) - 1) * 0.5f;
+        if (i == 15) input = 5000.0f;
+        output = sigProc.hampelFilter(input, &state);
+        if (i == 15) break;
+    }
+    
+    TEST_ASSERT_FLOAT_WITHIN_MESSAGE(
+        1.0,
+        100.0,
+        output,
+        "Spike should be replaced by the window median"
+    );
+    TEST_ASSERT_EQUAL_UINT32(1, state.rejected);
+}
+
+/**
+ * Test Hampel filter follows a genuine level change
+ */
+void test_hampel_tracks_step(void) {
+    static HampelState state;
+    SignalProcessor::initHampelState(&state, 7, 3.0f);
+    
+    float output = 0.0f;
+    for (int i = 0; i < 30; i++) {
+        float input = (i < 15) ? 100.0f : 300.0f;
+        input += ((i % 3) - 1) * 0.5f;
+        output = sigProc.hampelFilter(input, &state);
+    }
+    
+    TEST_ASSERT_FLOAT_WITHIN_MESSAGE(
+        1.0,
+        300.0,
+        output,
+        "Sustained step should pass once it fills half the window"
+    );
+}
+
+/**
+ * Test Hampel window lengths are clamped and rounded up to odd
+ */
+void test_hampel_window_odd(void) {
+    static HampelState state;
+    const uint8_t requested[] = {0, 3, 4, 8, 62, 63, 200};
+    const uint8_t expected[] = {3, 3, 5, 9, 63, 63, 63};
+    
+    for (uint8_t i = 0; i < sizeof(requested); i++) {
+        SignalProcessor::initHampelState(&state, requested[i], 3.0f);
+        TEST_ASSERT_EQUAL_UINT8(expected[i], state.window);
+    }
+}
+
+// Reference Hampel decision by sorting the window
+static float referenceHampel(const float* window, int n, float input, float threshold) {
+    float sorted[OSW_MAX_SIZE];
+    float dev[OSW_MAX_SIZE];
+    memcpy(sorted, window, n * sizeof(float));
+    
+    for (int i = 1; i < n; i++) {
+        for (int j = i; j > 0 && sorted[j - 1] > sorted[j]; j--) {
+            float t = sorted[j]; sorted[j] = sorted[j - 1]; sorted[j - 1] = t;
+        }
+    }
+    float median = sorted[(n - 1) / 2];
+    
+    for (int i = 0; i < n; i++) {
+        dev[i] = fabsf(sorted[i] - median);
+    }
+    for (int i = 1; i < n; i++) {
+        for (int j = i; j > 0 && dev[j - 1] > dev[j]; j--) {
+            float t = dev[j]; dev[j] = dev[j - 1]; dev[j - 1] = t;
+        }
+    }
+    float mad = dev[(n - 1) / 2];
+    
+    return (fabsf(input - median) > threshold * 1.4826f * mad) ? median : input;
+}
+
+/**
+ * Test Hampel filter against a brute-force sorted window
+ */
+void test_hampel_matches_reference(void) {
+    static HampelState state;
+    const uint8_t windows[] = {5, 8, 63};
+    
+    for (uint8_t w = 0; w < sizeof(windows); w++) {
+        SignalProcessor::initHampelState(&state, windows[w], 2.0f);
+        uint8_t n = state.window;
+        
+        float window[OSW_MAX_SIZE];
+        int filled = 0;
+        
+        for (int i = 0; i < 500; i++) {
+            // Coarse values so the window holds many duplicates
+            float input = (float)random(0, 40);
+            if (random(0, 20) == 0) input += 1000.0f;
+            
+            if (filled < n) {
+                window[filled++] = input;
+            } else {
+                memmove(window, window + 1, (n - 1) * sizeof(float));
+                window[n - 1] = input;
+            }
+            
+            float output = sigProc.hampelFilter(input, &state);
+            float expected = (filled < 3) ? input : referenceHampel(window, filled, input, 2.0f);
+            TEST_ASSERT_EQUAL_FLOAT(expected, output);
+        }
+    }
+}
+
+/**
+ * Benchmark Hampel filter cost per sample over window sizes
+ */
+void test_hampel_benchmark(void) {
+    static HampelState state;
+    const uint8_t windows[] = {5, 7, 15, 31, 63};
+    const int samples = 2000;
+    char msg[80];
+    
+    cycle_counter_init();
+    
+    for (uint8_t w = 0; w < sizeof(windows); w++) {
+        SignalProcessor::initHampelState(&state, windows[w], 3.0f);
+        
+        uint32_t start = cycle_counter_read();
+        for (int i = 0; i < samples; i++) {
+            float input = 100.0f + (float)random(-10, 10);
+            if ((i % 97) == 0) input += 2000.0f;
+            sigProc.hampelFilter(input, &state);
+        }
+        uint32_t elapsed = cycle_counter_read() - start;
+        
+        snprintf(msg, sizeof(msg), "window %2u: %lu ticks/sample (%lu Hz counter)",
+                 windows[w], (unsigned long)(elapsed / samples),
+                 (unsigned long)CYCLE_COUNTER_HZ);
+        TEST_MESSAGE(msg);
+    }
+    TEST_PASS();
+}
+
+/**
+ * Test composed pipeline matches the hand-written filter chain
+ */
+void test_pipeline_matches_manual_chain(void) {
+    typedef Pipeline<OutlierStage, BiquadStage, KalmanStage,
+                     ClampStage<SEROTONIN_MIN_NM, SEROTONIN_MAX_NM> > Chain;
+    static Chain chain;
+    static HampelState outlier;
+    FilterState filter;
+    KalmanState kalman;
+    
+    chain.stage<0>().configure(7, 3.0f);
+    chain.stage<1>().configure();
+    chain.stage<2>().configure(100.0f, 0.1f, 10.0f);
+    
+    SignalProcessor::initHampelState(&outlier, 7, 3.0f);
+    SignalProcessor::initFilterState(&filter);
+    SignalProcessor::initKalmanState(&kalman, 100.0f, 0.1f, 10.0f);
+    
+    TEST_ASSERT_EQUAL_UINT8(4, Chain::STAGE_COUNT);
+    
+    for (int i = 0; i < 500; i++) {
+        float input = 800.0f + (float)random(-50, 50);
+        if ((i % 61) == 0) input += 20000.0f;
+        
+        float expected = sigProc.hampelFilter(input, &outlier);
+        expected = sigProc.butterworthFilter(expected, &filter);
+        expected = sigProc.kalmanFilter(expected, &kalman);
+        if (expected < SEROTONIN_MIN_NM) expected = SEROTONIN_MIN_NM;
+        if (expected > SEROTONIN_MAX_NM) expected = SEROTONIN_MAX_NM;
+        
+        float output = chain.process(input);
+        TEST_ASSERT_EQUAL_MEMORY(&expected, &output, sizeof(float));
+    }
+}
+
+/**
+ * Test block and bank filters are bit-identical to the scalar path
+ */
+void test_block_matches_scalar(void) {
+    const uint16_t COUNT = 200;
+    const uint8_t CHANNELS = 3;
+    static float input[COUNT * CHANNELS];
+    static float scalar_out[COUNT * CHANNELS];
+    static float block_out[COUNT * CHANNELS];
+    
+    for (uint16_t i = 0; i < COUNT * CHANNELS; i++) {
+        input[i] = 500.0f + (float)random(-100, 100) * 0.37f;
+    }
+    
+    // Single channel, split into uneven blocks
+    FilterState bw_scalar, bw_block;
+    KalmanState kf_scalar, kf_block;
+    SignalProcessor::initFilterState(&bw_scalar);
+    SignalProcessor::initFilterState(&bw_block);
+    SignalProcessor::initKalmanState(&kf_scalar, 100.0f, 0.1f, 10.0f);
+    SignalProcessor::initKalmanState(&kf_block, 100.0f, 0.1f, 10.0f);
+    
+    for (uint16_t i = 0; i < COUNT; i++) {
+        scalar_out[i] = sigProc.kalmanFilter(sigProc.butterworthFilter(input[i], &bw_scalar), &kf_scalar);
+    }
+    sigProc.butterworthFilterBlock(input, block_out, 37, &bw_block);
+    sigProc.butterworthFilterBlock(input + 37, block_out + 37, COUNT - 37, &bw_block);
+    sigProc.kalmanFilterBlock(block_out, block_out, 100, &kf_block);
+    sigProc.kalmanFilterBlock(block_out + 100, block_out + 100, COUNT - 100, &kf_block);
+    
+    TEST_ASSERT_EQUAL_MEMORY(scalar_out, block_out, COUNT * sizeof(float));
+    TEST_ASSERT_EQUAL_MEMORY(&bw_scalar, &bw_block, sizeof(FilterState));
+    TEST_ASSERT_EQUAL_MEMORY(&kf_scalar, &kf_block, sizeof(KalmanState));
+    
+    // Interleaved filter bank
+    FilterState bank_bw[CHANNELS], ref_bw[CHANNELS];
+    KalmanState bank_kf[CHANNELS], ref_kf[CHANNELS];
+    for (uint8_t c = 0; c < CHANNELS; c++) {
+        SignalProcessor::initFilterState(&bank_bw[c]);
+        SignalProcessor::initFilterState(&ref_bw[c]);
+        SignalProcessor::initKalmanState(&bank_kf[c], 200.0f, 0.1f, 15.0f);
+        SignalProcessor::initKalmanState(&ref_kf[c], 200.0f, 0.1f, 15.0f);
+    }
+    
+    for (uint16_t i = 0; i < COUNT; i++) {
+        for (uint8_t c = 0; c < CHANNELS; c++) {
+            uint16_t idx = i * CHANNELS + c;
+            scalar_out[idx] = sigProc.kalmanFilter(sigProc.butterworthFilter(input[idx], &ref_bw[c]), &ref_kf[c]);
+        }
+    }
+    sigProc.butterworthFilterBank(input, block_out, COUNT, CHANNELS, bank_bw);
+    sigProc.kalmanFilterBank(block_out, block_out, COUNT, CHANNELS, bank_kf);
+    
+    TEST_ASSERT_EQUAL_MEMORY(scalar_out, block_out, COUNT * CHANNELS * sizeof(float));
+    TEST_ASSERT_EQUAL_MEMORY(ref_bw, bank_bw, sizeof(ref_bw));
+    TEST_ASSERT_EQUAL_MEMORY(ref_kf, bank_kf, sizeof(ref_kf));
+}
+
+/**
+ * Benchmark scalar vs block filtering over block sizes
+ */
+void test_block_benchmark(void) {
+    const uint16_t TOTAL = 1024;
+    const uint16_t block_sizes[] = {1, 4, 16, 64, 256, 1024};
+    static float input[TOTAL];
+    static float output[TOTAL];
+    char msg[96];
+    
+    for (uint16_t i = 0; i < TOTAL; i++) {
+        input[i] = 500.0f + (float)random(-100, 100);
+    }
+    
+    cycle_counter_init();
+    
+    FilterState bw;
+    KalmanState kf;
+    SignalProcessor::initFilterState(&bw);
+    SignalProcessor::initKalmanState(&kf, 100.0f, 0.1f, 10.0f);
+    
+    uint32_t start = cycle_counter_read();
+    for (uint16_t i = 0; i < TOTAL; i++) {
+        output[i] = sigProc.kalmanFilter(sigProc.butterworthFilter(input[i], &bw), &kf);
+    }
+    uint32_t scalar_ticks = cycle_counter_read() - start;
+    snprintf(msg, sizeof(msg), "scalar: %lu ticks/sample", (unsigned long)(scalar_ticks / TOTAL));
+    TEST_MESSAGE(msg);
+    
+    for (uint8_t b = 0; b < sizeof(block_sizes) / sizeof(block_sizes[0]); b++) {
+        uint16_t block = block_sizes[b];
+        SignalProcessor::initFilterState(&bw);
+        SignalProcessor::initKalmanState(&kf, 100.0f, 0.1f, 10.0f);
+        
+        start = cycle_counter_read();
+        for (uint16_t i = 0; i < TOTAL; i += block) {
+            sigProc.butterworthFilterBlock(input + i, output + i, block, &bw);
+            sigProc.kalmanFilterBlock(output + i, output + i, block, &kf);
+        }
+        uint32_t elapsed = cycle_counter_read() - start;
+        
+        snprintf(msg, sizeof(msg), "block %4u: %lu ticks/sample (%lu Hz counter)",
+                 block, (unsigned long)(elapsed / TOTAL), (unsigned long)CYCLE_COUNTER_HZ);
+        TEST_MESSAGE(msg);
+    }
+    TEST_PASS();
+}
+
 void setup() {
     delay(2000);
     
@@ -236,6 +532,14 @@ void setup() {
     RUN_TEST(test_delta_encoding);
     RUN_TEST(test_delta_encoding_identical);
     RUN_TEST(test_filter_state_persistence);
+    RUN_TEST(test_hampel_rejects_spike);
+    RUN_TEST(test_hampel_tracks_step);
+    RUN_TEST(test_hampel_window_odd);
+    RUN_TEST(test_hampel_matches_reference);
+    RUN_TEST(test_hampel_benchmark);
+    RUN_TEST(test_pipeline_matches_manual_chain);
+    RUN_TEST(test_block_matches_scalar);
+    RUN_TEST(test_block_benchmark);
     
     UNITY_END();
 }
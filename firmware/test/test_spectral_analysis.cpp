@@ -0,0 +1,141 @@
+/**
+ * @file test_spectral_analysis.cpp
+ * @brief Unit tests for SpectralAnalyzer module
+ *
+ * Tests Goertzel bank and Q15 real FFT motility features
+ */
+
+#include <unity.h>
+#include "spectral_analysis.h"
+#include <math.h>
+
+SpectralAnalyzer analyzer;
+
+void setUp(void) {
+    // Set up runs before each test
+}
+
+void tearDown(void) {
+    // Clean up runs after each test
+}
+
+// Feed a DC-offset sinusoid at 1 Hz sampling until the first feature set
+static bool feedTone(SpectralMode mode, float cpm, float amplitude, SpectralFeatures* features) {
+    analyzer.init(1.0f, 256, mode);
+
+    for (int n = 0; n < 1024; n++) {
+        float t = (float)n;
+        float sample = 500.0f + amplitude * sinf(2.0f * (float)M_PI * (cpm / 60.0f) * t)
+                       + 0.5f * sinf(1.7f * t);
+        if (analyzer.addSample(sample, features)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+/**
+ * Test no features are emitted until the window fills
+ */
+void test_spectral_window_fill(void) {
+    SpectralFeatures features;
+    analyzer.init(1.0f, 128, SPECTRAL_MODE_FFT);
+
+    for (int n = 0; n < 127; n++) {
+        TEST_ASSERT_FALSE(analyzer.addSample(100.0f, &features));
+    }
+    TEST_ASSERT_TRUE(analyzer.addSample(100.0f, &features));
+    TEST_ASSERT_EQUAL_UINT32(128, features.window_samples);
+
+    // Next emission after half a window
+    for (int n = 0; n < 63; n++) {
+        TEST_ASSERT_FALSE(analyzer.addSample(100.0f, &features));
+    }
+    TEST_ASSERT_TRUE(analyzer.addSample(100.0f, &features));
+}
+
+/**
+ * Test FFT finds the gastric slow wave
+ */
+void test_spectral_fft_gastric_rhythm(void) {
+    SpectralFeatures features;
+    TEST_ASSERT_TRUE(feedTone(SPECTRAL_MODE_FFT, 3.0f, 20.0f, &features));
+
+    TEST_ASSERT_FLOAT_WITHIN_MESSAGE(
+        0.15,
+        3.0,
+        features.dominant_cpm,
+        "Dominant frequency should be the 3 cpm slow wave"
+    );
+
+    // Mean-square power of a 20-unit sinusoid is 200
+    TEST_ASSERT_FLOAT_WITHIN(60.0, 200.0, features.band_power[SPECTRAL_BAND_NORMOGASTRIC]);
+    TEST_ASSERT_LESS_THAN(features.band_power[SPECTRAL_BAND_NORMOGASTRIC] / 10.0f,
+                          features.band_power[SPECTRAL_BAND_SMALL_INTESTINE]);
+}
+
+/**
+ * Test Goertzel bank finds the small-intestine rhythm
+ */
+void test_spectral_goertzel_intestinal_rhythm(void) {
+    SpectralFeatures features;
+    TEST_ASSERT_TRUE(feedTone(SPECTRAL_MODE_GOERTZEL, 10.5f, 20.0f, &features));
+
+    TEST_ASSERT_FLOAT_WITHIN_MESSAGE(
+        0.5,
+        10.5,
+        features.dominant_cpm,
+        "Dominant frequency should be the 10.5 cpm intestinal rhythm"
+    );
+    TEST_ASSERT_GREATER_THAN(features.band_power[SPECTRAL_BAND_NORMOGASTRIC],
+                             features.band_power[SPECTRAL_BAND_SMALL_INTESTINE]);
+}
+
+/**
+ * Test Goertzel and FFT agree on band powers
+ */
+void test_spectral_modes_agree(void) {
+    SpectralFeatures goertzel, fft;
+    TEST_ASSERT_TRUE(feedTone(SPECTRAL_MODE_GOERTZEL, 6.0f, 10.0f, &goertzel));
+    TEST_ASSERT_TRUE(feedTone(SPECTRAL_MODE_FFT, 6.0f, 10.0f, &fft));
+
+    TEST_ASSERT_FLOAT_WITHIN(0.5, fft.dominant_cpm, goertzel.dominant_cpm);
+    TEST_ASSERT_FLOAT_WITHIN(
+        fft.band_power[SPECTRAL_BAND_TACHYGASTRIC] * 0.5f,
+        fft.band_power[SPECTRAL_BAND_TACHYGASTRIC],
+        goertzel.band_power[SPECTRAL_BAND_TACHYGASTRIC]
+    );
+}
+
+/**
+ * Test a flat signal produces no spectral power
+ */
+void test_spectral_flat_signal(void) {
+    SpectralFeatures features;
+    analyzer.init(1.0f, 64, SPECTRAL_MODE_FFT);
+
+    bool emitted = false;
+    for (int n = 0; n < 64; n++) {
+        emitted = analyzer.addSample(250.0f, &features);
+    }
+    TEST_ASSERT_TRUE(emitted);
+    TEST_ASSERT_EQUAL_FLOAT(0.0f, features.total_power);
+}
+
+void setup() {
+    delay(2000);
+
+    UNITY_BEGIN();
+
+    RUN_TEST(test_spectral_window_fill);
+    RUN_TEST(test_spectral_fft_gastric_rhythm);
+    RUN_TEST(test_spectral_goertzel_intestinal_rhythm);
+    RUN_TEST(test_spectral_modes_agree);
+    RUN_TEST(test_spectral_flat_signal);
+
+    UNITY_END();
+}
+
+void loop() {
+    // Tests run once in setup()
+}
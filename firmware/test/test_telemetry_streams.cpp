@@ -0,0 +1,183 @@
+/**
+ * @file test_telemetry_streams.cpp
+ * @brief Unit tests for the raw, filtered and summary stream encodings
+ *
+ * Tests the byte layouts the app decodes, the per-channel summary over a
+ * period with slow channels converted less often, and reports what each
+ * stream costs on air so a central pays only for the ones it reads
+ */
+
+#include <unity.h>
+#include "telemetry_streams.h"
+#include "reading_codec.h"
+#include "aes.h"
+#include <stdio.h>
+#include <string.h>
+
+SummaryStream summary;
+
+static float getFloat(const uint8_t* in) {
+    uint32_t bits = in[0] | (in[1] << 8) | (in[2] << 16) | ((uint32_t)in[3] << 24);
+    float value;
+    memcpy(&value, &bits, sizeof(value));
+    return value;
+}
+
+static uint16_t getU16(const uint8_t* in) {
+    return in[0] | (in[1] << 8);
+}
+
+// n-th packed 12-bit count
+static uint16_t rawCount(const uint8_t* in, uint8_t n) {
+    uint16_t bit = n * 12;
+    uint32_t word = in[bit / 8] | (in[bit / 8 + 1] << 8);
+    return (word >> (bit % 8)) & 0x0FFF;
+}
+
+static uint32_t getU32(const uint8_t* in) {
+    return in[0] | (in[1] << 8) | (in[2] << 16) | ((uint32_t)in[3] << 24);
+}
+
+static void fillReading(SensorReading* r, float base, uint32_t timestamp_ms) {
+    r->serotonin_nm = base;
+    r->dopamine_nm = base * 2;
+    r->gaba_nm = base * 3;
+    r->ph_level = 7.0f;
+    r->temperature_c = 37.0f;
+    r->calprotectin_ug_g = 50.0f;
+    r->timestamp_ms = timestamp_ms;
+}
+
+void setUp(void) {
+    // Set up runs before each test
+    summary.init(SUMMARY_PERIOD_DEFAULT_MS);
+}
+
+void tearDown(void) {
+    // Clean up runs after each test
+}
+
+/**
+ * Test raw counts and filtered units carry only the masked channels, in
+ * channel order, and a full raw reading fits one AES block
+ */
+void test_reading_encoding(void) {
+    uint8_t out[STREAM_FILTERED_MAX_SIZE];
+    const uint16_t counts[6] = {100, 200, 300, 4095, 2048, 7};
+
+    TEST_ASSERT_EQUAL_UINT8(STREAM_RAW_MAX_SIZE, streamEncodeRaw(counts, 0x3F, 0x01020304, out));
+    TEST_ASSERT_EQUAL_UINT8(14, STREAM_RAW_MAX_SIZE);
+    TEST_ASSERT_EQUAL_UINT32(0x01020304, getU32(out));
+    TEST_ASSERT_EQUAL_UINT8(0x3F, out[4]);
+    for (uint8_t i = 0; i < 6; i++) {
+        TEST_ASSERT_EQUAL_UINT16(counts[i], rawCount(out + 5, i));
+    }
+
+    // pH only: one count, half a byte of padding
+    TEST_ASSERT_EQUAL_UINT8(STREAM_READING_HEADER + 2, streamEncodeRaw(counts, 0x08, 0, out));
+    TEST_ASSERT_EQUAL_UINT16(4095, rawCount(out + 5, 0));
+
+    SensorReading r;
+    fillReading(&r, 123.456f, 5000);
+    TEST_ASSERT_EQUAL_UINT8(STREAM_FILTERED_MAX_SIZE, streamEncodeFiltered(&r, 0x3F, out));
+    TEST_ASSERT_EQUAL_UINT32(5000, getU32(out));
+    TEST_ASSERT_EQUAL_FLOAT(123.456f, getFloat(out + 5));
+    TEST_ASSERT_EQUAL_FLOAT(7.0f, getFloat(out + 5 + 3 * 4));
+    TEST_ASSERT_EQUAL_FLOAT(50.0f, getFloat(out + 5 + 5 * 4));
+
+    // Fast channels only
+    TEST_ASSERT_EQUAL_UINT8(STREAM_READING_HEADER + 3 * 4, streamEncodeFiltered(&r, 0x07, out));
+    TEST_ASSERT_EQUAL_UINT8(0x07, out[4]);
+    TEST_ASSERT_EQUAL_FLOAT(123.456f * 3, getFloat(out + 5 + 2 * 4));
+}
+
+/**
+ * Test a summary covers its period per channel, counts slow channels
+ * only when converted, and starts over once taken
+ */
+void test_summary(void) {
+    SensorReading r;
+    summary.setPeriod(10000);
+    summary.restart(1000);
+    TEST_ASSERT_FALSE(summary.due(20000));
+
+    // 1 Hz for ten seconds; pH every fifth reading
+    for (uint8_t i = 0; i < 10; i++) {
+        fillReading(&r, 10.0f + i, 1000 + i * 1000);
+        r.ph_level = 6.0f + i * 0.1f;
+        summary.add(&r, (i % 5 == 0) ? 0x0F : 0x07);
+        TEST_ASSERT_FALSE(summary.due(1000 + i * 1000));
+    }
+    TEST_ASSERT_TRUE(summary.due(11000));
+
+    uint8_t out[STREAM_SUMMARY_MAX_SIZE];
+    uint8_t length = summary.take(11000, out);
+    TEST_ASSERT_EQUAL_UINT8(STREAM_SUMMARY_HEADER + 4 * STREAM_SUMMARY_CHANNEL, length);
+    TEST_ASSERT_EQUAL_UINT32(1000, getU32(out));
+    TEST_ASSERT_EQUAL_UINT32(10000, getU32(out + 4));
+    TEST_ASSERT_EQUAL_UINT8(0x0F, out[8]);
+
+    // Serotonin 10..19
+    const uint8_t* ch = out + STREAM_SUMMARY_HEADER;
+    TEST_ASSERT_EQUAL_UINT16(10, getU16(ch));
+    TEST_ASSERT_EQUAL_FLOAT(10.0f, getFloat(ch + 2));
+    TEST_ASSERT_EQUAL_FLOAT(14.5f, getFloat(ch + 6));
+    TEST_ASSERT_EQUAL_FLOAT(19.0f, getFloat(ch + 10));
+
+    // pH at readings 0 and 5
+    ch = out + STREAM_SUMMARY_HEADER + 3 * STREAM_SUMMARY_CHANNEL;
+    TEST_ASSERT_EQUAL_UINT16(2, getU16(ch));
+    TEST_ASSERT_FLOAT_WITHIN(1e-5f, 6.0f, getFloat(ch + 2));
+    TEST_ASSERT_FLOAT_WITHIN(1e-5f, 6.25f, getFloat(ch + 6));
+    TEST_ASSERT_FLOAT_WITHIN(1e-5f, 6.5f, getFloat(ch + 10));
+
+    // Next period empty: never due, nothing to send
+    TEST_ASSERT_FALSE(summary.due(30000));
+    TEST_ASSERT_EQUAL_UINT8(0, summary.take(30000, out));
+
+    summary.setPeriod(10);
+    TEST_ASSERT_EQUAL_UINT32(SUMMARY_PERIOD_MIN_MS, summary.period());
+}
+
+/**
+ * Test and report the encrypted bytes each stream costs per minute at
+ * 1 Hz with every channel converted
+ */
+void test_stream_cost(void) {
+    const uint32_t readings = 60;
+    ReadingCodec codec;
+    codec.init();
+
+    uint32_t raw = readings * (AES_BLOCK_SIZE + aes_padded_length(STREAM_RAW_MAX_SIZE));
+    uint32_t filtered = readings * (AES_BLOCK_SIZE + aes_padded_length(STREAM_FILTERED_MAX_SIZE));
+
+    // Compact readings batched ten to a payload
+    uint16_t batch = 10 * codec.size(0x3F);
+    uint32_t compressed = readings / 10 * (AES_BLOCK_SIZE + aes_padded_length(batch));
+    uint32_t summarised = AES_BLOCK_SIZE + aes_padded_length(STREAM_SUMMARY_MAX_SIZE);
+
+    TEST_ASSERT_TRUE(summarised < compressed);
+    TEST_ASSERT_TRUE(compressed < raw);
+    TEST_ASSERT_TRUE(raw < filtered);
+
+    char msg[160];
+    snprintf(msg, sizeof(msg), "Encrypted bytes per minute at 1 Hz: raw %lu | filtered %lu | compressed %lu | summary %lu",
+             (unsigned long)raw, (unsigned long)filtered, (unsigned long)compressed, (unsigned long)summarised);
+    TEST_MESSAGE(msg);
+}
+
+void setup() {
+    delay(2000);
+
+    UNITY_BEGIN();
+
+    RUN_TEST(test_reading_encoding);
+    RUN_TEST(test_summary);
+    RUN_TEST(test_stream_cost);
+
+    UNITY_END();
+}
+
+void loop() {
+    // Tests run once in setup()
+}
@@ -0,0 +1,169 @@
+/**
+ * @file test_trace_replay.cpp
+ * @brief Unit tests for the virtual clock and trace replay harness
+ *
+ * Tests virtual time, memory-mapped trace round trips, deterministic
+ * replay with throughput reporting, and bit-exact output diffs
+ */
+
+#include <unity.h>
+#include "trace_replay.h"
+#include "sys_time.h"
+#include <stdio.h>
+#include <string.h>
+#include <stddef.h>
+
+#define TRACE_A     "/tmp/symbion_trace_a.bin"
+#define TRACE_B     "/tmp/symbion_trace_b.bin"
+#define OUTPUT_A    "/tmp/symbion_replay_a.bin"
+#define OUTPUT_B    "/tmp/symbion_replay_b.bin"
+#define FRAMES      5000
+
+static const AdcSyntheticChannel channels[ADC_SCAN_CHANNELS] = {
+    {1000, 300, 600, 12}, {800, 150, 900, 8}, {1500, 400, 1200, 10},
+    {20, 5, 3600, 2}, {459, 3, 7200, 1}, {1000, 50, 36000, 4}
+};
+
+SensorManager sensors;
+TraceFile trace;
+
+void setUp(void) {
+    // Set up runs before each test
+    trace.init();
+}
+
+void tearDown(void) {
+    // Clean up runs after each test
+    trace.close();
+    sysTimeSetVirtual(false);
+    remove(TRACE_A);
+    remove(TRACE_B);
+    remove(OUTPUT_A);
+    remove(OUTPUT_B);
+}
+
+/**
+ * Test delays on the virtual clock advance time without waiting
+ */
+void test_virtual_time(void) {
+    uint32_t wall_start = millis();
+
+    sysTimeSetVirtual(true);
+    TEST_ASSERT_EQUAL_UINT32(0, sysMillis());
+    sysDelay(60000);
+    sysDelayMicroseconds(250);
+    TEST_ASSERT_EQUAL_UINT32(60000, sysMillis());
+    TEST_ASSERT_EQUAL_UINT32(60000250UL, sysMicros());
+    sysTimeAdvanceUs(750);
+    TEST_ASSERT_EQUAL_UINT32(60001, sysMillis());
+    sysTimeSetVirtual(false);
+
+    TEST_ASSERT_TRUE(millis() - wall_start < 100);
+}
+
+/**
+ * Test a written trace maps back frame for frame, and foreign files are
+ * refused
+ */
+void test_trace_round_trip(void) {
+    static uint16_t frames[100 * ADC_SCAN_CHANNELS];
+    for (uint32_t i = 0; i < 100 * ADC_SCAN_CHANNELS; i++) {
+        frames[i] = (uint16_t)((i * 37) & 0x0FFF);
+    }
+
+    TEST_ASSERT_TRUE(TraceFile::write(TRACE_A, frames, 100, 250000));
+    TEST_ASSERT_TRUE(trace.open(TRACE_A));
+    TEST_ASSERT_EQUAL_UINT32(100, trace.frameCount());
+    TEST_ASSERT_EQUAL_UINT32(250000, trace.intervalUs());
+    TEST_ASSERT_EQUAL_MEMORY(frames, trace.frames(), sizeof(frames));
+    trace.close();
+
+    // Header claims more frames than the file holds
+    TEST_ASSERT_TRUE(TraceFile::write(TRACE_B, frames, 100, 250000));
+    FILE* f = fopen(TRACE_B, "r+b");
+    TEST_ASSERT_NOT_NULL(f);
+    uint32_t too_many = 101;
+    fseek(f, offsetof(TraceHeader, frame_count), SEEK_SET);
+    fwrite(&too_many, sizeof(too_many), 1, f);
+    fclose(f);
+    TEST_ASSERT_FALSE(trace.open(TRACE_B));
+    TEST_ASSERT_FALSE(trace.open("/tmp/symbion_no_such_trace.bin"));
+}
+
+/**
+ * Test two replays of one trace are bit-identical and run far faster than
+ * the recording
+ */
+void test_replay_deterministic(void) {
+    ReplayStats stats;
+    ReplayDiff diff;
+    char msg[128];
+
+    TEST_ASSERT_TRUE(TraceFile::writeSynthetic(TRACE_A, channels, FRAMES, 100000));
+    TEST_ASSERT_TRUE(trace.open(TRACE_A));
+
+    TEST_ASSERT_TRUE(replayTrace(&sensors, &trace, OUTPUT_A, &stats));
+    TEST_ASSERT_EQUAL_UINT32(FRAMES, stats.readings);
+    TEST_ASSERT_EQUAL_UINT32(FRAMES * 100000ULL / 1000, (uint32_t)(stats.virtual_us / 1000));
+    TEST_ASSERT_TRUE(stats.speedup > 100.0f);
+    TEST_ASSERT_FALSE(sysTimeIsVirtual());
+
+    TEST_ASSERT_TRUE(replayTrace(&sensors, &trace, OUTPUT_B, &stats));
+    TEST_ASSERT_TRUE(diffReplayOutputs(OUTPUT_A, OUTPUT_B, &diff));
+    TEST_ASSERT_EQUAL_UINT32(FRAMES, diff.compared);
+    TEST_ASSERT_EQUAL_UINT32(0, diff.mismatched);
+    TEST_ASSERT_EQUAL_INT32(-1, diff.first_mismatch);
+    TEST_ASSERT_FALSE(diff.length_differs);
+
+    snprintf(msg, sizeof(msg), "%u readings (%.0f s of signal) in %.1f ms: %.0f samples/s, %.0fx real time",
+             stats.readings, stats.virtual_us / 1e6, stats.wall_us / 1e3,
+             stats.samples_per_sec, stats.speedup);
+    TEST_MESSAGE(msg);
+}
+
+/**
+ * Test a changed input shows up as a diff from the first affected record,
+ * and a shorter output is flagged
+ */
+void test_replay_diff_detects_change(void) {
+    static uint16_t frames[FRAMES * ADC_SCAN_CHANNELS];
+    ReplayStats stats;
+    ReplayDiff diff;
+
+    TEST_ASSERT_TRUE(TraceFile::writeSynthetic(TRACE_A, channels, FRAMES, 100000));
+    TEST_ASSERT_TRUE(trace.open(TRACE_A));
+    memcpy(frames, trace.frames(), sizeof(frames));
+    TEST_ASSERT_TRUE(replayTrace(&sensors, &trace, OUTPUT_A, &stats));
+    trace.close();
+
+    // One pH count off at frame 1234
+    frames[1234 * ADC_SCAN_CHANNELS + 3] += 1;
+    TEST_ASSERT_TRUE(TraceFile::write(TRACE_B, frames, FRAMES - 10, 100000));
+    TEST_ASSERT_TRUE(trace.open(TRACE_B));
+    TEST_ASSERT_TRUE(replayTrace(&sensors, &trace, OUTPUT_B, &stats));
+
+    TEST_ASSERT_TRUE(diffReplayOutputs(OUTPUT_A, OUTPUT_B, &diff));
+    TEST_ASSERT_EQUAL_UINT32(FRAMES - 10, diff.compared);
+    TEST_ASSERT_EQUAL_INT32(1234, diff.first_mismatch);
+    TEST_ASSERT_TRUE(diff.mismatched >= 1);
+    TEST_ASSERT_TRUE(diff.max_abs[3] > 0.0f);
+    TEST_ASSERT_EQUAL_FLOAT(0.0f, diff.max_abs[0]);
+    TEST_ASSERT_TRUE(diff.length_differs);
+}
+
+void setup() {
+    delay(2000);
+
+    UNITY_BEGIN();
+
+    RUN_TEST(test_virtual_time);
+    RUN_TEST(test_trace_round_trip);
+    RUN_TEST(test_replay_deterministic);
+    RUN_TEST(test_replay_diff_detects_change);
+
+    UNITY_END();
+}
+
+void loop() {
+    // Tests run once in setup()
+}
@@ -0,0 +1,219 @@
+/**
+ * @file test_tx_queue.cpp
+ * @brief Unit tests for the bounded notification TX queue
+ *
+ * Tests framed payload fragmentation, both drop policies, backpressure
+ * hysteresis and draining on controller TX-complete credits
+ */
+
+#include <unity.h>
+#include "tx_queue.h"
+#include "ble_frame.h"
+#include "ble_link.h"
+#include "sys_time.h"
+#include <stdio.h>
+#include <string.h>
+
+TxQueue txQueue;
+BleLink link;
+uint8_t payload[TX_SLOT_SIZE * 4];
+
+void setUp(void) {
+    // Set up runs before each test
+    txQueue.init();
+    link.init();
+    for (uint16_t i = 0; i < sizeof(payload); i++) {
+        payload[i] = (uint8_t)i;
+    }
+}
+
+void tearDown(void) {
+    // Clean up runs after each test
+}
+
+// Tag a payload's first byte so the order can be checked after draining;
+// 16 bytes of payload per 20-byte notification
+static bool pushTagged(uint8_t tag, uint16_t length, uint16_t fragment) {
+    payload[0] = tag;
+    return txQueue.push(0, payload, length, fragment);
+}
+
+/**
+ * Test a payload splits into framed notifications that reassemble in order
+ */
+void test_fragmentation(void) {
+    FrameReassembler reassembler;
+    FrameHeader header;
+    reassembler.init();
+
+    TEST_ASSERT_TRUE(txQueue.push(1, payload, 64, 20));
+    TEST_ASSERT_EQUAL_UINT8(4, txQueue.count());
+    TEST_ASSERT_EQUAL_UINT16(1, txQueue.nextSeq(1));
+    TEST_ASSERT_EQUAL_UINT16(0, txQueue.nextSeq(0));
+
+    for (uint8_t i = 0; i < 4; i++) {
+        const TxSlot* slot = txQueue.peek();
+        TEST_ASSERT_NOT_NULL(slot);
+        TEST_ASSERT_EQUAL_UINT8(1, slot->target);
+        TEST_ASSERT_EQUAL(i == 0, slot->first);
+        TEST_ASSERT_EQUAL_UINT8(20, slot->length);
+        TEST_ASSERT_TRUE(frameDecodeHeader(slot->data, slot->length, &header));
+        TEST_ASSERT_EQUAL_UINT16(0, header.seq);
+        TEST_ASSERT_EQUAL_UINT8(i, header.index);
+        TEST_ASSERT_EQUAL_UINT8(4, header.count);
+        TEST_ASSERT_EQUAL_UINT8(64, header.length);
+        TEST_ASSERT_EQUAL(i == 3, reassembler.feed(slot->data, slot->length));
+        txQueue.pop();
+    }
+    TEST_ASSERT_NULL(txQueue.peek());
+    TEST_ASSERT_EQUAL_UINT8(64, reassembler.packetLength());
+    TEST_ASSERT_EQUAL_MEMORY(payload, reassembler.packet(), 64);
+    TEST_ASSERT_EQUAL_UINT32(4, txQueue.stats()->sent);
+
+    // Notifications never exceed a slot; packets past the frame limit
+    // are refused
+    TEST_ASSERT_TRUE(txQueue.push(0, payload, 250, 512));
+    TEST_ASSERT_EQUAL_UINT8(2, txQueue.count());
+    TEST_ASSERT_EQUAL_UINT8(TX_SLOT_SIZE, txQueue.peek()->length);
+    TEST_ASSERT_FALSE(txQueue.push(0, payload, FRAME_MAX_PACKET + 1, 244));
+}
+
+/**
+ * Test a full queue refuses whole payloads under the default policy
+ */
+void test_drop_newest(void) {
+    for (uint8_t i = 0; i < 4; i++) {
+        TEST_ASSERT_TRUE(pushTagged(i, 64, 20));
+    }
+    TEST_ASSERT_EQUAL_UINT8(0, txQueue.space());
+
+    // No partial payload is ever queued
+    TEST_ASSERT_FALSE(pushTagged(9, 16, 20));
+    TEST_ASSERT_EQUAL_UINT8(TX_QUEUE_DEPTH, txQueue.count());
+    TEST_ASSERT_EQUAL_UINT32(1, txQueue.stats()->dropped_newest);
+    TEST_ASSERT_EQUAL_UINT8(0, txQueue.peek()->data[FRAME_HEADER_SIZE]);
+
+    // More notifications than the whole queue
+    txQueue.clear();
+    TEST_ASSERT_FALSE(txQueue.push(0, payload, 17 * 16, 20));
+    TEST_ASSERT_EQUAL_UINT8(0, txQueue.count());
+}
+
+/**
+ * Test the oldest unsent payloads make room, but one already partly
+ * handed to the controller finishes
+ */
+void test_drop_oldest(void) {
+    txQueue.setDropPolicy(TX_DROP_OLDEST);
+    for (uint8_t i = 0; i < 4; i++) {
+        TEST_ASSERT_TRUE(pushTagged(i, 64, 20));
+    }
+
+    // One 2-fragment payload evicts payload 0 (4 fragments)
+    TEST_ASSERT_TRUE(pushTagged(4, 32, 20));
+    TEST_ASSERT_EQUAL_UINT32(1, txQueue.stats()->dropped_oldest);
+    TEST_ASSERT_EQUAL_UINT8(14, txQueue.count());
+    TEST_ASSERT_EQUAL_UINT8(1, txQueue.peek()->data[FRAME_HEADER_SIZE]);
+
+    // Start sending payload 1, then fill: it cannot be evicted
+    txQueue.pop();
+    TEST_ASSERT_TRUE(pushTagged(5, 48, 20));
+    TEST_ASSERT_EQUAL_UINT8(16, txQueue.count());
+    TEST_ASSERT_FALSE(pushTagged(6, 16, 20));
+    TEST_ASSERT_EQUAL_UINT32(1, txQueue.stats()->dropped_newest);
+    TEST_ASSERT_FALSE(txQueue.peek()->first);
+}
+
+/**
+ * Test backpressure asserts at the high watermark and holds until the
+ * queue drains to the low one
+ */
+void test_backpressure(void) {
+    while (txQueue.count() + 2 <= TX_HIGH_WATERMARK - 1) {
+        TEST_ASSERT_TRUE(txQueue.push(0, payload, 32, 20));
+    }
+    TEST_ASSERT_FALSE(txQueue.backpressure());
+    TEST_ASSERT_TRUE(txQueue.push(0, payload, 32, 20));
+    TEST_ASSERT_TRUE(txQueue.backpressure());
+    TEST_ASSERT_EQUAL_UINT32(1, txQueue.stats()->backpressure);
+
+    while (txQueue.count() > TX_LOW_WATERMARK + 1) {
+        txQueue.pop();
+        TEST_ASSERT_TRUE(txQueue.backpressure());
+    }
+    txQueue.pop();
+    TEST_ASSERT_FALSE(txQueue.backpressure());
+    TEST_ASSERT_EQUAL_UINT8(TX_HIGH_WATERMARK, txQueue.stats()->high_water);
+}
+
+/**
+ * Test the queue drains only as the controller returns buffers, never
+ * overruns them, and delivers every accepted fragment in order
+ */
+void test_credit_drain(void) {
+    uint32_t delivered = 0;
+    uint32_t outstanding = 0;
+    uint32_t peak = 0;
+    uint8_t next_tag = 0;
+    uint8_t expect_tag = 0;
+    char msg[128];
+
+    link.setTxBuffers(3);
+    link.onConnect("00:11:22:33:44:55");
+
+    // A reading (2 notifications) per pass; the controller completes one
+    // notification every other pass, as on a slow connection interval
+    for (uint16_t pass = 0; pass < 200; pass++) {
+        if (txQueue.backpressure() == false) {
+            if (pushTagged(next_tag, 32, link.notifyPayload())) {
+                next_tag++;
+            }
+        }
+        const TxSlot* slot;
+        while (link.txCredits() > 0 && (slot = txQueue.peek()) != 0) {
+            if (slot->first) {
+                TEST_ASSERT_EQUAL_UINT8(expect_tag++, slot->data[FRAME_HEADER_SIZE]);
+            }
+            link.onTxSent();
+            txQueue.pop();
+            outstanding++;
+            delivered++;
+        }
+        if (outstanding > peak) peak = outstanding;
+        TEST_ASSERT_TRUE(outstanding <= 3);
+        if (pass % 2 && outstanding) {
+            link.completeTx(1);
+            outstanding--;
+        }
+    }
+
+    const TxQueueStats* stats = txQueue.stats();
+    TEST_ASSERT_EQUAL_UINT32(stats->sent, delivered);
+    TEST_ASSERT_EQUAL_UINT32(stats->fragments, delivered + txQueue.count());
+    TEST_ASSERT_EQUAL_UINT32(0, stats->dropped_newest);
+    TEST_ASSERT_TRUE(stats->backpressure > 0);
+    TEST_ASSERT_EQUAL_UINT32(3, peak);
+
+    snprintf(msg, sizeof(msg), "%lu payloads, %lu notifications sent, queue peak %u, backpressure %lu, dropped %lu",
+             (unsigned long)stats->payloads, (unsigned long)delivered, stats->high_water,
+             (unsigned long)stats->backpressure, (unsigned long)stats->dropped_newest);
+    TEST_MESSAGE(msg);
+}
+
+void setup() {
+    delay(2000);
+
+    UNITY_BEGIN();
+
+    RUN_TEST(test_fragmentation);
+    RUN_TEST(test_drop_newest);
+    RUN_TEST(test_drop_oldest);
+    RUN_TEST(test_backpressure);
+    RUN_TEST(test_credit_drain);
+
+    UNITY_END();
+}
+
+void loop() {
+    // Tests run once in setup()
+}
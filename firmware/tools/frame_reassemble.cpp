@@ -0,0 +1,116 @@
+// firmware/tools/frame_reassemble.cpp
+// Host tool: reassemble captured sensor-data notifications into packets.
+//
+//   frame_reassemble [key_hex] < notifications.txt
+//
+// One notification per line in hex (spaces and colons ignored), e.g. from
+// a sniffer or phone log export. Without a key each packet is printed as
+// hex; with the 16-byte session key packets are decrypted and their batched
+// readings printed as CSV. Loss statistics go to stderr.
+//
+// Built on the host from ble_frame.cpp, aes.cpp, reading_codec.cpp and this
+// file.
+
+#include "ble_frame.h"
+#include "reading_codec.h"
+#include "aes.h"
+#include <ctype.h>
+#include <stdio.h>
+#include <string.h>
+
+static int hexValue(char c) {
+    if (c >= '0' && c <= '9') return c - '0';
+    c = (char)tolower(c);
+    if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+    return -1;
+}
+
+// Hex digits to bytes, skipping separators; -1 on an odd digit count
+static int parseHex(const char* text, uint8_t* out, int max) {
+    int n = 0;
+    int high = -1;
+    for (; *text && n < max; text++) {
+        int v = hexValue(*text);
+        if (v < 0) {
+            continue;
+        }
+        if (high < 0) {
+            high = v;
+        } else {
+            out[n++] = (uint8_t)((high << 4) | v);
+            high = -1;
+        }
+    }
+    return (high < 0) ? n : -1;
+}
+
+static void printReadings(const ReadingCodec* codec, uint16_t seq, const uint8_t* plain, uint16_t length) {
+    uint16_t at = 0;
+    while (at < length) {
+        SensorReading r;
+        memset(&r, 0, sizeof(r));
+        uint8_t mask = codec->decode(plain + at, (uint8_t)(length - at), &r);
+        if (!mask) {
+            break;
+        }
+        printf("%u,%lu,0x%02X,%.1f,%.1f,%.1f,%.2f,%.1f,%.0f\n", seq, (unsigned long)r.timestamp_ms, mask,
+               r.serotonin_nm, r.dopamine_nm, r.gaba_nm, r.ph_level, r.temperature_c, r.calprotectin_ug_g);
+        at += codec->size(mask);
+    }
+}
+
+int main(int argc, char** argv) {
+    uint8_t key[16];
+    bool decrypt = false;
+    if (argc >= 2) {
+        if (parseHex(argv[1], key, sizeof(key)) != 16) {
+            fprintf(stderr, "usage: frame_reassemble [key_hex] < notifications.txt\n");
+            return 2;
+        }
+        decrypt = true;
+    }
+
+    ReadingCodec codec;
+    codec.init();
+    FrameReassembler reassembler;
+    reassembler.init();
+
+    if (decrypt) {
+        printf("seq,timestamp_ms,mask,serotonin_nm,dopamine_nm,gaba_nm,ph,temperature_c,calprotectin_ug_g\n");
+    }
+
+    char line[1024];
+    uint8_t notification[512];
+    uint32_t lines = 0;
+    while (fgets(line, sizeof(line), stdin)) {
+        int n = parseHex(line, notification, sizeof(notification));
+        if (n <= 0) {
+            continue;
+        }
+        lines++;
+        if (!reassembler.feed(notification, (uint16_t)n)) {
+            continue;
+        }
+
+        uint16_t seq = reassembler.packetSeq();
+        uint8_t length = reassembler.packetLength();
+        if (decrypt) {
+            uint8_t plain[FRAME_MAX_PACKET];
+            uint16_t plain_length = aes128_decrypt(reassembler.packet(), plain, key, length);
+            printReadings(&codec, seq, plain, plain_length);
+        } else {
+            printf("%u %u ", seq, length);
+            for (uint8_t i = 0; i < length; i++) {
+                printf("%02x", reassembler.packet()[i]);
+            }
+            printf("\n");
+        }
+    }
+
+    const FrameStats* stats = reassembler.stats();
+    fprintf(stderr, "%lu notifications: %lu packets (%lu late), %lu incomplete, %lu lost in %lu gaps, %lu malformed\n",
+            (unsigned long)lines, (unsigned long)stats->packets, (unsigned long)stats->late,
+            (unsigned long)stats->incomplete, (unsigned long)stats->lost, (unsigned long)stats->gaps,
+            (unsigned long)stats->malformed);
+    return 0;
+}
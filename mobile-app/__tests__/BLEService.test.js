@@ -3,7 +3,7 @@
  * @brief Unit tests for BLE Service
  */
 
-import BLEService from '../src/services/BLEService';
+import BLEService, { compactReadingLength, FrameReassembler, AckWindow, decodeRawReading, decodeSummary } from '../src/services/BLEService';
 import { BleManager } from 'react-native-ble-plx';
 
 // Mock react-native-ble-plx
@@ -66,7 +66,7 @@ describe('BLEService', () => {
 
       const result = await BLEService.connect('device-123');
 
-      expect(mockConnectToDevice).toHaveBeenCalledWith('device-123');
+      expect(mockConnectToDevice).toHaveBeenCalledWith('device-123', { requestMTU: 247 });
       expect(mockDevice.discoverAllServicesAndCharacteristics).toHaveBeenCalled();
       expect(result).toBe(true);
     });
@@ -103,31 +103,69 @@ describe('BLEService', () => {
 
   describe('parseData', () => {
     it('should parse sensor data correctly', () => {
-      // Create test data matching SensorReading struct
-      const buffer = Buffer.alloc(28);
-      
-      // Write float values (little endian)
-      buffer.writeFloatLE(1000.5, 0);  // serotonin
-      buffer.writeFloatLE(500.3, 4);   // dopamine
-      buffer.writeFloatLE(2000.7, 8);  // gaba
-      buffer.writeFloatLE(6.5, 12);    // ph
-      buffer.writeFloatLE(37.0, 16);   // temperature
-      buffer.writeFloatLE(50.2, 20);   // calprotectin
-      buffer.writeUInt32LE(12345, 24); // timestamp
+      // Compact reading: timestamp LE, then mask and codes LSB first
+      const codes = [
+        [Math.round((Math.log(1000) - Math.log(10)) / Math.log(1000) * 1023), 10],
+        [Math.round((Math.log(400) - Math.log(50)) / Math.log(100) * 1023), 10],
+        [Math.round((Math.log(2000) - Math.log(100)) / Math.log(500) * 1023), 10],
+        [Math.round(6.5 / 14 * 1023), 10],
+        [Math.round((37.0 - 20) / 25.5 * 255), 8],
+        [Math.round((Math.log(50) - Math.log(5)) / Math.log(1000) * 255), 8],
+      ];
+      const buffer = Buffer.alloc(12);
+      buffer.writeUInt32LE(12345, 0);
+      let acc = 0x3f;
+      let pending = 6;
+      let at = 4;
+      codes.forEach(([code, bits]) => {
+        acc |= code << pending;
+        pending += bits;
+        while (pending >= 8) {
+          buffer[at++] = acc & 0xff;
+          acc >>>= 8;
+          pending -= 8;
+        }
+      });
+      buffer[at] = acc;
 
       const base64 = buffer.toString('base64');
       const parsed = BLEService.parseData(base64);
 
       expect(parsed).toBeDefined();
-      expect(parsed.serotonin_nm).toBeCloseTo(1000.5, 1);
-      expect(parsed.dopamine_nm).toBeCloseTo(500.3, 1);
-      expect(parsed.gaba_nm).toBeCloseTo(2000.7, 1);
+      expect(parsed.channel_mask).toBe(0x3f);
+      expect(parsed.serotonin_nm).toBeCloseTo(1000, -1);
+      expect(parsed.dopamine_nm).toBeCloseTo(400, -1);
+      expect(parsed.gaba_nm).toBeCloseTo(2000, -1);
       expect(parsed.ph_level).toBeCloseTo(6.5, 1);
       expect(parsed.temperature_c).toBeCloseTo(37.0, 1);
-      expect(parsed.calprotectin_ug_g).toBeCloseTo(50.2, 1);
+      expect(parsed.calprotectin_ug_g).toBeCloseTo(50, 0);
       expect(parsed.timestamp_ms).toBe(12345);
     });
 
+    it('should leave out channels absent from the mask', () => {
+      // pH only: 6-bit mask, 10-bit code
+      const code = Math.round(7.0 / 14 * 1023);
+      const buffer = Buffer.from([1, 0, 0, 0, 0x08 | ((code & 0x03) << 6), code >> 2]);
+      const parsed = BLEService.parseData(buffer.toString('base64'));
+
+      expect(parsed.ph_level).toBeCloseTo(7.0, 1);
+      expect(parsed.serotonin_nm).toBeUndefined();
+      expect(compactReadingLength(buffer)).toBe(6);
+    });
+
+    it('should split a batch into its readings', () => {
+      // Two pH-only readings back to back
+      const code = Math.round(7.0 / 14 * 1023);
+      const reading = (t) => [t, 0, 0, 0, 0x08 | ((code & 0x03) << 6), code >> 2];
+      const buffer = Buffer.from([...reading(1), ...reading(2)]);
+      const readings = BLEService.parseBatch(buffer.toString('base64'));
+
+      expect(readings).toHaveLength(2);
+      expect(readings[0].timestamp_ms).toBe(1);
+      expect(readings[1].timestamp_ms).toBe(2);
+      expect(readings[1].ph_level).toBeCloseTo(7.0, 1);
+    });
+
     it('should return null for invalid data', () => {
       const shortBuffer = Buffer.alloc(10); // Too short
       const base64 = shortBuffer.toString('base64');
@@ -137,6 +175,66 @@ describe('BLEService', () => {
     });
   });
 
+  describe('FrameReassembler', () => {
+    // Notifications for one packet split into fragments of `share` bytes
+    const frame = (seq, packet, share) => {
+      const count = Math.ceil(packet.length / share);
+      return Array.from({ length: count }, (_, i) => [
+        seq & 0xff, seq >> 8, (i << 4) | (count - 1), packet.length,
+        ...packet.slice(i * share, (i + 1) * share),
+      ]);
+    };
+    const packet = Array.from({ length: 40 }, (_, i) => i);
+
+    it('should rebuild a packet from its fragments', () => {
+      const frames = new FrameReassembler();
+      const [a, b, c] = frame(7, packet, 16);
+
+      expect(frames.feed(a)).toBeNull();
+      expect(frames.feed(b)).toBeNull();
+      expect(Array.from(frames.feed(c))).toEqual(packet);
+      expect(frames.stats.packets).toBe(1);
+    });
+
+    it('should count lost packets and resync after a missing fragment', () => {
+      const frames = new FrameReassembler();
+      const first = frame(0xffff, packet, 16);
+      const broken = frame(0, packet, 16);
+      const after = frame(3, packet, 16);
+
+      first.forEach((n) => frames.feed(n));
+      frames.feed(broken[0]);
+      frames.feed(broken[2]);
+      const delivered = after.map((n) => frames.feed(n)).filter(Boolean);
+
+      // Seq wraps to 0; 1 and 2 never arrived
+      expect(delivered).toHaveLength(1);
+      expect(frames.stats).toMatchObject({ packets: 2, incomplete: 1, lost: 2, gaps: 1, malformed: 0 });
+    });
+
+    it('should rebuild a resent packet behind the newest without new gaps', () => {
+      const frames = new FrameReassembler();
+      [5, 7, 6, 8].forEach((seq) => frame(seq, packet, 16).forEach((n) => frames.feed(n)));
+
+      expect(frames.stats).toMatchObject({ packets: 4, lost: 1, gaps: 1, late: 1 });
+    });
+  });
+
+  describe('AckWindow', () => {
+    it('should acknowledge the first missing packet and a bitmap of later ones', () => {
+      const acks = new AckWindow();
+      [100, 101, 103, 105].forEach((seq) => expect(acks.receive(seq)).toBe(true));
+      expect(acks.encode()).toEqual([0, 102, 0, 0, 0, 0x05]);
+
+      // Resends fill the holes once
+      expect(acks.receive(102)).toBe(true);
+      expect(acks.receive(104)).toBe(true);
+      expect(acks.receive(104)).toBe(false);
+      expect(acks.encode()).toEqual([0, 106, 0, 0, 0, 0]);
+      expect(acks.stats).toMatchObject({ delivered: 6, recovered: 2, duplicates: 1, lost: 0 });
+    });
+  });
+
   describe('sendCommand', () => {
     it('should send command to device', async () => {
       const mockWrite = jest.fn().mockResolvedValue(undefined);
@@ -184,6 +282,238 @@ describe('BLEService', () => {
       expect(mockWrite).toHaveBeenCalled(); // Start command sent
       expect(mockMonitor).toHaveBeenCalled(); // Monitoring started
     });
+    it('should catch up on readings logged offline and acknowledge them', async () => {
+      const callbacks = {};
+      const mockWrite = jest.fn().mockResolvedValue(undefined);
+      const mockDevice = {
+        writeCharacteristicWithResponseForService: mockWrite,
+        monitorCharacteristicForService: (service, uuid, callback) => {
+          callbacks[uuid] = callback;
+          return { remove: jest.fn() };
+        },
+        discoverAllServicesAndCharacteristics: jest.fn(),
+        onDisconnected: jest.fn()
+      };
+
+      BleManager.mockImplementation(() => ({
+        connectToDevice: jest.fn().mockResolvedValue(mockDevice)
+      }));
+
+      await BLEService.connect('device-123');
+      BLEService.encryptionKey = null;
+      const history = jest.fn();
+      BLEService.onHistoryReceived(history);
+      await BLEService.startMonitoring();
+
+      // Log sync requested after the start command
+      const written = () => mockWrite.mock.calls.map((call) => Array.from(Buffer.from(call[2], 'base64')));
+      expect(written()).toContainEqual([0x0d]);
+
+      // Readings 10 and 11 (pH only), then the end marker at 12
+      const code = Math.round(7.0 / 14 * 1023);
+      const reading = (t) => [t, 0, 0, 0, 0x08 | ((code & 0x03) << 6), code >> 2];
+      const notify = (seq, packet) => callbacks['5c3e9f1a-7d2b-4a6c-8e05-b4f17a2c9d36'](null, {
+        value: Buffer.from([seq, 0, 0, packet.length, ...packet]).toString('base64')
+      });
+      notify(0, [10, 0, 0, 0, ...reading(1), ...reading(2)]);
+      notify(1, [12, 0, 0, 0]);
+
+      expect(history).toHaveBeenCalledTimes(1);
+      const readings = history.mock.calls[0][0];
+      expect(readings.map((r) => r.seq)).toEqual([10, 11]);
+      expect(readings[1].ph_level).toBeCloseTo(7.0, 1);
+      expect(written()).toContainEqual([0x0e, 0, 0, 0, 12]);
+      expect(BLEService.getLogSyncState()).toMatchObject({ next: 12, syncing: false, lost: 0 });
+    });
+
+    it('should acknowledge live packets and pass a resend on once', async () => {
+      jest.useFakeTimers();
+      const callbacks = {};
+      const mockWrite = jest.fn().mockResolvedValue(undefined);
+      const mockDevice = {
+        writeCharacteristicWithResponseForService: mockWrite,
+        monitorCharacteristicForService: (service, uuid, callback) => {
+          callbacks[uuid] = callback;
+          return { remove: jest.fn() };
+        },
+        discoverAllServicesAndCharacteristics: jest.fn(),
+        onDisconnected: jest.fn()
+      };
+
+      BleManager.mockImplementation(() => ({
+        connectToDevice: jest.fn().mockResolvedValue(mockDevice)
+      }));
+
+      await BLEService.connect('device-123');
+      BLEService.encryptionKey = null;
+      const onData = jest.fn();
+      BLEService.onDataReceived(onData);
+      await BLEService.startMonitoring();
+
+      // One pH-only reading per packet; seq 1 lost, then resent twice
+      const code = Math.round(7.0 / 14 * 1023);
+      const notify = (seq) => {
+        const packet = [seq, 0, 0, 0, 0x08 | ((code & 0x03) << 6), code >> 2];
+        callbacks['beb5483e-36e1-4688-b7f5-ea07361b26a8'](null, {
+          value: Buffer.from([seq, 0, 0, packet.length, ...packet]).toString('base64')
+        });
+      };
+      notify(0);
+      notify(2);
+      jest.advanceTimersByTime(250);
+
+      const acks = () => mockWrite.mock.calls
+        .map((call) => Array.from(Buffer.from(call[2], 'base64')))
+        .filter((bytes) => bytes[0] === 0x13);
+      expect(acks()).toEqual([[0x13, 0, 1, 0, 0, 0, 0x01]]);
+
+      notify(1);
+      notify(1);
+      expect(onData).toHaveBeenCalledTimes(3);
+      expect(onData.mock.calls[2][0].timestamp_ms).toBe(1);
+      expect(BLEService.getAckStats()).toMatchObject({ delivered: 3, recovered: 1, duplicates: 1 });
+
+      // A few acks after the last packet, then quiet
+      jest.advanceTimersByTime(2000);
+      expect(acks()).toHaveLength(3);
+      expect(acks()[2]).toEqual([0x13, 0, 3, 0, 0, 0, 0]);
+      jest.useRealTimers();
+    });
+  });
+
+  describe('downloadHistory', () => {
+    it('should stream the log on credits and report the throughput', async () => {
+      const callbacks = {};
+      const mockWrite = jest.fn().mockResolvedValue(undefined);
+      const mockDevice = {
+        writeCharacteristicWithResponseForService: mockWrite,
+        monitorCharacteristicForService: (service, uuid, callback) => {
+          callbacks[uuid] = callback;
+          return { remove: jest.fn() };
+        },
+        discoverAllServicesAndCharacteristics: jest.fn(),
+        onDisconnected: jest.fn()
+      };
+
+      BleManager.mockImplementation(() => ({
+        connectToDevice: jest.fn().mockResolvedValue(mockDevice)
+      }));
+
+      await BLEService.connect('device-123');
+      BLEService.encryptionKey = null;
+      const history = jest.fn();
+      BLEService.onHistoryReceived(history);
+      const done = BLEService.downloadHistory(100);
+
+      // 32 credits, then the start sequence
+      const written = () => mockWrite.mock.calls.map((call) => Array.from(Buffer.from(call[2], 'base64')));
+      expect(written()).toContainEqual([0x0f, 0, 32, 0, 0, 0, 100]);
+
+      // Eight packets of one pH reading each return a batch of credits
+      const code = Math.round(7.0 / 14 * 1023);
+      const notify = (seq, packet) => callbacks['5c3e9f1a-7d2b-4a6c-8e05-b4f17a2c9d36'](null, {
+        value: Buffer.from([seq, 0, 0, packet.length, ...packet]).toString('base64')
+      });
+      for (let i = 0; i < 8; i++) {
+        notify(i, [100 + i, 0, 0, 0, i, 0, 0, 0, 0x08 | ((code & 0x03) << 6), code >> 2]);
+      }
+      expect(written()).toContainEqual([0x10, 0, 8]);
+      notify(8, [108, 0, 0, 0]);
+
+      const result = await done;
+      expect(result.readings).toBe(8);
+      expect(result.bytes).toBe(8 * 14 + 8);
+      expect(result.kBps).toBeGreaterThan(0);
+      expect(history).toHaveBeenCalledTimes(8);
+      expect(BLEService.getLogSyncState()).toMatchObject({ next: 108, syncing: false, lost: 0 });
+    });
+  });
+
+  describe('requestStatus', () => {
+    it('should decode the status and record the command latency', async () => {
+      const callbacks = {};
+      const mockDevice = {
+        writeCharacteristicWithResponseForService: jest.fn().mockImplementation(async () => {
+          const respond = callbacks['e3b7a2d4-6c1f-4f8e-a5d0-9b2c7e41f6a8'];
+          respond(null, { value: Buffer.from([0x80, 0x07, 0, 1, 0x10, 0x27, 0, 0]).toString('base64') });
+          respond(null, {
+            value: Buffer.from([0x81, 0x09, 87, 0xe8, 0x03, 10, 0, 0, 0, 5, 0, 0, 0, 64, 0, 7, 2, 0, 1]).toString('base64')
+          });
+        }),
+        monitorCharacteristicForService: (service, uuid, callback) => {
+          callbacks[uuid] = callback;
+          return { remove: jest.fn() };
+        },
+        discoverAllServicesAndCharacteristics: jest.fn(),
+        onDisconnected: jest.fn()
+      };
+
+      BleManager.mockImplementation(() => ({
+        connectToDevice: jest.fn().mockResolvedValue(mockDevice)
+      }));
+
+      await BLEService.connect('device-123');
+      const status = await BLEService.requestStatus();
+
+      expect(status).toMatchObject({
+        sampling: true,
+        keySet: false,
+        bulk: true,
+        battery: 87,
+        samplingIntervalMs: 1000,
+        uptimeS: 10,
+        logPending: 5,
+        connIntervalMs: 80,
+        connLatency: 7,
+        phy: 2,
+        commandDrops: 1
+      });
+      expect(status.roundTripMs).toBeGreaterThanOrEqual(0);
+      expect(BLEService.getCommandStats()).toMatchObject({ lastUs: 10000, failed: 0 });
+    });
+  });
+
+  describe('subscribeStream', () => {
+    it('should decode filtered readings from their own characteristic', async () => {
+      const callbacks = {};
+      const mockRemove = jest.fn();
+      const mockDevice = {
+        monitorCharacteristicForService: (service, uuid, callback) => {
+          callbacks[uuid] = callback;
+          return { remove: mockRemove };
+        },
+        discoverAllServicesAndCharacteristics: jest.fn(),
+        onDisconnected: jest.fn()
+      };
+
+      BleManager.mockImplementation(() => ({
+        connectToDevice: jest.fn().mockResolvedValue(mockDevice)
+      }));
+
+      await BLEService.connect('device-123');
+      BLEService.encryptionKey = null;
+      const onReading = jest.fn();
+      BLEService.subscribeStream('filtered', onReading);
+
+      // pH only, 7.25 as float32
+      const packet = [0xe7, 0x03, 0, 0, 0x08, 0, 0, 0xe8, 0x40];
+      callbacks['6b0f2c8e-9a3d-4e17-b5c4-1d7a9e2f6c03'](null, {
+        value: Buffer.from([0, 0, 0, packet.length, ...packet]).toString('base64')
+      });
+      expect(onReading).toHaveBeenCalledWith({ timestamp_ms: 999, channel_mask: 0x08, ph_level: 7.25 });
+
+      BLEService.unsubscribeStream('filtered');
+      expect(mockRemove).toHaveBeenCalled();
+    });
+
+    it('should decode packed raw counts and summaries', () => {
+      const raw = decodeRawReading([210, 4, 0, 0, 42, 200, 240, 255, 7, 0]);
+      expect(raw.counts).toEqual({ dopamine_nm: 200, ph_level: 4095, calprotectin_ug_g: 7 });
+
+      const summary = decodeSummary([0, 0, 0, 0, 220, 5, 0, 0, 1, 2, 0, 0, 0, 72, 65, 0, 0, 130, 65, 0, 0, 160, 65]);
+      expect(summary.period_ms).toBe(1500);
+      expect(summary.channels.serotonin_nm).toEqual({ count: 2, min: 12.5, mean: 16.25, max: 20 });
+    });
   });
 
   describe('stopMonitoring', () => {
@@ -5,6 +5,11 @@ import { Buffer } from 'buffer';
 const SERVICE_UUID = '4fafc201-1fb5-459e-8fcc-c5c9c331914b';
 const SENSOR_DATA_UUID = 'beb5483e-36e1-4688-b7f5-ea07361b26a8';
 const CONTROL_UUID = '1c95d5e3-d8f7-413a-bf3d-7a2e5d7be87e';
+const LOG_DATA_UUID = '5c3e9f1a-7d2b-4a6c-8e05-b4f17a2c9d36';
+const RESPONSE_UUID = 'e3b7a2d4-6c1f-4f8e-a5d0-9b2c7e41f6a8';
+const RAW_DATA_UUID = 'a1d7e3b0-2f4c-4b8e-9d16-5e8c0f3a7b29';
+const FILTERED_DATA_UUID = '6b0f2c8e-9a3d-4e17-b5c4-1d7a9e2f6c03';
+const SUMMARY_UUID = 'd42e8a6c-0b1f-4c7d-8e93-7f5a2b6c1e48';
 
 // Control commands
 const CMD_START_SAMPLING = 0x01;
@@ -13,6 +18,387 @@ const CMD_CALIBRATE = 0x03;
 const CMD_SELF_TEST = 0x04;
 const CMD_SET_INTERVAL = 0x05;
 const CMD_SET_KEY = 0x06;
+const CMD_REQUEST_STATUS = 0x07;
+const CMD_SET_BATCH_LATENCY = 0x0c;
+const CMD_LOG_SYNC = 0x0d;
+const CMD_LOG_ACK = 0x0e;
+const CMD_BULK_START = 0x0f;
+const CMD_BULK_CREDIT = 0x10;
+const CMD_SET_SUMMARY_PERIOD = 0x11;
+const CMD_SET_BROADCAST = 0x12;
+const CMD_ACK_TELEMETRY = 0x13;
+
+// Catch-up of readings logged while disconnected (firmware sample_log.h):
+// each packet is the first reading's sequence number (uint32 LE) and the
+// readings; one with no readings ends the log. Acknowledged every few
+// packets so an interrupted sync resumes close to where it stopped.
+const LOG_PACKET_HEADER = 4;
+const LOG_ACK_PACKETS = 16;
+
+// History download: the same packets sent back-to-back on the 2M PHY,
+// paced by credits. The app offers room for BULK_CREDITS packets and
+// returns credits in batches as it processes them.
+const BULK_CREDITS = 32;
+const BULK_CREDIT_BATCH = 8;
+
+// Response characteristic (firmware command_queue.h), first byte the type.
+// Every command is acknowledged with its status and the time the device
+// took from receiving it to answering, in microseconds.
+const RESP_ACK = 0x80;
+const RESP_STATUS = 0x81;
+const COMMAND_STATUS = ['ok', 'unknown', 'bad_length', 'rejected', 'busy'];
+const STATUS_TIMEOUT_MS = 2000;
+
+// Live readings are acknowledged every ACK_INTERVAL_MS (firmware
+// retransmit.h): the first sequence number not yet received and a bitmap of
+// the 32 after it. The device resends only the holes. Acks go on for a few
+// rounds after the last packet so a lost tail is resent too, then stop
+// until the next one.
+const ACK_INTERVAL_MS = 250;
+const ACK_BITS = 32;
+const ACK_IDLE_ROUNDS = 2;
+
+// Telemetry streams besides the compact readings on SENSOR_DATA_UUID
+// (firmware telemetry_streams.h); the device only produces the ones
+// subscribed to
+const STREAM_UUIDS = {
+  raw: RAW_DATA_UUID,
+  filtered: FILTERED_DATA_UUID,
+  summary: SUMMARY_UUID,
+};
+
+// Largest ATT MTU the firmware accepts (ble_link.h); Android stays at 23
+// bytes unless asked, iOS negotiates on its own
+const BLE_REQUEST_MTU = 247;
+
+// Compact reading format (must match firmware reading_codec.h):
+// timestamp_ms (uint32 LE), then an LSB-first bit stream holding the 6-bit
+// channel mask and each present channel's code in channel order.
+// Neurotransmitters and calprotectin are log-scaled over their range,
+// pH and temperature linear.
+const CODEC_HEADER_SIZE = 4;
+const CODEC_CHANNELS = [
+  { field: 'serotonin_nm', min: 10, max: 10000, log: true, bits: 10 },
+  { field: 'dopamine_nm', min: 50, max: 5000, log: true, bits: 10 },
+  { field: 'gaba_nm', min: 100, max: 50000, log: true, bits: 10 },
+  { field: 'ph_level', min: 0, max: 14, log: false, bits: 10 },
+  { field: 'temperature_c', min: 20, max: 45.5, log: false, bits: 8 },
+  { field: 'calprotectin_ug_g', min: 5, max: 5000, log: true, bits: 8 },
+];
+
+// Bytes in a compact reading, or 0 until the mask byte has arrived
+export function compactReadingLength(bytes) {
+  if (bytes.length <= CODEC_HEADER_SIZE) {
+    return 0;
+  }
+  const mask = bytes[CODEC_HEADER_SIZE] & 0x3f;
+  let nbits = CODEC_CHANNELS.length;
+  CODEC_CHANNELS.forEach((channel, i) => {
+    if (mask & (1 << i)) {
+      nbits += channel.bits;
+    }
+  });
+  return CODEC_HEADER_SIZE + Math.ceil(nbits / 8);
+}
+
+// A batch is compact readings back to back; decoding stops at the first
+// byte that does not start a valid reading (e.g. zero padding)
+export function decodeReadingBatch(bytes) {
+  const readings = [];
+  let at = 0;
+  while (at < bytes.length) {
+    const rest = bytes.slice(at);
+    const reading = decodeCompactReading(rest);
+    if (!reading) {
+      break;
+    }
+    readings.push(reading);
+    at += compactReadingLength(rest);
+  }
+  return readings;
+}
+
+// Channels absent from the mask are left out of the result
+export function decodeCompactReading(bytes) {
+  const length = compactReadingLength(bytes);
+  const mask = length ? bytes[CODEC_HEADER_SIZE] & 0x3f : 0;
+  if (!mask || bytes.length < length) {
+    return null;
+  }
+
+  const reading = {
+    timestamp_ms: (bytes[0] | (bytes[1] << 8) | (bytes[2] << 16) | (bytes[3] << 24)) >>> 0,
+    channel_mask: mask,
+  };
+
+  let acc = bytes[CODEC_HEADER_SIZE] >> 6;
+  let pending = 2;
+  let at = CODEC_HEADER_SIZE + 1;
+  CODEC_CHANNELS.forEach((channel, i) => {
+    if (!(mask & (1 << i))) {
+      return;
+    }
+    while (pending < channel.bits) {
+      acc |= bytes[at++] << pending;
+      pending += 8;
+    }
+    const maxCode = (1 << channel.bits) - 1;
+    const code = acc & maxCode;
+    acc >>>= channel.bits;
+    pending -= channel.bits;
+
+    if (channel.log) {
+      const lo = Math.log(channel.min);
+      const hi = Math.log(channel.max);
+      reading[channel.field] = Math.exp(lo + (code * (hi - lo)) / maxCode);
+    } else {
+      reading[channel.field] = channel.min + (code * (channel.max - channel.min)) / maxCode;
+    }
+  });
+  return reading;
+}
+
+// Raw, filtered and summary streams (must match firmware
+// telemetry_streams.h), little-endian
+const STREAM_READING_HEADER = 5;
+const STREAM_RAW_BITS = 12;
+const STREAM_SUMMARY_HEADER = 9;
+const STREAM_SUMMARY_CHANNEL = 14;
+
+function readU32(bytes, at) {
+  return (bytes[at] | (bytes[at + 1] << 8) | (bytes[at + 2] << 16) | (bytes[at + 3] << 24)) >>> 0;
+}
+
+function readFloat(bytes, at) {
+  return new DataView(Uint8Array.from(bytes.slice(at, at + 4)).buffer).getFloat32(0, true);
+}
+
+function presentChannels(mask) {
+  return CODEC_CHANNELS.map((channel, i) => i).filter((i) => mask & (1 << i));
+}
+
+// Raw stream: timestamp, mask, 12-bit ADC counts packed LSB first
+export function decodeRawReading(bytes) {
+  const channels = presentChannels(bytes[4] & 0x3f);
+  if (bytes.length < STREAM_READING_HEADER + Math.ceil((channels.length * STREAM_RAW_BITS) / 8)) {
+    return null;
+  }
+  const counts = {};
+  channels.forEach((ch, n) => {
+    const bit = n * STREAM_RAW_BITS;
+    const at = STREAM_READING_HEADER + (bit >> 3);
+    const word = bytes[at] | ((bytes[at + 1] || 0) << 8);
+    counts[CODEC_CHANNELS[ch].field] = (word >> (bit & 7)) & 0x0fff;
+  });
+  return { timestamp_ms: readU32(bytes, 0), channel_mask: bytes[4] & 0x3f, counts };
+}
+
+// Filtered stream: timestamp, mask, float32 units
+export function decodeFilteredReading(bytes) {
+  const mask = bytes[4] & 0x3f;
+  const channels = presentChannels(mask);
+  if (!mask || bytes.length < STREAM_READING_HEADER + channels.length * 4) {
+    return null;
+  }
+  const reading = { timestamp_ms: readU32(bytes, 0), channel_mask: mask };
+  channels.forEach((ch, n) => {
+    reading[CODEC_CHANNELS[ch].field] = readFloat(bytes, STREAM_READING_HEADER + n * 4);
+  });
+  return reading;
+}
+
+// Summary stream: period start and length, then count, min, mean and max
+// per present channel
+export function decodeSummary(bytes) {
+  const mask = bytes[8] & 0x3f;
+  const channels = presentChannels(mask);
+  if (!mask || bytes.length < STREAM_SUMMARY_HEADER + channels.length * STREAM_SUMMARY_CHANNEL) {
+    return null;
+  }
+  const summary = { start_ms: readU32(bytes, 0), period_ms: readU32(bytes, 4), channels: {} };
+  channels.forEach((ch, n) => {
+    const at = STREAM_SUMMARY_HEADER + n * STREAM_SUMMARY_CHANNEL;
+    summary.channels[CODEC_CHANNELS[ch].field] = {
+      count: bytes[at] | (bytes[at + 1] << 8),
+      min: readFloat(bytes, at + 2),
+      mean: readFloat(bytes, at + 6),
+      max: readFloat(bytes, at + 10),
+    };
+  });
+  return summary;
+}
+
+// Frame header on every sensor-data notification (must match firmware
+// ble_frame.h): seq (uint16 LE), fragment index << 4 | count - 1, and the
+// whole packet length. Fragment 0 always starts a packet.
+const FRAME_HEADER_SIZE = 4;
+
+// Rebuilds packets from notifications and counts what the link lost
+export class FrameReassembler {
+  constructor() {
+    this.reset();
+  }
+
+  reset() {
+    this.lastSeq = null;
+    this.parts = null;
+    this.packetSeq = null;
+    this.stats = { packets: 0, fragments: 0, lost: 0, incomplete: 0, gaps: 0, late: 0, malformed: 0 };
+  }
+
+  abandon() {
+    if (this.parts) {
+      this.stats.incomplete++;
+      this.parts = null;
+    }
+  }
+
+  // One notification in; the completed packet, or null
+  feed(notification) {
+    if (notification.length <= FRAME_HEADER_SIZE) {
+      this.stats.malformed++;
+      return null;
+    }
+    const seq = notification[0] | (notification[1] << 8);
+    const index = notification[2] >> 4;
+    const count = (notification[2] & 0x0f) + 1;
+    const length = notification[3];
+    if (index >= count || length === 0) {
+      this.stats.malformed++;
+      return null;
+    }
+    const data = notification.slice(FRAME_HEADER_SIZE);
+
+    // A new packet ends whatever was in progress; numbers skipped since
+    // the newest one never arrived. One behind the newest is a resend.
+    if (!this.parts || seq !== this.parts.seq) {
+      this.abandon();
+      let ahead = 1;
+      if (this.lastSeq !== null) {
+        ahead = ((seq - this.lastSeq) << 16) >> 16;
+      }
+      if (ahead > 0) {
+        if (this.lastSeq !== null && ahead > 1) {
+          this.stats.gaps++;
+          this.stats.lost += ahead - 1;
+        }
+        this.lastSeq = seq;
+      } else if (ahead < 0 && index === 0) {
+        this.stats.late++;
+      }
+
+      // Joined mid-packet: wait for the next fragment 0
+      if (index !== 0) {
+        if (ahead !== 0) {
+          this.stats.incomplete++;
+        }
+        return null;
+      }
+      this.parts = { seq, count, length, next: 0, bytes: [] };
+    }
+
+    const parts = this.parts;
+    if (!parts) {
+      return null;
+    }
+    if (count !== parts.count || length !== parts.length ||
+        parts.bytes.length + data.length > length) {
+      this.abandon();
+      this.stats.malformed++;
+      return null;
+    }
+    if (index !== parts.next) {
+      // A fragment went missing: drop the packet, resync on the next
+      this.abandon();
+      return null;
+    }
+
+    parts.bytes.push(...data);
+    parts.next++;
+    this.stats.fragments++;
+    if (parts.next < count) {
+      return null;
+    }
+    this.parts = null;
+    if (parts.bytes.length !== length) {
+      this.stats.incomplete++;
+      return null;
+    }
+    this.stats.packets++;
+    this.packetSeq = parts.seq;
+    return new Uint8Array(parts.bytes);
+  }
+}
+
+// Which sequence numbers have arrived, for the acknowledgement; mirrors
+// the firmware's AckWindow
+export class AckWindow {
+  constructor() {
+    this.reset();
+  }
+
+  reset() {
+    this.base = null;
+    this.bitmap = 0;
+    this.stats = { delivered: 0, recovered: 0, duplicates: 0, lost: 0 };
+  }
+
+  // Move past base and everything received right after it
+  advance() {
+    let received;
+    do {
+      received = this.bitmap & 1;
+      this.bitmap >>>= 1;
+      this.base = (this.base + 1) & 0xffff;
+    } while (received);
+  }
+
+  // False for a packet already delivered
+  receive(seq) {
+    if (this.base === null) {
+      this.base = seq;
+      this.bitmap = 0;
+    }
+    let offset = ((seq - this.base) << 16) >> 16;
+    if (offset < 0) {
+      this.stats.duplicates++;
+      return false;
+    }
+
+    // Too far ahead for the bitmap: the device has given up the oldest gaps
+    while (offset > ACK_BITS) {
+      this.stats.lost++;
+      this.advance();
+      offset = ((seq - this.base) << 16) >> 16;
+    }
+
+    if (offset === 0) {
+      if (this.bitmap) {
+        this.stats.recovered++;
+      }
+      this.advance();
+    } else {
+      const bit = 2 ** (offset - 1);
+      if (Math.floor(this.bitmap / bit) % 2) {
+        this.stats.duplicates++;
+        return false;
+      }
+      this.bitmap = (this.bitmap + bit) >>> 0;
+    }
+    this.stats.delivered++;
+    return true;
+  }
+
+  // Command arguments: base (uint16 BE), bitmap (uint32 BE)
+  encode() {
+    const base = this.base === null ? 0 : this.base;
+    const bitmap = this.bitmap >>> 0;
+    return [
+      (base >> 8) & 0xff, base & 0xff,
+      (bitmap >>> 24) & 0xff, (bitmap >>> 16) & 0xff, (bitmap >>> 8) & 0xff, bitmap & 0xff,
+    ];
+  }
+}
 
 // AES-128 constants
 const AES_BLOCK_SIZE = 16;
@@ -151,8 +537,20 @@ class BLEService {
     this.subscription = null;
     this.dataCallback = null;
     this.encryptionKey = null;
-    this.reassemblyBuffer = [];
-    this.expectedLength = 0;
+    this.frames = new FrameReassembler();
+    this.acks = new AckWindow();
+    this.ackTimer = null;
+    this.idleAcks = 0;
+    this.lastReading = {};
+    this.logSubscription = null;
+    this.logFrames = new FrameReassembler();
+    this.historyCallback = null;
+    this.logSync = { next: null, packets: 0, lost: 0, syncing: false };
+    this.bulk = null;
+    this.responseSubscription = null;
+    this.streams = {};
+    this.statusWaiters = [];
+    this.commandStats = { acks: 0, failed: 0, lastUs: 0, maxUs: 0 };
   }
 
   get manager() {
@@ -195,12 +593,15 @@ class BLEService {
 
   async connect(deviceId) {
     try {
-      this.device = await this.manager.connectToDevice(deviceId);
+      this.device = await this.manager.connectToDevice(deviceId, { requestMTU: BLE_REQUEST_MTU });
       await this.device.discoverAllServicesAndCharacteristics();
 
       this.device.onDisconnected((error, device) => {
         console.log('Device disconnected:', device?.name);
         this.device = null;
+        this.responseSubscription = null;
+        this.streams = {};
+        this.stopAcknowledging();
       });
 
       return true;
@@ -215,6 +616,12 @@ class BLEService {
       this.subscription.remove();
       this.subscription = null;
     }
+    Object.keys(this.streams).forEach((stream) => this.unsubscribeStream(stream));
+    this.stopAcknowledging();
+    if (this.responseSubscription) {
+      this.responseSubscription.remove();
+      this.responseSubscription = null;
+    }
     if (this.device) {
       await this.device.cancelConnection();
       this.device = null;
@@ -247,6 +654,11 @@ class BLEService {
     this.dataCallback = callback;
   }
 
+  // Readings taken while disconnected, oldest first, each with its seq
+  onHistoryReceived(callback) {
+    this.historyCallback = callback;
+  }
+
   async startMonitoring() {
     if (!this.device) {
       throw new Error('No device connected');
@@ -254,7 +666,9 @@ class BLEService {
 
     await this.sendCommand(CMD_START_SAMPLING);
 
-    this.reassemblyBuffer = [];
+    this.frames.reset();
+    this.acks.reset();
+    this.lastReading = {};
 
     this.subscription = this.device.monitorCharacteristicForService(
       SERVICE_UUID,
@@ -265,32 +679,271 @@ class BLEService {
           return;
         }
         if (characteristic?.value) {
-          const chunk = Buffer.from(characteristic.value, 'base64');
-          this.reassemblyBuffer.push(...chunk);
+          const packet = this.frames.feed(Buffer.from(characteristic.value, 'base64'));
+          if (packet && this.acks.receive(this.frames.packetSeq)) {
+            this.idleAcks = 0;
+            if (!this.ackTimer) {
+              this.startAcknowledging();
+            }
+            this.handlePacket(packet, this.frames.packetSeq !== this.frames.lastSeq);
+          }
+        }
+      }
+    );
 
-          // AES-128 CBC: IV (16) + encrypted SensorReading (padded to 32) = 48 bytes
-          const expectedSize = this.encryptionKey ? 48 : 28;
+    // Catch up on what was logged offline, interleaved with live data
+    this.subscribeLog();
+    await this.sendCommand(CMD_LOG_SYNC);
+  }
 
-          if (this.reassemblyBuffer.length >= expectedSize) {
-            const fullPacket = new Uint8Array(this.reassemblyBuffer.splice(0, expectedSize));
-            const data = this.parseData(fullPacket);
-            if (data && this.dataCallback) {
-              this.dataCallback(data);
-            }
+  // Raw counts, filtered readings or periodic summaries, each decoded and
+  // passed to the callback; the device stops producing a stream once
+  // nothing is subscribed to it
+  subscribeStream(stream, callback) {
+    if (!this.device) {
+      throw new Error('No device connected');
+    }
+    const uuid = STREAM_UUIDS[stream];
+    if (!uuid) {
+      throw new Error('Unknown stream: ' + stream);
+    }
+
+    const decode = { raw: decodeRawReading, filtered: decodeFilteredReading, summary: decodeSummary }[stream];
+    const frames = new FrameReassembler();
+    this.unsubscribeStream(stream);
+    const subscription = this.device.monitorCharacteristicForService(
+      SERVICE_UUID,
+      uuid,
+      (error, characteristic) => {
+        if (error) {
+          console.error('Stream notification error:', error);
+          return;
+        }
+        if (!characteristic?.value) {
+          return;
+        }
+        const packet = frames.feed(Buffer.from(characteristic.value, 'base64'));
+        if (!packet) {
+          return;
+        }
+        const plain = this.encryptionKey ? aes128CbcDecrypt(packet, this.encryptionKey) : packet;
+        const decoded = plain ? decode(Array.from(plain)) : null;
+        if (decoded) {
+          callback(decoded);
+        }
+      }
+    );
+    this.streams[stream] = { subscription, frames };
+  }
+
+  unsubscribeStream(stream) {
+    const entry = this.streams[stream];
+    if (entry) {
+      entry.subscription.remove();
+      delete this.streams[stream];
+    }
+  }
+
+  async setSummaryPeriod(seconds) {
+    await this.sendCommand(CMD_SET_SUMMARY_PERIOD, [(seconds >> 8) & 0xff, seconds & 0xff]);
+  }
+
+  // Advertise an encrypted snapshot of the latest reading every intervalMs
+  // while disconnected, for hubs that never connect; 0 turns it off
+  async setBroadcastInterval(intervalMs) {
+    await this.sendCommand(CMD_SET_BROADCAST, [(intervalMs >> 8) & 0xff, intervalMs & 0xff]);
+  }
+
+  subscribeLog() {
+    this.logFrames.reset();
+    this.logSync = { next: null, packets: 0, lost: 0, syncing: true };
+    if (this.logSubscription) {
+      this.logSubscription.remove();
+    }
+    this.logSubscription = this.device.monitorCharacteristicForService(
+      SERVICE_UUID,
+      LOG_DATA_UUID,
+      (error, characteristic) => {
+        if (error) {
+          console.error('Log notification error:', error);
+          return;
+        }
+        if (characteristic?.value) {
+          const notification = Buffer.from(characteristic.value, 'base64');
+          if (this.bulk) {
+            this.bulk.bytes += notification.length;
+          }
+          const packet = this.logFrames.feed(notification);
+          if (packet) {
+            this.handleLogPacket(packet);
           }
         }
       }
     );
   }
 
+  // Pull the offline log at full speed; resolves with the throughput once
+  // the end marker arrives. Readings go to onHistoryReceived as usual.
+  async downloadHistory(from = null) {
+    if (!this.device) {
+      throw new Error('No device connected');
+    }
+
+    this.subscribeLog();
+    const done = new Promise((resolve) => {
+      this.bulk = { started: Date.now(), bytes: 0, readings: 0, processed: 0, resolve };
+    });
+    const payload = [(BULK_CREDITS >> 8) & 0xff, BULK_CREDITS & 0xff];
+    if (from !== null) {
+      payload.push((from >>> 24) & 0xff, (from >>> 16) & 0xff, (from >>> 8) & 0xff, from & 0xff);
+    }
+    await this.sendCommand(CMD_BULK_START, payload);
+    return done;
+  }
+
+  finishBulk() {
+    const bulk = this.bulk;
+    this.bulk = null;
+    const ms = Math.max(Date.now() - bulk.started, 1);
+    bulk.resolve({
+      readings: bulk.readings,
+      bytes: bulk.bytes,
+      ms,
+      kBps: bulk.bytes / ms,
+    });
+  }
+
+  returnBulkCredits() {
+    const bulk = this.bulk;
+    if (++bulk.processed % BULK_CREDIT_BATCH !== 0) {
+      return;
+    }
+    this.sendCommand(CMD_BULK_CREDIT, [0, BULK_CREDIT_BATCH]).catch((error) => {
+      console.warn('Bulk credit grant failed:', error);
+    });
+  }
+
+  handleLogPacket(packet) {
+    const decrypted = this.encryptionKey ? aes128CbcDecrypt(packet, this.encryptionKey) : packet;
+    if (!decrypted || decrypted.length < LOG_PACKET_HEADER) {
+      return;
+    }
+    const first = (decrypted[0] | (decrypted[1] << 8) | (decrypted[2] << 16) | (decrypted[3] << 24)) >>> 0;
+    const readings = decodeReadingBatch(decrypted.slice(LOG_PACKET_HEADER));
+    const sync = this.logSync;
+
+    if (!readings.length) {
+      // End of the log: everything before first has been offered
+      sync.syncing = false;
+      sync.next = first;
+      this.acknowledgeLog(first);
+      if (this.bulk) {
+        this.finishBulk();
+      }
+      return;
+    }
+
+    // Readings the log wrapped over before they could be sent
+    if (sync.next !== null && first > sync.next) {
+      sync.lost += first - sync.next;
+    }
+    const fresh = readings
+      .map((reading, i) => ({ ...reading, seq: first + i }))
+      .filter((reading) => sync.next === null || reading.seq >= sync.next);
+    sync.next = Math.max(sync.next ?? 0, first + readings.length);
+    sync.packets++;
+
+    if (fresh.length && this.historyCallback) {
+      this.historyCallback(fresh);
+    }
+    if (sync.packets % LOG_ACK_PACKETS === 0) {
+      this.acknowledgeLog(sync.next);
+    }
+    if (this.bulk) {
+      this.bulk.readings += fresh.length;
+      this.returnBulkCredits();
+    }
+  }
+
+  acknowledgeLog(seq) {
+    const bytes = [(seq >>> 24) & 0xff, (seq >>> 16) & 0xff, (seq >>> 8) & 0xff, seq & 0xff];
+    this.sendCommand(CMD_LOG_ACK, bytes).catch((error) => {
+      console.warn('Log acknowledgement failed:', error);
+    });
+  }
+
+  // Catch-up progress: next expected seq, packets, readings lost to wrap
+  getLogSyncState() {
+    return { ...this.logSync };
+  }
+
+  // Packets delivered, lost to sequence gaps or left incomplete since
+  // monitoring started
+  getFrameStats() {
+    return { ...this.frames.stats };
+  }
+
+  // Packets delivered, recovered from resends, duplicates dropped and
+  // gaps given up since monitoring started
+  getAckStats() {
+    return { ...this.acks.stats };
+  }
+
+  // Runs while packets arrive and a few rounds after
+  startAcknowledging() {
+    this.stopAcknowledging();
+    this.idleAcks = 0;
+    this.ackTimer = setInterval(() => this.acknowledgeTelemetry(), ACK_INTERVAL_MS);
+  }
+
+  stopAcknowledging() {
+    if (this.ackTimer) {
+      clearInterval(this.ackTimer);
+      this.ackTimer = null;
+    }
+  }
+
+  acknowledgeTelemetry() {
+    if (!this.device || this.idleAcks >= ACK_IDLE_ROUNDS) {
+      this.stopAcknowledging();
+      return;
+    }
+    this.idleAcks++;
+    this.sendCommand(CMD_ACK_TELEMETRY, this.acks.encode()).catch((error) => {
+      console.warn('Telemetry acknowledgement failed:', error);
+    });
+  }
+
+  handlePacket(packet, late = false) {
+    this.parseBatch(packet).forEach((data) => {
+      // A resent batch is older than what is already shown: passed on as
+      // it is, without holding its values
+      if (late) {
+        if (this.dataCallback) {
+          this.dataCallback(data);
+        }
+        return;
+      }
+      // Slow channels hold their last value between conversions
+      this.lastReading = { ...this.lastReading, ...data };
+      if (this.dataCallback) {
+        this.dataCallback(this.lastReading);
+      }
+    });
+  }
+
   async stopMonitoring() {
     await this.sendCommand(CMD_STOP_SAMPLING);
 
+    this.stopAcknowledging();
     if (this.subscription) {
       this.subscription.remove();
       this.subscription = null;
     }
-    this.reassemblyBuffer = [];
+    if (this.logSubscription) {
+      this.logSubscription.remove();
+      this.logSubscription = null;
+    }
   }
 
   async sendCommand(command, payload = []) {
@@ -308,6 +961,97 @@ class BLEService {
     );
   }
 
+  subscribeResponses() {
+    if (this.responseSubscription) {
+      return;
+    }
+    this.responseSubscription = this.device.monitorCharacteristicForService(
+      SERVICE_UUID,
+      RESPONSE_UUID,
+      (error, characteristic) => {
+        if (error) {
+          console.error('Response notification error:', error);
+          return;
+        }
+        if (characteristic?.value) {
+          this.handleResponse(new Uint8Array(Buffer.from(characteristic.value, 'base64')));
+        }
+      }
+    );
+  }
+
+  handleResponse(bytes) {
+    if (bytes[0] === RESP_ACK && bytes.length >= 8) {
+      const latencyUs = (bytes[4] | (bytes[5] << 8) | (bytes[6] << 16) | (bytes[7] << 24)) >>> 0;
+      const stats = this.commandStats;
+      stats.acks++;
+      stats.lastUs = latencyUs;
+      stats.maxUs = Math.max(stats.maxUs, latencyUs);
+      if (bytes[2] !== 0) {
+        stats.failed++;
+        console.warn('Command 0x' + bytes[1].toString(16) + ' refused:', COMMAND_STATUS[bytes[2]] || bytes[2]);
+      }
+    } else if (bytes[0] === RESP_STATUS && bytes.length >= 19) {
+      const status = this.parseStatus(bytes);
+      const waiters = this.statusWaiters;
+      this.statusWaiters = [];
+      waiters.forEach((waiter) => waiter(status));
+    }
+  }
+
+  parseStatus(bytes) {
+    const u16 = (i) => bytes[i] | (bytes[i + 1] << 8);
+    const u32 = (i) => (u16(i) | (u16(i + 2) << 16)) >>> 0;
+    const flags = bytes[1];
+    return {
+      sampling: (flags & 0x01) !== 0,
+      keySet: (flags & 0x02) !== 0,
+      logSync: (flags & 0x04) !== 0,
+      bulk: (flags & 0x08) !== 0,
+      procedure: (flags & 0x10) !== 0,
+      backpressure: (flags & 0x20) !== 0,
+      battery: bytes[2],
+      samplingIntervalMs: u16(3),
+      uptimeS: u32(5),
+      logPending: u32(9),
+      connIntervalMs: u16(13) * 1.25,
+      connLatency: bytes[15],
+      phy: bytes[16],
+      procedurePercent: bytes[17],
+      commandDrops: bytes[18],
+    };
+  }
+
+  // One binary status snapshot; resolves with it and the round trip in ms,
+  // or null if the device does not answer
+  async requestStatus() {
+    if (!this.device) {
+      throw new Error('No device connected');
+    }
+
+    this.subscribeResponses();
+    const started = Date.now();
+    const answer = new Promise((resolve) => {
+      const timer = setTimeout(() => {
+        this.statusWaiters = this.statusWaiters.filter((waiter) => waiter !== done);
+        resolve(null);
+      }, STATUS_TIMEOUT_MS);
+      const done = (status) => {
+        clearTimeout(timer);
+        resolve({ ...status, roundTripMs: Date.now() - started });
+      };
+      this.statusWaiters.push(done);
+    });
+    await this.sendCommand(CMD_REQUEST_STATUS);
+    return answer;
+  }
+
+  // Acknowledgements seen, how many were refused and the device's
+  // receive-to-answer time
+  getCommandStats() {
+    return { ...this.commandStats };
+  }
+
   async calibrate() {
     await this.sendCommand(CMD_CALIBRATE);
   }
@@ -341,7 +1085,19 @@ class BLEService {
     await this.sendCommand(CMD_SET_INTERVAL, [highByte, lowByte]);
   }
 
+  async setBatchLatency(latencyMs) {
+    const highByte = (latencyMs >> 8) & 0xff;
+    const lowByte = latencyMs & 0xff;
+    await this.sendCommand(CMD_SET_BATCH_LATENCY, [highByte, lowByte]);
+  }
+
+  // First reading of a packet, or null
   parseData(rawBytes) {
+    const readings = this.parseBatch(rawBytes);
+    return readings.length ? readings[0] : null;
+  }
+
+  parseBatch(rawBytes) {
     // Backward compatibility: accept base64 string or Uint8Array
     if (typeof rawBytes === 'string') {
       rawBytes = new Uint8Array(Buffer.from(rawBytes, 'base64'));
@@ -353,33 +1109,17 @@ class BLEService {
       decrypted = aes128CbcDecrypt(rawBytes, this.encryptionKey);
       if (!decrypted) {
         console.warn('AES decryption failed');
-        return null;
+        return [];
       }
     } else {
       decrypted = rawBytes;
     }
 
-    // Parse sensor reading structure (28 bytes):
-    // float serotonin_nm (4), float dopamine_nm (4), float gaba_nm (4),
-    // float ph_level (4), float temperature_c (4), float calprotectin_ug_g (4),
-    // uint32_t timestamp_ms (4)
-    if (decrypted.length < 28) {
+    const readings = decodeReadingBatch(decrypted);
+    if (!readings.length) {
       console.warn('Invalid data length:', decrypted.length);
-      return null;
     }
-
-    const buf = Buffer.from(decrypted);
-    const dataView = new DataView(buf.buffer, buf.byteOffset);
-
-    return {
-      serotonin_nm: dataView.getFloat32(0, true),
-      dopamine_nm: dataView.getFloat32(4, true),
-      gaba_nm: dataView.getFloat32(8, true),
-      ph_level: dataView.getFloat32(12, true),
-      temperature_c: dataView.getFloat32(16, true),
-      calprotectin_ug_g: dataView.getFloat32(20, true),
-      timestamp_ms: dataView.getUint32(24, true),
-    };
+    return readings;
   }
 
   async readBatteryLevel() {